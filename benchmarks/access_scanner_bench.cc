@@ -16,70 +16,10 @@
  */
 
 #include <access_scanner.h>
-#include <benchmark/benchmark.h>
-#include <fakes/fake_executorpool.h>
-#include <mock/mock_synchronous_ep_engine.h>
-#include <programs/engine_testapp/mock_server.h>
-#include "benchmark_memory_tracker.h"
-#include "dcp/dcpconnmap.h"
-
-class EngineFixture : public benchmark::Fixture {
-protected:
-    void SetUp(const benchmark::State& state) override {
-        SingleThreadedExecutorPool::replaceExecutorPoolWithFake();
-        executorPool = reinterpret_cast<SingleThreadedExecutorPool*>(
-                ExecutorPool::get());
-        memoryTracker = BenchmarkMemoryTracker::getInstance(
-                *get_mock_server_api()->alloc_hooks);
-        memoryTracker->reset();
-        std::string config = "dbname=benchmarks-test;" + varConfig;
-
-        engine.reset(new SynchronousEPEngine(config));
-        ObjectRegistry::onSwitchThread(engine.get());
-
-        engine->setKVBucket(
-                engine->public_makeBucket(engine->getConfiguration()));
-
-        engine->public_initializeEngineCallbacks();
-        initialize_time_functions(get_mock_server_api()->core);
-        cookie = create_mock_cookie();
-    }
-
-    void TearDown(const benchmark::State& state) override {
-        executorPool->cancelAndClearAll();
-        destroy_mock_cookie(cookie);
-        destroy_mock_event_callbacks();
-        engine->getDcpConnMap().manageConnections();
-        engine.reset();
-        ObjectRegistry::onSwitchThread(nullptr);
-        ExecutorPool::shutdown();
-        memoryTracker->destroyInstance();
-    }
-
-    Item make_item(uint16_t vbid,
-                   const std::string& key,
-                   const std::string& value) {
-        uint8_t ext_meta[EXT_META_LEN] = {PROTOCOL_BINARY_DATATYPE_JSON};
-        Item item({key, DocNamespace::DefaultCollection},
-                  /*flags*/ 0,
-                  /*exp*/ 0,
-                  value.c_str(),
-                  value.size(),
-                  ext_meta,
-                  sizeof(ext_meta));
-        item.setVBucketId(vbid);
-        return item;
-    }
-
-    std::unique_ptr<SynchronousEPEngine> engine;
-    const void* cookie = nullptr;
-    const int vbid = 0;
-
-    // Allows subclasses to add stuff to the config
-    std::string varConfig;
-    BenchmarkMemoryTracker* memoryTracker;
-    SingleThreadedExecutorPool* executorPool;
-};
+#include <kvstore.h>
+#include <mutation_log.h>
+#include <sorted_access_log.h>
+#include "engine_fixture.h"
 
 class AccessLogBenchEngine : public EngineFixture {
 protected:
@@ -164,6 +104,177 @@ BENCHMARK_REGISTER_F(AccessLogBenchEngine, MemoryOverhead)
         ->Apply(AccessScannerArguments)
         ->MinTime(0.000001);
 
+/*
+ * Fixture for loading the documents an access log lists from disk, as warmup
+ * does, with the log in either format.
+ */
+class AccessLogWarmupBench : public AccessLogBenchEngine {
+protected:
+    void TearDown(const benchmark::State& state) override {
+        remove(logPath.c_str());
+        AccessLogBenchEngine::TearDown(state);
+    }
+
+    // Store and persist numItems documents in vbid, logging every fourth
+    void populate(size_t numItems, bool sorted) {
+        auto* store = engine->getKVBucket();
+        store->setVBucketState(vbid, vbucket_state_active, false);
+        std::string value(200, 'x');
+        std::string keyPrefix(20, 'a');
+        for (size_t i = 0; i < numItems; ++i) {
+            auto item = make_item(vbid, keyPrefix + std::to_string(i), value);
+            store->set(item, cookie);
+        }
+        store->flushVBucket(vbid);
+
+        // The log is written in hash table order, as the access scanner would
+        MutationLog ml(logPath);
+        SortedAccessLogWriter writer(logPath);
+        if (sorted) {
+            writer.open();
+            writer.beginVBucket(vbid);
+        } else {
+            ml.open();
+        }
+        LogEveryFourth visitor(vbid, sorted ? nullptr : &ml,
+                               sorted ? &writer : nullptr);
+        store->getVBucket(vbid)->ht.visit(visitor);
+        if (sorted) {
+            writer.close();
+        } else {
+            ml.commit1();
+            ml.commit2();
+        }
+        numLogged = (numItems + 3) / 4;
+    }
+
+    class LogEveryFourth : public HashTableVisitor {
+    public:
+        LogEveryFourth(uint16_t vbid,
+                       MutationLog* ml,
+                       SortedAccessLogWriter* writer)
+            : vbid(vbid), ml(ml), writer(writer) {
+        }
+
+        void visit(const HashTable::HashBucketLock& lh,
+                   StoredValue* v) override {
+            if (visited++ % 4 == 0) {
+                if (writer) {
+                    writer->add(v->getBySeqno(), v->getKey());
+                } else {
+                    ml->newItem(vbid, v->getKey());
+                }
+            }
+        }
+
+    private:
+        const uint16_t vbid;
+        MutationLog* ml;
+        SortedAccessLogWriter* writer;
+        size_t visited = 0;
+    };
+
+    // Counts, then discards, the documents loaded
+    class CountingCallback : public Callback<GetValue> {
+    public:
+        void callback(GetValue& val) override {
+            delete val.getValue();
+            ++loaded;
+        }
+        size_t loaded = 0;
+    };
+
+    static bool fetchBatch(uint16_t vbId,
+                           const std::set<StoredDocKey>& fetches,
+                           void* arg) {
+        auto* fixture = static_cast<AccessLogWarmupBench*>(arg);
+        vb_bgfetch_queue_t items2fetch;
+        for (auto& key : fetches) {
+            vb_bgfetch_item_ctx_t& ctx = items2fetch[key];
+            ctx.isMetaOnly = false;
+            ctx.bgfetched_list.emplace_back(
+                    std::make_unique<VBucketBGFetchItem>(nullptr, false));
+        }
+        fixture->engine->getKVBucket()->getROUnderlying(vbId)->getMulti(
+                vbId, items2fetch);
+        for (auto& items : items2fetch) {
+            auto& fetched = items.second.bgfetched_list.back();
+            if (fetched->value.getStatus() == ENGINE_SUCCESS) {
+                fixture->loader.callback(fetched->value);
+            }
+        }
+        return true;
+    }
+
+    // As Warmup::doWarmup
+    void loadMutationLog() {
+        MutationLog ml(logPath);
+        ml.open();
+        MutationLogHarvester harvester(ml, engine.get());
+        harvester.setVBucket(vbid);
+        auto it = ml.begin();
+        do {
+            it = harvester.loadBatch(
+                    it, engine->getConfiguration().getWarmupBatchSize());
+            harvester.apply(this, &fetchBatch);
+        } while (it != ml.end());
+    }
+
+    // As Warmup::loadSortedAccessLog
+    void loadSortedAccessLog() {
+        SortedAccessLog alog(logPath);
+        alog.open();
+        auto* kvstore = engine->getKVBucket()->getROUnderlying(vbid);
+        auto cb = std::shared_ptr<Callback<GetValue>>(
+                &loader, [](Callback<GetValue>*) {});
+        auto lookup =
+                std::make_shared<SortedAccessLogLookup>(alog.getVBucket(vbid));
+        ScanContext* ctx = kvstore->initScanContext(
+                cb,
+                lookup,
+                vbid,
+                lookup->getStartSeqno(),
+                DocumentFilter::NO_DELETES,
+                ValueFilter::VALUES_DECOMPRESSED);
+        kvstore->scan(ctx);
+        kvstore->destroyScanContext(ctx);
+    }
+
+    const std::string logPath = "access_scanner_bench.alog";
+    size_t numLogged = 0;
+    CountingCallback loader;
+};
+
+/*
+ * Loads the documents listed by an access log from disk, as warmup does, to
+ * compare the MutationLog format (keys fetched in batches in key order) with
+ * the sorted format (one scan of the vBucket in seqno order).
+ * Variables:
+ *  - range(0) : The format of the log (0: mutation_log, 1: sorted)
+ *  - range(1) : The number of items stored; a quarter of them are logged
+ */
+BENCHMARK_DEFINE_F(AccessLogWarmupBench, LoadFromAccessLog)
+(benchmark::State& state) {
+    const bool sorted = state.range(0) == 1;
+    state.SetLabel(sorted ? "sorted" : "mutation_log");
+    populate(state.range(1), sorted);
+
+    while (state.KeepRunning()) {
+        if (sorted) {
+            loadSortedAccessLog();
+        } else {
+            loadMutationLog();
+        }
+    }
+    if (loader.loaded != numLogged * state.iterations()) {
+        state.SkipWithError("Didn't load every logged document");
+    }
+    state.SetItemsProcessed(loader.loaded);
+}
+
+BENCHMARK_REGISTER_F(AccessLogWarmupBench, LoadFromAccessLog)
+        ->Apply(AccessScannerArguments);
+
 static char allow_no_stats_env[] = "ALLOW_NO_STATS_UPDATE=yeah";
 int main(int argc, char** argv) {
     putenv(allow_no_stats_env);
@@ -0,0 +1,79 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <bloomfilter.h>
+#include <storeddockey.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * Compares the Standard and Blocked bloom filter layouts. The filter is
+ * sized for range(1) keys at a 1% false positive rate and filled with them;
+ * lookups then probe a mix of present and absent keys.
+ * Variables:
+ *  - range(0) : The layout (0: Standard, 1: Blocked)
+ *  - range(1) : The number of keys in the filter
+ *
+ * The label reports the filter size and the measured false positive rate.
+ */
+static void BloomFilterMaybeKeyExists(benchmark::State& state) {
+    const auto layout = state.range(0) == 0 ? BloomFilterLayout::Standard
+                                            : BloomFilterLayout::Blocked;
+    const int numKeys = state.range(1);
+    BloomFilter filter(numKeys, 0.01, BFILTER_ENABLED, layout);
+
+    std::vector<StoredDocKey> keys;
+    keys.reserve(numKeys * 2);
+    for (int i = 0; i < numKeys * 2; i++) {
+        keys.emplace_back("key_" + std::to_string(i),
+                          DocNamespace::DefaultCollection);
+    }
+    for (int i = 0; i < numKeys; i++) {
+        filter.addKey(keys[i]);
+    }
+
+    size_t falsePositives = 0;
+    for (int i = numKeys; i < numKeys * 2; i++) {
+        if (filter.maybeKeyExists(keys[i])) {
+            falsePositives++;
+        }
+    }
+
+    size_t index = 0;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(filter.maybeKeyExists(keys[index]));
+        if (++index == keys.size()) {
+            index = 0;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(std::string(layout == BloomFilterLayout::Standard
+                                       ? "Standard"
+                                       : "Blocked") +
+                   " bytes:" + std::to_string(filter.getFilterSize() / 8) +
+                   " fp_rate:" +
+                   std::to_string(double(falsePositives) / numKeys));
+}
+
+BENCHMARK(BloomFilterMaybeKeyExists)
+        ->ArgPair(0, 10000)
+        ->ArgPair(1, 10000)
+        ->ArgPair(0, 1000000)
+        ->ArgPair(1, 1000000);
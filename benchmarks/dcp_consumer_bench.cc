@@ -0,0 +1,148 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "engine_fixture.h"
+
+#include <mock/mock_dcp_consumer.h>
+
+#include <thread>
+#include <vector>
+
+/*
+ * Fixture with a DCP consumer streaming numVbuckets replica vbuckets over
+ * one connection - the replica side of a rebalance.
+ */
+class DcpConsumerBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        varConfig = "dcp_consumer_processor_tasks=" +
+                    std::to_string(state.range(0));
+        EngineFixture::SetUp(state);
+
+        consumer = new MockDcpConsumer(*engine, cookie, "bench_consumer");
+        for (uint16_t vb = 0; vb < numVbuckets; ++vb) {
+            engine->getKVBucket()->setVBucketState(
+                    vb, vbucket_state_replica, false);
+            consumer->addStream(/*opaque*/ 0, vb, /*flags*/ 0);
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        consumer->closeAllStreams();
+        consumer->cancelTask();
+        consumer.reset();
+        EngineFixture::TearDown(state);
+    }
+
+    // Buffer a snapshot of itemsPerVbucket mutations on every vbucket, as
+    // when they arrive faster than the replica can apply them.
+    void bufferSnapshots() {
+        auto& stats = engine->getEpStats();
+        const ssize_t queueCap = stats.replicationThrottleWriteQueueCap;
+        stats.replicationThrottleWriteQueueCap = 0;
+
+        const std::string value(256, 'x');
+        for (uint16_t vb = 0; vb < numVbuckets; ++vb) {
+            const uint32_t opaque = consumer->getVbucketStream(vb)->getOpaque();
+            consumer->snapshotMarker(opaque,
+                                     vb,
+                                     seqno + 1,
+                                     seqno + itemsPerVbucket,
+                                     MARKER_FLAG_MEMORY);
+            for (uint64_t ii = 1; ii <= itemsPerVbucket; ++ii) {
+                const std::string key = "key" + std::to_string(ii);
+                const DocKey docKey{key, DocNamespace::DefaultCollection};
+                consumer->mutation(
+                        opaque,
+                        docKey,
+                        {(const uint8_t*)value.c_str(), value.length()},
+                        0, // privileged bytes
+                        PROTOCOL_BINARY_RAW_BYTES, // datatype
+                        0, // cas
+                        vb, // vbucket
+                        0, // flags
+                        seqno + ii, // bySeqno
+                        0, // revSeqno
+                        0, // exptime
+                        0, // locktime
+                        {}, // meta
+                        0); // nru
+            }
+        }
+        seqno += itemsPerVbucket;
+
+        stats.replicationThrottleWriteQueueCap = queueCap;
+    }
+
+    // Persist what has been applied and drop the closed checkpoints, as the
+    // flusher and checkpoint remover would, so memory doesn't grow across
+    // iterations.
+    void flushAll() {
+        auto* store = engine->getKVBucket();
+        for (uint16_t vb = 0; vb < numVbuckets; ++vb) {
+            store->flushVBucket(vb);
+            auto vbucket = store->getVBucket(vb);
+            bool newCheckpointCreated;
+            vbucket->checkpointManager.removeClosedUnrefCheckpoints(
+                    *vbucket, newCheckpointCreated);
+        }
+    }
+
+    const uint16_t numVbuckets = 64;
+    const uint64_t itemsPerVbucket = 100;
+    uint64_t seqno = 0;
+    SingleThreadedRCPtr<MockDcpConsumer> consumer;
+};
+
+/*
+ * Throughput of applying a buffered snapshot on every vbucket with
+ * range(0) Processor tasks, each played by a thread.
+ */
+BENCHMARK_DEFINE_F(DcpConsumerBench, ApplyBufferedSnapshots)
+(benchmark::State& state) {
+    state.SetLabel("processor_tasks=" + std::to_string(state.range(0)));
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        bufferSnapshots();
+        state.ResumeTiming();
+
+        std::vector<std::thread> processors;
+        for (int ii = 0; ii < state.range(0); ++ii) {
+            processors.emplace_back([this]() {
+                ObjectRegistry::onSwitchThread(engine.get());
+                while (consumer->processBufferedItems() != all_processed) {
+                }
+            });
+        }
+        for (auto& processor : processors) {
+            processor.join();
+        }
+
+        state.PauseTiming();
+        flushAll();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * numVbuckets *
+                            itemsPerVbucket);
+}
+
+BENCHMARK_REGISTER_F(DcpConsumerBench, ApplyBufferedSnapshots)
+        ->Arg(1)
+        ->Arg(2)
+        ->Arg(4)
+        ->Arg(8)
+        ->UseRealTime();
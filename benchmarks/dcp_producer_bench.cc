@@ -0,0 +1,95 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "engine_fixture.h"
+
+#include <mock/mock_dcp_producer.h>
+#include <mock/mock_stream.h>
+
+#include <memcached/dcp.h>
+
+#include <limits>
+
+static EventuallyPersistentEngine* benchEngine;
+
+// The server's side of a mutation: just give up the item.
+static ENGINE_ERROR_CODE benchMutation(const void* cookie,
+                                       uint32_t opaque,
+                                       item* itm,
+                                       uint16_t vbucket,
+                                       uint64_t by_seqno,
+                                       uint64_t rev_seqno,
+                                       uint32_t lock_time,
+                                       const void* meta,
+                                       uint16_t nmeta,
+                                       uint8_t nru) {
+    benchEngine->itemRelease(cookie, itm);
+    return ENGINE_SUCCESS;
+}
+
+/*
+ * Fixture with a DCP producer streaming small mutations from numVbuckets
+ * streams, none of which ever run out.
+ */
+class DcpProducerBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        varConfig = "dcp_producer_batch_item_limit=" +
+                    std::to_string(state.range(0));
+        EngineFixture::SetUp(state);
+        benchEngine = engine.get();
+
+        producer = new MockDcpProducer(
+                *engine, cookie, "bench_producer", /*notifyOnly*/ false);
+        queued_item item(new Item(make_item(0, "key", "value")));
+        for (uint16_t vb = 0; vb < numVbuckets; ++vb) {
+            producer->addStream(stream_t(new MockMutationStream(
+                    *producer, vb, item, std::numeric_limits<size_t>::max())));
+        }
+
+        producers.mutation = benchMutation;
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        producer->closeAllStreams();
+        producer.reset();
+        EngineFixture::TearDown(state);
+    }
+
+    const uint16_t numVbuckets = 64;
+    SingleThreadedRCPtr<MockDcpProducer> producer;
+    dcp_message_producers producers = {};
+};
+
+/*
+ * Throughput of DcpProducer::step, sending one message per step
+ * (range(0) == 1) or batches of up to range(0) messages.
+ */
+BENCHMARK_DEFINE_F(DcpProducerBench, StepSmallMutations)
+(benchmark::State& state) {
+    state.SetLabel("batch_item_limit=" + std::to_string(state.range(0)));
+    const size_t sentBefore = producer->getItemsSent();
+    while (state.KeepRunning()) {
+        producer->step(&producers);
+    }
+    state.SetItemsProcessed(producer->getItemsSent() - sentBefore);
+}
+
+BENCHMARK_REGISTER_F(DcpProducerBench, StepSmallMutations)
+        ->Arg(1)
+        ->Arg(8)
+        ->Arg(32);
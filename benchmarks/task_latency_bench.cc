@@ -0,0 +1,84 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <stats.h>
+#include <task_latency_histograms.h>
+
+#include <chrono>
+#include <memory>
+
+/*
+ * The cost an ExecutorThread pays to record one task run in the pool's
+ * TaskLatencyHistograms, each benchmark thread recording into its own shard
+ * as the executor threads do. Tasks run for microseconds at the least, so
+ * this needs to stay in the low nanoseconds to add well under 1% to them.
+ */
+static void TaskLatencyHistogramsRecord(benchmark::State& state) {
+    static std::unique_ptr<TaskLatencyHistograms> histos;
+    if (state.thread_index == 0) {
+        histos.reset(new TaskLatencyHistograms());
+    }
+    const std::array<TaskId, 2> ids{
+            {TaskId::MultiBGFetcherTask, TaskId::FlusherTask}};
+
+    size_t iteration = 0;
+    while (state.KeepRunning()) {
+        const auto wait = std::chrono::microseconds(iteration & 0xfff);
+        histos->record(state.thread_index,
+                       ids[iteration & 1],
+                       wait,
+                       wait * 4);
+        iteration++;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index == 0) {
+        histos.reset();
+    }
+}
+
+/*
+ * For comparison, the cost of recording the same into the per-bucket
+ * scheduling and runtime histograms (KVBucket::logQTime/logRunTime), which
+ * all threads share.
+ */
+static void TaskLatencyBucketHistogramAdd(benchmark::State& state) {
+    static std::unique_ptr<EPStats::ProcessDurationHistogram> schedHisto;
+    static std::unique_ptr<EPStats::ProcessDurationHistogram> runHisto;
+    if (state.thread_index == 0) {
+        schedHisto.reset(new EPStats::ProcessDurationHistogram());
+        runHisto.reset(new EPStats::ProcessDurationHistogram());
+    }
+
+    size_t iteration = 0;
+    while (state.KeepRunning()) {
+        const auto wait = iteration & 0xfff;
+        schedHisto->add(wait);
+        runHisto->add(wait * 4);
+        iteration++;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index == 0) {
+        schedHisto.reset();
+        runHisto.reset();
+    }
+}
+
+BENCHMARK(TaskLatencyHistogramsRecord)->Threads(1)->Threads(4)->Threads(16);
+BENCHMARK(TaskLatencyBucketHistogramAdd)->Threads(1)->Threads(4)->Threads(16);
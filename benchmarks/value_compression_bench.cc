@@ -0,0 +1,110 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "engine_fixture.h"
+
+#include <algorithm>
+
+/*
+ * Fixture running the engine with values held uncompressed
+ * (compression_mode=off, range(0) == 0) or compressed (compression_mode=
+ * active, range(0) == 1).
+ */
+class ValueCompressionBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        varConfig = state.range(0) == 1 ? "compression_mode=active"
+                                        : "compression_mode=off";
+        EngineFixture::SetUp(state);
+        engine->getKVBucket()->setVBucketState(
+                vbid, vbucket_state_active, false);
+    }
+
+    // A JSON document of about 1KB, of the repetitive sort that compresses
+    // 3-5x with snappy.
+    static std::string makeDocument(size_t seed) {
+        std::string doc = "{\"id\":" + std::to_string(seed) + ",\"orders\":[";
+        for (int ii = 0; ii < 8; ++ii) {
+            doc += std::string(ii ? "," : "") + "{\"order_id\":" +
+                   std::to_string(seed * 8 + ii) +
+                   ",\"status\":\"shipped\",\"currency\":\"USD\","
+                   "\"warehouse\":\"eu-west-1\",\"items\":" +
+                   std::to_string(ii + 1) + ",\"gift\":false}";
+        }
+        return doc + "]}";
+    }
+
+    std::string keyOf(size_t ii) {
+        return keyPrefix + std::to_string(ii);
+    }
+
+    // Realistic key lengths
+    const std::string keyPrefix = std::string(20, 'k');
+    const size_t numItems = 10000;
+};
+
+/*
+ * Throughput of front-end sets, and the memory held per item once numItems
+ * have been stored.
+ */
+BENCHMARK_DEFINE_F(ValueCompressionBench, Set)(benchmark::State& state) {
+    state.SetLabel(state.range(0) == 1 ? "active" : "off");
+    std::vector<Item> items;
+    for (size_t ii = 0; ii < numItems; ++ii) {
+        items.push_back(make_item(vbid, keyOf(ii), makeDocument(ii)));
+    }
+    const size_t baseMemory = memoryTracker->getCurrentAlloc();
+
+    size_t ii = 0;
+    while (state.KeepRunning()) {
+        // Copy, as the store may replace the item's value
+        Item item(items[ii++ % numItems]);
+        engine->getKVBucket()->set(item, cookie);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    const size_t stored =
+            std::min(size_t(state.iterations()), numItems);
+    state.counters["BytesPerItem"] =
+            (memoryTracker->getCurrentAlloc() - baseMemory) / stored;
+}
+
+/*
+ * Throughput of front-end gets by a client which hasn't negotiated snappy,
+ * so in compression_mode active each value is decompressed.
+ */
+BENCHMARK_DEFINE_F(ValueCompressionBench, Get)(benchmark::State& state) {
+    state.SetLabel(state.range(0) == 1 ? "active" : "off");
+    for (size_t ii = 0; ii < numItems; ++ii) {
+        auto item = make_item(vbid, keyOf(ii), makeDocument(ii));
+        engine->getKVBucket()->set(item, cookie);
+    }
+
+    size_t ii = 0;
+    while (state.KeepRunning()) {
+        const StoredDocKey key(keyOf(ii++ % numItems),
+                               DocNamespace::DefaultCollection);
+        item* itm = nullptr;
+        engine->get(cookie, &itm, key, vbid, TRACK_STATISTICS);
+        engine->itemRelease(cookie, itm);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(ValueCompressionBench, Set)->Arg(0)->Arg(1);
+BENCHMARK_REGISTER_F(ValueCompressionBench, Get)->Arg(0)->Arg(1);
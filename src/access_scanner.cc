@@ -25,26 +25,39 @@
 #include "access_scanner.h"
 #include "ep_engine.h"
 #include "mutation_log.h"
+#include "sorted_access_log.h"
 #include "vb_count_visitor.h"
 
+#include <algorithm>
 #include <numeric>
+#include <set>
 
 class ItemAccessVisitor : public VBucketVisitor,
                           public PauseResumeHashTableVisitor {
 public:
+    /**
+     * @param filter the vBuckets to log
+     * @param seg if non-zero, write the vBuckets as this segment of a sorted
+     *        access log (see SortedAccessLogSet) rather than a whole log
+     * @param compactAfter merge the segments into the main log afterwards
+     */
     ItemAccessVisitor(KVBucket& _store,
                       EPStats& _stats,
                       uint16_t sh,
                       std::atomic<bool>& sfin,
                       AccessScanner& aS,
-                      uint64_t items_to_scan)
-        : VBucketVisitor(VBucketFilter(
-                  _store.getVBuckets().getShard(sh)->getVBuckets())),
+                      uint64_t items_to_scan,
+                      const VBucketFilter& filter,
+                      size_t seg = 0,
+                      bool compactAfter = false)
+        : VBucketVisitor(filter),
           store(_store),
           stats(_stats),
           startTime(ep_real_time()),
           taskStart(gethrtime()),
           shardID(sh),
+          segment(seg),
+          compactAfter(compactAfter),
           stateFinalizer(sfin),
           as(aS),
           items_to_scan(items_to_scan) {
@@ -55,13 +68,32 @@ public:
         name = name + "." + s.str();
         prev = name + ".old";
         next = name + ".next";
+        if (segment) {
+            segmentPath = SortedAccessLogSet::getSegmentPath(name, segment);
+            next = segmentPath + ".next";
+        }
 
-        log = std::make_unique<MutationLog>(next, conf.getAlogBlockSize());
-        log->open();
-        if (!log->isOpen()) {
+        bool opened;
+        // Incremental runs always write the sorted format, whose segments
+        // can be merged into the main log
+        if (segment || conf.getAlogFormat() == "sorted" ||
+            conf.getAlogIncrementalItems() > 0) {
+            sortedLog = std::make_unique<SortedAccessLogWriter>(next);
+            opened = sortedLog->open();
+            if (!opened) {
+                sortedLog.reset();
+            }
+        } else {
+            log = std::make_unique<MutationLog>(next, conf.getAlogBlockSize());
+            log->open();
+            opened = log->isOpen();
+            if (!opened) {
+                log.reset();
+            }
+        }
+        if (!opened) {
             LOG(EXTENSION_LOG_WARNING, "Failed to open access log: '%s'",
                 next.c_str());
-            log.reset();
         } else {
             LOG(EXTENSION_LOG_NOTICE, "Attempting to generate new access file "
                 "'%s'", next.c_str());
@@ -69,13 +101,20 @@ public:
     }
 
     bool visit(StoredValue& v) override {
-        if (log && v.isResident()) {
+        if (isLogOpen() && v.isResident()) {
             if (v.isExpired(startTime) || v.isDeleted()) {
                 LOG(EXTENSION_LOG_INFO,
                     "INFO: Skipping expired/deleted item: %" PRIu64,
                     v.getBySeqno());
             } else {
-                accessed.push_back(StoredDocKey(v.getKey()));
+                if (sortedLog) {
+                    // Recently referenced items score higher
+                    sortedLog->add(v.getBySeqno(),
+                                   v.getKey(),
+                                   MAX_NRU_VALUE - v.getNRUValue());
+                } else {
+                    accessed.push_back(StoredDocKey(v.getKey()));
+                }
                 return ++items_scanned < items_to_scan;
             }
         }
@@ -95,34 +134,62 @@ public:
         currentBucket = vb;
         update();
 
-        if (log == nullptr) {
+        if (!isLogOpen()) {
             return;
         }
         HashTable::Position ht_start;
         if (vBucketFilter(vb->getId())) {
+            if (sortedLog) {
+                sortedLog->beginVBucket(vb->getId());
+            }
             while (ht_start != vb->ht.endPosition()) {
                 ht_start = vb->ht.pauseResumeVisit(*this, ht_start);
-                update();
-                log->commit1();
-                log->commit2();
+                if (log) {
+                    update();
+                    log->commit1();
+                    log->commit2();
+                }
                 items_scanned = 0;
             }
+            if (sortedLog) {
+                // The vBucket's keys are sorted and written out
+                sortedLog->endVBucket();
+            }
         }
     }
 
     void complete() override {
 
-        if (log == nullptr) {
+        if (!isLogOpen()) {
             updateStateFinalizer(false);
         } else {
-            size_t num_items = log->itemsLogged[int(MutationLogType::New)];
-            log->commit1();
-            log->commit2();
-            log.reset();
+            size_t num_items;
+            if (sortedLog) {
+                num_items = sortedLog->getItemsLogged();
+                if (!sortedLog->close()) {
+                    LOG(EXTENSION_LOG_WARNING, "Failed to write access log: "
+                        "'%s'", next.c_str());
+                    sortedLog.reset();
+                    remove(next.c_str());
+                    updateStateFinalizer(false);
+                    return;
+                }
+                sortedLog.reset();
+            } else {
+                num_items = log->itemsLogged[int(MutationLogType::New)];
+                log->commit1();
+                log->commit2();
+                log.reset();
+            }
             stats.alogRuntime.store(ep_real_time() - startTime);
             stats.alogNumItems.store(num_items);
             stats.accessScannerHisto.add((gethrtime() - taskStart) / 1000);
 
+            if (segment) {
+                completeSegment(num_items);
+                return;
+            }
+
             if (num_items == 0) {
                 LOG(EXTENSION_LOG_NOTICE, "The new access log file is empty. "
                     "Delete it without replacing the current access log...");
@@ -131,42 +198,112 @@ public:
                 return;
             }
 
-            if (access(prev.c_str(), F_OK) == 0 && remove(prev.c_str()) == -1){
-                LOG(EXTENSION_LOG_WARNING, "Failed to remove access log file "
-                    "'%s': %s", prev.c_str(), strerror(errno));
-                remove(next.c_str());
-                updateStateFinalizer(true);
-                return;
-            }
-            LOG(EXTENSION_LOG_NOTICE, "Removed old access log file: '%s'",
-                prev.c_str());
-            if (access(name.c_str(), F_OK) == 0 && rename(name.c_str(),
-                                                          prev.c_str()) == -1){
-                LOG(EXTENSION_LOG_WARNING, "Failed to rename access log file "
-                    "from '%s' to '%s': %s", name.c_str(), prev.c_str(),
-                    strerror(errno));
-                remove(next.c_str());
-                updateStateFinalizer(true);
-                return;
+            if (replaceLog(next)) {
+                LOG(EXTENSION_LOG_NOTICE, "New access log file '%s' created "
+                    "with %" PRIu64 " keys", name.c_str(),
+                    static_cast<uint64_t>(num_items));
+                // Any segments of a previous incremental run are older
+                as.deleteSegments(shardID);
             }
-            LOG(EXTENSION_LOG_NOTICE, "Renamed access log file from '%s' to "
-                "'%s'", name.c_str(), prev.c_str());
-            if (rename(next.c_str(), name.c_str()) == -1) {
-                LOG(EXTENSION_LOG_WARNING, "Failed to rename access log file "
-                    "from '%s' to '%s': %s", next.c_str(), name.c_str(),
-                    strerror(errno));
-                remove(next.c_str());
-                updateStateFinalizer(true);
-                return;
-            }
-            LOG(EXTENSION_LOG_NOTICE, "New access log file '%s' created with "
-                "%" PRIu64 " keys", name.c_str(),
-                static_cast<uint64_t>(num_items));
             updateStateFinalizer(true);
         }
     }
 
 private:
+    /**
+     * Replace the access log with the new one at from, keeping the current
+     * one as the .old log. On failure from is removed.
+     */
+    bool replaceLog(const std::string& from) {
+        if (access(prev.c_str(), F_OK) == 0 && remove(prev.c_str()) == -1){
+            LOG(EXTENSION_LOG_WARNING, "Failed to remove access log file "
+                "'%s': %s", prev.c_str(), strerror(errno));
+            remove(from.c_str());
+            return false;
+        }
+        LOG(EXTENSION_LOG_NOTICE, "Removed old access log file: '%s'",
+            prev.c_str());
+        if (access(name.c_str(), F_OK) == 0 && rename(name.c_str(),
+                                                      prev.c_str()) == -1){
+            LOG(EXTENSION_LOG_WARNING, "Failed to rename access log file "
+                "from '%s' to '%s': %s", name.c_str(), prev.c_str(),
+                strerror(errno));
+            remove(from.c_str());
+            return false;
+        }
+        LOG(EXTENSION_LOG_NOTICE, "Renamed access log file from '%s' to "
+            "'%s'", name.c_str(), prev.c_str());
+        if (rename(from.c_str(), name.c_str()) == -1) {
+            LOG(EXTENSION_LOG_WARNING, "Failed to rename access log file "
+                "from '%s' to '%s': %s", from.c_str(), name.c_str(),
+                strerror(errno));
+            remove(from.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void completeSegment(size_t num_items) {
+        if (rename(next.c_str(), segmentPath.c_str()) == -1) {
+            LOG(EXTENSION_LOG_WARNING, "Failed to rename access log segment "
+                "from '%s' to '%s': %s", next.c_str(), segmentPath.c_str(),
+                strerror(errno));
+            remove(next.c_str());
+            updateStateFinalizer(false);
+            return;
+        }
+        as.segmentWritten(shardID);
+        LOG(EXTENSION_LOG_INFO, "New access log segment '%s' created with "
+            "%" PRIu64 " keys", segmentPath.c_str(),
+            static_cast<uint64_t>(num_items));
+
+        if (compactAfter) {
+            compactSegments();
+        }
+        updateStateFinalizer(true);
+    }
+
+    /**
+     * Merge the segments into a new access log, and remove them.
+     */
+    void compactSegments() {
+        const std::string merged = name + ".next";
+        size_t numSegments;
+        ssize_t num_items;
+        {
+            SortedAccessLogSet alog(name);
+            try {
+                alog.open();
+            } catch (SortedAccessLog::ReadException& e) {
+                LOG(EXTENSION_LOG_WARNING, "Failed to read access log '%s' "
+                    "for compaction: %s", name.c_str(), e.what());
+                return;
+            }
+            numSegments = alog.getNumSegments();
+            num_items = alog.compact(merged);
+        }
+        if (num_items < 0) {
+            LOG(EXTENSION_LOG_WARNING, "Failed to write access log: '%s'",
+                merged.c_str());
+            remove(merged.c_str());
+            return;
+        }
+        if (!replaceLog(merged)) {
+            return;
+        }
+        for (size_t ii = 1; ii <= numSegments; ++ii) {
+            remove(SortedAccessLogSet::getSegmentPath(name, ii).c_str());
+        }
+        as.segmentsCompacted(shardID);
+        LOG(EXTENSION_LOG_NOTICE, "Compacted %" PRIu64 " access log segments "
+            "into '%s' with %" PRIu64 " keys", uint64_t(numSegments),
+            name.c_str(), uint64_t(num_items));
+    }
+
+    bool isLogOpen() const {
+        return log || sortedLog;
+    }
+
     /**
      * Finalizer method called at the end of completing a visit.
      * @param created_log: Did we successfully create a MutationLog object on
@@ -196,10 +333,15 @@ private:
     std::string next;
     std::string name;
     uint16_t shardID;
+    const size_t segment;
+    const bool compactAfter;
+    std::string segmentPath;
 
     std::vector<StoredDocKey> accessed;
 
+    // One or the other, as alog_format says
     std::unique_ptr<MutationLog> log;
+    std::unique_ptr<SortedAccessLogWriter> sortedLog;
     std::atomic<bool> &stateFinalizer;
     AccessScanner &as;
 
@@ -229,8 +371,21 @@ AccessScanner::AccessScanner(KVBucket& _store,
     residentRatioThreshold = conf.getAlogResidentRatioThreshold();
     alogPath = conf.getAlogPath();
     maxStoredItems = conf.getAlogMaxStoredItems();
+    incrementalItems = conf.getAlogIncrementalItems();
+    maxSegments = conf.getAlogMaxSegments();
     double initialSleep = sleeptime;
-    if (useStartTime) {
+    if (incrementalItems > 0) {
+        // Short runs, often, instead of the daily one
+        sleepTime = conf.getAlogIncrementalInterval();
+        initialSleep = sleepTime;
+        snooze(initialSleep);
+        for (size_t i = 0; i < store.getVBuckets().getNumShards(); i++) {
+            IncrementalShard shard;
+            shard.numSegments = SortedAccessLogSet::countSegments(
+                    alogPath + "." + std::to_string(i));
+            incremental.push_back(shard);
+        }
+    } else if (useStartTime) {
         size_t startTime = conf.getAlogTaskTime();
 
         /*
@@ -304,17 +459,12 @@ bool AccessScanner::run() {
                 deleteAlogFile(prev);
                 /* Remove shard access log file */
                 deleteAlogFile(name);
+                deleteSegments(i);
                 stats.accessScannerSkips++;
+            } else if (incrementalItems > 0) {
+                scheduleIncrementalRun(i);
             } else {
-                auto pv = std::make_unique<ItemAccessVisitor>(
-                        store, stats, i, available, *this, maxStoredItems);
-                ExTask task = new VBCBAdaptor(&store,
-                                              TaskId::AccessScannerVisitor,
-                                              std::move(pv),
-                                              "Item Access Scanner",
-                                              sleepTime,
-                                              true);
-                ExecutorPool::get()->schedule(task);
+                scheduleFullRun(i);
             }
         }
     }
@@ -324,6 +474,101 @@ bool AccessScanner::run() {
     return true;
 }
 
+void AccessScanner::scheduleFullRun(uint16_t shardId) {
+    auto pv = std::make_unique<ItemAccessVisitor>(
+            store,
+            stats,
+            shardId,
+            available,
+            *this,
+            maxStoredItems,
+            VBucketFilter(store.getVBuckets().getShard(shardId)->getVBuckets()));
+    ExTask task = new VBCBAdaptor(&store,
+                                  TaskId::AccessScannerVisitor,
+                                  std::move(pv),
+                                  "Item Access Scanner",
+                                  sleepTime,
+                                  true);
+    ExecutorPool::get()->schedule(task);
+}
+
+void AccessScanner::scheduleIncrementalRun(uint16_t shardId) {
+    auto& shard = incremental[shardId];
+
+    // Segments can only be merged into a sorted access log. A MutationLog
+    // left by full runs before incremental mode was turned on is converted
+    // first by a full run of the shard (always sorted in this mode), which
+    // replaces it with a log of every vBucket and drops any segments.
+    const std::string name(alogPath + "." + std::to_string(shardId));
+    if (access(name.c_str(), F_OK) == 0 &&
+        !SortedAccessLog::isSortedAccessLog(name)) {
+        LOG(EXTENSION_LOG_NOTICE, "Converting access log '%s' to the sorted "
+            "format for incremental runs", name.c_str());
+        shard.nextVb = 0;
+        scheduleFullRun(shardId);
+        return;
+    }
+    const auto vbs = store.getVBuckets().getShard(shardId)->getVBuckets();
+
+    // The next of the shard's vBuckets, up to about incrementalItems
+    // resident items (and at least one vBucket)
+    std::set<uint16_t> toLog;
+    size_t items = 0;
+    auto it = std::lower_bound(vbs.begin(), vbs.end(), shard.nextVb);
+    while (it != vbs.end() && (toLog.empty() || items < incrementalItems)) {
+        RCPtr<VBucket> vb = store.getVBucket(*it);
+        if (vb) {
+            items += vb->ht.getNumInMemoryItems() -
+                     vb->ht.getNumInMemoryNonResItems();
+        }
+        toLog.insert(*it);
+        ++it;
+    }
+
+    // Once every vBucket has a segment since the last compaction, there is
+    // no point keeping them apart from the main log any longer
+    const bool passComplete = it == vbs.end();
+    shard.nextVb = passComplete ? 0 : *it;
+    const size_t segment = shard.numSegments + 1;
+    const bool compact = passComplete || segment >= maxSegments;
+
+    auto pv = std::make_unique<ItemAccessVisitor>(store,
+                                                  stats,
+                                                  shardId,
+                                                  available,
+                                                  *this,
+                                                  maxStoredItems,
+                                                  VBucketFilter(toLog),
+                                                  segment,
+                                                  compact);
+    ExTask task = new VBCBAdaptor(&store,
+                                  TaskId::AccessScannerVisitor,
+                                  std::move(pv),
+                                  "Item Access Scanner",
+                                  sleepTime,
+                                  true);
+    ExecutorPool::get()->schedule(task);
+}
+
+void AccessScanner::segmentWritten(uint16_t shardId) {
+    ++incremental[shardId].numSegments;
+}
+
+void AccessScanner::segmentsCompacted(uint16_t shardId) {
+    incremental[shardId].numSegments = 0;
+}
+
+void AccessScanner::deleteSegments(uint16_t shardId) {
+    const std::string name(alogPath + "." + std::to_string(shardId));
+    const size_t numSegments = SortedAccessLogSet::countSegments(name);
+    for (size_t ii = 1; ii <= numSegments; ++ii) {
+        deleteAlogFile(SortedAccessLogSet::getSegmentPath(name, ii));
+    }
+    if (!incremental.empty()) {
+        segmentsCompacted(shardId);
+    }
+}
+
 void AccessScanner::updateAlogTime(double sleepSecs) {
     struct timeval _waketime;
     gettimeofday(&_waketime, NULL);
@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include <string>
+#include <vector>
 
 #include "tasks.h"
 
@@ -41,9 +42,29 @@ public:
     cb::const_char_buffer getDescription();
     std::atomic<size_t> completedCount;
 
+    /* Called by the visitors of incremental runs */
+    void segmentWritten(uint16_t shardId);
+    void segmentsCompacted(uint16_t shardId);
+
+    /* Remove the segments of the shard's access log */
+    void deleteSegments(uint16_t shardId);
+
 private:
+    /**
+     * Where the incremental runs over a shard have got to. Each run logs
+     * the next few of its vBuckets to a new segment of the access log.
+     */
+    struct IncrementalShard {
+        // The vBucket for the next run to start from
+        uint16_t nextVb = 0;
+        // The segments since the access log was last compacted
+        size_t numSegments = 0;
+    };
+
     void updateAlogTime(double sleepSecs);
     void deleteAlogFile(const std::string& fileName);
+    void scheduleFullRun(uint16_t shardId);
+    void scheduleIncrementalRun(uint16_t shardId);
 
     KVBucket& store;
     EPStats& stats;
@@ -52,6 +73,10 @@ private:
     std::atomic<bool> available;
     uint8_t residentRatioThreshold;
     uint64_t maxStoredItems;
+    // Non-zero for incremental runs, of about this many items per shard
+    size_t incrementalItems;
+    size_t maxSegments;
+    std::vector<IncrementalShard> incremental;
 };
 
 #endif  // SRC_ACCESS_SCANNER_H_
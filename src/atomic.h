@@ -289,6 +289,33 @@ public:
         return (bool)value;
     }
 
+    /**
+     * Take a reference to the value for code which can't hold a
+     * SingleThreadedRCPtr, such as an item handed to the server. The
+     * reference must be given up with releaseReference().
+     */
+    T* acquireReference() const {
+        return gimme();
+    }
+
+    /**
+     * Give up a reference taken by acquireReference(), deleting the value if
+     * it was the last one.
+     *
+     * @returns false, doing nothing, if the value has no references - it was
+     *          never shared and the caller owns it outright.
+     */
+    static bool releaseReference(T* value) {
+        auto* rc = static_cast<RCValue*>(value);
+        if (rc->_rc_refcount.load() == 0) {
+            return false;
+        }
+        if (rc->_rc_decref() == 0) {
+            delete value;
+        }
+        return true;
+    }
+
 private:
     template <typename Y>
     friend class SingleThreadedRCPtr;
@@ -37,6 +37,9 @@ void BgFetcher::start() {
     pendingFetch.compare_exchange_strong(inverse, true);
     ExecutorPool* iom = ExecutorPool::get();
     ExTask task = new MultiBGFetcherTask(&(store->getEPEngine()), this, false);
+    if (shard) {
+        task->setNumaNode(shard->getNumaNode());
+    }
     this->setTaskId(task->getId());
     iom->schedule(task);
 }
@@ -83,11 +86,13 @@ size_t BgFetcher::doFetch(VBucket::id_type vbId,
 
     if (fetchedItems.size() > 0) {
         store->completeBGFetchMulti(vbId, fetchedItems, startTime);
-        stats.getMultiHisto.add(
+        const auto latency =
                 std::chrono::duration_cast<std::chrono::microseconds>(
-                        ProcessClock::now() - startTime)
-                        .count(),
-                fetchedItems.size());
+                        ProcessClock::now() - startTime);
+        stats.getMultiHisto.add(latency.count(), fetchedItems.size());
+        stats.bgFetchBatchLatencyHisto.add(latency.count());
+        stats.bgFetchBatchSizeHisto.add(fetchedItems.size());
+        updateBatchLatency(latency);
     }
 
     clearItems(vbId, itemsToFetch);
@@ -103,7 +108,41 @@ void BgFetcher::clearItems(VBucket::id_type vbId,
     }
 }
 
+std::chrono::microseconds BgFetcher::getCoalesceWindow() const {
+    const auto maxWait = store->getBGFetchCoalesceMaxWait();
+    const auto target = store->getBGFetchLatencyTarget();
+    if (maxWait.count() == 0 || avgBatchLatency <= target) {
+        // Coalescing disabled, or the disk is keeping up - don't add any
+        // latency of our own.
+        return std::chrono::microseconds(0);
+    }
+    // The disk is busy; reads issued now would queue behind outstanding
+    // I/O for roughly the excess over the target anyway, so spend (up to)
+    // that long gathering more keys into this batch instead.
+    return std::min(maxWait, avgBatchLatency - target);
+}
+
+void BgFetcher::updateBatchLatency(std::chrono::microseconds latency) {
+    // Exponentially weighted (1/8) so a single slow read doesn't flip the
+    // policy, but a sustained change is picked up within a few batches.
+    avgBatchLatency += (latency - avgBatchLatency) / 8;
+}
+
 bool BgFetcher::run(GlobalTask *task) {
+    if (!coalesced && pendingFetch.load()) {
+        const auto window = getCoalesceWindow();
+        if (window.count() > 0) {
+            // Leave pendingFetch set so that notifyBGEvent() doesn't wake us
+            // early; misses arriving in the meantime join this batch.
+            coalesced = true;
+            ++stats.bgFetchCoalesced;
+            stats.bgFetchCoalesceHisto.add(window.count());
+            task->snooze(std::chrono::duration<double>(window).count());
+            return true;
+        }
+    }
+    coalesced = false;
+
     size_t num_fetched_items = 0;
     bool inverse = true;
     pendingFetch.compare_exchange_strong(inverse, false);
@@ -49,7 +49,8 @@ public:
      * @param st reference to statistics
      */
     BgFetcher(KVBucket* s, KVShard* k, EPStats &st) :
-        store(s), shard(k), taskId(0), stats(st), pendingFetch(false) {}
+        store(s), shard(k), taskId(0), stats(st), pendingFetch(false),
+        avgBatchLatency(0), coalesced(false) {}
 
     /**
      * Construct a BgFetcher
@@ -87,6 +88,16 @@ private:
     size_t doFetch(VBucket::id_type vbId, vb_bgfetch_queue_t& items);
     void clearItems(VBucket::id_type vbId, vb_bgfetch_queue_t& items);
 
+    /**
+     * How long the batch which woke this fetcher should be held open so
+     * that further misses can join it. Zero (dispatch now) unless the disk
+     * is currently busy, i.e. recent batches exceed the latency target.
+     */
+    std::chrono::microseconds getCoalesceWindow() const;
+
+    /// Fold the latency of a completed batch into avgBatchLatency.
+    void updateBatchLatency(std::chrono::microseconds latency);
+
     KVBucket* store;
     KVShard* shard;
     size_t taskId;
@@ -95,6 +106,12 @@ private:
 
     std::atomic<bool> pendingFetch;
     std::set<VBucket::id_type> pendingVbs;
+
+    // Moving average of recent batch fetch latencies. Only accessed from
+    // run(), which is never executed concurrently for one BgFetcher.
+    std::chrono::microseconds avgBatchLatency;
+    // True if the current batch has already been held open once.
+    bool coalesced;
 };
 
 #endif  // SRC_BGFETCHER_H_
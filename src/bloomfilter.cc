@@ -21,7 +21,10 @@
 
 #include "murmurhash3.h"
 
+#include <algorithm>
 #include <cmath>
+#include <iterator>
+#include <stdexcept>
 
 #if __x86_64__ || __ppc64__
 #define MURMURHASH_3 MurmurHash3_x64_128
@@ -30,13 +33,30 @@
 #endif
 
 BloomFilter::BloomFilter(size_t key_count, double false_positive_prob,
-                         bfilter_status_t new_status) {
+                         bfilter_status_t new_status,
+                         BloomFilterLayout new_layout) {
 
     status = new_status;
+    layout = new_layout;
     filterSize = estimateFilterSize(key_count, false_positive_prob);
     noOfHashes = estimateNoOfHashes(key_count);
+    if (layout == BloomFilterLayout::Blocked) {
+        // Round up to a whole number of blocks.
+        filterSize = ((filterSize + blockBits - 1) / blockBits) * blockBits;
+    }
     keyCounter = 0;
-    bitArray.assign(filterSize, false);
+    allocateBits();
+}
+
+BloomFilter::BloomFilter(size_t filter_size, size_t no_of_hashes,
+                         size_t key_counter, bfilter_status_t new_status,
+                         BloomFilterLayout new_layout)
+    : filterSize(filter_size),
+      noOfHashes(no_of_hashes),
+      keyCounter(key_counter),
+      status(new_status),
+      layout(new_layout) {
+    allocateBits();
 }
 
 BloomFilter::~BloomFilter() {
@@ -55,10 +75,40 @@ size_t BloomFilter::estimateNoOfHashes(size_t key_count) {
 }
 
 uint64_t BloomFilter::hashDocKey(const DocKey& key, uint32_t iteration) {
-    uint64_t result = 0;
+    // murmurhash3 produces 128 bits, only the first 64 are used.
+    uint64_t result[2] = {0, 0};
     uint32_t seed = iteration + (uint32_t(key.getDocNamespace()) * noOfHashes);
-    MURMURHASH_3(key.data(), key.size(), seed, &result);
-    return result;
+    MURMURHASH_3(key.data(), key.size(), seed, result);
+    return result[0];
+}
+
+void BloomFilter::allocateBits() {
+    const size_t words = (filterSize + 63) / 64;
+    // Over-allocate by up to a cache line so the bits can start on one.
+    bitArray.assign(words + blockWords - 1, 0);
+    const auto addr = reinterpret_cast<uintptr_t>(bitArray.data());
+    bitOffset = ((64 - (addr % 64)) % 64) / sizeof(uint64_t);
+}
+
+size_t BloomFilter::blockMask(const DocKey& key,
+                              uint64_t (&mask)[blockWords]) {
+    uint64_t hash[2];
+    MURMURHASH_3(key.data(), key.size(), uint32_t(key.getDocNamespace()),
+                 hash);
+
+    // The first half of the hash picks the block, the second half drives
+    // double hashing within it. An odd step visits distinct bits for up to
+    // blockBits probes.
+    const uint32_t start = static_cast<uint32_t>(hash[1]);
+    const uint32_t step = static_cast<uint32_t>(hash[1] >> 32) | 1;
+    std::fill(std::begin(mask), std::end(mask), 0);
+    for (uint32_t i = 0; i < noOfHashes; i++) {
+        const uint32_t bit = (start + i * step) % blockBits;
+        mask[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+
+    const size_t numBlocks = filterSize / blockBits;
+    return bitOffset + (hash[0] % numBlocks) * blockWords;
 }
 
 void BloomFilter::setStatus(bfilter_status_t to) {
@@ -114,35 +164,77 @@ std::string BloomFilter::getStatusString() {
 }
 
 void BloomFilter::addKey(const DocKey& key) {
-    if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
-        bool overlap = true;
-        for (uint32_t i = 0; i < noOfHashes; i++) {
-            uint64_t result = hashDocKey(key, i);
-            if (overlap && bitArray[result % filterSize] == 0) {
-                overlap = false;
-            }
-            bitArray[result % filterSize] = 1;
-        }
-        if (!overlap) {
+    // The bit array is released when the filter is disabled.
+    if ((status == BFILTER_COMPACTING || status == BFILTER_ENABLED) &&
+        !bitArray.empty()) {
+        bool added = (layout == BloomFilterLayout::Blocked)
+                             ? addKeyBlocked(key)
+                             : addKeyStandard(key);
+        if (added) {
             keyCounter++;
         }
     }
 }
 
+bool BloomFilter::addKeyStandard(const DocKey& key) {
+    bool overlap = true;
+    for (uint32_t i = 0; i < noOfHashes; i++) {
+        uint64_t result = hashDocKey(key, i);
+        if (overlap && !testBit(result % filterSize)) {
+            overlap = false;
+        }
+        setBit(result % filterSize);
+    }
+    return !overlap;
+}
+
+bool BloomFilter::addKeyBlocked(const DocKey& key) {
+    uint64_t mask[blockWords];
+    uint64_t* block = &bitArray[blockMask(key, mask)];
+    uint64_t missing = 0;
+    for (size_t w = 0; w < blockWords; w++) {
+        missing |= mask[w] & ~block[w];
+        block[w] |= mask[w];
+    }
+    return missing != 0;
+}
+
 bool BloomFilter::maybeKeyExists(const DocKey& key) {
-    if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
-        for (uint32_t i = 0; i < noOfHashes; i++) {
-            uint64_t result = hashDocKey(key, i);
-            if (bitArray[result % filterSize] == 0) {
-                // The key does NOT exist.
-                return false;
-            }
+    if ((status == BFILTER_COMPACTING || status == BFILTER_ENABLED) &&
+        !bitArray.empty()) {
+        return (layout == BloomFilterLayout::Blocked)
+                       ? maybeKeyExistsBlocked(key)
+                       : maybeKeyExistsStandard(key);
+    }
+    // The key may exist.
+    return true;
+}
+
+bool BloomFilter::maybeKeyExistsStandard(const DocKey& key) {
+    for (uint32_t i = 0; i < noOfHashes; i++) {
+        uint64_t result = hashDocKey(key, i);
+        if (!testBit(result % filterSize)) {
+            // The key does NOT exist.
+            return false;
         }
     }
     // The key may exist.
     return true;
 }
 
+bool BloomFilter::maybeKeyExistsBlocked(const DocKey& key) {
+    uint64_t mask[blockWords];
+    const uint64_t* block = &bitArray[blockMask(key, mask)];
+    // Check the whole (cache line sized) block without branching; the
+    // compiler turns this into a pair of 256-bit and-not/or operations
+    // when AVX2 is available.
+    uint64_t missing = 0;
+    for (size_t w = 0; w < blockWords; w++) {
+        missing |= mask[w] & ~block[w];
+    }
+    return missing == 0;
+}
+
 size_t BloomFilter::getNumOfKeysInFilter() {
     if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
         return keyCounter;
@@ -158,3 +250,104 @@ size_t BloomFilter::getFilterSize() {
         return 0;
     }
 }
+
+/*
+ * Serialised layout (all integers little-endian):
+ *   uint8_t  version
+ *   uint8_t  layout (version 2 onwards; version 1 is always Standard)
+ *   uint64_t filterSize
+ *   uint64_t noOfHashes
+ *   uint64_t keyCounter
+ *   uint8_t  bits[(filterSize + 7) / 8]
+ */
+static const uint8_t serialisedVersion = 2;
+
+static size_t serialisedHeaderSize(uint8_t version) {
+    return (version == 1 ? 1 : 2) + (3 * sizeof(uint64_t));
+}
+
+static void appendUint64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<char>(value & 0xff));
+        value >>= 8;
+    }
+}
+
+static uint64_t readUint64(const std::string& in, size_t offset) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | static_cast<uint8_t>(in[offset + i]);
+    }
+    return value;
+}
+
+std::string BloomFilter::serialise() const {
+    const size_t bytes = (filterSize + 7) / 8;
+    std::string out;
+    out.reserve(serialisedHeaderSize(serialisedVersion) + bytes);
+    out.push_back(static_cast<char>(serialisedVersion));
+    out.push_back(static_cast<char>(layout));
+    appendUint64(out, filterSize);
+    appendUint64(out, noOfHashes);
+    appendUint64(out, keyCounter);
+
+    for (size_t i = 0; i < bytes; i++) {
+        const uint64_t word = bitArray.empty() ? 0
+                                               : bitArray[bitOffset + (i / 8)];
+        out.push_back(static_cast<char>((word >> (8 * (i % 8))) & 0xff));
+    }
+    return out;
+}
+
+std::unique_ptr<BloomFilter> BloomFilter::deserialise(
+        const std::string& data) {
+    if (data.empty()) {
+        throw std::invalid_argument("BloomFilter::deserialise: no data");
+    }
+    const uint8_t version = static_cast<uint8_t>(data[0]);
+    if (version != 1 && version != serialisedVersion) {
+        throw std::invalid_argument(
+                "BloomFilter::deserialise: unknown version " +
+                std::to_string(version));
+    }
+    const size_t headerSize = serialisedHeaderSize(version);
+    if (data.size() < headerSize) {
+        throw std::invalid_argument("BloomFilter::deserialise: data size (" +
+                                    std::to_string(data.size()) +
+                                    ") is smaller than the header");
+    }
+
+    BloomFilterLayout layout = BloomFilterLayout::Standard;
+    size_t offset = 1;
+    if (version != 1) {
+        const uint8_t value = static_cast<uint8_t>(data[offset++]);
+        if (value > static_cast<uint8_t>(BloomFilterLayout::Blocked)) {
+            throw std::invalid_argument(
+                    "BloomFilter::deserialise: unknown layout " +
+                    std::to_string(value));
+        }
+        layout = static_cast<BloomFilterLayout>(value);
+    }
+
+    const uint64_t size = readUint64(data, offset);
+    const uint64_t hashes = readUint64(data, offset + 8);
+    const uint64_t keys = readUint64(data, offset + 16);
+    if (size == 0 || hashes == 0 ||
+        data.size() - headerSize != (size + 7) / 8 ||
+        (layout == BloomFilterLayout::Blocked && size % blockBits != 0)) {
+        throw std::invalid_argument(
+                "BloomFilter::deserialise: inconsistent filter of size " +
+                std::to_string(size) + " with " +
+                std::to_string(data.size() - headerSize) +
+                " bytes of data");
+    }
+
+    // Construct via new as the exact-geometry constructor is protected.
+    std::unique_ptr<BloomFilter> filter(
+            new BloomFilter(size, hashes, keys, BFILTER_ENABLED, layout));
+    for (size_t i = 0; i < (size + 7) / 8; i++) {
+        const uint64_t byte = static_cast<uint8_t>(data[headerSize + i]);
+        filter->bitArray[filter->bitOffset + (i / 8)] |= byte << (8 * (i % 8));
+    }
+    return filter;
+}
@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -32,6 +33,20 @@ enum bfilter_status_t {
     BFILTER_ENABLED
 };
 
+/**
+ * How a BloomFilter lays out its bits.
+ *
+ * Standard: each of the k hashes sets a bit anywhere in the array, so a
+ * lookup touches up to k cache lines and needs k murmurhash3 calls.
+ * Blocked: a single 128-bit hash selects one 64-byte block and all k bits
+ * are set within it, so a lookup touches one cache line. This costs a
+ * slightly higher false positive rate for the same number of bits.
+ */
+enum class BloomFilterLayout : uint8_t {
+    Standard,
+    Blocked
+};
+
 /**
  * A bloom filter instance for a vbucket.
  * We are to maintain the vbucket-number of these instances.
@@ -41,7 +56,8 @@ enum bfilter_status_t {
 class BloomFilter {
 public:
     BloomFilter(size_t key_count, double false_positive_prob,
-                bfilter_status_t newStatus = BFILTER_DISABLED);
+                bfilter_status_t newStatus = BFILTER_DISABLED,
+                BloomFilterLayout newLayout = BloomFilterLayout::Standard);
     ~BloomFilter();
 
     void setStatus(bfilter_status_t to);
@@ -54,19 +70,76 @@ public:
     size_t getNumOfKeysInFilter();
     size_t getFilterSize();
 
+    BloomFilterLayout getLayout() const {
+        return layout;
+    }
+
+    /**
+     * Serialise the filter (its geometry, key count and bit array) into a
+     * portable byte string, so it can be persisted alongside the vbucket's
+     * data file.
+     */
+    std::string serialise() const;
+
+    /**
+     * Rebuild a filter from the output of serialise(). The returned filter
+     * is in the ENABLED state.
+     *
+     * @throws std::invalid_argument if the data is not a valid filter.
+     */
+    static std::unique_ptr<BloomFilter> deserialise(const std::string& data);
+
 protected:
+    /* Used by deserialise() to build a filter of an exact geometry */
+    BloomFilter(size_t filter_size, size_t no_of_hashes, size_t key_counter,
+                bfilter_status_t newStatus, BloomFilterLayout newLayout);
+
     size_t estimateFilterSize(size_t key_count, double false_positive_prob);
     size_t estimateNoOfHashes(size_t key_count);
 
     uint64_t hashDocKey(const DocKey& key, uint32_t iteration);
 
+    /* Allocate a zeroed bit array of filterSize bits */
+    void allocateBits();
+
+    bool testBit(size_t bit) const {
+        return (bitArray[bitOffset + (bit / 64)] >> (bit % 64)) & 1;
+    }
+
+    void setBit(size_t bit) {
+        bitArray[bitOffset + (bit / 64)] |= uint64_t(1) << (bit % 64);
+    }
+
+    /* Number of 64-bit words in a block of the Blocked layout */
+    static const size_t blockWords = 8;
+    static const size_t blockBits = blockWords * 64;
+
+    /**
+     * Blocked layout: compute the index of the first word of the key's
+     * block, and the mask of bits the key sets within the block.
+     */
+    size_t blockMask(const DocKey& key, uint64_t (&mask)[blockWords]);
+
+    bool addKeyStandard(const DocKey& key);
+    bool addKeyBlocked(const DocKey& key);
+    bool maybeKeyExistsStandard(const DocKey& key);
+    bool maybeKeyExistsBlocked(const DocKey& key);
+
     size_t filterSize;
     size_t noOfHashes;
 
     size_t keyCounter;
 
     bfilter_status_t status;
-    std::vector<bool> bitArray;
+    BloomFilterLayout layout;
+
+    /*
+     * The bits, packed into words. The array is over-allocated so that the
+     * bits can start at a cache line boundary (bitOffset words in), keeping
+     * each block of the Blocked layout within a single cache line.
+     */
+    std::vector<uint64_t> bitArray;
+    size_t bitOffset;
 };
 
 #endif // SRC_BLOOMFILTER_H_
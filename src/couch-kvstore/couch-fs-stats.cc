@@ -71,7 +71,7 @@ ssize_t StatsOps::pread(couchstore_error_info_t* errinfo,
     ssize_t result = sf->orig_ops->pread(errinfo, sf->orig_handle, buf,
                                          sz, off);
     if (result > 0) {
-        stats.totalBytesRead += result;
+        stats.addBytesRead(result);
     }
     return result;
 }
@@ -87,7 +87,7 @@ ssize_t StatsOps::pwrite(couchstore_error_info_t*errinfo,
     ssize_t result = sf->orig_ops->pwrite(errinfo, sf->orig_handle, buf,
                                           sz, off);
     if (result > 0) {
-        stats.totalBytesWritten += result;
+        stats.addBytesWritten(result);
     }
     return result;
 }
@@ -162,6 +162,43 @@ static DocKey makeDocKey(const sized_buf buf, bool restoreNamespace) {
     }
 }
 
+/**
+ * Deleter for DocInfo objects allocated with cb_malloc (see copyDocInfo).
+ */
+struct DocInfoDeleter {
+    void operator()(DocInfo* info) {
+        cb_free(info);
+    }
+};
+
+using UniqueDocInfoPtr = std::unique_ptr<DocInfo, DocInfoDeleter>;
+
+/**
+ * Deep-copy a DocInfo, including the id and rev_meta buffers it points at,
+ * into a single allocation. Couchstore only lends the DocInfo to callbacks
+ * so it must be copied if it is to be used after the callback returns.
+ *
+ * @return the copy, or nullptr if memory could not be allocated.
+ */
+static UniqueDocInfoPtr copyDocInfo(const DocInfo& info) {
+    char* buffer = static_cast<char*>(cb_malloc(sizeof(DocInfo) +
+                                                info.id.size +
+                                                info.rev_meta.size));
+    if (buffer == nullptr) {
+        return {};
+    }
+    DocInfo* copy = reinterpret_cast<DocInfo*>(buffer);
+    *copy = info;
+
+    copy->id.buf = buffer + sizeof(DocInfo);
+    std::memcpy(copy->id.buf, info.id.buf, info.id.size);
+
+    copy->rev_meta.buf = copy->id.buf + info.id.size;
+    std::memcpy(copy->rev_meta.buf, info.rev_meta.buf, info.rev_meta.size);
+
+    return UniqueDocInfoPtr(copy);
+}
+
 struct GetMultiCbCtx {
     GetMultiCbCtx(CouchKVStore &c, uint16_t v, vb_bgfetch_queue_t &f) :
         cks(c), vbId(v), fetches(f) {}
@@ -169,6 +206,9 @@ struct GetMultiCbCtx {
     CouchKVStore &cks;
     uint16_t vbId;
     vb_bgfetch_queue_t &fetches;
+    // Documents whose bodies still need to be read, deferred until every
+    // key has been looked up so the reads can be issued in file order.
+    std::vector<UniqueDocInfoPtr> bodyReads;
 };
 
 struct StatResponseCtx {
@@ -199,20 +239,11 @@ couchstore_content_meta_flags CouchRequest::getContentMeta(const Item& it) {
         rval = COUCH_DOC_NON_JSON_MODE;
     }
 
-    if (mcbp::datatype::is_snappy(it.getDataType())) {
-        // We are currently using couchstore in a mode where it will try to
-        // compress documents iff COUCH_DOC_IS_COMPRESSED is specified.
-        // This would cause a conflict if we tried to store a document which
-        // is already compressed.
-        //
-        // Luckily for us we don't support keeping objects compressed in
-        // memory yet, so this won't happen. Let's throw an exception
-        // to make sure that we fix this when we're going to support
-        // compressed objects.
-        throw std::logic_error(
-            "CouchRequest::getContentMeta: can't store compressed items");
-    }
-
+    // We are currently using couchstore in a mode where it will try to
+    // compress documents iff COUCH_DOC_IS_COMPRESSED is specified. Values
+    // held compressed in memory (compression_mode=active) are inflated
+    // before they're handed to couchstore (see the CouchRequest ctor), so
+    // every body is compressed by couchstore and flagged as such.
     if (it.getNBytes() > 0) {
         // Don't try to compress empty bodies ;-)
         rval |= COUCH_DOC_IS_COMPRESSED;
@@ -238,7 +269,24 @@ CouchRequest::CouchRequest(const Item& it,
         dbDoc.id = {const_cast<char*>(key.c_str()), it.getKey().size()};
     }
 
-    if (it.getNBytes()) {
+    protocol_binary_datatype_t datatype = it.getDataType();
+    if (it.getNBytes() && mcbp::datatype::is_snappy(datatype)) {
+        // Persist the plain value so that couchstore compresses it and sets
+        // COUCH_DOC_IS_COMPRESSED; any couchstore reader (couch_dbdump,
+        // backup) can then decompress it.
+        if (!cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                                      value->getData(),
+                                      it.getNBytes(),
+                                      inflated)) {
+            throw std::runtime_error(
+                    "CouchRequest: failed to inflate document with seqno: " +
+                    std::to_string(it.getBySeqno()) + " vb: " +
+                    std::to_string(it.getVBucketId()));
+        }
+        dbDoc.data.buf = inflated.data.get();
+        dbDoc.data.size = inflated.len;
+        datatype &= ~PROTOCOL_BINARY_DATATYPE_SNAPPY;
+    } else if (it.getNBytes()) {
         dbDoc.data.buf = const_cast<char *>(value->getData());
         dbDoc.data.size = it.getNBytes();
     } else {
@@ -253,7 +301,7 @@ CouchRequest::CouchRequest(const Item& it,
         meta.setExptime(it.getExptime());
     }
 
-    meta.setDataType(it.getDataType());
+    meta.setDataType(datatype);
 
     dbDocInfo.db_seq = it.getBySeqno();
 
@@ -538,11 +586,38 @@ void CouchKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t &itms) {
         ++idx;
     }
 
+    // Present the keys in B-tree (byte) order so the by-id index is
+    // descended in a single left-to-right pass.
+    std::sort(ids, ids + itms.size(),
+              [](const sized_buf& a, const sized_buf& b) {
+                  const int cmp =
+                          std::memcmp(a.buf, b.buf, std::min(a.size, b.size));
+                  return cmp < 0 || (cmp == 0 && a.size < b.size);
+              });
+
     GetMultiCbCtx ctx(*this, vb, itms);
+    ctx.bodyReads.reserve(itms.size());
 
     errCode = couchstore_docinfos_by_id(db, ids, itms.size(),
                                         0, getMultiCbC, &ctx);
-    if (errCode != COUCHSTORE_SUCCESS) {
+    if (errCode == COUCHSTORE_SUCCESS) {
+        // Now read the document bodies in order of their position in the
+        // file. Neighbouring bodies are then served from the same buffered
+        // read (and the disk sees a forward sweep rather than random seeks).
+        std::sort(ctx.bodyReads.begin(), ctx.bodyReads.end(),
+                  [](const UniqueDocInfoPtr& a, const UniqueDocInfoPtr& b) {
+                      return a->bp < b->bp;
+                  });
+        for (auto& docinfo : ctx.bodyReads) {
+            // Collections: TODO: Permanently restore to stored namespace
+            DocKey key = makeDocKey(docinfo->id,
+                                    configuration.shouldPersistDocNamespace());
+            auto qitr = itms.find(key);
+            if (qitr != itms.end()) {
+                readBgFetchItem(db, docinfo.get(), vb, qitr->second);
+            }
+        }
+    } else {
         st.numGetFailure += numItems;
         logger.log(EXTENSION_LOG_WARNING, "CouchKVStore::getMulti: "
                    "couchstore_docinfos_by_id error %s [%s], vb:%" PRIu16,
@@ -857,6 +932,32 @@ bool CouchKVStore::compactDB(compaction_ctx *hook_ctx) {
         return false;
     }
 
+    // Compaction copies every live document into a new file, so it needs
+    // free space for the live data plus a full read of the file. When only
+    // a small fraction of the file is stale that cost buys back very little,
+    // so leave the file alone. Requests which must drop all deletes are
+    // always honoured; expiry and tombstone purging are simply deferred to
+    // the next compaction which does rewrite the file.
+    const float minStaleRatio = configuration.getCompactionMinStaleRatio();
+    if (minStaleRatio > 0 && !hook_ctx->drop_deletes) {
+        errCode = couchstore_db_info(compactdb, &info);
+        if (errCode == COUCHSTORE_SUCCESS && info.file_size > 0) {
+            const uint64_t live =
+                    std::min<uint64_t>(info.space_used, info.file_size);
+            const float staleRatio =
+                    float(info.file_size - live) / info.file_size;
+            if (staleRatio < minStaleRatio) {
+                logger.log(EXTENSION_LOG_INFO,
+                           "CouchKVStore::compactDB: Skipping vb:%" PRIu16
+                           ", stale ratio %.3f is below threshold %.3f",
+                           vbid, staleRatio, minStaleRatio);
+                closeDatabaseHandle(compactdb);
+                st.numCompactionSkipped++;
+                return true;
+            }
+        }
+    }
+
     // Build the temporary vbucket.compact file name
     dbfile       = getDBFileName(dbname, vbid, fileRev);
     compact_file = dbfile + ".compact";
@@ -1731,8 +1832,10 @@ int CouchKVStore::recordDbDump(Db *db, DocInfo *docinfo, void *ctx) {
                     // We always store the document bodies compressed on disk,
                     // but now the client _wanted_ to fetch the document
                     // in a compressed mode.
-                    // We've never stored the "compressed" flag on disk
-                    // (as we don't keep items compressed in memory).
+                    // We've never stored the "compressed" flag in the
+                    // persisted datatype: values held compressed in
+                    // memory are inflated before they're persisted, and
+                    // couchstore sets COUCH_DOC_IS_COMPRESSED instead.
                     // Update the datatype flag for this item to
                     // reflect that it is compressed so that the
                     // receiver of the object may notice (Note:
@@ -2311,16 +2414,34 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
     }
 
     vb_bgfetch_item_ctx_t& bg_itm_ctx = (*qitr).second;
+    if (!bg_itm_ctx.isMetaOnly) {
+        // Defer the body read until all keys have been looked up. If the
+        // DocInfo can't be copied just read it now, out of order.
+        auto copy = copyDocInfo(*docinfo);
+        if (copy) {
+            cbCtx->bodyReads.push_back(std::move(copy));
+            return 0;
+        }
+    }
+
+    cbCtx->cks.readBgFetchItem(db, docinfo, cbCtx->vbId, bg_itm_ctx);
+    return 0;
+}
+
+void CouchKVStore::readBgFetchItem(Db* db,
+                                   DocInfo* docinfo,
+                                   uint16_t vbId,
+                                   vb_bgfetch_item_ctx_t& bg_itm_ctx) {
     bool meta_only = bg_itm_ctx.isMetaOnly;
 
     GetValue returnVal;
-    couchstore_error_t errCode = cbCtx->cks.fetchDoc(db, docinfo, returnVal,
-                                                     cbCtx->vbId, meta_only);
+    couchstore_error_t errCode = fetchDoc(db, docinfo, returnVal, vbId,
+                                          meta_only);
     if (errCode != COUCHSTORE_SUCCESS && !meta_only) {
         st.numGetFailure++;
     }
 
-    returnVal.setStatus(cbCtx->cks.couchErr2EngineErr(errCode));
+    returnVal.setStatus(couchErr2EngineErr(errCode));
 
     bool return_val_ownership_transferred = false;
     for (auto& fetch : bg_itm_ctx.bgfetched_list) {
@@ -2338,15 +2459,13 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
         }
     }
     if (!return_val_ownership_transferred) {
-        cbCtx->cks.logger.log(EXTENSION_LOG_WARNING,
-                              "CouchKVStore::getMultiCb called with zero"
-                              "items in bgfetched_list, vb:%" PRIu16
-                              ", seqno:%" PRIu64,
-                              cbCtx->vbId, docinfo->rev_seq);
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::readBgFetchItem called with zero"
+                   "items in bgfetched_list, vb:%" PRIu16
+                   ", seqno:%" PRIu64,
+                   vbId, docinfo->rev_seq);
         delete returnVal.getValue();
     }
-
-    return 0;
 }
 
 
@@ -2764,4 +2883,125 @@ std::string CouchKVStore::getCollectionsManifest(uint16_t vbid) {
     return readCollectionsManifest(*db.getDb());
 }
 
+static const char bloomFilterDocId[] = "_local/bloomfilter";
+
+bool CouchKVStore::persistBloomFilter(uint16_t vbid,
+                                      const std::string& filter) {
+    DbHolder db(this);
+
+    // openDB logs error details
+    couchstore_error_t errCode =
+            openDB(vbid, 0, db.getDbAddress(), COUCHSTORE_OPEN_FLAG_CREATE);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        return false;
+    }
+
+    DbInfo info;
+    errCode = couchstore_db_info(db.getDb(), &info);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::persistBloomFilter: couchstore_db_info "
+                   "error:%s, vb:%" PRIu16,
+                   couchstore_strerror(errCode), vbid);
+        return false;
+    }
+
+    // Prefix the filter with the seqno it is valid for, so that a filter
+    // saved before later writes to the file is not used at warmup.
+    std::string value(sizeof(uint64_t), '\0');
+    const uint64_t seqno = htonll(info.last_sequence);
+    std::memcpy(&value[0], &seqno, sizeof(seqno));
+    value.append(filter);
+
+    LocalDoc lDoc;
+    lDoc.id.buf = const_cast<char*>(bloomFilterDocId);
+    lDoc.id.size = sizeof(bloomFilterDocId) - 1;
+    lDoc.json.buf = const_cast<char*>(value.data());
+    lDoc.json.size = value.size();
+    lDoc.deleted = 0;
+
+    errCode = couchstore_save_local_document(db.getDb(), &lDoc);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::persistBloomFilter "
+                   "couchstore_save_local_document error:%s [%s], vb:%" PRIu16,
+                   couchstore_strerror(errCode),
+                   couchkvstore_strerrno(db.getDb(), errCode).c_str(),
+                   vbid);
+        return false;
+    }
+
+    errCode = couchstore_commit(db.getDb());
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::persistBloomFilter: couchstore_commit "
+                   "error:%s [%s], vb:%" PRIu16,
+                   couchstore_strerror(errCode),
+                   couchkvstore_strerrno(db.getDb(), errCode).c_str(),
+                   vbid);
+        return false;
+    }
+
+    return true;
+}
+
+std::string CouchKVStore::getBloomFilter(uint16_t vbid) {
+    DbHolder db(this);
+
+    // openDB logs error details
+    couchstore_error_t errCode =
+            openDB(vbid, 0, db.getDbAddress(), COUCHSTORE_OPEN_FLAG_RDONLY);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        return {};
+    }
+
+    LocalDocHolder lDoc;
+    errCode = couchstore_open_local_document(db.getDb(),
+                                             bloomFilterDocId,
+                                             sizeof(bloomFilterDocId) - 1,
+                                             lDoc.getLocalDocAddress());
+    if (errCode != COUCHSTORE_SUCCESS) {
+        if (errCode != COUCHSTORE_ERROR_DOC_NOT_FOUND) {
+            logger.log(EXTENSION_LOG_WARNING,
+                       "CouchKVStore::getBloomFilter: "
+                       "couchstore_open_local_document error:%s, vb:%" PRIu16,
+                       couchstore_strerror(errCode), vbid);
+        }
+        return {};
+    }
+
+    const sized_buf& value = lDoc.getLocalDoc()->json;
+    if (value.size < sizeof(uint64_t)) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::getBloomFilter: truncated document "
+                   "(size:%" PRIu64 "), vb:%" PRIu16,
+                   uint64_t(value.size), vbid);
+        return {};
+    }
+
+    DbInfo info;
+    errCode = couchstore_db_info(db.getDb(), &info);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::getBloomFilter: couchstore_db_info "
+                   "error:%s, vb:%" PRIu16,
+                   couchstore_strerror(errCode), vbid);
+        return {};
+    }
+
+    uint64_t seqno;
+    std::memcpy(&seqno, value.buf, sizeof(seqno));
+    seqno = ntohll(seqno);
+    if (seqno != info.last_sequence) {
+        logger.log(EXTENSION_LOG_NOTICE,
+                   "CouchKVStore::getBloomFilter: ignoring stale filter for "
+                   "vb:%" PRIu16 " (saved at seqno:%" PRIu64
+                   ", file at seqno:%" PRIu64 ")",
+                   vbid, seqno, info.last_sequence);
+        return {};
+    }
+
+    return {value.buf + sizeof(uint64_t), value.size - sizeof(uint64_t)};
+}
+
 /* end of couch-kvstore.cc */
@@ -30,6 +30,7 @@
 #include "configuration.h"
 #include "couch-kvstore/couch-fs-stats.h"
 #include "couch-kvstore/couch-kvstore-metadata.h"
+#include <platform/compress.h>
 #include <platform/histogram.h>
 #include <platform/strerror.h>
 #include "logger.h"
@@ -138,6 +139,8 @@ protected:
     static couchstore_content_meta_flags getContentMeta(const Item& it);
 
     value_t value;
+    // The inflated body of a value held snappy compressed in memory
+    cb::compression::Buffer inflated;
 
     MetaData meta;
     uint64_t fileRevNum;
@@ -397,6 +400,13 @@ public:
     couchstore_error_t fetchDoc(Db *db, DocInfo *docinfo,
                                 GetValue &docValue, uint16_t vbId,
                                 bool metaOnly);
+
+    /**
+     * Read the document described by docinfo and hand the result to every
+     * bg fetch waiting on it.
+     */
+    void readBgFetchItem(Db* db, DocInfo* docinfo, uint16_t vbId,
+                         vb_bgfetch_item_ctx_t& bg_itm_ctx);
     ENGINE_ERROR_CODE couchErr2EngineErr(couchstore_error_t errCode);
 
     uint64_t getLastPersistedSeqno(uint16_t vbid);
@@ -433,6 +443,21 @@ public:
 
     std::string getCollectionsManifest(uint16_t vbid) override;
 
+    /**
+     * Write the serialised bloom filter to the _local/bloomfilter document
+     * of the vbucket, tagged with the file's current high seqno.
+     *
+     * @returns true if the update was successful. Note logging on all failures
+     */
+    bool persistBloomFilter(uint16_t vbid, const std::string& filter) override;
+
+    /**
+     * Read the _local/bloomfilter document of the vbucket. Returns an empty
+     * string if the document is absent, or if documents have been written
+     * since it was saved (the filter would then not cover them).
+     */
+    std::string getBloomFilter(uint16_t vbid) override;
+
 protected:
     /*
      * Returns the DbInfo for the given vbucket database.
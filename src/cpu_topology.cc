@@ -0,0 +1,129 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "cpu_topology.h"
+
+#include <platform/sysinfo.h>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+CpuTopology::CpuTopology(std::vector<std::vector<int>> n)
+    : nodes(std::move(n)) {
+    if (nodes.empty()) {
+        nodes.emplace_back();
+    }
+}
+
+CpuTopology CpuTopology::detect() {
+    std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+    // Nodes are numbered from 0 but may have gaps (e.g. offline nodes), so
+    // stop at the first run of missing ones.
+    const int maxNodeGap = 8;
+    for (int node = 0, missing = 0; missing < maxNodeGap; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" +
+                           std::to_string(node) + "/cpulist");
+        std::string list;
+        if (!file || !std::getline(file, list)) {
+            ++missing;
+            continue;
+        }
+        missing = 0;
+        try {
+            auto cpus = parseCpuList(list);
+            if (!cpus.empty()) {
+                nodes.push_back(std::move(cpus));
+            }
+        } catch (const std::invalid_argument&) {
+            // Treat an unreadable node as if it wasn't there
+        }
+    }
+#endif
+    if (nodes.empty()) {
+        std::vector<int> cpus;
+        const size_t numCpus = Couchbase::get_available_cpu_count();
+        for (size_t cpu = 0; cpu < numCpus; ++cpu) {
+            cpus.push_back(int(cpu));
+        }
+        nodes.push_back(std::move(cpus));
+    }
+    return CpuTopology(std::move(nodes));
+}
+
+std::vector<int> CpuTopology::parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        size_t end;
+        int first;
+        int last;
+        try {
+            first = std::stoi(range, &end);
+            last = first;
+            if (end < range.size() && range[end] == '-') {
+                const std::string rest = range.substr(end + 1);
+                last = std::stoi(rest, &end);
+                end += range.size() - rest.size();
+            }
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument(
+                    "CpuTopology::parseCpuList: invalid range '" + range +
+                    "'");
+        }
+        if (first < 0 || last < first ||
+            range.find_first_not_of(" \n", end) != std::string::npos) {
+            throw std::invalid_argument(
+                    "CpuTopology::parseCpuList: invalid range '" + range +
+                    "'");
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+bool CpuTopology::bindCurrentThread(size_t node) const {
+    const auto& cpus = getCpus(node);
+    if (cpus.empty()) {
+        return false;
+    }
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,65 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * The NUMA nodes of the host and the CPUs belonging to each, as used by the
+ * ExecutorPool's topology-aware mode to place threads and shards.
+ */
+class CpuTopology {
+public:
+    /**
+     * @param nodes the CPU ids of each node; an empty list is treated as a
+     *        single node with no known CPUs.
+     */
+    explicit CpuTopology(std::vector<std::vector<int>> nodes);
+
+    /**
+     * Read the topology of this host. On Linux this is taken from sysfs;
+     * elsewhere, or if sysfs can't be read, it's a single node of all CPUs.
+     */
+    static CpuTopology detect();
+
+    /**
+     * Parse a Linux cpulist, e.g. "0-3,8-11", into the CPU ids it lists.
+     * @throws std::invalid_argument if the list is malformed
+     */
+    static std::vector<int> parseCpuList(const std::string& list);
+
+    size_t getNumNodes() const {
+        return nodes.size();
+    }
+
+    const std::vector<int>& getCpus(size_t node) const {
+        return nodes[node % nodes.size()];
+    }
+
+    /**
+     * Restrict the calling thread to the CPUs of node.
+     * @returns false if not supported on this platform or the call failed.
+     */
+    bool bindCurrentThread(size_t node) const;
+
+private:
+    std::vector<std::vector<int>> nodes;
+};
@@ -27,6 +27,8 @@
 
 #include <phosphor/phosphor.h>
 
+#include <tuple>
+
 static const size_t sleepTime = 1;
 
 class BackfillManagerTask : public GlobalTask {
@@ -262,8 +264,9 @@ backfill_status_t BackfillManager::backfill() {
         return reschedule ? backfill_success : backfill_snooze;
     }
 
-    UniqueDCPBackfillPtr backfill = std::move(activeBackfills.front());
-    activeBackfills.pop_front();
+    auto next = nextBackfill();
+    UniqueDCPBackfillPtr backfill = std::move(*next);
+    activeBackfills.erase(next);
 
     lh.unlock();
     backfill_status_t status = backfill->run();
@@ -325,6 +328,38 @@ void BackfillManager::moveToActiveQueue() {
     }
 }
 
+/*
+ * Orders backfills by what they hold up: takeover streams, then backfills
+ * with a scan open, then unstarted backfills by how little they have to
+ * scan. Lower runs first.
+ *
+ * Started backfills of a class all rank equal, so they take turns: each
+ * goes to the back of activeBackfills after its run. Ranking them by what
+ * is left would keep picking the same one - also when it can't move
+ * because its stream's buffer is full - and starve the others.
+ */
+static std::tuple<bool, bool, uint64_t> backfillPriority(
+        DCPBackfill& backfill) {
+    const bool started = backfill.hasStarted();
+    return std::make_tuple(!backfill.isTakeover(),
+                           !started,
+                           started ? 0 : backfill.getSeqnosRemaining());
+}
+
+std::list<UniqueDCPBackfillPtr>::iterator BackfillManager::nextBackfill() {
+    // Backfills of equal priority keep their turns in queue order
+    auto best = activeBackfills.begin();
+    auto bestPriority = backfillPriority(**best);
+    for (auto itr = std::next(best); itr != activeBackfills.end(); ++itr) {
+        auto priority = backfillPriority(**itr);
+        if (priority < bestPriority) {
+            best = itr;
+            bestPriority = priority;
+        }
+    }
+    return best;
+}
+
 void BackfillManager::wakeUpTask() {
     LockHolder lh(lock);
     if (managerTask) {
@@ -36,10 +36,19 @@
  * sufficiently drained (by sending to the client), backfilling can be
  * resumed.
  *
+ * The manager runs one backfill at a time, picking the one which matters
+ * most: ones feeding takeover streams first, then ones which have already
+ * started scanning (so that disk reads stay with the files being
+ * scanned), which take turns, then the unstarted one with the smallest
+ * seqno range to scan.
+ * How many disk backfills may scan a shard at once is limited across all
+ * connections by the DcpConnMap.
+ *
  * Significant configuration parameters affecting backfill:
  * - dcp_scan_byte_limit
  * - dcp_scan_item_limit
  * - dcp_backfill_byte_limit
+ * - dcp_backfill_disk_scans_per_shard
  */
 
 #ifndef SRC_DCP_BACKFILL_MANAGER_H_
@@ -82,6 +91,12 @@ private:
 
     void moveToActiveQueue();
 
+    /**
+     * Returns the active backfill to run next; activeBackfills must not
+     * be empty.
+     */
+    std::list<UniqueDCPBackfillPtr>::iterator nextBackfill();
+
     std::mutex lock;
     std::list<UniqueDCPBackfillPtr> activeBackfills;
     std::list<std::pair<rel_time_t, UniqueDCPBackfillPtr> > snoozingBackfills;
@@ -21,6 +21,8 @@
 
 #include "dcp/stream.h"
 
+#include <algorithm>
+
 class ScanContext;
 
 /**
@@ -69,6 +71,32 @@ public:
      */
     virtual void cancel() = 0;
 
+    /**
+     * Indicates if the backfill has started reading its snapshot (and so
+     * holds a scan of it open)
+     *
+     * @return true if the backfill has started; else false
+     */
+    virtual bool hasStarted() = 0;
+
+    /**
+     * Indicates if the backfill feeds a takeover stream, whose vbucket
+     * can't move until the backfill is done
+     */
+    bool isTakeover() {
+        return stream->getFlags() & DCP_ADD_STREAM_FLAG_TAKEOVER;
+    }
+
+    /**
+     * The part of the backfill's seqno range still to be scanned. Used to
+     * compare disk and memory backfills alike, as neither knows in advance
+     * how many items its range holds.
+     */
+    uint64_t getSeqnosRemaining() {
+        const uint64_t read = std::max(startSeqno, stream->getLastReadSeqno());
+        return endSeqno > read ? endSeqno - read : 0;
+    }
+
 protected:
     /**
      * Ptr to the associated Active DCP stream. Backfill can be run for only
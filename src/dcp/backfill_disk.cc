@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include "dcp/backfill_disk.h"
+#include "dcp/dcpconnmap.h"
 #include "dcp/stream.h"
 #include "ep_engine.h"
 
@@ -119,7 +120,9 @@ DCPBackfillDisk::DCPBackfillDisk(EventuallyPersistentEngine& e,
     : DCPBackfill(s, startSeqno, endSeqno),
       engine(e),
       scanCtx(nullptr),
-      state(backfill_state_init) {
+      state(backfill_state_init),
+      shardId(0),
+      diskScanAcquired(false) {
 }
 
 backfill_status_t DCPBackfillDisk::run() {
@@ -150,6 +153,11 @@ void DCPBackfillDisk::cancel() {
     }
 }
 
+bool DCPBackfillDisk::hasStarted() {
+    LockHolder lh(lock);
+    return state != backfill_state_init;
+}
+
 backfill_status_t DCPBackfillDisk::create() {
     uint16_t vbid = stream->getVBucket();
 
@@ -168,6 +176,13 @@ backfill_status_t DCPBackfillDisk::create() {
         return backfill_snooze;
     }
 
+    /* Wait for a place among the disk scans of the vbucket's shard */
+    shardId = engine.getKVBucket()->getVBuckets().getShardByVbId(vbid)->getId();
+    if (!engine.getDcpConnMap().tryAcquireDiskScan(shardId)) {
+        return backfill_snooze;
+    }
+    diskScanAcquired = true;
+
     KVStore* kvstore = engine.getKVBucket()->getROUnderlying(vbid);
     ValueFilter valFilter = ValueFilter::VALUES_DECOMPRESSED;
     if (stream->isCompressionEnabled()) {
@@ -185,6 +200,8 @@ backfill_status_t DCPBackfillDisk::create() {
         stream->markDiskSnapshot(startSeqno, scanCtx->maxSeqno);
         transitionState(backfill_state_scanning);
     } else {
+        engine.getDcpConnMap().releaseDiskScan(shardId);
+        diskScanAcquired = false;
         transitionState(backfill_state_done);
     }
 
@@ -215,6 +232,11 @@ backfill_status_t DCPBackfillDisk::complete(bool cancelled) {
     KVStore* kvstore = engine.getKVBucket()->getROUnderlying(vbid);
     kvstore->destroyScanContext(scanCtx);
 
+    if (diskScanAcquired) {
+        engine.getDcpConnMap().releaseDiskScan(shardId);
+        diskScanAcquired = false;
+    }
+
     stream->completeBackfill();
 
     EXTENSION_LOG_LEVEL severity =
@@ -80,6 +80,8 @@ public:
 
     void cancel() override;
 
+    bool hasStarted() override;
+
 private:
     /**
      * Creates a scan context with the KV Store to read items in the sequential
@@ -120,4 +122,11 @@ private:
     ScanContext* scanCtx;
     backfill_state_t state;
     std::mutex lock;
+
+    /**
+     * The shard whose disk scan limit this backfill holds a place in, while
+     * scanning (see DcpConnMap::tryAcquireDiskScan)
+     */
+    uint16_t shardId;
+    bool diskScanAcquired;
 };
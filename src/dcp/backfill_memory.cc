@@ -41,13 +41,19 @@ backfill_status_t DCPBackfillMemory::run() {
             getVBucketId(),
             startSeqno,
             endSeqno);
+        rangeItr.reset();
         return backfill_finished;
     }
 
-    /* Get sequence of items (backfill) from memory */
-    std::vector<UniqueItemPtr> items;
+    if (!rangeItr) {
+        return create();
+    }
+    return scan();
+}
+
+backfill_status_t DCPBackfillMemory::create() {
     ENGINE_ERROR_CODE status;
-    std::tie(status, items) = evb->inMemoryBackfill(startSeqno, endSeqno);
+    std::tie(status, rangeItr) = evb->makeRangeIterator(startSeqno, endSeqno);
 
     /* Handle any failures */
     if (status != ENGINE_SUCCESS) {
@@ -63,19 +69,45 @@ backfill_status_t DCPBackfillMemory::run() {
         return backfill_finished;
     }
 
-    /* Put items onto readyQ of the DCP stream */
-    stream->incrBackfillRemaining(items.size());
+    /* Mark disk snapshot, unless there is nothing to send in it */
+    if (!rangeItr->done()) {
+        stream->markDiskSnapshot(startSeqno, rangeItr->getEnd());
+    }
+
+    return scan();
+}
+
+backfill_status_t DCPBackfillMemory::scan() {
+    if (!stream->isActive()) {
+        rangeItr.reset();
+        stream->completeBackfill();
+        return backfill_finished;
+    }
 
-    /* Mark disk snapshot */
-    stream->markDiskSnapshot(items.front()->getBySeqno(),
-                             items.back()->getBySeqno());
+    /* Move items to the stream until its backfill buffer is full */
+    while (!rangeItr->done()) {
+        UniqueItemPtr item;
+        try {
+            item = rangeItr->curr();
+        } catch (const std::bad_alloc&) {
+            LOG(EXTENSION_LOG_WARNING,
+                "DCPBackfillMemory::scan(): "
+                "(vb:%d) ENOMEM while trying to copy an item before "
+                "streaming it; will retry",
+                getVBucketId());
+            return backfill_snooze;
+        }
 
-    /* Move every item to the stream */
-    for (auto& item : items) {
-        stream->backfillReceived(std::move(item), BACKFILL_FROM_MEMORY);
+        if (!stream->backfillReceived(std::move(item), BACKFILL_FROM_MEMORY)) {
+            /* No room; the same item is read again on the next run */
+            return backfill_success;
+        }
+        stream->incrBackfillRemaining(1);
+        rangeItr->next();
     }
 
-    /* Indicate completion to the stream */
+    /* Give up the read range before indicating completion to the stream */
+    rangeItr.reset();
     stream->completeBackfill();
 
     return backfill_finished;
@@ -21,6 +21,7 @@
 
 #include "callbacks.h"
 #include "dcp/backfill.h"
+#include "seqlist.h"
 
 class EphemeralVBucket;
 
@@ -28,9 +29,11 @@ class EphemeralVBucket;
  * Concrete class that does backfill from in-memory ordered data strucuture and
  * informs the DCP stream of the backfill progress.
  *
- * This class calls one synchronous vBucket API to read items in the sequential
- * order from the in-memory ordered data structure and calls the DCP stream
- * for disk snapshot, backfill items and backfill completion.
+ * This class reads items in the sequential order from a point-in-time range
+ * iterator over the in-memory ordered data structure and calls the DCP stream
+ * for disk snapshot, backfill items and backfill completion. Items are copied
+ * one at a time as the stream takes them, so each run sends what fits in the
+ * backfill buffer and the next run carries on from where it stopped.
  */
 class DCPBackfillMemory : public DCPBackfill {
 public:
@@ -48,11 +51,33 @@ public:
     }
 
     void cancel() override {
+        rangeItr.reset();
+    }
+
+    bool hasStarted() override {
+        return rangeItr != nullptr;
     }
 
 private:
+    /**
+     * Creates the range iterator and marks the snapshot on the stream.
+     */
+    backfill_status_t create();
+
+    /**
+     * Sends items from the range iterator until the stream's backfill buffer
+     * is full or the range has been read.
+     */
+    backfill_status_t scan();
+
     /**
      * Ref counted ptr to EphemeralVBucket
      */
     SingleThreadedRCPtr<EphemeralVBucket> evb;
+
+    /**
+     * The range read of the backfill. Holds a read range on the vbucket's
+     * ordered data structure until reset; must be destroyed before evb.
+     */
+    std::unique_ptr<SequenceList::RangeIterator> rangeItr;
 };
@@ -0,0 +1,161 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "dcp/compression_cache.h"
+
+#include "statwriter.h"
+
+#include <platform/compress.h>
+
+DcpCompressionCache::DcpCompressionCache(size_t maxSize)
+    : maxSize(maxSize),
+      memSize(0),
+      numItems(0),
+      hits(0),
+      misses(0),
+      evictions(0),
+      compressTimeSaved(0) {
+}
+
+value_t DcpCompressionCache::getCompressed(const Item& item, float minRatio) {
+    const size_t nbytes = item.getNBytes();
+    if (nbytes == 0 || item.getExtMetaLen() == 0) {
+        // Without extended meta there's nowhere to record the datatype
+        return value_t();
+    }
+
+    const Key key{item.getVBucketId(), item.getBySeqno()};
+    Shard& shard = shards[key.vbid % numShards];
+    {
+        std::lock_guard<std::mutex> lh(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end() && it->second.cas == item.getCas() &&
+            it->second.revSeqno == item.getRevSeqno()) {
+            Entry& entry = it->second;
+            const bool withinRatio = entry.deflatedLen <= minRatio * nbytes;
+            // If the ratio has been relaxed since a value not worth keeping
+            // was compressed, compress it again below.
+            if (entry.value || !withinRatio) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, entry.lruPos);
+                hits++;
+                compressTimeSaved += entry.compressTime.count();
+                return withinRatio ? entry.value : value_t();
+            }
+        }
+    }
+
+    misses++;
+    const auto start = ProcessClock::now();
+    cb::compression::Buffer deflated;
+    if (!cb::compression::deflate(cb::compression::Algorithm::Snappy,
+                                  item.getData(),
+                                  nbytes,
+                                  deflated)) {
+        LOG(EXTENSION_LOG_WARNING,
+            "DcpCompressionCache::getCompressed: (vb %" PRIu16
+            ") Failed to snappy compress an uncompressed value!",
+            key.vbid);
+        return value_t();
+    }
+
+    Entry entry;
+    entry.cas = item.getCas();
+    entry.revSeqno = item.getRevSeqno();
+    entry.deflatedLen = deflated.len;
+    if (deflated.len <= minRatio * nbytes) {
+        Blob* blob = Blob::New(deflated.data.get(),
+                               deflated.len,
+                               reinterpret_cast<uint8_t*>(const_cast<char*>(
+                                       item.getExtMeta())),
+                               item.getExtMetaLen());
+        blob->setDataType(item.getDataType() | PROTOCOL_BINARY_DATATYPE_SNAPPY);
+        entry.value.reset(blob);
+    }
+    entry.compressTime = ProcessClock::now() - start;
+
+    value_t value = entry.value;
+    if (maxSize.load() != 0) {
+        std::lock_guard<std::mutex> lh(shard.mutex);
+        insert(shard, key, std::move(entry));
+    }
+    return value;
+}
+
+void DcpCompressionCache::setMaxSize(size_t size) {
+    maxSize.store(size);
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lh(shard.mutex);
+        evict_UNLOCKED(shard);
+    }
+}
+
+void DcpCompressionCache::addStats(ADD_STAT add_stat, const void* c) const {
+    add_casted_stat("ep_dcp_compression_cache_mem_used", getMemSize(),
+                    add_stat, c);
+    add_casted_stat("ep_dcp_compression_cache_items", getNumItems(), add_stat,
+                    c);
+    add_casted_stat("ep_dcp_compression_cache_hits", getHits(), add_stat, c);
+    add_casted_stat("ep_dcp_compression_cache_misses", getMisses(), add_stat,
+                    c);
+    add_casted_stat("ep_dcp_compression_cache_evictions", getEvictions(),
+                    add_stat, c);
+    add_casted_stat("ep_dcp_compression_cache_cpu_saved",
+                    getCompressTimeSaved().count(), add_stat, c);
+}
+
+size_t DcpCompressionCache::entrySize(const Entry& entry) {
+    return sizeof(Key) + sizeof(Entry) +
+           (entry.value ? entry.value->getSize() : 0);
+}
+
+void DcpCompressionCache::insert(Shard& shard, const Key& key, Entry entry) {
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        // Another revision, or another producer got here first
+        const size_t size = entrySize(it->second);
+        shard.memSize -= size;
+        memSize -= size;
+        entry.lruPos = it->second.lruPos;
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry.lruPos);
+        it->second = std::move(entry);
+    } else {
+        shard.lru.push_front(key);
+        entry.lruPos = shard.lru.begin();
+        it = shard.entries.emplace(key, std::move(entry)).first;
+        numItems++;
+    }
+    const size_t size = entrySize(it->second);
+    shard.memSize += size;
+    memSize += size;
+    evict_UNLOCKED(shard);
+}
+
+void DcpCompressionCache::evict_UNLOCKED(Shard& shard) {
+    const size_t shardMax = maxSize.load() / numShards;
+    while (shard.memSize > shardMax && !shard.lru.empty()) {
+        auto it = shard.entries.find(shard.lru.back());
+        const size_t size = entrySize(it->second);
+        shard.memSize -= size;
+        memSize -= size;
+        shard.entries.erase(it);
+        shard.lru.pop_back();
+        numItems--;
+        evictions++;
+    }
+}
@@ -0,0 +1,158 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include "item.h"
+
+#include <memcached/engine_common.h>
+#include <platform/processclock.h>
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * A cache of the snappy compressed values of the items DCP producers with
+ * value compression enabled send, shared by all the producers of a bucket.
+ * Every producer streaming a vbucket sends the same items, so the first to
+ * send one compresses its value and the rest reuse the result.
+ *
+ * Entries are keyed by (vbucket, seqno) and checked against the item's CAS
+ * and revSeqno, so that a seqno reused after a rollback is never served a
+ * stale value. Whether a value meets the minimum compression ratio is
+ * decided from the compressed size recorded with the entry, so a value
+ * which doesn't compress well is also only compressed once.
+ *
+ * The cache is split into shards by vbucket, each with its own lock and its
+ * own LRU list, and is bounded by the memory held by the entries. A maximum
+ * size of zero disables caching - every request compresses.
+ */
+class DcpCompressionCache {
+public:
+    explicit DcpCompressionCache(size_t maxSize);
+
+    /**
+     * The value of item in snappy compressed form, compressing it if it
+     * isn't already cached.
+     *
+     * @param item the (uncompressed) item to be sent
+     * @param minRatio the ratio of compressed to original size at or under
+     *        which the compressed value is worth sending
+     * @returns the compressed value, or an empty value_t if it doesn't
+     *          achieve minRatio or couldn't be compressed.
+     */
+    value_t getCompressed(const Item& item, float minRatio);
+
+    /**
+     * Change the memory the cache may use, evicting entries as required.
+     */
+    void setMaxSize(size_t size);
+
+    size_t getMaxSize() const {
+        return maxSize.load();
+    }
+
+    size_t getMemSize() const {
+        return memSize.load();
+    }
+
+    size_t getNumItems() const {
+        return numItems.load();
+    }
+
+    size_t getHits() const {
+        return hits.load();
+    }
+
+    size_t getMisses() const {
+        return misses.load();
+    }
+
+    size_t getEvictions() const {
+        return evictions.load();
+    }
+
+    /**
+     * The time spent compressing values which later requests were spared.
+     */
+    std::chrono::microseconds getCompressTimeSaved() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                ProcessClock::duration(compressTimeSaved.load()));
+    }
+
+    void addStats(ADD_STAT add_stat, const void* c) const;
+
+    static const size_t numShards = 16;
+
+protected:
+    struct Key {
+        bool operator==(const Key& other) const {
+            return vbid == other.vbid && bySeqno == other.bySeqno;
+        }
+
+        uint16_t vbid;
+        int64_t bySeqno;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<int64_t>()(key.bySeqno) ^ key.vbid;
+        }
+    };
+
+    struct Entry {
+        // Identify the revision of the item the value was compressed from
+        uint64_t cas;
+        uint64_t revSeqno;
+        size_t deflatedLen;
+        // Only held if the value was within the ratio when compressed
+        value_t value;
+        ProcessClock::duration compressTime;
+        std::list<Key>::iterator lruPos;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Key, Entry, KeyHash> entries;
+        // Most recently used first
+        std::list<Key> lru;
+        size_t memSize = 0;
+    };
+
+    static size_t entrySize(const Entry& entry);
+
+    void insert(Shard& shard, const Key& key, Entry entry);
+
+    // Evict from shard's LRU end until it fits in its share of maxSize
+    void evict_UNLOCKED(Shard& shard);
+
+    std::array<Shard, numShards> shards;
+
+    std::atomic<size_t> maxSize;
+    std::atomic<size_t> memSize;
+    std::atomic<size_t> numItems;
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+    std::atomic<size_t> evictions;
+    // In ProcessClock ticks
+    std::atomic<ProcessClock::duration::rep> compressTimeSaved;
+};
@@ -40,10 +40,12 @@ class Processor : public GlobalTask {
 public:
     Processor(EventuallyPersistentEngine* e,
               connection_t c,
+              size_t index,
               double sleeptime = 1,
               bool completeBeforeShutdown = true)
         : GlobalTask(e, TaskId::Processor, sleeptime, completeBeforeShutdown),
           conn(c),
+          index(index),
           description("Processing buffered items for " + conn->getName()) {
     }
 
@@ -86,7 +88,7 @@ public:
             }
         }
 
-        consumer->setProcessorTaskState(state);
+        consumer->setProcessorTaskState(index, state);
 
         return true;
     }
@@ -97,6 +99,8 @@ public:
 
 private:
     const connection_t conn;
+    // Which of the consumer's Processors this is
+    const size_t index;
     const std::string description;
 };
 
@@ -105,8 +109,7 @@ DcpConsumer::DcpConsumer(EventuallyPersistentEngine &engine, const void *cookie,
     : Consumer(engine, cookie, name),
       lastMessageTime(ep_current_time()),
       opaqueCounter(0),
-      processorTaskId(0),
-      processorTaskState(all_processed),
+      numLiveProcessors(0),
       processorNotification(false),
       backoffs(0),
       dcpIdleTimeout(engine.getConfiguration().getDcpIdleTimeout()),
@@ -130,8 +133,15 @@ DcpConsumer::DcpConsumer(EventuallyPersistentEngine &engine, const void *cookie,
     pendingEnableValueCompression = config.isDcpValueCompressionEnabled();
     pendingSupportCursorDropping = true;
 
-    ExTask task = new Processor(&engine, this, 1);
-    processorTaskId = ExecutorPool::get()->schedule(task);
+    const size_t numProcessors = config.getDcpConsumerProcessorTasks();
+    processorTaskStates.reset(
+            new std::atomic<process_items_error_t>[numProcessors]);
+    numLiveProcessors = numProcessors;
+    for (size_t ii = 0; ii < numProcessors; ++ii) {
+        processorTaskStates[ii] = all_processed;
+        ExTask task = new Processor(&engine, this, ii, 1);
+        processorTaskIds.push_back(ExecutorPool::get()->schedule(task));
+    }
 }
 
 DcpConsumer::~DcpConsumer() {
@@ -142,13 +152,19 @@ DcpConsumer::~DcpConsumer() {
 void DcpConsumer::cancelTask() {
     bool inverse = false;
     if (taskAlreadyCancelled.compare_exchange_strong(inverse, true)) {
-        ExecutorPool::get()->cancel(processorTaskId);
+        for (auto taskId : processorTaskIds) {
+            ExecutorPool::get()->cancel(taskId);
+        }
     }
 }
 
 void DcpConsumer::taskCancelled() {
-    bool inverse = false;
-    taskAlreadyCancelled.compare_exchange_strong(inverse, true);
+    // Only once the last Processor has gone is there nothing to cancel; the
+    // others must still be cancelled if one stops early.
+    if (--numLiveProcessors == 0) {
+        bool inverse = false;
+        taskAlreadyCancelled.compare_exchange_strong(inverse, true);
+    }
 }
 
 ENGINE_ERROR_CODE DcpConsumer::addStream(uint32_t opaque, uint16_t vbucket,
@@ -689,8 +705,10 @@ bool DcpConsumer::handleResponse(protocol_binary_response_header* resp) {
 
         streamAccepted(opaque, status, body, bodylen);
         return true;
-    } else if (opcode == PROTOCOL_BINARY_CMD_DCP_BUFFER_ACKNOWLEDGEMENT ||
-               opcode == PROTOCOL_BINARY_CMD_DCP_CONTROL) {
+    } else if (opcode == PROTOCOL_BINARY_CMD_DCP_BUFFER_ACKNOWLEDGEMENT) {
+        return true;
+    } else if (opcode == PROTOCOL_BINARY_CMD_DCP_CONTROL) {
+        flowControl.handleControlResponse(opaque);
         return true;
     }
 
@@ -791,6 +809,13 @@ void DcpConsumer::addStats(ADD_STAT add_stat, const void *c) {
 
     addStat("total_backoffs", backoffs, add_stat, c);
     addStat("processor_task_state", getProcessorTaskStatusStr(), add_stat, c);
+    if (processorTaskIds.size() > 1) {
+        for (size_t ii = 0; ii < processorTaskIds.size(); ++ii) {
+            addStat(("processor_task_state_" + std::to_string(ii)).c_str(),
+                    getProcessorTaskStatusStr(processorTaskStates[ii]),
+                    add_stat, c);
+        }
+    }
     flowControl.addStats(add_stat, c);
 }
 
@@ -843,9 +868,20 @@ process_items_error_t DcpConsumer::processBufferedItems() {
             continue;
         }
 
+        // Another Processor task is draining this vbucket; it re-checks
+        // the buffer once it lets go, so the vbucket can be skipped.
+        if (!stream->claimBufferedMessages()) {
+            continue;
+        }
+
         process_ret = drainStreamsBufferedItems(stream,
                                                 processBufferedMessagesYieldThreshold);
 
+        stream->releaseBufferedMessages();
+        if (stream->hasBufferedMessages()) {
+            vbReady.pushUnique(vbucket);
+        }
+
         if (process_ret == all_processed) {
             return more_to_process;
         }
@@ -869,7 +905,9 @@ process_items_error_t DcpConsumer::processBufferedItems() {
 void DcpConsumer::notifyVbucketReady(uint16_t vbucket) {
     if (vbReady.pushUnique(vbucket) &&
         notifiedProcessor(true)) {
-        ExecutorPool::get()->wake(processorTaskId);
+        for (auto taskId : processorTaskIds) {
+            ExecutorPool::get()->wake(taskId);
+        }
     }
 }
 
@@ -878,12 +916,36 @@ bool DcpConsumer::notifiedProcessor(bool to) {
     return processorNotification.compare_exchange_strong(inverse, to);
 }
 
-void DcpConsumer::setProcessorTaskState(enum process_items_error_t to) {
-    processorTaskState = to;
+void DcpConsumer::setProcessorTaskState(size_t index,
+                                        enum process_items_error_t to) {
+    processorTaskStates[index] = to;
+}
+
+enum process_items_error_t DcpConsumer::getProcessorTaskState() {
+    // The busiest of the Processors: one with more to process, else one
+    // backing off, else all have processed everything.
+    enum process_items_error_t state = all_processed;
+    for (size_t ii = 0; ii < processorTaskIds.size(); ++ii) {
+        switch (processorTaskStates[ii].load()) {
+            case more_to_process:
+                return more_to_process;
+            case cannot_process:
+                state = cannot_process;
+                break;
+            case all_processed:
+                break;
+        }
+    }
+    return state;
 }
 
 std::string DcpConsumer::getProcessorTaskStatusStr() {
-    switch (processorTaskState.load()) {
+    return getProcessorTaskStatusStr(getProcessorTaskState());
+}
+
+std::string DcpConsumer::getProcessorTaskStatusStr(
+        enum process_items_error_t state) {
+    switch (state) {
         case all_processed:
             return "ALL_PROCESSED";
         case more_to_process:
@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include <relaxed_atomic.h>
+#include <vector>
 
 #include "connmap.h"
 #include "dcp/dcp-types.h"
@@ -157,10 +158,17 @@ public:
 
     bool notifiedProcessor(bool to);
 
-    void setProcessorTaskState(enum process_items_error_t to);
+    /// Record the state the index'th Processor task finished a run in
+    void setProcessorTaskState(size_t index, enum process_items_error_t to);
+
+    /// The state of the busiest of the Processor tasks
+    enum process_items_error_t getProcessorTaskState();
 
     std::string getProcessorTaskStatusStr();
 
+    static std::string getProcessorTaskStatusStr(
+            enum process_items_error_t state);
+
     /**
      * Check if the enough bytes have been removed from the
      * flow control buffer, for the consumer to send an ACK
@@ -260,8 +268,14 @@ protected:
                                 uint64_t rollbackSeqno);
 
     uint64_t opaqueCounter;
-    size_t processorTaskId;
-    std::atomic<enum process_items_error_t> processorTaskState;
+    // The Processor tasks applying buffered messages, each taking vbuckets
+    // from vbReady. Sized by 'dcp_consumer_processor_tasks'
+    std::vector<size_t> processorTaskIds;
+    // The state each Processor task finished its last run in
+    std::unique_ptr<std::atomic<enum process_items_error_t>[]>
+            processorTaskStates;
+    // Processor tasks not yet destroyed
+    std::atomic<size_t> numLiveProcessors;
 
     DcpReadyQueue vbReady;
     std::atomic<bool> processorNotification;
@@ -58,7 +58,7 @@ typedef RCPtr<PassiveStream> passive_stream_t;
  * queue of vbuckets that are ready for a DCP producer/consumer to process.
  * The queue does not allow duplicates and the push_unique method enforces
  * this. The interface is generally customised for the needs of:
- * - getNextItem and is thread safe as the frontend operations and
+ * - getNextItems and is thread safe as the frontend operations and
  *   DCPProducer threads are accessing this data.
  * - processBufferedItems by the processer task of the consumer
  *
@@ -35,8 +35,15 @@ const uint8_t DcpConnMap::numBackfillsMemThreshold = 1;
 
 DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     : ConnMap(e),
+      compressionCache(e.getConfiguration().getDcpCompressionCacheSize()),
+      producerBatchItemLimit(
+              e.getConfiguration().getDcpProducerBatchItemLimit()),
+      producerBatchByteLimit(
+              e.getConfiguration().getDcpProducerBatchByteLimit()),
       aggrDcpConsumerBufferSize(0) {
     backfills.numActiveSnoozing = 0;
+    backfills.maxDiskScansPerShard =
+            engine.getConfiguration().getDcpBackfillDiskScansPerShard();
     updateMaxActiveSnoozingBackfills(engine.getEpStats().getMaxDataSize());
     minCompressionRatioForProducer.store(
                     engine.getConfiguration().getDcpMinCompressionRatio());
@@ -48,6 +55,18 @@ DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     engine.getConfiguration().
         addValueChangedListener("dcp_consumer_process_buffered_messages_batch_size",
                                 new DcpConfigChangeListener(*this));
+    engine.getConfiguration().
+        addValueChangedListener("dcp_compression_cache_size",
+                                new DcpConfigChangeListener(*this));
+    engine.getConfiguration().
+        addValueChangedListener("dcp_producer_batch_item_limit",
+                                new DcpConfigChangeListener(*this));
+    engine.getConfiguration().
+        addValueChangedListener("dcp_producer_batch_byte_limit",
+                                new DcpConfigChangeListener(*this));
+    engine.getConfiguration().
+        addValueChangedListener("dcp_backfill_disk_scans_per_shard",
+                                new DcpConfigChangeListener(*this));
 }
 
 DcpConsumer *DcpConnMap::newConsumer(const void* cookie,
@@ -406,6 +425,30 @@ void DcpConnMap::decrNumActiveSnoozingBackfills()
     LOG(EXTENSION_LOG_WARNING, "ActiveSnoozingBackfills already zero!!!");
 }
 
+bool DcpConnMap::tryAcquireDiskScan(uint16_t shardId) {
+    std::lock_guard<std::mutex> lh(backfills.mutex);
+    size_t& scans = backfills.diskScans[shardId];
+    if (backfills.maxDiskScansPerShard != 0 &&
+        scans >= backfills.maxDiskScansPerShard) {
+        return false;
+    }
+    ++scans;
+    return true;
+}
+
+void DcpConnMap::releaseDiskScan(uint16_t shardId) {
+    {
+        std::lock_guard<std::mutex> lh(backfills.mutex);
+        size_t& scans = backfills.diskScans[shardId];
+        if (scans > 0) {
+            --scans;
+            return;
+        }
+    }
+    LOG(EXTENSION_LOG_WARNING, "DiskScans for shard %" PRIu16 " already zero!!!",
+        shardId);
+}
+
 void DcpConnMap::updateMaxActiveSnoozingBackfills(size_t maxDataSize)
 {
     double numBackfillsMemThresholdPercent =
@@ -429,6 +472,15 @@ void DcpConnMap::addStats(ADD_STAT add_stat, const void *c) {
     LockHolder lh(connsLock);
     add_casted_stat("ep_dcp_dead_conn_count", deadConnections.size(), add_stat,
                     c);
+    {
+        std::lock_guard<std::mutex> blh(backfills.mutex);
+        size_t diskScans = 0;
+        for (const auto& shard : backfills.diskScans) {
+            diskScans += shard.second;
+        }
+        add_casted_stat("ep_dcp_backfill_disk_scans", diskScans, add_stat, c);
+    }
+    compressionCache.addStats(add_stat, c);
 }
 
 void DcpConnMap::updateMinCompressionRatioForProducers(float value) {
@@ -448,6 +500,15 @@ void DcpConnMap::DcpConfigChangeListener::sizeValueChanged(const std::string &ke
         myConnMap.consumerYieldConfigChanged(value);
     } else if (key == "dcp_consumer_process_buffered_messages_batch_size") {
         myConnMap.consumerBatchSizeConfigChanged(value);
+    } else if (key == "dcp_compression_cache_size") {
+        myConnMap.compressionCache.setMaxSize(value);
+    } else if (key == "dcp_producer_batch_item_limit") {
+        myConnMap.producerBatchItemLimit.store(value);
+    } else if (key == "dcp_producer_batch_byte_limit") {
+        myConnMap.producerBatchByteLimit.store(value);
+    } else if (key == "dcp_backfill_disk_scans_per_shard") {
+        std::lock_guard<std::mutex> lh(myConnMap.backfills.mutex);
+        myConnMap.backfills.maxDiskScansPerShard = value;
     }
 }
 
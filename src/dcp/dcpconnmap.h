@@ -22,6 +22,7 @@
 #include <atomic>
 #include <climits>
 #include <list>
+#include <map>
 #include <string>
 
 #include "ep_engine.h"
@@ -29,8 +30,10 @@
 #include "syncobject.h"
 #include "atomicqueue.h"
 #include "connmap.h"
+#include "dcp/compression_cache.h"
 #include "dcp/consumer.h"
 #include "dcp/producer.h"
+#include "dcp/stream_sampler.h"
 
 class DcpConnMap : public ConnMap {
 
@@ -106,6 +109,19 @@ public:
         return backfills.maxActiveSnoozing;
     }
 
+    /**
+     * Claim one of the disk scans a shard may run at once. The limit
+     * (dcp_backfill_disk_scans_per_shard) is shared by the backfills of all
+     * producers, so that a device reads a few vbucket files through rather
+     * than seeking between many of them.
+     *
+     * @return true if the scan may start; it must then be given back with
+     *         releaseDiskScan() when done
+     */
+    bool tryAcquireDiskScan(uint16_t shardId);
+
+    void releaseDiskScan(uint16_t shardId);
+
     ENGINE_ERROR_CODE addPassiveStream(ConnHandler& conn, uint32_t opaque,
                                        uint16_t vbucket, uint32_t flags);
 
@@ -120,6 +136,26 @@ public:
 
     float getMinCompressionRatio();
 
+    /* The most messages and bytes a producer sends from one stream in a
+     * single step */
+    size_t getProducerBatchItemLimit() const {
+        return producerBatchItemLimit.load();
+    }
+
+    size_t getProducerBatchByteLimit() const {
+        return producerBatchByteLimit.load();
+    }
+
+    /* The compressed values shared by the producers which compress */
+    DcpCompressionCache& getCompressionCache() {
+        return compressionCache;
+    }
+
+    /* The throughput and latency of the producers' streams */
+    DcpStreamSampler& getStreamSampler() {
+        return streamSampler;
+    }
+
     connection_t findByName(const std::string &name);
 
     bool isConnections() {
@@ -170,11 +206,14 @@ protected:
     /* Db file memory */
     static const uint32_t dbFileMem;
 
-    // Current and maximum number of backfills which are snoozing.
+    // Current and maximum number of backfills which are snoozing, and the
+    // number of disk backfills scanning each shard.
     struct {
         std::mutex mutex;
         uint16_t numActiveSnoozing;
         uint16_t maxActiveSnoozing;
+        std::map<uint16_t, size_t> diskScans;
+        size_t maxDiskScansPerShard;
     } backfills;
 
     /* Max num of backfills we want to have irrespective of memory */
@@ -184,6 +223,13 @@ protected:
 
     std::atomic<float> minCompressionRatioForProducer;
 
+    DcpCompressionCache compressionCache;
+
+    DcpStreamSampler streamSampler;
+
+    std::atomic<size_t> producerBatchItemLimit;
+    std::atomic<size_t> producerBatchByteLimit;
+
     /* Total memory used by all DCP consumer buffers */
     std::atomic<size_t> aggrDcpConsumerBufferSize;
 
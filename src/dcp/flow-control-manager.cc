@@ -34,6 +34,13 @@ size_t DcpFlowControlManager::newConsumerConn(DcpConsumer *) {
 
 void DcpFlowControlManager::handleDisconnect(DcpConsumer *) {}
 
+void DcpFlowControlManager::handleBdpMeasurement(DcpConsumer *, size_t) {}
+
+bool DcpFlowControlManager::measuresBdp() const
+{
+    return false;
+}
+
 bool DcpFlowControlManager::isEnabled() const
 {
     return false;
@@ -215,3 +222,88 @@ void DcpFlowControlManagerAggressive::resizeBuffers_UNLOCKED(size_t bufferSize)
         iter.second->setFlowControlBufSize(bufferSize);
     }
 }
+
+DcpFlowControlManagerAdaptive::DcpFlowControlManagerAdaptive(
+                                        EventuallyPersistentEngine &engine) :
+    DcpFlowControlManager(engine), aggrDcpConsumerBufferSize(0)
+{
+}
+
+DcpFlowControlManagerAdaptive::~DcpFlowControlManagerAdaptive() {}
+
+size_t DcpFlowControlManagerAdaptive::newConsumerConn(
+                                                    DcpConsumer *consumerConn)
+{
+    if (consumerConn == nullptr) {
+        throw std::invalid_argument(
+                "DcpFlowControlManagerAdaptive::newConsumerConn: resp is NULL");
+    }
+    /* Start at the default size until the connection has been measured */
+    size_t bufferSize = engine_.getConfiguration().getDcpConnBufferSize();
+
+    std::lock_guard<std::mutex> lh(aggrMutex);
+    aggrDcpConsumerBufferSize += bufferSize;
+    LOG(EXTENSION_LOG_INFO, "%s Conn flow control buffer is %zu",
+        consumerConn->logHeader(), bufferSize);
+    return bufferSize;
+}
+
+void DcpFlowControlManagerAdaptive::handleDisconnect(DcpConsumer *consumerConn)
+{
+    std::lock_guard<std::mutex> lh(aggrMutex);
+    aggrDcpConsumerBufferSize -= consumerConn->getFlowControlBufSize();
+}
+
+void DcpFlowControlManagerAdaptive::handleBdpMeasurement(
+                                                    DcpConsumer *consumerConn,
+                                                    size_t bdp)
+{
+    Configuration &config = engine_.getConfiguration();
+    size_t bufferSize = bdp * 2;
+    bufferSize = std::max(bufferSize,
+                          config.getDcpConnBufferSizeAdaptiveMin());
+    bufferSize = std::min(bufferSize, config.getDcpConnBufferSizeMax());
+
+    std::lock_guard<std::mutex> lh(aggrMutex);
+    const size_t currentSize = consumerConn->getFlowControlBufSize();
+
+    /* Ignore changes of less than 1/8th, so that the producer isn't sent a
+       control message for every measurement */
+    const size_t change = (bufferSize > currentSize) ? bufferSize - currentSize
+                                                     : currentSize - bufferSize;
+    if (change < currentSize / 8) {
+        return;
+    }
+
+    if (bufferSize > currentSize) {
+        /* Grow only as far as the aggr memory threshold allows */
+        double dcpConnBufferSizeThreshold = static_cast<double>
+                            (config.getDcpConnBufferSizeAggrMemThreshold())/100;
+        const size_t maxAggr = dcpConnBufferSizeThreshold *
+                               engine_.getEpStats().getMaxDataSize();
+        const size_t otherConns = aggrDcpConsumerBufferSize - currentSize;
+        if (otherConns + bufferSize > maxAggr) {
+            if (maxAggr <= otherConns + currentSize) {
+                return;
+            }
+            bufferSize = maxAggr - otherConns;
+        }
+    }
+
+    aggrDcpConsumerBufferSize -= currentSize;
+    aggrDcpConsumerBufferSize += bufferSize;
+    consumerConn->setFlowControlBufSize(bufferSize);
+    LOG(EXTENSION_LOG_INFO, "%s Conn flow control buffer is %zu, measured "
+        "bandwidth-delay product %zu", consumerConn->logHeader(), bufferSize,
+        bdp);
+}
+
+bool DcpFlowControlManagerAdaptive::measuresBdp() const
+{
+    return true;
+}
+
+bool DcpFlowControlManagerAdaptive::isEnabled() const
+{
+    return true;
+}
@@ -47,6 +47,14 @@ public:
     /* To be called when a consumer connection is deleted */
     virtual void handleDisconnect(DcpConsumer *);
 
+    /* To be called when a consumer connection has measured the bytes it
+       needs in flight to stay busy (its bandwidth-delay product) */
+    virtual void handleBdpMeasurement(DcpConsumer *, size_t bdp);
+
+    /* Will indicate if the policy sizes buffers by the bandwidth-delay
+       product, which consumer connections then measure */
+    virtual bool measuresBdp(void) const;
+
     /* Will indicate if flow control is enabled */
     virtual bool isEnabled(void) const;
 
@@ -129,4 +137,39 @@ private:
     /* Fraction of memQuota for all dcp consumer connection buffers */
     std::atomic<double> dcpConnBufferSizeAggrFrac;
 };
+
+/**
+ * In this policy flow control buffer sizes start at the default size (10 MB)
+ * and then follow each connection's bandwidth-delay product: the rate at
+ * which the consumer drains its buffer times the round trip of a control
+ * message. The buffer is sized to twice that, so that a connection held back
+ * by its buffer measures a higher rate and keeps growing until the consumer
+ * or the link is the limit, within max (50MB) and the adaptive min (1MB), so
+ * that connections on a fast link give back memory they don't need. Buffers
+ * only grow while the aggr flow control buffer memory stays under a
+ * threshold (10% of bucket memory).
+ */
+class DcpFlowControlManagerAdaptive : public DcpFlowControlManager {
+public:
+    DcpFlowControlManagerAdaptive(EventuallyPersistentEngine &engine);
+
+    ~DcpFlowControlManagerAdaptive();
+
+    size_t newConsumerConn(DcpConsumer *consumerConn);
+
+    void handleDisconnect(DcpConsumer *consumerConn);
+
+    void handleBdpMeasurement(DcpConsumer *consumerConn, size_t bdp);
+
+    bool measuresBdp(void) const;
+
+    bool isEnabled(void) const;
+
+private:
+    /* Mutex to keep aggrDcpConsumerBufferSize in step with the buffer
+       sizes it adds up */
+    std::mutex aggrMutex;
+    /* Total memory used by all DCP consumer buffers */
+    size_t aggrDcpConsumerBufferSize;
+};
 #endif  /* SRC_DCP_FLOW_CONTROL_MANAGER_H_ */
@@ -22,6 +22,12 @@
 #include "dcp/flow-control.h"
 #include "dcp/flow-control-manager.h"
 
+#include <algorithm>
+
+/* How often the round trip is measured again when nothing else has made
+   the buffer size be sent */
+static const std::chrono::seconds rttProbeInterval(10);
+
 FlowControl::FlowControl(EventuallyPersistentEngine &engine,
                          DcpConsumer* consumer) :
     consumerConn(consumer),
@@ -29,7 +35,12 @@ FlowControl::FlowControl(EventuallyPersistentEngine &engine,
     pendingControl(true),
     lastBufferAck(ep_current_time()),
     ackedBytes(0),
-    freedBytes(0)
+    freedBytes(0),
+    measureBdp(engine.getDcpFlowControlManager().measuresBdp()),
+    timedControlOpaque(0),
+    lastAckSent(ProcessClock::now()),
+    rtt(0),
+    drainRate(0)
 {
     enabled = engine.getDcpFlowControlManager().isEnabled();
     if (enabled) {
@@ -50,11 +61,21 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
         ENGINE_ERROR_CODE ret;
         uint32_t ackable_bytes = freedBytes.load();
         std::unique_lock<SpinLock> lh(bufferSizeLock);
+        if (measureBdp &&
+            ProcessClock::now() - timedControlSent > rttProbeInterval) {
+            /* Re-send the buffer size to measure the round trip again */
+            pendingControl = true;
+        }
         if (pendingControl) {
             pendingControl = false;
             std::string buf_size(std::to_string(bufferSize));
             lh.unlock();
             uint64_t opaque = consumerConn->incrOpaqueCounter();
+            if (measureBdp) {
+                /* Time its response, superseding any not yet responded to */
+                timedControlOpaque = uint32_t(opaque);
+                timedControlSent = ProcessClock::now();
+            }
             const std::string &controlMsgKey = consumerConn->getControlMsgKey();
             EventuallyPersistentEngine *epe =
                                     ObjectRegistry::onSwitchThread(NULL, true);
@@ -68,30 +89,12 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
         } else if (isBufferSufficientlyDrained_UNLOCKED(ackable_bytes)) {
             lh.unlock();
             /* Send a buffer ack when at least 20% of the buffer is drained */
-            uint64_t opaque = consumerConn->incrOpaqueCounter();
-            EventuallyPersistentEngine *epe =
-                                    ObjectRegistry::onSwitchThread(NULL, true);
-            ret = producers->buffer_acknowledgement(consumerConn->getCookie(),
-                                                    opaque, 0, ackable_bytes);
-            ObjectRegistry::onSwitchThread(epe);
-            lastBufferAck = ep_current_time();
-            ackedBytes.fetch_add(ackable_bytes);
-            freedBytes.fetch_sub(ackable_bytes);
-            return (ret == ENGINE_SUCCESS) ? ENGINE_WANT_MORE : ret;
+            return sendBufferAck(producers, ackable_bytes);
         } else if (ackable_bytes > 0 &&
                    (ep_current_time() - lastBufferAck) > 5) {
             lh.unlock();
             /* Ack at least every 5 seconds */
-            uint64_t opaque = consumerConn->incrOpaqueCounter();
-            EventuallyPersistentEngine *epe =
-                                    ObjectRegistry::onSwitchThread(NULL, true);
-            ret = producers->buffer_acknowledgement(consumerConn->getCookie(),
-                                                    opaque, 0, ackable_bytes);
-            ObjectRegistry::onSwitchThread(epe);
-            lastBufferAck = ep_current_time();
-            ackedBytes.fetch_add(ackable_bytes);
-            freedBytes.fetch_sub(ackable_bytes);
-            return (ret == ENGINE_SUCCESS) ? ENGINE_WANT_MORE : ret;
+            return sendBufferAck(producers, ackable_bytes);
         } else {
             lh.unlock();
         }
@@ -99,6 +102,73 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
     return ENGINE_FAILED;
 }
 
+/* Exponentially weighted moving average, weighting a new sample by 1/8 */
+static uint64_t smooth(uint64_t average, uint64_t sample) {
+    return (average == 0) ? sample : (average * 7 + sample) / 8;
+}
+
+ENGINE_ERROR_CODE FlowControl::sendBufferAck(
+                                    struct dcp_message_producers* producers,
+                                    uint32_t ackable_bytes)
+{
+    uint64_t opaque = consumerConn->incrOpaqueCounter();
+    EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL, true);
+    ENGINE_ERROR_CODE ret =
+            producers->buffer_acknowledgement(consumerConn->getCookie(),
+                                              opaque, 0, ackable_bytes);
+    ObjectRegistry::onSwitchThread(epe);
+    lastBufferAck = ep_current_time();
+    ackedBytes.fetch_add(ackable_bytes);
+    freedBytes.fetch_sub(ackable_bytes);
+
+    /* The bytes acked were drained since the previous ack */
+    const auto now = ProcessClock::now();
+    const std::chrono::duration<double> elapsed = now - lastAckSent;
+    lastAckSent = now;
+    if (elapsed.count() > 0) {
+        drainRate.store(smooth(drainRate.load(),
+                               uint64_t(ackable_bytes / elapsed.count())));
+    }
+
+    if (measureBdp) {
+        handleBdpMeasurement();
+    }
+
+    return (ret == ENGINE_SUCCESS) ? ENGINE_WANT_MORE : ret;
+}
+
+void FlowControl::handleControlResponse(uint32_t opaque)
+{
+    if (!enabled || !measureBdp || opaque == 0 ||
+        opaque != timedControlOpaque) {
+        return;
+    }
+    timedControlOpaque = 0;
+
+    /* At least 1us, as 0 means not measured */
+    const uint64_t sample = std::max<uint64_t>(
+            1,
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                    ProcessClock::now() - timedControlSent)
+                    .count());
+    rtt.store(smooth(rtt.load(), sample));
+    handleBdpMeasurement();
+}
+
+void FlowControl::handleBdpMeasurement()
+{
+    const uint64_t roundTrip = rtt.load();
+    const uint64_t rate = drainRate.load();
+    if (roundTrip == 0 || rate == 0) {
+        return;
+    }
+
+    /* Bandwidth-delay product: the bytes the producer must have in flight
+       to keep the consumer draining at its current rate */
+    const size_t bdp = (rate * roundTrip) / 1000000;
+    engine_.getDcpFlowControlManager().handleBdpMeasurement(consumerConn, bdp);
+}
+
 void FlowControl::incrFreedBytes(uint32_t bytes)
 {
     freedBytes.fetch_add(bytes);
@@ -133,4 +203,6 @@ void FlowControl::addStats(ADD_STAT add_stat, const void *c)
     consumerConn->addStat("total_acked_bytes", ackedBytes, add_stat, c);
     consumerConn->addStat("max_buffer_bytes", bufferSize, add_stat, c);
     consumerConn->addStat("unacked_bytes", freedBytes, add_stat, c);
+    consumerConn->addStat("rtt_us", rtt, add_stat, c);
+    consumerConn->addStat("drain_rate_bytes_per_sec", drainRate, add_stat, c);
 }
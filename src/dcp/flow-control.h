@@ -23,6 +23,7 @@
 #include <atomic>
 #include "memcached/engine.h"
 
+#include <platform/processclock.h>
 #include <relaxed_atomic.h>
 
 class DcpConsumer;
@@ -33,7 +34,11 @@ class EventuallyPersistentEngine;
  * It is always associated with a DCP consumer.
  * Flow control buffer size is set when the class obj is initialized.
  * The class obj subsequently handles sending control messages and
- * sending bytes processed acks to the DCP producer
+ * sending bytes processed acks to the DCP producer. For policies which size
+ * buffers by it, it also measures the round trip of the buffer size control
+ * message (which, unlike a buffer ack, the producer responds to) and the
+ * rate the buffer is drained at, and hands their product (the bytes in
+ * flight needed to keep the connection busy) to the flow control manager.
  */
 class FlowControl {
 public:
@@ -45,6 +50,9 @@ public:
 
     void incrFreedBytes(uint32_t bytes);
 
+    /* To be called when the producer responds to a control message */
+    void handleControlResponse(uint32_t opaque);
+
     uint32_t getFlowControlBufSize(void);
 
     void setFlowControlBufSize(uint32_t newSize);
@@ -58,6 +66,13 @@ private:
 
     bool isBufferSufficientlyDrained_UNLOCKED(uint32_t ackable_bytes);
 
+    ENGINE_ERROR_CODE sendBufferAck(struct dcp_message_producers* producers,
+                                    uint32_t ackable_bytes);
+
+    /* Hands the bandwidth-delay product to the flow control manager, once
+       both the round trip and the drain rate have been measured */
+    void handleBdpMeasurement();
+
     /* Associated consumer connection handler */
     DcpConsumer* consumerConn;
 
@@ -85,6 +100,25 @@ private:
 
     /* Bytes processed from the flow control buffer */
     std::atomic<uint64_t> freedBytes;
+
+    /* Indicates if the flow control manager sizes the buffer by the
+       measured bandwidth-delay product */
+    bool measureBdp;
+
+    /* Opaque of the last buffer size control message sent and when it was
+       sent, to time its response; 0 once timed. Only used from the
+       connection's thread */
+    uint32_t timedControlOpaque;
+    ProcessClock::time_point timedControlSent;
+
+    /* When the previous buffer ack was sent, for the drain rate */
+    ProcessClock::time_point lastAckSent;
+
+    /* Smoothed round trip time of a control message, in microseconds */
+    std::atomic<uint64_t> rtt;
+
+    /* Smoothed rate at which the buffer is drained, in bytes per second */
+    std::atomic<uint64_t> drainRate;
 };
 
 #endif  /* SRC_DCP_FLOW_CONTROL_H_ */
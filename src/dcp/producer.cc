@@ -134,12 +134,12 @@ DcpProducer::DcpProducer(EventuallyPersistentEngine& e,
                          bool isNotifier,
                          bool startTask)
     : Producer(e, cookie, name),
-      rejectResp(NULL),
       notifyOnly(isNotifier),
       lastSendTime(ep_current_time()),
       log(*this),
       itemsSent(0),
-      totalBytesSent(0) {
+      totalBytesSent(0),
+      itemsCopied(0) {
     setSupportAck(true);
     setReserved(true);
     setPaused(true);
@@ -203,7 +203,9 @@ DcpProducer::DcpProducer(EventuallyPersistentEngine& e,
 
 DcpProducer::~DcpProducer() {
     backfillMgr.reset();
-    delete rejectResp;
+    for (auto* resp : pendingResps) {
+        delete resp;
+    }
 
     if (checkpointCreatorTask) {
         ExecutorPool::get()->cancel(checkpointCreatorTask->getId());
@@ -434,57 +436,97 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         return ret;
     }
 
-    DcpResponse *resp;
-    if (rejectResp) {
-        resp = rejectResp;
-        rejectResp = NULL;
-    } else {
-        resp = getNextItem();
-        if (!resp) {
+    if (pendingResps.empty()) {
+        auto& connMap = engine_.getDcpConnMap();
+        getNextItems(connMap.getProducerBatchItemLimit(),
+                     connMap.getProducerBatchByteLimit());
+        if (pendingResps.empty()) {
             return ENGINE_SUCCESS;
         }
     }
 
-    Item* itmCpy = nullptr;
-    auto* mutationResponse = dynamic_cast<MutationResponse*>(resp);
-    if (mutationResponse != nullptr) {
-        try {
-            itmCpy = mutationResponse->getItemCopy();
-        } catch (const std::bad_alloc&) {
-            rejectResp = resp;
-            LOG(EXTENSION_LOG_WARNING,
-                "%s (vb %d) ENOMEM while trying to copy "
-                "item with seqno %" PRIu64 "before streaming it",
-                logHeader(),
-                mutationResponse->getVBucket(),
-                *mutationResponse->getBySeqno());
-            return ENGINE_ENOMEM;
+    // Send the responses in order until one can't be sent. Each Item is
+    // made ready only when its response is next, while still accounted to
+    // the engine, so none are prepared for nothing under back-pressure.
+    size_t sent = 0;
+    bool sendFailed = false;
+    ret = ENGINE_SUCCESS;
+    for (auto* resp : pendingResps) {
+        Item* itmCpy = nullptr;
+        // A response whose Item can't be made ready stays pending, and
+        // fails the step once it is at the front.
+        ret = prepareItemToSend(*resp, itmCpy);
+        if (ret != ENGINE_SUCCESS) {
+            break;
         }
 
-        if (enableValueCompression) {
-            /**
-             * If value compression is enabled, the producer will need
-             * to snappy-compress the document before transmitting.
-             * Compression will obviously be done only if the datatype
-             * indicates that the value isn't compressed already.
-             */
-            uint32_t sizeBefore = itmCpy->getNBytes();
-            if (!itmCpy->compressValue(
-                            engine_.getDcpConnMap().getMinCompressionRatio())) {
-                LOG(EXTENSION_LOG_WARNING,
-                    "%s Failed to snappy compress an uncompressed value!",
-                    logHeader());
-            }
-            uint32_t sizeAfter = itmCpy->getNBytes();
-
-            if (sizeAfter < sizeBefore) {
-                log.acknowledge(sizeBefore - sizeAfter);
-            }
+        EventuallyPersistentEngine* epe =
+                ObjectRegistry::onSwitchThread(NULL, true);
+        ret = sendResponse(producers, resp, itmCpy);
+        ObjectRegistry::onSwitchThread(epe);
+        if (ret != ENGINE_SUCCESS) {
+            sendFailed = true;
+            break;
         }
+        ++sent;
+    }
+
+    // A response rejected with E2BIG stays at the front to be retried
+    size_t done = sent;
+    if (sendFailed && ret != ENGINE_E2BIG) {
+        ++done;
+    }
+    for (size_t ii = 0; ii < done; ++ii) {
+        delete pendingResps.front();
+        pendingResps.pop_front();
+    }
+
+    if (sent > 0 && (ret == ENGINE_E2BIG || !sendFailed)) {
+        // The connection's buffer filled up (or the next Item couldn't be
+        // made ready) part way through the batch, but what was sent needs
+        // shipping first.
+        ret = ENGINE_SUCCESS;
     }
 
-    EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL,
-                                                                     true);
+    lastSendTime = ep_current_time();
+    return (ret == ENGINE_SUCCESS) ? ENGINE_WANT_MORE : ret;
+}
+
+ENGINE_ERROR_CODE DcpProducer::prepareItemToSend(DcpResponse& resp,
+                                                Item*& itmCpy) {
+    auto* mutationResponse = dynamic_cast<MutationResponse*>(&resp);
+    if (mutationResponse == nullptr) {
+        return ENGINE_SUCCESS;
+    }
+    try {
+        itmCpy = getItemToSend(*mutationResponse);
+    } catch (const std::bad_alloc&) {
+        LOG(EXTENSION_LOG_WARNING,
+            "%s (vb %d) ENOMEM while trying to copy "
+            "item with seqno %" PRIu64 "before streaming it",
+            logHeader(),
+            mutationResponse->getVBucket(),
+            *mutationResponse->getBySeqno());
+        return ENGINE_ENOMEM;
+    }
+    if (itmCpy == nullptr) {
+        LOG(EXTENSION_LOG_WARNING,
+            "%s (vb %d) Failed to decompress item with seqno %" PRIu64
+            ", disconnecting",
+            logHeader(),
+            mutationResponse->getVBucket(),
+            *mutationResponse->getBySeqno());
+        return ENGINE_DISCONNECT;
+    }
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE DcpProducer::sendResponse(
+        struct dcp_message_producers* producers,
+        DcpResponse* resp,
+        Item* itmCpy) {
+    ENGINE_ERROR_CODE ret;
+    auto* mutationResponse = dynamic_cast<MutationResponse*>(resp);
     switch (resp->getEvent()) {
         case DcpResponse::Event::StreamEnd:
         {
@@ -574,16 +616,46 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         }
     }
 
-    ObjectRegistry::onSwitchThread(epe);
+    return ret;
+}
 
-    if (ret == ENGINE_E2BIG) {
-        rejectResp = resp;
-    } else {
-        delete resp;
+Item* DcpProducer::getItemToSend(MutationResponse& response) {
+    const queued_item& item = response.getItem();
+    if (enableValueCompression && item->getNBytes() != 0 &&
+        !mcbp::datatype::is_snappy(item->getDataType())) {
+        /**
+         * If value compression is enabled, the producer will need
+         * to snappy-compress the document before transmitting.
+         * Compression will obviously be done only if the datatype
+         * indicates that the value isn't compressed already. The
+         * value is compressed once for all producers by the
+         * DcpConnMap's cache, and as the checkpoint's Item is shared
+         * the compressed value goes in a copy - but only if it is
+         * small enough to be worth it.
+         */
+        auto& connMap = engine_.getDcpConnMap();
+        value_t compressed = connMap.getCompressionCache().getCompressed(
+                *item, connMap.getMinCompressionRatio());
+        if (compressed) {
+            std::unique_ptr<Item> copy(response.getItemCopy());
+            const size_t saved = item->getNBytes() - compressed->vlength();
+            copy->setValue(compressed);
+            log.acknowledge(saved);
+            itemsCopied++;
+            return copy.release();
+        }
+    } else if (!enableValueCompression &&
+               mcbp::datatype::is_snappy(item->getDataType())) {
+        // Held compressed (compression_mode=active) but the consumer
+        // hasn't asked for compressed values.
+        std::unique_ptr<Item> copy(response.getItemCopy());
+        if (!copy->decompressValue()) {
+            return nullptr;
+        }
+        itemsCopied++;
+        return copy.release();
     }
-
-    lastSendTime = ep_current_time();
-    return (ret == ENGINE_SUCCESS) ? ENGINE_WANT_MORE : ret;
+    return response.getItemReference();
 }
 
 ENGINE_ERROR_CODE DcpProducer::bufferAcknowledgement(uint32_t opaque,
@@ -801,6 +873,7 @@ void DcpProducer::addStats(ADD_STAT add_stat, const void *c) {
     addStat("items_sent", getItemsSent(), add_stat, c);
     addStat("items_remaining", getItemsRemaining(), add_stat, c);
     addStat("total_bytes_sent", getTotalBytes(), add_stat, c);
+    addStat("items_copied", itemsCopied.load(), add_stat, c);
     addStat("last_sent_time", lastSendTime, add_stat, c);
     addStat("last_receive_time", lastReceiveTime, add_stat, c);
     addStat("noop_enabled", noopCtx.enabled, add_stat, c);
@@ -931,7 +1004,7 @@ const char* DcpProducer::getType() const {
     }
 }
 
-DcpResponse* DcpProducer::getNextItem() {
+void DcpProducer::getNextItems(size_t itemLimit, size_t byteLimit) {
     do {
         setPaused(false);
 
@@ -939,54 +1012,62 @@ DcpResponse* DcpProducer::getNextItem() {
         while (ready.popFront(vbucket)) {
             if (log.pauseIfFull()) {
                 ready.pushUnique(vbucket);
-                return NULL;
+                return;
             }
 
-            DcpResponse* op = NULL;
-            stream_t stream;
-            {
-                stream = findStream(vbucket);
-                if (!stream) {
-                    continue;
-                }
+            stream_t stream = findStream(vbucket);
+            if (!stream) {
+                continue;
             }
 
-            op = stream->next();
+            size_t items = 0;
+            size_t bytes = 0;
+            DcpResponse* op;
+            while ((op = stream->next()) != nullptr) {
+                switch (op->getEvent()) {
+                    case DcpResponse::Event::SnapshotMarker:
+                    case DcpResponse::Event::Mutation:
+                    case DcpResponse::Event::Deletion:
+                    case DcpResponse::Event::Expiration:
+                    case DcpResponse::Event::StreamEnd:
+                    case DcpResponse::Event::SetVbucket:
+                    case DcpResponse::Event::SystemEvent:
+                        break;
+                    default:
+                        throw std::logic_error(
+                                std::string("DcpProducer::getNextItems: "
+                                "Producer (") + logHeader() + ") is attempting "
+                                "to write an unexpected event:" +
+                                op->to_string());
+                }
 
-            if (!op) {
-                // stream is empty, try another vbucket.
-                continue;
-            }
+                if (op->getEvent() == DcpResponse::Event::Mutation ||
+                    op->getEvent() == DcpResponse::Event::Deletion ||
+                    op->getEvent() == DcpResponse::Event::Expiration ||
+                    op->getEvent() == DcpResponse::Event::SystemEvent) {
+                    itemsSent++;
+                }
+
+                const size_t size = op->getMessageSize();
+                totalBytesSent.fetch_add(size);
+                pendingResps.push_back(op);
 
-            switch (op->getEvent()) {
-                case DcpResponse::Event::SnapshotMarker:
-                case DcpResponse::Event::Mutation:
-                case DcpResponse::Event::Deletion:
-                case DcpResponse::Event::Expiration:
-                case DcpResponse::Event::StreamEnd:
-                case DcpResponse::Event::SetVbucket:
-                case DcpResponse::Event::SystemEvent:
+                bytes += size;
+                if (++items >= itemLimit || bytes >= byteLimit ||
+                    log.pauseIfFull()) {
                     break;
-                default:
-                    throw std::logic_error(
-                            std::string("DcpProducer::getNextItem: "
-                            "Producer (") + logHeader() + ") is attempting to "
-                            "write an unexpected event:" +
-                            op->to_string());
+                }
             }
 
-            ready.pushUnique(vbucket);
-
-            if (op->getEvent() == DcpResponse::Event::Mutation ||
-                op->getEvent() == DcpResponse::Event::Deletion ||
-                op->getEvent() == DcpResponse::Event::Expiration ||
-                op->getEvent() == DcpResponse::Event::SystemEvent) {
-                itemsSent++;
+            if (items == 0) {
+                // stream is empty, try another vbucket.
+                continue;
             }
 
-            totalBytesSent.fetch_add(op->getMessageSize());
-
-            return op;
+            // To the back of the queue, so that the other vbuckets ready
+            // get their turn before this one sends again.
+            ready.pushUnique(vbucket);
+            return;
         }
 
         // flag we are paused
@@ -996,8 +1077,6 @@ DcpResponse* DcpProducer::getNextItem() {
         // A new vbucket could of became ready and the notifier could of seen
         // paused = false, so reloop so we don't miss an operation.
     } while(!ready.empty());
-
-    return NULL;
 }
 
 void DcpProducer::setDisconnect(bool disconnect) {
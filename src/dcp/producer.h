@@ -24,6 +24,8 @@
 #include "dcp/dcp-types.h"
 #include "tapconnection.h"
 
+#include <deque>
+
 class BackfillManager;
 class DcpResponse;
 
@@ -279,14 +281,50 @@ protected:
 
     Couchbase::RelaxedAtomic<rel_time_t> lastReceiveTime;
 
-    DcpResponse* getNextItem();
+    /**
+     * Take the next responses to send into pendingResps, from the next
+     * stream which is ready: up to itemLimit responses or byteLimit bytes
+     * of them, and no more once the buffer log is full. The stream then
+     * goes to the back of the ready queue, so vbuckets take turns.
+     */
+    void getNextItems(size_t itemLimit, size_t byteLimit);
+
+    /**
+     * Make ready the Item to send for a mutation or deletion response, if
+     * any; called while accounted to the engine.
+     *
+     * @param itmCpy set to the Item to pass to sendResponse
+     * @returns ENGINE_ENOMEM or ENGINE_DISCONNECT if it couldn't be made
+     */
+    ENGINE_ERROR_CODE prepareItemToSend(DcpResponse& resp, Item*& itmCpy);
+
+    /**
+     * Pass one response to the server; called switched out of the engine.
+     *
+     * @param itmCpy the Item to send for a mutation or deletion
+     */
+    ENGINE_ERROR_CODE sendResponse(struct dcp_message_producers* producers,
+                                   DcpResponse* resp,
+                                   Item* itmCpy);
+
+    /**
+     * The Item to send for a mutation or deletion. Normally the Item in
+     * the checkpoint itself, shared with a reference for the server; only
+     * if the value must be transformed (compressed or decompressed) is a
+     * copy made.
+     *
+     * @returns nullptr if a compressed value couldn't be decompressed
+     */
+    Item* getItemToSend(MutationResponse& response);
 
     size_t getItemsRemaining();
     stream_t findStreamByVbid(uint16_t vbid);
 
     std::string priority;
 
-    DcpResponse *rejectResp; // stash response for retry if E2BIG was hit
+    // Responses taken from a stream but not yet sent, in order. The front
+    // is retried if E2BIG was hit.
+    std::deque<DcpResponse*> pendingResps;
 
     bool notifyOnly;
 
@@ -311,6 +349,8 @@ protected:
 
     std::atomic<size_t> itemsSent;
     std::atomic<size_t> totalBytesSent;
+    // Items sent as a transformed copy rather than shared
+    std::atomic<size_t> itemsCopied;
 
     ExTask checkpointCreatorTask;
     static const std::chrono::seconds defaultDcpNoopTxInterval;
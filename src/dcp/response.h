@@ -337,6 +337,14 @@ public:
         return new Item(*item_);
     }
 
+    /**
+     * @returns the (shared) Item itself with a reference taken for the
+     *          caller, to be given up with queued_item::releaseReference().
+     */
+    Item* getItemReference() {
+        return item_.acquireReference();
+    }
+
     uint16_t getVBucket() {
         return item_->getVBucketId();
     }
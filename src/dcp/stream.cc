@@ -26,6 +26,7 @@
 #include "dcp/backfill-manager.h"
 #include "dcp/backfill.h"
 #include "dcp/consumer.h"
+#include "dcp/dcpconnmap.h"
 #include "dcp/producer.h"
 #include "dcp/response.h"
 #include "dcp/stream.h"
@@ -138,24 +139,33 @@ void Stream::popFromReadyQ(void)
 {
     /* expect streamMutex.ownsLock() == true */
     if (!readyQ.empty()) {
-        const auto& front = readyQ.front();
-        if (!front->isMetaEvent()) {
-            readyQ_non_meta_items--;
-        }
-        const uint32_t respSize = front->getMessageSize();
+        DcpResponse* front = readyQ.front();
         readyQ.pop();
+        removeFromReadyQAccounting(*front);
+    }
+}
 
-        /* Decrement the readyQ size */
-        if (respSize <= readyQueueMemory.load(std::memory_order_relaxed)) {
-            readyQueueMemory.fetch_sub(respSize, std::memory_order_relaxed);
-        } else {
-            LOG(EXTENSION_LOG_DEBUG, "readyQ size for stream %s (vb %d)"
-                "underflow, likely wrong stat calculation! curr size: %" PRIu64
-                "; new size: %d",
-                name_.c_str(), getVBucket(),
-                readyQueueMemory.load(std::memory_order_relaxed), respSize);
-            readyQueueMemory.store(0, std::memory_order_relaxed);
-        }
+void Stream::addToReadyQAccounting(size_t nonMetaItems, uint64_t bytes) {
+    readyQ_non_meta_items.fetch_add(nonMetaItems);
+    readyQueueMemory.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Stream::removeFromReadyQAccounting(DcpResponse& resp) {
+    if (!resp.isMetaEvent()) {
+        readyQ_non_meta_items--;
+    }
+    const uint32_t respSize = resp.getMessageSize();
+
+    /* Decrement the readyQ size */
+    if (respSize <= readyQueueMemory.load(std::memory_order_relaxed)) {
+        readyQueueMemory.fetch_sub(respSize, std::memory_order_relaxed);
+    } else {
+        LOG(EXTENSION_LOG_DEBUG, "readyQ size for stream %s (vb %d)"
+            "underflow, likely wrong stat calculation! curr size: %" PRIu64
+            "; new size: %d",
+            name_.c_str(), getVBucket(),
+            readyQueueMemory.load(std::memory_order_relaxed), respSize);
+        readyQueueMemory.store(0, std::memory_order_relaxed);
     }
 }
 
@@ -221,6 +231,7 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
       pendingBackfill(false),
       lastReadSeqno(st_seqno),
       backfillRemaining(0),
+      backfillTiming(),
       lastReadSeqnoUnSnapshotted(st_seqno),
       lastSentSeqno(st_seqno),
       curChkSeqno(st_seqno),
@@ -231,7 +242,8 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
       engine(e),
       producer(p),
       lastSentSnapEndSeqno(0),
-      chkptItemsExtractionInProgress(false) {
+      chkptItemsExtractionInProgress(false),
+      sample(e->getDcpConnMap().getStreamSampler().add(n, vb)) {
     const char* type = "";
     if (flags_ & DCP_ADD_STREAM_FLAG_TAKEOVER) {
         type = "takeover ";
@@ -278,6 +290,11 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
 
 ActiveStream::~ActiveStream() {
     transitionState(StreamState::Dead);
+
+    DcpResponse* resp;
+    while (memoryReadyQ.pop(resp)) {
+        delete resp;
+    }
 }
 
 DcpResponse* ActiveStream::next() {
@@ -288,6 +305,8 @@ DcpResponse* ActiveStream::next() {
 DcpResponse* ActiveStream::next(std::lock_guard<std::mutex>& lh) {
     DcpResponse* response = NULL;
 
+    takeMemorySnapshots_UNLOCKED();
+
     switch (state_.load()) {
         case StreamState::Pending:
             break;
@@ -315,6 +334,23 @@ DcpResponse* ActiveStream::next(std::lock_guard<std::mutex>& lh) {
             break;
     }
 
+    sample->setReadyQueueItems(readyQ_non_meta_items.load());
+    if (response) {
+        switch (response->getEvent()) {
+            case DcpResponse::Event::Mutation:
+            case DcpResponse::Event::Deletion:
+            case DcpResponse::Event::Expiration: {
+                auto* mutation = static_cast<MutationResponse*>(response);
+                sample->recordItemSent(mutation->getMessageSize(),
+                                       mutation->getItem()->getQueuedTime());
+                break;
+            }
+            default:
+                sample->recordSent(response->getMessageSize());
+                break;
+        }
+    }
+
     itemsReady.store(response ? true : false);
     return response;
 }
@@ -335,6 +371,11 @@ void ActiveStream::markDiskSnapshot(uint64_t startSeqno, uint64_t endSeqno) {
         startSeqno = std::min(snap_start_seqno_, startSeqno);
         firstMarkerSent = true;
 
+        backfillTiming.start = ProcessClock::now();
+        backfillTiming.end = ProcessClock::time_point();
+        backfillTiming.itemsBefore =
+                backfillItems.disk.load() + backfillItems.memory.load();
+
         RCPtr<VBucket> vb = engine->getVBucket(vb_);
         if (!vb) {
             producer->getLogger().log(EXTENSION_LOG_WARNING,"(vb %" PRIu16 ") "
@@ -435,13 +476,17 @@ void ActiveStream::completeBackfill() {
     {
         LockHolder lh(streamMutex);
         if (isBackfilling()) {
+            if (backfillTiming.end == ProcessClock::time_point()) {
+                backfillTiming.end = ProcessClock::now();
+            }
             producer->getLogger().log(EXTENSION_LOG_NOTICE,
                     "(vb %" PRIu16 ") Backfill complete, %" PRIu64 " items "
                     "read from disk, %" PRIu64 " from memory, last seqno read: "
-                    "%" PRIu64 ", pendingBackfill : %s",
+                    "%" PRIu64 ", %" PRIu64 " items/s, pendingBackfill : %s",
                     vb_, uint64_t(backfillItems.disk.load()),
                     uint64_t(backfillItems.memory.load()),
                     lastReadSeqno.load(),
+                    uint64_t(getBackfillRate_UNLOCKED()),
                     pendingBackfill ? "True" : "False");
         } else {
             producer->getLogger().log(EXTENSION_LOG_WARNING,
@@ -556,6 +601,16 @@ DcpResponse* ActiveStream::inMemoryPhase() {
         endStream(END_STREAM_OK);
     } else if (readyQ.empty()) {
         if (pendingBackfill) {
+            // A snapshot still being built must land before the switch, or
+            // it would be dropped after advancing lastReadSeqno. The task
+            // notifies the stream once it is done.
+            if (chkptItemsExtractionInProgress) {
+                return NULL;
+            }
+            takeMemorySnapshots_UNLOCKED();
+            if (!readyQ.empty()) {
+                return nextQueuedItem();
+            }
             // Moving the state from InMemory to Backfilling will result in a
             // backfill being scheduled
             transitionState(StreamState::Backfilling);
@@ -585,6 +640,13 @@ DcpResponse* ActiveStream::takeoverSendPhase() {
         }
     }
 
+    // No extraction is in progress, so whatever the last one snapshotted
+    // has been pushed - it must be sent before the vbucket state.
+    takeMemorySnapshots_UNLOCKED();
+    if (!readyQ.empty()) {
+        return nextQueuedItem();
+    }
+
     if (waitForSnapshot != 0) {
         return NULL;
     }
@@ -668,6 +730,16 @@ void ActiveStream::addStats(ADD_STAT add_stat, const void *c) {
         checked_snprintf(buffer, bsize, "%s:stream_%d_backfill_buffer_items",
                          name_.c_str(), vb_);
         add_casted_stat(buffer, bufferedBackfill.items, add_stat, c);
+        {
+            LockHolder lh(streamMutex);
+            if (backfillTiming.start != ProcessClock::time_point()) {
+                checked_snprintf(buffer, bsize,
+                                 "%s:stream_%d_backfill_items_per_sec",
+                                 name_.c_str(), vb_);
+                add_casted_stat(buffer, getBackfillRate_UNLOCKED(), add_stat,
+                                c);
+            }
+        }
 
         if (isTakeoverSend() && takeoverStart != 0) {
             checked_snprintf(buffer, bsize, "%s:stream_%d_takeover_since",
@@ -681,6 +753,20 @@ void ActiveStream::addStats(ADD_STAT add_stat, const void *c) {
     }
 }
 
+size_t ActiveStream::getBackfillRate_UNLOCKED() const {
+    const auto end = (backfillTiming.end == ProcessClock::time_point())
+                             ? ProcessClock::now()
+                             : backfillTiming.end;
+    const std::chrono::duration<double> elapsed = end - backfillTiming.start;
+    if (elapsed.count() <= 0) {
+        return 0;
+    }
+    const size_t items = backfillItems.disk.load() +
+                         backfillItems.memory.load() -
+                         backfillTiming.itemsBefore;
+    return static_cast<size_t>(items / elapsed.count());
+}
+
 void ActiveStream::addTakeoverStats(ADD_STAT add_stat, const void *cookie,
                                     const VBucket& vb) {
     LockHolder lh(streamMutex);
@@ -742,6 +828,9 @@ void ActiveStream::addTakeoverStats(ADD_STAT add_stat, const void *cookie,
 }
 
 DcpResponse* ActiveStream::nextQueuedItem() {
+    if (readyQ.empty()) {
+        takeMemorySnapshots_UNLOCKED();
+    }
     if (!readyQ.empty()) {
         DcpResponse* response = readyQ.front();
         if (producer->bufferLogInsert(response->getMessageSize())) {
@@ -920,8 +1009,9 @@ void ActiveStream::snapshot(std::deque<DcpResponse*>& items, bool mark) {
         return;
     }
 
-    LockHolder lh(streamMutex);
-
+    // Runs without streamMutex: the snapshot is handed over through
+    // memoryReadyQ, and takeMemorySnapshots_UNLOCKED drops it if the stream
+    // has changed state in the meantime.
     if (!isActive() || isBackfilling()) {
         // If stream was closed forcefully by the time the checkpoint items
         // retriever task completed, or if we decided to switch the stream to
@@ -969,13 +1059,39 @@ void ActiveStream::snapshot(std::deque<DcpResponse*>& items, bool mark) {
             snapStart = std::min(snap_start_seqno_, snapStart);
             firstMarkerSent = true;
         }
-        pushToReadyQ(new SnapshotMarker(opaque_, vb_, snapStart, snapEnd,
-                                        flags));
+        items.push_front(new SnapshotMarker(opaque_, vb_, snapStart, snapEnd,
+                                            flags));
         lastSentSnapEndSeqno.store(snapEnd, std::memory_order_relaxed);
     }
 
+    // Accounted for once for the whole snapshot, before the front end can
+    // take (and un-account) any of it
+    size_t nonMetaItems = 0;
+    uint64_t bytes = 0;
     for (const auto& item : items) {
-        pushToReadyQ(item);
+        if (!item->isMetaEvent()) {
+            nonMetaItems++;
+        }
+        bytes += item->getMessageSize();
+    }
+    addToReadyQAccounting(nonMetaItems, bytes);
+
+    for (const auto& item : items) {
+        memoryReadyQ.push(item);
+    }
+}
+
+void ActiveStream::takeMemorySnapshots_UNLOCKED() {
+    const bool accept = isActive() && !isBackfilling();
+    DcpResponse* resp;
+    while (memoryReadyQ.pop(resp)) {
+        if (accept) {
+            // Already accounted for when pushed to memoryReadyQ
+            readyQ.push(resp);
+        } else {
+            removeFromReadyQAccounting(*resp);
+            delete resp;
+        }
     }
 }
 
@@ -1004,6 +1120,8 @@ void ActiveStream::notifySeqnoAvailable(uint64_t seqno) {
 
 void ActiveStream::endStream(end_stream_status_t reason) {
     if (isActive()) {
+        // Snapshots already pushed go out ahead of the stream end
+        takeMemorySnapshots_UNLOCKED();
         pendingBackfill = false;
         if (isBackfilling()) {
             // If Stream were in Backfilling state, clear out the
@@ -1531,7 +1649,8 @@ PassiveStream::PassiveStream(EventuallyPersistentEngine* e, dcp_consumer_t c,
     : Stream(name, flags, opaque, vb, st_seqno, en_seqno, vb_uuid,
              snap_start_seqno, snap_end_seqno),
       engine(e), consumer(c), last_seqno(vb_high_seqno), cur_snapshot_start(0),
-      cur_snapshot_end(0), cur_snapshot_type(Snapshot::None), cur_snapshot_ack(false) {
+      cur_snapshot_end(0), cur_snapshot_type(Snapshot::None), cur_snapshot_ack(false),
+      bufferClaimed(false) {
     LockHolder lh(streamMutex);
     type_ = STREAM_PASSIVE;
     streamRequest_UNLOCKED(vb_uuid);
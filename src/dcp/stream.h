@@ -24,7 +24,9 @@
 #include "ext_meta_parser.h"
 #include "dcp/dcp-types.h"
 #include "dcp/producer.h"
+#include "dcp/stream_sampler.h"
 #include "response.h"
+#include "spsc_queue.h"
 #include "vbucket.h"
 
 #include <atomic>
@@ -166,6 +168,11 @@ protected:
     /* To be called after getting streamMutex lock */
     void popFromReadyQ(void);
 
+    /* Account for responses put on the readyQ other than by pushToReadyQ,
+       or taken off it other than by popFromReadyQ */
+    void addToReadyQAccounting(size_t nonMetaItems, uint64_t bytes);
+    void removeFromReadyQAccounting(DcpResponse& resp);
+
     uint64_t getReadyQueueMemory(void);
 
     const std::string &name_;
@@ -235,6 +242,10 @@ public:
         backfillRemaining.fetch_add(by, std::memory_order_relaxed);
     }
 
+    size_t getBackfillRemaining() const {
+        return backfillRemaining.load(std::memory_order_relaxed);
+    }
+
     void markDiskSnapshot(uint64_t startSeqno, uint64_t endSeqno);
 
     bool backfillReceived(std::unique_ptr<Item> itm,
@@ -319,8 +330,21 @@ protected:
      */
     std::atomic<size_t> backfillRemaining;
 
+    /* When the current (or last) backfill started and finished sending its
+     * snapshot, and the items backfilled before it, for its throughput
+     * stat. end is zero until it finishes. Guarded by streamMutex.
+     */
+    struct {
+        ProcessClock::time_point start;
+        ProcessClock::time_point end;
+        size_t itemsBefore;
+    } backfillTiming;
+
 private:
 
+    /* Items per second read by the current (or last) backfill */
+    size_t getBackfillRate_UNLOCKED() const;
+
     DcpResponse* next(std::lock_guard<std::mutex>& lh);
 
     DcpResponse* backfillPhase(std::lock_guard<std::mutex>& lh);
@@ -335,6 +359,12 @@ private:
 
     void snapshot(std::deque<DcpResponse*>& snapshot, bool mark);
 
+    /* Move the snapshots pushed to memoryReadyQ onto the readyQ, or drop
+     * them if the stream is no longer taking items from memory.
+     * Note: Expects the streamMutex to be acquired when called
+     */
+    void takeMemorySnapshots_UNLOCKED();
+
     void endStream(end_stream_status_t reason);
 
     /* reschedule = FALSE ==> First backfill on the stream
@@ -372,7 +402,7 @@ private:
     std::atomic<size_t> itemsFromMemoryPhase;
 
     //! Whether ot not this is the first snapshot marker sent
-    bool firstMarkerSent;
+    std::atomic<bool> firstMarkerSent;
 
     std::atomic<int> waitForSnapshot;
 
@@ -395,6 +425,15 @@ private:
        items are added to the readyQ */
     std::atomic<bool> chkptItemsExtractionInProgress;
 
+    /* The in-memory snapshots built by the checkpoint processor task,
+     * handed to the front end without either taking streamMutex. The task
+     * is the only producer and the front end (under streamMutex) the only
+     * consumer. Counted in the readyQ's accounting from when pushed. */
+    SpscQueue<DcpResponse*> memoryReadyQ;
+
+    /* What this stream sends, for the bucket's dcp-hot stats */
+    std::shared_ptr<DcpStreamSampler::Sample> sample;
+
 };
 
 
@@ -497,6 +536,26 @@ public:
     process_items_error_t processBufferedMessages(uint32_t &processed_bytes,
                                                   size_t batchSize);
 
+    /**
+     * Claim the stream's buffered messages for processing. A consumer may
+     * run several Processor tasks; only the one holding the claim calls
+     * processBufferedMessages, so that the messages are applied in order.
+     *
+     * @returns false if another task holds the claim
+     */
+    bool claimBufferedMessages() {
+        bool expected = false;
+        return bufferClaimed.compare_exchange_strong(expected, true);
+    }
+
+    void releaseBufferedMessages() {
+        bufferClaimed.store(false);
+    }
+
+    bool hasBufferedMessages() const {
+        return !buffer.empty();
+    }
+
     DcpResponse* next();
 
     uint32_t setDead(end_stream_status_t status);
@@ -591,6 +650,9 @@ protected:
     std::atomic<Snapshot> cur_snapshot_type;
     bool cur_snapshot_ack;
 
+    // Set while a Processor task is processing the buffered messages
+    std::atomic<bool> bufferClaimed;
+
     struct Buffer {
         Buffer() : bytes(0) {}
 
@@ -0,0 +1,172 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+#include "dcp/stream_sampler.h"
+#include "ep_time.h"
+#include "statwriter.h"
+
+#include <platform/checked_snprintf.h>
+
+#include <algorithm>
+
+// Fewest references add() leaves before dropping expired ones
+static const size_t minPruneAt = 64;
+
+DcpStreamSampler::DcpStreamSampler() : pruneAt(minPruneAt) {
+}
+
+DcpStreamSampler::Sample::Sample(std::string name, uint16_t vbid)
+    : name(std::move(name)),
+      vbid(vbid),
+      itemsSent(0),
+      bytesSent(0),
+      latencyTotal(0),
+      maxLatency(0),
+      readyQueueItems(0),
+      lastRead(ProcessClock::now()),
+      lastItemsSent(0),
+      lastBytesSent(0),
+      lastLatencyTotal(0) {
+}
+
+void DcpStreamSampler::Sample::recordItemSent(size_t bytes,
+                                              rel_time_t queuedTime) {
+    const rel_time_t now = ep_current_time();
+    const uint32_t latency = now > queuedTime ? now - queuedTime : 0;
+
+    // Each stream's sends are serialised by its streamMutex, so the only
+    // other writer of maxLatency is the reader resetting it.
+    if (latency > maxLatency.load(std::memory_order_relaxed)) {
+        maxLatency.store(latency, std::memory_order_relaxed);
+    }
+    latencyTotal.fetch_add(latency, std::memory_order_relaxed);
+    bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+    itemsSent.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::shared_ptr<DcpStreamSampler::Sample> DcpStreamSampler::add(
+        const std::string& name, uint16_t vbid) {
+    auto sample = std::make_shared<Sample>(name, vbid);
+    std::lock_guard<std::mutex> lh(mutex);
+    if (samples.size() >= pruneAt) {
+        // Each expired reference still holds its stream's Sample (allocated
+        // with the control block), so drop them before they pile up.
+        samples.remove_if([](const std::weak_ptr<Sample>& s) {
+            return s.expired();
+        });
+        pruneAt = std::max(minPruneAt, samples.size() * 2);
+    }
+    samples.push_back(sample);
+    return sample;
+}
+
+std::vector<DcpStreamSampler::Snapshot> DcpStreamSampler::getHottest(
+        size_t n) {
+    std::vector<Snapshot> result;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        const auto now = ProcessClock::now();
+        for (auto it = samples.begin(); it != samples.end();) {
+            auto sample = it->lock();
+            if (!sample) {
+                it = samples.erase(it);
+                continue;
+            }
+            result.push_back(read_UNLOCKED(*sample, now));
+            ++it;
+        }
+    }
+
+    auto byLag = [](const Snapshot& a, const Snapshot& b) {
+        if (a.lag != b.lag) {
+            return a.lag > b.lag;
+        }
+        return a.readyQueueItems > b.readyQueueItems;
+    };
+    if (result.size() > n) {
+        std::partial_sort(
+                result.begin(), result.begin() + n, result.end(), byLag);
+        result.resize(n);
+    } else {
+        std::sort(result.begin(), result.end(), byLag);
+    }
+    return result;
+}
+
+void DcpStreamSampler::addStats(size_t n, ADD_STAT add_stat, const void* c) {
+    const auto hottest = getHottest(n);
+    char key[64];
+    for (size_t ii = 0; ii < hottest.size(); ++ii) {
+        const auto& stream = hottest[ii];
+        checked_snprintf(key, sizeof(key), "hot_%zu:name", ii);
+        add_casted_stat(key, stream.name.c_str(), add_stat, c);
+        checked_snprintf(key, sizeof(key), "hot_%zu:vbucket", ii);
+        add_casted_stat(key, stream.vbid, add_stat, c);
+        checked_snprintf(key, sizeof(key), "hot_%zu:items_per_sec", ii);
+        add_casted_stat(key, uint64_t(stream.itemsPerSec), add_stat, c);
+        checked_snprintf(key, sizeof(key), "hot_%zu:bytes_per_sec", ii);
+        add_casted_stat(key, uint64_t(stream.bytesPerSec), add_stat, c);
+        checked_snprintf(key, sizeof(key), "hot_%zu:ready_queue_items", ii);
+        add_casted_stat(key, stream.readyQueueItems, add_stat, c);
+        checked_snprintf(key, sizeof(key), "hot_%zu:latency_avg_s", ii);
+        add_casted_stat(key, stream.avgLatency, add_stat, c);
+        checked_snprintf(key, sizeof(key), "hot_%zu:latency_max_s", ii);
+        add_casted_stat(key, stream.maxLatency, add_stat, c);
+    }
+}
+
+size_t DcpStreamSampler::size() {
+    std::lock_guard<std::mutex> lh(mutex);
+    return samples.size();
+}
+
+DcpStreamSampler::Snapshot DcpStreamSampler::read_UNLOCKED(
+        Sample& sample, ProcessClock::time_point now) {
+    const uint64_t items = sample.itemsSent.load(std::memory_order_relaxed);
+    const uint64_t bytes = sample.bytesSent.load(std::memory_order_relaxed);
+    const uint64_t latency =
+            sample.latencyTotal.load(std::memory_order_relaxed);
+
+    const double secs =
+            std::chrono::duration<double>(now - sample.lastRead).count();
+    const uint64_t itemsDelta = items - sample.lastItemsSent;
+
+    Snapshot snap;
+    snap.name = sample.name;
+    snap.vbid = sample.vbid;
+    snap.itemsPerSec = secs > 0 ? itemsDelta / secs : 0;
+    snap.bytesPerSec = secs > 0 ? (bytes - sample.lastBytesSent) / secs : 0;
+    snap.readyQueueItems =
+            sample.readyQueueItems.load(std::memory_order_relaxed);
+    snap.avgLatency =
+            itemsDelta ? double(latency - sample.lastLatencyTotal) / itemsDelta
+                       : 0;
+    snap.maxLatency = sample.maxLatency.exchange(0, std::memory_order_relaxed);
+    if (itemsDelta == 0 && snap.readyQueueItems > 0) {
+        // Stuck - its items have waited at least this long
+        snap.lag = secs;
+    } else {
+        snap.lag = snap.avgLatency;
+    }
+
+    sample.lastRead = now;
+    sample.lastItemsSent = items;
+    sample.lastBytesSent = bytes;
+    sample.lastLatencyTotal = latency;
+    return snap;
+}
@@ -0,0 +1,135 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <memcached/engine_common.h>
+#include <memcached/types.h>
+#include <platform/processclock.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Throughput and latency samples of the active DCP streams of a bucket,
+ * for finding which of the many streams multiplexed over its connections
+ * are falling behind (the "dcp-hot" stats group).
+ *
+ * Each stream records what it sends into its own Sample, touching only
+ * relaxed atomics of that sample. The sampler holds weak references to the
+ * samples, so reading them takes neither the connection map's lock nor any
+ * stream's, and a stream going away just leaves an expired reference which
+ * the next read drops. Adding streams also drops expired references once
+ * the list has doubled, so that they don't pile up where nobody reads the
+ * samples. Rates and latencies are over the interval since the previous
+ * read.
+ */
+class DcpStreamSampler {
+public:
+    DcpStreamSampler();
+
+    class Sample {
+    public:
+        Sample(std::string name, uint16_t vbid);
+
+        /**
+         * Record an item sent in a message of the given size.
+         *
+         * @param queuedTime when the item was queued in the vbucket
+         */
+        void recordItemSent(size_t bytes, rel_time_t queuedTime);
+
+        /**
+         * Record a message which doesn't carry an item (a snapshot marker,
+         * stream end etc.).
+         */
+        void recordSent(size_t bytes) {
+            bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void setReadyQueueItems(size_t items) {
+            readyQueueItems.store(items, std::memory_order_relaxed);
+        }
+
+        const std::string name;
+        const uint16_t vbid;
+
+    private:
+        friend class DcpStreamSampler;
+
+        std::atomic<uint64_t> itemsSent;
+        std::atomic<uint64_t> bytesSent;
+        // Seconds from queued to sent, summed over itemsSent
+        std::atomic<uint64_t> latencyTotal;
+        // Since the previous read
+        std::atomic<uint32_t> maxLatency;
+        std::atomic<size_t> readyQueueItems;
+
+        // The counts at the previous read, guarded by the sampler's mutex
+        ProcessClock::time_point lastRead;
+        uint64_t lastItemsSent;
+        uint64_t lastBytesSent;
+        uint64_t lastLatencyTotal;
+    };
+
+    /**
+     * A stream's figures over the interval since the previous read.
+     */
+    struct Snapshot {
+        std::string name;
+        uint16_t vbid;
+        double itemsPerSec;
+        double bytesPerSec;
+        size_t readyQueueItems;
+        // Seconds from queued to sent
+        double avgLatency;
+        uint32_t maxLatency;
+        // What streams are ranked by: the average latency, or if nothing
+        // was sent while items were ready, the whole interval.
+        double lag;
+    };
+
+    /**
+     * Start sampling a stream. Sampling stops when the returned Sample is
+     * released.
+     */
+    std::shared_ptr<Sample> add(const std::string& name, uint16_t vbid);
+
+    /**
+     * The n streams lagging the most, most first.
+     */
+    std::vector<Snapshot> getHottest(size_t n);
+
+    void addStats(size_t n, ADD_STAT add_stat, const void* c);
+
+    /* Number of streams being sampled, including any not yet dropped */
+    size_t size();
+
+private:
+    Snapshot read_UNLOCKED(Sample& sample, ProcessClock::time_point now);
+
+    std::mutex mutex;
+    std::list<std::weak_ptr<Sample>> samples;
+    // The size of samples at which add() next drops expired references
+    size_t pruneAt;
+};
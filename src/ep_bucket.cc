@@ -53,6 +53,17 @@ void EPBucket::deinitialize() {
     stopFlusher();
     stopBgFetcher();
 
+    if (isBfilterPersistEnabled() && !stats.forceShutdown) {
+        // With the flusher stopped the filters describe the files exactly,
+        // save them so that warmup does not start with no filters.
+        for (VBucketMap::id_type vbid = 0; vbid < vbMap.getSize(); ++vbid) {
+            RCPtr<VBucket> vb = vbMap.getBucket(vbid);
+            if (vb) {
+                persistBloomFilter(*vb);
+            }
+        }
+    }
+
     KVBucket::deinitialize();
 }
 
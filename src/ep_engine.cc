@@ -524,6 +524,11 @@ static protocol_binary_response_status setFlushParam(
                     delete tmp;
                 }
             }
+        } else if (strcmp(keyz, "bg_fetch_coalesce_max_us") == 0) {
+            e->getConfiguration().setBgFetchCoalesceMaxUs(std::stoull(valz));
+        } else if (strcmp(keyz, "bg_fetch_latency_target_us") == 0) {
+            e->getConfiguration().setBgFetchLatencyTargetUs(
+                std::stoull(valz));
         } else if (strcmp(keyz, "exp_pager_enabled") == 0) {
             e->getConfiguration().setExpPagerEnabled(cb_stob(valz));
         } else if (strcmp(keyz, "exp_pager_stime") == 0) {
@@ -565,6 +570,10 @@ static protocol_binary_response_status setFlushParam(
             size_t value = std::stoull(valz);
             e->getConfiguration().setNumNonioThreads(value);
             ExecutorPool::get()->setNumNonIO(value);
+        } else if (strcmp(keyz, "executor_cpu_quota") == 0) {
+            e->getConfiguration().setExecutorCpuQuota(std::stoull(valz));
+        } else if (strcmp(keyz, "executor_io_quota") == 0) {
+            e->getConfiguration().setExecutorIoQuota(std::stoull(valz));
         } else if (strcmp(keyz, "bfilter_enabled") == 0) {
             e->getConfiguration().setBfilterEnabled(cb_stob(valz));
         } else if (strcmp(keyz, "bfilter_residency_threshold") == 0) {
@@ -654,6 +663,28 @@ static protocol_binary_response_status setDcpParam(
             validate(v, size_t(1), std::numeric_limits<size_t>::max());
             e->getConfiguration().setDcpConsumerProcessBufferedMessagesBatchSize(
                 v);
+        } else if (strcmp(keyz, "dcp_consumer_processor_tasks") == 0) {
+            size_t v = atoi(valz);
+            checkNumeric(valz);
+            validate(v, size_t(1), size_t(64));
+            e->getConfiguration().setDcpConsumerProcessorTasks(v);
+        } else if (strcmp(keyz, "dcp_backfill_disk_scans_per_shard") == 0) {
+            checkNumeric(valz);
+            e->getConfiguration().setDcpBackfillDiskScansPerShard(
+                    std::stoull(valz));
+        } else if (strcmp(keyz, "dcp_compression_cache_size") == 0) {
+            checkNumeric(valz);
+            e->getConfiguration().setDcpCompressionCacheSize(std::stoull(valz));
+        } else if (strcmp(keyz, "dcp_producer_batch_item_limit") == 0) {
+            size_t v = atoi(valz);
+            checkNumeric(valz);
+            validate(v, size_t(1), std::numeric_limits<size_t>::max());
+            e->getConfiguration().setDcpProducerBatchItemLimit(v);
+        } else if (strcmp(keyz, "dcp_producer_batch_byte_limit") == 0) {
+            checkNumeric(valz);
+            size_t v = std::stoull(valz);
+            validate(v, size_t(1), std::numeric_limits<size_t>::max());
+            e->getConfiguration().setDcpProducerBatchByteLimit(v);
         } else {
             msg = "Unknown config param";
             rv = PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
@@ -979,6 +1010,10 @@ static ENGINE_ERROR_CODE getReplicaCmd(EventuallyPersistentEngine* e,
             return error_code;
         }
     } else {
+        if (!e->decompressForClient(cookie, *rv.getValue())) {
+            delete rv.getValue();
+            return ENGINE_FAILED;
+        }
         *it = rv.getValue();
         *res = PROTOCOL_BINARY_RESPONSE_SUCCESS;
     }
@@ -1917,6 +1952,10 @@ public:
             engine.setMaxItemSize(value);
         } else if (key.compare("max_item_privileged_bytes") == 0) {
             engine.setMaxItemPrivilegedBytes(value);
+        } else if (key.compare("executor_cpu_quota") == 0) {
+            engine.getWorkLoadPolicy().setCpuQuota(value);
+        } else if (key.compare("executor_io_quota") == 0) {
+            engine.getWorkLoadPolicy().setIOQuota(value);
         }
     }
 
@@ -1988,6 +2027,12 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
 
     workload = new WorkLoadPolicy(configuration.getMaxNumWorkers(),
                                   configuration.getMaxNumShards());
+    workload->setCpuQuota(configuration.getExecutorCpuQuota());
+    configuration.addValueChangedListener("executor_cpu_quota",
+                                       new EpEngineValueChangeListener(*this));
+    workload->setIOQuota(configuration.getExecutorIoQuota());
+    configuration.addValueChangedListener("executor_io_quota",
+                                       new EpEngineValueChangeListener(*this));
     if ((unsigned int)workload->getNumShards() >
                                               configuration.getMaxVbuckets()) {
         LOG(EXTENSION_LOG_WARNING, "Invalid configuration: Shards must be "
@@ -2006,6 +2051,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
         dcpFlowControlManager_ = new DcpFlowControlManagerDynamic(*this);
     } else if (!flowCtlPolicy.compare("aggressive")) {
         dcpFlowControlManager_ = new DcpFlowControlManagerAggressive(*this);
+    } else if (!flowCtlPolicy.compare("adaptive")) {
+        dcpFlowControlManager_ = new DcpFlowControlManagerAdaptive(*this);
     } else {
         /* Flow control is not enabled */
         dcpFlowControlManager_ = new DcpFlowControlManager(*this);
@@ -2191,6 +2238,12 @@ cb::EngineErrorItemPair EventuallyPersistentEngine::get_if(const void* cookie,
         // Currently
         if (filter(item->toItemInfo(vb_uuid))) {
             if (!gv.isPartial()) {
+                if (!decompressForClient(cookie, *item)) {
+                    return std::make_pair(cb::engine_errc::failed,
+                                          cb::unique_item_ptr{
+                                                  nullptr,
+                                                  cb::ItemDeleter{handle}});
+                }
                 return std::make_pair(cb::engine_errc::success,
                                cb::unique_item_ptr{ret.release(),
                                                    cb::ItemDeleter{handle}});
@@ -2232,6 +2285,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::get_locked(const void* cookie,
                                       lock_timeout, cookie);
 
     if (result.getStatus() == ENGINE_SUCCESS) {
+        if (!decompressForClient(cookie, *result.getValue())) {
+            delete result.getValue();
+            return ENGINE_FAILED;
+        }
         ++stats.numOpsGet;
         *itm = result.getValue();
     }
@@ -2408,6 +2465,15 @@ inline uint16_t EventuallyPersistentEngine::doWalkTapQueue(const void *cookie,
     case TAP_DELETION:
         *itm = it;
         if (ret == TAP_MUTATION) {
+            // TAP has no way to negotiate snappy
+            if (!it->decompressValue()) {
+                LOG(EXTENSION_LOG_WARNING,
+                    "%s Failed to decompress a value for TAP, disconnecting",
+                    connection->logHeader());
+                delete it;
+                *itm = nullptr;
+                return TAP_DISCONNECT;
+            }
             *nes = TapEngineSpecific::packSpecificData(ret, connection,
                                                        it->getRevSeqno(), nru);
             *es = connection->specificData;
@@ -3123,6 +3189,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(const void *cookie,
                     add_stat, cookie);
     add_casted_stat("ep_bg_meta_fetched", epstats.bg_meta_fetched,
                     add_stat, cookie);
+    add_casted_stat("ep_bg_fetch_coalesced", epstats.bgFetchCoalesced,
+                    add_stat, cookie);
     add_casted_stat("ep_bg_remaining_items", epstats.numRemainingBgItems,
                     add_stat, cookie);
     add_casted_stat("ep_bg_remaining_jobs", epstats.numRemainingBgJobs,
@@ -3921,6 +3989,26 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doDcpStats(const void *cookie,
     return ENGINE_SUCCESS;
 }
 
+ENGINE_ERROR_CODE EventuallyPersistentEngine::doDcpHotStats(const void *cookie,
+                                                            ADD_STAT add_stat,
+                                                            const char* stat_key,
+                                                            int nkey) {
+    // "dcp-hot" or "dcp-hot <n>" for the n most lagging streams
+    size_t n = 10;
+    if (nkey > 7) {
+        if (stat_key[7] != ' ') {
+            return ENGINE_EINVAL;
+        }
+        try {
+            n = std::stoull(std::string(stat_key + 8, nkey - 8));
+        } catch (std::exception&) {
+            return ENGINE_EINVAL;
+        }
+    }
+    dcpConnMap_->getStreamSampler().addStats(n, add_stat, cookie);
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::doKeyStats(const void *cookie,
                                                          ADD_STAT add_stat,
                                                          uint16_t vbid,
@@ -4053,6 +4141,12 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doTimingStats(const void *cookie,
     // Misc
     add_casted_stat("notify_io", stats.notifyIOHisto, add_stat, cookie);
     add_casted_stat("batch_read", stats.getMultiHisto, add_stat, cookie);
+    add_casted_stat("bg_batch_latency", stats.bgFetchBatchLatencyHisto,
+                    add_stat, cookie);
+    add_casted_stat("bg_batch_size", stats.bgFetchBatchSizeHisto,
+                    add_stat, cookie);
+    add_casted_stat("bg_coalesce_wait", stats.bgFetchCoalesceHisto,
+                    add_stat, cookie);
 
     // Disk stats
     add_casted_stat("disk_insert", stats.diskInsertHisto, add_stat, cookie);
@@ -4101,6 +4195,36 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doRunTimeStats(const void
     return ENGINE_SUCCESS;
 }
 
+ENGINE_ERROR_CODE EventuallyPersistentEngine::doTaskLatencyStats(
+        const void* cookie, ADD_STAT add_stat) {
+    const TaskLatencyHistograms& histos = ExecutorPool::get()->getTaskLatency();
+    TaskLatencyHistograms::Bins wait;
+    TaskLatencyHistograms::Bins run;
+    for (TaskId id : GlobalTask::allTaskIds) {
+        histos.getBins(id, wait, run);
+        for (size_t ii = 0; ii < TaskLatencyHistograms::numBins; ii++) {
+            if (wait[ii] == 0 && run[ii] == 0) {
+                continue;
+            }
+            const std::string range =
+                    std::to_string(TaskLatencyHistograms::binStart(ii)) + "," +
+                    std::to_string(TaskLatencyHistograms::binEnd(ii));
+            if (wait[ii]) {
+                add_prefixed_stat(GlobalTask::getTaskName(id),
+                                  ("wait_" + range).c_str(),
+                                  wait[ii], add_stat, cookie);
+            }
+            if (run[ii]) {
+                add_prefixed_stat(GlobalTask::getTaskName(id),
+                                  ("run_" + range).c_str(),
+                                  run[ii], add_stat, cookie);
+            }
+        }
+    }
+
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::doDispatcherStats(const void
                                                                 *cookie,
                                                                 ADD_STAT
@@ -4170,6 +4294,30 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doWorkloadStats(const void
                          "ep_workload:num_sleepers");
         add_casted_stat(statname, numSleepers, add_stat, cookie);
 
+        checked_snprintf(statname, sizeof(statname),
+                         "ep_workload:autoscale_adjustments");
+        add_casted_stat(statname,
+                        expool->getNumAutoscaleAdjustments(),
+                        add_stat,
+                        cookie);
+
+        checked_snprintf(statname, sizeof(statname), "ep_workload:numa_nodes");
+        add_casted_stat(statname, expool->getNumNumaNodes(), add_stat, cookie);
+
+        checked_snprintf(statname, sizeof(statname),
+                         "ep_workload:numa_local_tasks");
+        add_casted_stat(statname,
+                        expool->getNumNumaLocalTasks(),
+                        add_stat,
+                        cookie);
+
+        checked_snprintf(statname, sizeof(statname),
+                         "ep_workload:numa_remote_tasks");
+        add_casted_stat(statname,
+                        expool->getNumNumaRemoteTasks(),
+                        add_stat,
+                        cookie);
+
         expool->doTaskQStat(ObjectRegistry::getCurrentEngine(),
                             cookie, add_stat);
 
@@ -4305,6 +4453,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(const void* cookie,
         }
     } else if (statKey == "dcp") {
         rv = doDcpStats(cookie, add_stat);
+    } else if (cb_isPrefix(statKey, "dcp-hot")) {
+        rv = doDcpHotStats(cookie, add_stat, stat_key, nkey);
     } else if (statKey == "hash") {
         rv = doHashStats(cookie, add_stat);
     } else if (statKey == "vbucket") {
@@ -4327,6 +4477,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(const void* cookie,
         rv = doSchedulerStats(cookie, add_stat);
     } else if (statKey == "runtimes") {
         rv = doRunTimeStats(cookie, add_stat);
+    } else if (statKey == "task-latency") {
+        rv = doTaskLatencyStats(cookie, add_stat);
     } else if (statKey == "memory") {
         rv = doMemoryStats(cookie, add_stat);
     } else if (statKey == "uuid") {
@@ -4658,6 +4810,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::touch(const void *cookie,
                               PROTOCOL_BINARY_RAW_BYTES,
                               PROTOCOL_BINARY_RESPONSE_SUCCESS, it->getCas(),
                               cookie);
+        } else if (!decompressForClient(cookie, *it)) {
+            rv = ENGINE_FAILED;
         } else { // GET and TOUCH
             uint32_t flags = it->getFlags();
             rv = sendResponse(response, NULL, 0, &flags, sizeof(flags),
@@ -6062,6 +6216,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getRandomKey(const void *cookie,
 
     if (ret == ENGINE_SUCCESS) {
         Item *it = gv.getValue();
+        if (!decompressForClient(cookie, *it)) {
+            delete it;
+            return ENGINE_FAILED;
+        }
         uint32_t flags = it->getFlags();
         ret = sendResponse(response, static_cast<const void *>(it->getKey().data()),
                            it->getKey().size(),
@@ -6388,3 +6546,7 @@ void EpEngineTaskable::logRunTime(TaskId id,
                                   const ProcessClock::duration runTime) {
     myEngine->getKVBucket()->logRunTime(id, runTime);
 }
+
+size_t EpEngineTaskable::getDiskIOBytes() {
+    return myEngine->getWorkLoadPolicy().getDiskIOBytes();
+}
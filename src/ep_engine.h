@@ -85,6 +85,8 @@ public:
 
     void logRunTime(TaskId id, const ProcessClock::duration runTime);
 
+    size_t getDiskIOBytes();
+
 private:
     EventuallyPersistentEngine* myEngine;
 };
@@ -168,7 +170,11 @@ public:
     void itemRelease(const void* cookie, item *itm)
     {
         (void)cookie;
-        delete (Item*)itm;
+        // Items shared with a checkpoint (see DcpProducer::step) carry a
+        // reference for the server, others are the server's outright.
+        if (!queued_item::releaseReference(static_cast<Item*>(itm))) {
+            delete (Item*)itm;
+        }
     }
 
     ENGINE_ERROR_CODE get(const void* cookie,
@@ -182,6 +188,10 @@ public:
         ENGINE_ERROR_CODE ret = gv.getStatus();
 
         if (ret == ENGINE_SUCCESS) {
+            if (!decompressForClient(cookie, *gv.getValue())) {
+                delete gv.getValue();
+                return ENGINE_FAILED;
+            }
             *itm = gv.getValue();
             if (options & TRACK_STATISTICS) {
                 ++stats.numOpsGet;
@@ -378,6 +388,21 @@ public:
         return isDatatypeSupported(cookie, PROTOCOL_BINARY_DATATYPE_XATTR);
     }
 
+    /**
+     * Values may be held snappy compressed (compression_mode=active), so
+     * decompress itm's value if it is going to a client which hasn't
+     * negotiated snappy.
+     *
+     * @returns false if the value couldn't be decompressed
+     */
+    bool decompressForClient(const void* cookie, Item& itm) {
+        if (!mcbp::datatype::is_snappy(itm.getDataType()) ||
+            isDatatypeSupported(cookie, PROTOCOL_BINARY_DATATYPE_SNAPPY)) {
+            return true;
+        }
+        return itm.decompressValue();
+    }
+
     uint8_t getOpcodeIfEwouldblockSet(const void *cookie) {
         EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL, true);
         uint8_t opcode = serverApi->cookie->get_opcode_if_ewouldblock_set(cookie);
@@ -701,12 +726,16 @@ protected:
                                         const char* stat_key, int nkey);
     ENGINE_ERROR_CODE doTapStats(const void *cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doDcpStats(const void *cookie, ADD_STAT add_stat);
+    ENGINE_ERROR_CODE doDcpHotStats(const void *cookie, ADD_STAT add_stat,
+                                    const char* stat_key, int nkey);
     ENGINE_ERROR_CODE doConnAggStats(const void *cookie, ADD_STAT add_stat,
                                      const char *sep, size_t nsep,
                                      conn_type_t connType);
     ENGINE_ERROR_CODE doTimingStats(const void *cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doSchedulerStats(const void *cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doRunTimeStats(const void *cookie, ADD_STAT add_stat);
+    ENGINE_ERROR_CODE doTaskLatencyStats(const void *cookie,
+                                         ADD_STAT add_stat);
     ENGINE_ERROR_CODE doDispatcherStats(const void *cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doTasksStats(const void* cookie, ADD_STAT add_stat);
     ENGINE_ERROR_CODE doKeyStats(const void *cookie, ADD_STAT add_stat,
@@ -80,6 +80,10 @@ ENGINE_ERROR_CODE EPVBucket::completeBGFetchForSingleItem(
         const ProcessClock::time_point startTime) {
     ENGINE_ERROR_CODE status = fetched_item.value.getStatus();
     Item* fetchedValue = fetched_item.value.getValue();
+    if (status == ENGINE_SUCCESS && !fetched_item.metaDataOnly) {
+        // Values are persisted inflated; compress it again to restore it
+        maybeCompressValue(*fetchedValue);
+    }
     { // locking scope
         ReaderLockHolder rlh(getStateLock());
         auto hbl = ht.getLockedBucket(key);
@@ -242,6 +242,11 @@ EphemeralVBucket::inMemoryBackfill(uint64_t start, uint64_t end) {
     return seqList->rangeRead(start, end);
 }
 
+std::pair<ENGINE_ERROR_CODE, std::unique_ptr<SequenceList::RangeIterator>>
+EphemeralVBucket::makeRangeIterator(uint64_t start, uint64_t end) {
+    return seqList->makeRangeIterator(start, end);
+}
+
 /* Vb level backfill queue is for items in a huge snapshot (disk backfill
    snapshots from DCP are typically huge) that could not be fit on a
    checkpoint. They update all stats, checkpoint seqno, but are not put
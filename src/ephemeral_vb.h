@@ -18,11 +18,9 @@
 #pragma once
 
 #include "config.h"
+#include "seqlist.h"
 #include "vbucket.h"
 
-/* Forward declarations */
-class SequenceList;
-
 class EphemeralVBucket : public VBucket {
 public:
     class CountVisitor;
@@ -117,6 +115,19 @@ public:
     std::pair<ENGINE_ERROR_CODE, std::vector<UniqueItemPtr>> inMemoryBackfill(
             uint64_t start, uint64_t end);
 
+    /**
+     * Creates an iterator over a point-in-time snapshot of the in memory
+     * ordered data structure, for a backfill to read a batch at a time.
+     *
+     * @param startSeqno requested start sequence number of the backfill
+     * @param endSeqno requested end sequence number of the backfill
+     *
+     * @return ENGINE_SUCCESS and the iterator
+     *         ENGINE_ERANGE on incorrect start and end
+     */
+    std::pair<ENGINE_ERROR_CODE, std::unique_ptr<SequenceList::RangeIterator>>
+    makeRangeIterator(uint64_t start, uint64_t end);
+
     void dump() const override;
 
     uint64_t getPersistenceSeqno() const override {
@@ -32,6 +32,10 @@
 #include <queue>
 #include <sstream>
 
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
 std::mutex ExecutorPool::initGuard;
 std::atomic<ExecutorPool*> ExecutorPool::instance;
 
@@ -46,6 +50,26 @@ static const size_t EP_MAX_WRITER_THREADS = 8;
 static const size_t EP_MAX_AUXIO_THREADS  = 8;
 static const size_t EP_MAX_NONIO_THREADS  = 8;
 
+// Periods a thread group must be idle for before autoscale() shrinks it
+static const size_t AUTOSCALE_SHRINK_PERIODS = 3;
+
+/**
+ * @returns the CPU time (user + system) used by the process so far, or zero
+ *          where it isn't known.
+ */
+static std::chrono::microseconds getProcessCpuTime() {
+#ifndef WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return std::chrono::seconds(usage.ru_utime.tv_sec +
+                                    usage.ru_stime.tv_sec) +
+               std::chrono::microseconds(usage.ru_utime.tv_usec +
+                                         usage.ru_stime.tv_usec);
+    }
+#endif
+    return std::chrono::microseconds::zero();
+}
+
 size_t ExecutorPool::getNumNonIO(void) {
     // 1. compute: 30% of total threads
     size_t count = maxGlobalThreads * 0.3;
@@ -130,6 +154,13 @@ ExecutorPool *ExecutorPool::get(void) {
 
             Configuration &config =
                 ObjectRegistry::getCurrentEngine()->getConfiguration();
+            AutoscaleConfig autoscale;
+            autoscale.enabled = config.isExecutorAutoscale();
+            autoscale.latencyTarget = std::chrono::microseconds(
+                    config.getExecutorAutoscaleLatencyTargetUs());
+            autoscale.minThreads = config.getExecutorAutoscaleMinThreads();
+            autoscale.maxThreads = config.getExecutorAutoscaleMaxThreads();
+            autoscale.cpuLimit = config.getExecutorAutoscaleCpuLimit();
             EventuallyPersistentEngine *epe =
                                    ObjectRegistry::onSwitchThread(NULL, true);
             tmp = new ExecutorPool(config.getMaxThreads(),
@@ -137,7 +168,11 @@ ExecutorPool *ExecutorPool::get(void) {
                                    config.getNumReaderThreads(),
                                    config.getNumWriterThreads(),
                                    config.getNumAuxioThreads(),
-                                   config.getNumNonioThreads());
+                                   config.getNumNonioThreads(),
+                                   config.isExecutorWorkStealing(),
+                                   config.isExecutorFairShare(),
+                                   autoscale,
+                                   config.isExecutorNumaAware());
             ObjectRegistry::onSwitchThread(epe);
             instance.store(tmp);
         }
@@ -154,23 +189,47 @@ void ExecutorPool::shutdown(void) {
     }
 }
 
+// Three quarters of the CPUs, but at least EP_MIN_NUM_THREADS
+static size_t defaultMaxThreads() {
+    const size_t numCPU = Couchbase::get_available_cpu_count();
+    const size_t numThreads = (numCPU * 3) / 4;
+    return numThreads < EP_MIN_NUM_THREADS ? EP_MIN_NUM_THREADS : numThreads;
+}
+
 ExecutorPool::ExecutorPool(size_t maxThreads, size_t nTaskSets,
                            size_t maxReaders, size_t maxWriters,
-                           size_t maxAuxIO,   size_t maxNonIO) :
-                  numTaskSets(nTaskSets), totReadyTasks(0),
+                           size_t maxAuxIO,   size_t maxNonIO,
+                           bool workStealing, bool fairShare,
+                           const AutoscaleConfig& autoscale,
+                           bool numaAware, const CpuTopology* topology) :
+                  numTaskSets(nTaskSets), workStealing(workStealing),
+                  fairShare(fairShare), numaAware(numaAware),
+                  // Only probe the host if the topology is going to be used
+                  topology(!numaAware ? CpuTopology({})
+                                      : topology ? *topology
+                                                 : CpuTopology::detect()),
+                  totReadyTasks(0),
                   isHiPrioQset(false), isLowPrioQset(false), numBuckets(0),
-                  numSleepers(0) {
-    size_t numCPU = Couchbase::get_available_cpu_count();
-    size_t numThreads = (size_t)((numCPU * 3)/4);
-    numThreads = (numThreads < EP_MIN_NUM_THREADS) ?
-                        EP_MIN_NUM_THREADS : numThreads;
-    maxGlobalThreads = maxThreads ? maxThreads : numThreads;
+                  numSleepers(0), autoscaleConfig(autoscale),
+                  lastAutoscale(ProcessClock::now()),
+                  lastCpuTime(getProcessCpuTime()),
+                  numAutoscaleAdjustments(0),
+                  // A shard per thread, for as many as maxGlobalThreads
+                  taskLatency(maxThreads ? maxThreads : defaultMaxThreads()),
+                  numaLocalTasks(0), numaRemoteTasks(0) {
+    maxGlobalThreads = maxThreads ? maxThreads : defaultMaxThreads();
     curWorkers  = new std::atomic<uint16_t>[nTaskSets];
     numWorkers = new std::atomic<uint16_t>[nTaskSets];
     numReadyTasks  = new std::atomic<size_t>[nTaskSets];
+    schedLatencyNs = new std::atomic<uint64_t>[nTaskSets];
+    schedCount = new std::atomic<uint64_t>[nTaskSets];
+    lowLatencyPeriods = new size_t[nTaskSets];
     for (size_t i = 0; i < nTaskSets; i++) {
         curWorkers[i] = 0;
         numReadyTasks[i] = 0;
+        schedLatencyNs[i] = 0;
+        schedCount[i] = 0;
+        lowLatencyPeriods[i] = 0;
     }
     numWorkers[WRITER_TASK_IDX] = maxWriters;
     numWorkers[READER_TASK_IDX] = maxReaders;
@@ -184,6 +243,9 @@ ExecutorPool::~ExecutorPool(void) {
     delete[] curWorkers;
     delete[] numWorkers;
     delete[] numReadyTasks;
+    delete[] schedLatencyNs;
+    delete[] schedCount;
+    delete[] lowLatencyPeriods;
 
     if (isHiPrioQset) {
         for (size_t i = 0; i < numTaskSets; i++) {
@@ -478,8 +540,18 @@ void ExecutorPool::_registerTaskable(Taskable& taskable) {
         if (!(*whichQset)) {
             taskQ->reserve(numTaskSets);
             for (size_t i = 0; i < numTaskSets; ++i) {
-                taskQ->push_back(
-                        new TaskQueue(this, (task_type_t)i, queueName));
+                // Topology aware, each NUMA node has a local ready queue
+                // for the tasks of its shards in place of per-thread ones.
+                size_t numLocalQueues = workStealing ? maxGlobalThreads : 0;
+                if (numaAware) {
+                    numLocalQueues = topology.getNumNodes();
+                }
+                taskQ->push_back(new TaskQueue(this,
+                                               (task_type_t)i,
+                                               queueName,
+                                               numLocalQueues,
+                                               fairShare,
+                                               numaAware));
             }
             *whichQset = true;
         }
@@ -497,7 +569,19 @@ void ExecutorPool::registerTaskable(Taskable& taskable) {
     ObjectRegistry::onSwitchThread(epe);
 }
 
-ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems) {
+size_t ExecutorPool::_freeHistoShard() {
+    // The lowest shard no running thread records into. Once there are more
+    // threads than shards they wrap around and share.
+    std::vector<bool> used(taskLatency.getNumShards());
+    for (const auto* thread : threadQ) {
+        used[thread->getHistoShard() % used.size()] = true;
+    }
+    const auto it = std::find(used.begin(), used.end(), false);
+    return it != used.end() ? size_t(it - used.begin()) : threadQ.size();
+}
+
+ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems,
+                                     bool join) {
     std::string typeName{to_string(type)};
 
     // vector of threads which have been stopped
@@ -530,10 +614,16 @@ ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems) {
             // If we want to increase the number of threads, they must be
             // created and started
             for (size_t tidx = numItems; tidx < desiredNumItems; ++tidx) {
+                // Spread each thread group evenly over the NUMA nodes
+                const int node =
+                        numaAware ? int(tidx % topology.getNumNodes()) : -1;
                 threadQ.push_back(new ExecutorThread(
                         this,
                         type,
-                        typeName + "_worker_" + std::to_string(tidx)));
+                        typeName + "_worker_" + std::to_string(tidx),
+                        tidx,
+                        node,
+                        _freeHistoShard()));
                 threadQ.back()->start();
             }
         } else if (numItems > desiredNumItems) {
@@ -572,6 +662,15 @@ ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems) {
         sleepQ->doWake(threadCount);
     }
 
+    if (!join) {
+        // The caller may be one of the removed threads; they exit once
+        // their current task is done and are reaped later.
+        LockHolder lh(tMutex);
+        retiredThreads.insert(
+                retiredThreads.end(), removed.begin(), removed.end());
+        removed.clear();
+    }
+
     // We could not join the threads while holding the lock, as some operations
     // called from the threads (such as schedule) acquire the lock - we could
     // have caused deadlock by waiting for the thread to complete its task and
@@ -586,6 +685,27 @@ ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems) {
     return ssize_t(desiredNumItems) - ssize_t(numItems);
 }
 
+void ExecutorPool::_reapRetiredThreads(bool wait) {
+    ThreadQ exited;
+    {
+        LockHolder lh(tMutex);
+        auto itr = retiredThreads.begin();
+        while (itr != retiredThreads.end()) {
+            if (wait || (*itr)->state == EXECUTOR_DEAD) {
+                exited.push_back(*itr);
+                itr = retiredThreads.erase(itr);
+            } else {
+                ++itr;
+            }
+        }
+    }
+
+    for (auto thread : exited) {
+        thread->stop(true);
+        delete thread;
+    }
+}
+
 void ExecutorPool::adjustWorkers(task_type_t type, size_t newCount) {
     EventuallyPersistentEngine* epe =
             ObjectRegistry::onSwitchThread(NULL, true);
@@ -593,6 +713,137 @@ void ExecutorPool::adjustWorkers(task_type_t type, size_t newCount) {
     ObjectRegistry::onSwitchThread(epe);
 }
 
+size_t ExecutorPool::calcAutoscaleWorkers(
+        const AutoscaleSample& sample,
+        std::chrono::nanoseconds latencyTarget,
+        size_t minThreads,
+        size_t maxThreads,
+        size_t& lowPeriods) {
+    size_t workers = sample.workers;
+    if (sample.tasksRun && sample.meanLatency > latencyTarget) {
+        // Tasks are waiting for a thread; add a quarter more threads unless
+        // the CPUs are already busy, where more threads won't help.
+        lowPeriods = 0;
+        if (!sample.cpuSaturated && workers < maxThreads) {
+            workers = std::min(maxThreads,
+                               workers + std::max(size_t(1), workers / 4));
+        }
+    } else if (sample.readyTasks == 0 &&
+               (sample.tasksRun == 0 ||
+                sample.meanLatency < latencyTarget / 4)) {
+        // Shrink one at a time, and only once idle for a while, so that a
+        // group doesn't flap between sizes with bursty load.
+        if (++lowPeriods >= AUTOSCALE_SHRINK_PERIODS) {
+            lowPeriods = 0;
+            if (workers > minThreads) {
+                workers--;
+            }
+        }
+    } else {
+        lowPeriods = 0;
+    }
+    return workers;
+}
+
+void ExecutorPool::autoscale(const ProcessClock::duration minInterval) {
+    if (!autoscaleConfig.enabled) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lh(autoscaleMutex, std::try_to_lock);
+    if (!lh.owns_lock()) {
+        return; // another bucket's monitor is already at it
+    }
+    const auto now = ProcessClock::now();
+    const auto period = now - lastAutoscale;
+    if (period < minInterval || period <= ProcessClock::duration::zero()) {
+        return;
+    }
+
+    // Threads removed in earlier periods have had time to finish their task.
+    _reapRetiredThreads(false);
+
+    const auto cpuTime = getProcessCpuTime();
+    const double cpuUsed =
+            std::chrono::duration<double>(cpuTime - lastCpuTime).count() /
+            std::chrono::duration<double>(period).count();
+    const bool cpuSaturated =
+            cpuUsed >= autoscaleConfig.cpuLimit *
+                               Couchbase::get_available_cpu_count();
+    lastAutoscale = now;
+    lastCpuTime = cpuTime;
+
+    // The buckets' workload patterns decide which of the reader and writer
+    // groups gets to grow sooner.
+    size_t readHeavy = 0;
+    size_t writeHeavy = 0;
+    {
+        LockHolder tlh(tMutex);
+        for (auto owner : taskOwners) {
+            auto& workload = static_cast<Taskable*>(owner)->getWorkLoadPolicy();
+            switch (workload.getWorkLoadPattern()) {
+            case READ_HEAVY:
+                readHeavy++;
+                break;
+            case WRITE_HEAVY:
+                writeHeavy++;
+                break;
+            case MIXED:
+                break;
+            }
+        }
+    }
+
+    const size_t maxThreads = autoscaleConfig.maxThreads
+                                      ? autoscaleConfig.maxThreads
+                                      : maxGlobalThreads;
+    for (size_t type = 0; type < numTaskSets; type++) {
+        AutoscaleSample sample;
+        sample.workers = numWorkers[type];
+        sample.tasksRun = schedCount[type].exchange(0);
+        const uint64_t latency = schedLatencyNs[type].exchange(0);
+        sample.meanLatency = std::chrono::nanoseconds(
+                sample.tasksRun ? latency / sample.tasksRun : 0);
+        sample.readyTasks = numReadyTasks[type];
+        sample.cpuSaturated = cpuSaturated;
+        if (sample.workers == 0) {
+            continue; // threads not started yet
+        }
+
+        auto latencyTarget = autoscaleConfig.latencyTarget;
+        if ((type == READER_TASK_IDX && readHeavy > writeHeavy) ||
+            (type == WRITER_TASK_IDX && writeHeavy > readHeavy)) {
+            latencyTarget /= 2;
+        }
+
+        const size_t desired =
+                calcAutoscaleWorkers(sample,
+                                     latencyTarget,
+                                     autoscaleConfig.minThreads,
+                                     maxThreads,
+                                     lowLatencyPeriods[type]);
+        if (desired != sample.workers) {
+            LOG(EXTENSION_LOG_NOTICE,
+                "Autoscaling %s threads, mean scheduling latency:%" PRIu64
+                "us tasks run:%" PRIu64 " ready:%" PRIu64 " cpu used:%.2f",
+                to_string(task_type_t(type)).c_str(),
+                uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                                 sample.meanLatency)
+                                 .count()),
+                sample.tasksRun,
+                uint64_t(sample.readyTasks),
+                cpuUsed);
+            // Called from a pool thread (a WorkLoadMonitor) which may be
+            // one of those removed, so don't wait for them here.
+            EventuallyPersistentEngine* epe =
+                    ObjectRegistry::onSwitchThread(NULL, true);
+            _adjustWorkers(task_type_t(type), desired, false);
+            ObjectRegistry::onSwitchThread(epe);
+            numAutoscaleAdjustments++;
+        }
+    }
+}
+
 bool ExecutorPool::_startWorkers(void) {
     size_t numReaders = getNumReaders();
     size_t numWriters = getNumWriters();
@@ -677,6 +928,12 @@ void ExecutorPool::_unregisterTaskable(Taskable& taskable, bool force) {
 
     LockHolder lh(tMutex);
     taskOwners.erase(&taskable);
+    for (auto tq : hpTaskQ) {
+        tq->forgetTaskable(taskable.getGID());
+    }
+    for (auto tq : lpTaskQ) {
+        tq->forgetTaskable(taskable.getGID());
+    }
     if (!(--numBuckets)) {
         if (taskLocator.size()) {
             throw std::logic_error("ExecutorPool::_unregisterTaskable: "
@@ -755,6 +1012,13 @@ void ExecutorPool::doTaskQStat(EventuallyPersistentEngine *engine,
                 add_casted_stat(statname, hpTaskQ[i]->getReadyQueueSize(),
                                 add_stat,
                                 cookie);
+                if (hpTaskQ[i]->isWorkStealing()) {
+                    checked_snprintf(statname, sizeof(statname),
+                                     "ep_workload:%s:Stolen",
+                                     hpTaskQ[i]->getName().c_str());
+                    add_casted_stat(statname, hpTaskQ[i]->getNumStolen(),
+                                    add_stat, cookie);
+                }
                 size_t pendingQsize = hpTaskQ[i]->getPendingQueueSize();
                 if (pendingQsize > 0) {
                     checked_snprintf(statname, sizeof(statname),
@@ -778,6 +1042,13 @@ void ExecutorPool::doTaskQStat(EventuallyPersistentEngine *engine,
                 add_casted_stat(statname, lpTaskQ[i]->getReadyQueueSize(),
                                 add_stat,
                                 cookie);
+                if (lpTaskQ[i]->isWorkStealing()) {
+                    checked_snprintf(statname, sizeof(statname),
+                                     "ep_workload:%s:Stolen",
+                                     lpTaskQ[i]->getName().c_str());
+                    add_casted_stat(statname, lpTaskQ[i]->getNumStolen(),
+                                    add_stat, cookie);
+                }
                 size_t pendingQsize = lpTaskQ[i]->getPendingQueueSize();
                 if (pendingQsize > 0) {
                     checked_snprintf(statname, sizeof(statname),
@@ -949,6 +1220,46 @@ void ExecutorPool::doTasksStat(EventuallyPersistentEngine* engine,
     checked_snprintf(statname, sizeof(statname), "%s:tasks", prefix);
     add_casted_stat(statname, to_string(list, false), add_stat, cookie);
 
+    // Shared thread time and disk I/O used per bucket (fair share only)
+    std::map<task_gid_t, TaskableUsage> usage;
+    std::map<task_gid_t, std::string> owners;
+    {
+        LockHolder lh(tMutex);
+        for (auto tq : hpTaskQ) {
+            tq->addUsage(usage);
+        }
+        for (auto tq : lpTaskQ) {
+            tq->addUsage(usage);
+        }
+        for (auto owner : taskOwners) {
+            const Taskable* taskable = static_cast<Taskable*>(owner);
+            owners[taskable->getGID()] = taskable->getName();
+        }
+    }
+
+    unique_cJSON_ptr usageList(cJSON_CreateArray());
+    for (const auto& entry : usage) {
+        auto owner = owners.find(entry.first);
+        if (owner == owners.end()) {
+            continue;
+        }
+        unique_cJSON_ptr obj(cJSON_CreateObject());
+        cJSON_AddStringToObject(obj.get(), "bucket", owner->second.c_str());
+        cJSON_AddNumberToObject(
+                obj.get(),
+                "runtime_ns",
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        entry.second.runtime)
+                        .count());
+        cJSON_AddNumberToObject(obj.get(), "tasks_run", entry.second.tasksRun);
+        cJSON_AddNumberToObject(
+                obj.get(), "disk_bytes", entry.second.diskBytes);
+        cJSON_AddItemToArray(usageList.get(), obj.release());
+    }
+
+    checked_snprintf(statname, sizeof(statname), "%s:usage", prefix);
+    add_casted_stat(statname, to_string(usageList, false), add_stat, cookie);
+
     checked_snprintf(statname, sizeof(statname), "%s:cur_time", prefix);
     add_casted_stat(statname,
                     to_ns_since_epoch(ProcessClock::now()).count(),
@@ -979,4 +1290,5 @@ void ExecutorPool::_stopAndJoinThreads() {
     for (auto thread : threadQ) {
         thread->stop(true);
     }
+    _reapRetiredThreads(true);
 }
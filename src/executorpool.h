@@ -68,17 +68,57 @@
 
 #include "config.h"
 
+#include "cpu_topology.h"
 #include "tasks.h"
+#include "task_latency_histograms.h"
 #include "task_type.h"
 #include "taskable.h"
 
+#include <platform/processclock.h>
+
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <mutex>
 
 // Forward decl
 class TaskQueue;
 class ExecutorThread;
 class TaskLogEntry;
 
+/**
+ * Settings of the ExecutorPool's thread group autoscaling.
+ */
+struct AutoscaleConfig {
+    AutoscaleConfig()
+        : enabled(false),
+          latencyTarget(std::chrono::milliseconds(10)),
+          minThreads(1),
+          maxThreads(0),
+          cpuLimit(0.9) {
+    }
+
+    bool enabled;
+    // Mean scheduling latency a thread group should stay under
+    std::chrono::nanoseconds latencyTarget;
+    // Bounds on the threads of each group, maxThreads 0 for max_threads
+    size_t minThreads;
+    size_t maxThreads;
+    // Don't grow when the process uses more than this fraction of the CPUs
+    double cpuLimit;
+};
+
+/**
+ * What the autoscaler saw of a thread group over the last period.
+ */
+struct AutoscaleSample {
+    size_t workers;
+    uint64_t tasksRun;
+    std::chrono::nanoseconds meanLatency;
+    size_t readyTasks;
+    bool cpuSaturated;
+};
+
 typedef std::vector<ExecutorThread *> ThreadQ;
 typedef std::pair<ExTask, TaskQueue *> TaskQpair;
 typedef std::vector<TaskQueue *> TaskQ;
@@ -196,6 +236,106 @@ public:
 
     size_t getNumSleepers(void) { return numSleepers; }
 
+    /**
+     * Record how long a task of the given type waited past its waketime
+     * before it was run, as input to autoscale().
+     */
+    void logSchedulingLatency(task_type_t taskType,
+                              const ProcessClock::duration latency) {
+        if (autoscaleConfig.enabled) {
+            schedLatencyNs[taskType] +=
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            latency)
+                            .count();
+            schedCount[taskType]++;
+        }
+    }
+
+    /**
+     * If autoscaling is enabled, grow or shrink each thread group based on
+     * the scheduling latency of its tasks, how many of them are waiting and
+     * whether the process has CPU to spare. Called periodically by each
+     * bucket's WorkLoadMonitor; does nothing if called again within
+     * minInterval.
+     */
+    void autoscale(const ProcessClock::duration minInterval);
+
+    /**
+     * The number of workers a thread group should have given what was seen
+     * of it over the last period.
+     *
+     * @param sample the group's last period
+     * @param latencyTarget mean scheduling latency to stay under
+     * @param lowPeriods consecutive periods the group has been idle enough
+     *        to shrink, updated by the call
+     */
+    static size_t calcAutoscaleWorkers(const AutoscaleSample& sample,
+                                       std::chrono::nanoseconds latencyTarget,
+                                       size_t minThreads,
+                                       size_t maxThreads,
+                                       size_t& lowPeriods);
+
+    size_t getNumAutoscaleAdjustments(void) {
+        return numAutoscaleAdjustments;
+    }
+
+    /**
+     * Record how long a task waited past its waketime and how long it then
+     * ran, in the shard of the thread which ran it.
+     */
+    void logTaskLatency(size_t shard,
+                        TaskId id,
+                        const ProcessClock::duration wait,
+                        const ProcessClock::duration run) {
+        taskLatency.record(shard, id, wait, run);
+    }
+
+    const TaskLatencyHistograms& getTaskLatency(void) const {
+        return taskLatency;
+    }
+
+    /**
+     * @returns the NUMA node a KVShard's memory and tasks should be placed
+     *          on, or -1 if the pool isn't topology aware.
+     */
+    int getShardNode(size_t shardId) const {
+        return numaAware ? int(shardId % topology.getNumNodes()) : -1;
+    }
+
+    /**
+     * Restrict the calling thread to the CPUs of the given NUMA node.
+     */
+    bool bindThread(int node) const {
+        return topology.bindCurrentThread(node);
+    }
+
+    /**
+     * Count a task run by a thread on threadNode which prefers to run on
+     * taskNode, if both are placed.
+     */
+    void logTaskPlacement(int threadNode, int taskNode) {
+        if (threadNode < 0 || taskNode < 0) {
+            return;
+        }
+        if (threadNode == taskNode) {
+            numaLocalTasks++;
+        } else {
+            numaRemoteTasks++;
+        }
+    }
+
+    size_t getNumNumaNodes(void) const {
+        return numaAware ? topology.getNumNodes() : 0;
+    }
+
+    size_t getNumNumaLocalTasks(void) const {
+        return numaLocalTasks;
+    }
+
+    size_t getNumNumaRemoteTasks(void) const {
+        return numaRemoteTasks;
+    }
+
     size_t schedule(ExTask task);
 
     static ExecutorPool *get(void);
@@ -204,15 +344,35 @@ public:
 
 protected:
 
+    /**
+     * @param topology the NUMA topology for numaAware, detected from the
+     *        host if null. Unused (and not detected) unless numaAware.
+     */
     ExecutorPool(size_t t, size_t nTaskSets, size_t r, size_t w, size_t a,
-                 size_t n);
+                 size_t n, bool workStealing = false, bool fairShare = false,
+                 const AutoscaleConfig& autoscale = AutoscaleConfig(),
+                 bool numaAware = false,
+                 const CpuTopology* topology = nullptr);
     virtual ~ExecutorPool(void);
 
     TaskQueue* _nextTask(ExecutorThread &t, uint8_t tick);
     bool _cancel(size_t taskId, bool eraseTask=false);
     bool _wake(size_t taskId);
     virtual bool _startWorkers(void);
-    ssize_t _adjustWorkers(task_type_t type, size_t desiredNumItems);
+    /**
+     * @param join if true, wait for removed threads to exit and delete
+     *        them; if false (from a pool thread, which may itself be
+     *        removed) leave them to exit on their own in retiredThreads.
+     */
+    // The TaskLatencyHistograms shard for a new thread (under tMutex)
+    size_t _freeHistoShard();
+    ssize_t _adjustWorkers(task_type_t type, size_t desiredNumItems,
+                           bool join = true);
+    /**
+     * Join and delete the retired threads which have exited, or if wait
+     * all of them. wait must not be used from a pool thread.
+     */
+    void _reapRetiredThreads(bool wait);
     bool _snooze(size_t taskId, double tosleep);
     size_t _schedule(ExTask task);
     void _registerTaskable(Taskable& taskable);
@@ -223,6 +383,10 @@ protected:
 
     size_t numTaskSets; // safe to read lock-less not altered after creation
     size_t maxGlobalThreads;
+    const bool workStealing; // per-thread local ready queues (TaskQueue)
+    const bool fairShare; // share ready tasks between Taskables by quota
+    const bool numaAware; // pin threads and place shard tasks by NUMA node
+    const CpuTopology topology;
 
     std::atomic<size_t> totReadyTasks;
     SyncObject mutex; // Thread management condition var + mutex
@@ -232,6 +396,8 @@ protected:
 
     //A list of threads
     ThreadQ threadQ;
+    // Threads removed by autoscale() which are stopping but not yet joined
+    ThreadQ retiredThreads;
 
     // Global cross bucket priority queues where tasks get scheduled into ...
     TaskQ hpTaskQ; // a vector array of numTaskSets elements for high priority
@@ -252,6 +418,23 @@ protected:
     // Set of all known task owners
     std::set<void *> taskOwners;
 
+    // Autoscaling of the thread groups, see autoscale()
+    const AutoscaleConfig autoscaleConfig;
+    std::atomic<uint64_t>* schedLatencyNs; // per TaskSet, since last period
+    std::atomic<uint64_t>* schedCount; // per TaskSet, since last period
+    std::mutex autoscaleMutex; // serializes autoscale(), guards below
+    size_t* lowLatencyPeriods; // per TaskSet
+    ProcessClock::time_point lastAutoscale;
+    std::chrono::microseconds lastCpuTime;
+    std::atomic<size_t> numAutoscaleAdjustments;
+
+    // Per-TaskId wait and run time of every task run, across all buckets
+    TaskLatencyHistograms taskLatency;
+
+    // Runs of tasks with a preferred NUMA node, on/off that node
+    std::atomic<size_t> numaLocalTasks;
+    std::atomic<size_t> numaRemoteTasks;
+
     // Singleton creation
     static std::mutex initGuard;
     static std::atomic<ExecutorPool*> instance;
@@ -71,6 +71,13 @@ void ExecutorThread::stop(bool wait) {
 void ExecutorThread::run() {
     LOG(EXTENSION_LOG_DEBUG, "Thread %s running..", getName().c_str());
 
+    if (numaNode >= 0 && !manager->bindThread(numaNode)) {
+        LOG(EXTENSION_LOG_WARNING,
+            "%s: Failed to bind to the CPUs of NUMA node %d",
+            getName().c_str(),
+            numaNode);
+    }
+
     for (uint8_t tick = 1;; tick++) {
         {
             LockHolder lh(currentTaskMutex);
@@ -101,11 +108,13 @@ void ExecutorThread::run() {
             // that the task wanted to wake up and the current time
             const ProcessClock::time_point woketime =
                     currentTask->getWaketime();
+            const ProcessClock::duration schedLatency =
+                    getCurTime() > woketime ? getCurTime() - woketime
+                                            : ProcessClock::duration::zero();
             currentTask->
-            getTaskable().logQTime(currentTask->getTypeId(),
-                                   getCurTime() > woketime ?
-                                           getCurTime() - woketime :
-                                           ProcessClock::duration::zero());
+            getTaskable().logQTime(currentTask->getTypeId(), schedLatency);
+            manager->logSchedulingLatency(taskType, schedLatency);
+            manager->logTaskPlacement(numaNode, currentTask->getNumaNode());
             updateTaskStart();
             rel_time_t startReltime = ep_current_time();
 
@@ -127,6 +136,9 @@ void ExecutorThread::run() {
             currentTask->getTaskable().logRunTime(currentTask->getTypeId(),
                                                   runtime);
             currentTask->updateRuntime(runtime);
+            manager->logTaskLatency(histoShard, currentTask->getTypeId(),
+                                    schedLatency, runtime);
+            q->charge(currentTask, runtime);
             if (engine) {
                 ObjectRegistry::onSwitchThread(NULL);
             }
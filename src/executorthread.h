@@ -85,10 +85,18 @@ public:
         ProcessClock::time_point timepoint;
     };
 
-    ExecutorThread(ExecutorPool* m, task_type_t type, const std::string nm)
+    ExecutorThread(ExecutorPool* m,
+                   task_type_t type,
+                   const std::string nm,
+                   size_t idx = 0,
+                   int node = -1,
+                   size_t shard = 0)
         : manager(m),
           taskType(type),
           name(nm),
+          localQueueIdx(idx),
+          histoShard(shard),
+          numaNode(node),
           state(EXECUTOR_RUNNING),
           now(ProcessClock::now()),
           waketime(ProcessClock::time_point::max()),
@@ -163,12 +171,32 @@ public:
         now.setTimePoint(ProcessClock::now());
     }
 
+    /// Which of a TaskQueue's local ready queues this thread owns when
+    /// work stealing is enabled.
+    size_t getLocalQueueIdx() const {
+        return localQueueIdx;
+    }
+
+    /// Which shard of the pool's TaskLatencyHistograms this thread records
+    /// into; unique while there are no more threads than shards.
+    size_t getHistoShard() const {
+        return histoShard;
+    }
+
+    /// The NUMA node this thread is bound to, -1 if none.
+    int getNumaNode() const {
+        return numaNode;
+    }
+
 protected:
 
     cb_thread_t thread;
     ExecutorPool *manager;
     task_type_t taskType;
     const std::string name;
+    const size_t localQueueIdx;
+    const size_t histoShard;
+    const int numaNode;
     std::atomic<executor_state_t> state;
 
     // record of current time
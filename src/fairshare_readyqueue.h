@@ -0,0 +1,173 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * The FairShareReadyQueue provides a std::priority_queue style interface onto
+ * the ready tasks of a TaskQueue.
+ *
+ * Without fair share it is exactly a priority_queue sorted by
+ * CompareByPriority. With fair share, each Taskable (bucket) has its own
+ * priority_queue and the Taskables are served by deficit round-robin: the
+ * Taskable at the head of the round is served while it has a positive
+ * deficit, the cost of each task it runs is charged against the deficit
+ * (see charge()), and when the deficit is used up the Taskable goes to the
+ * back of the round and is credited one quantum. Costs are expressed as a
+ * fraction of the Taskable's own quota, so a quantum is always 1.0 and a
+ * Taskable with twice the quota gets twice the share of the threads.
+ *
+ * Like priority_queue, the FairShareReadyQueue does no locking of its own.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+
+#include "taskable.h"
+#include "tasks.h"
+
+class FairShareReadyQueue {
+public:
+    FairShareReadyQueue(bool fairShare = false)
+        : fairShare(fairShare), count(0) {
+    }
+
+    bool isFairShare() const {
+        return fairShare;
+    }
+
+    void push(const ExTask& task) {
+        const task_gid_t gid = fairShare ? task->getTaskable().getGID() : 0;
+        Share& share = shares[gid];
+        if (share.queue.empty()) {
+            active.push_back(gid);
+        }
+        share.queue.push(task);
+        count++;
+    }
+
+    ExTask top() {
+        return select().queue.top();
+    }
+
+    void pop() {
+        Share& share = select();
+        share.queue.pop();
+        count--;
+        if (share.queue.empty()) {
+            // Unused credit isn't kept once a Taskable has nothing ready,
+            // but debt is so that long running tasks are paid for.
+            share.deficit = std::min(share.deficit, 0.0);
+            active.pop_front();
+        }
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    /**
+     * @returns true if more than one Taskable has ready tasks, so the order
+     *          they are served in depends on the charges for tasks run.
+     */
+    bool isContended() const {
+        return fairShare && active.size() > 1;
+    }
+
+    /**
+     * Charge the cost of a task run by the given Taskable.
+     * @param cost the cost as a fraction of the Taskable's quota
+     */
+    void charge(task_gid_t gid, double cost) {
+        if (!fairShare) {
+            return;
+        }
+        shares[gid].deficit -= cost;
+    }
+
+    /**
+     * Forget any debt or credit of a Taskable which is going away.
+     */
+    void forget(task_gid_t gid) {
+        auto it = shares.find(gid);
+        if (it != shares.end() && it->second.queue.empty()) {
+            shares.erase(it);
+        }
+    }
+
+private:
+    struct Share {
+        Share() : deficit(0) {
+        }
+
+        std::priority_queue<ExTask, std::deque<ExTask>,
+                            CompareByPriority> queue;
+        double deficit;
+    };
+
+    /**
+     * @returns the share of the Taskable which is next to be served, moving
+     *          the round along as needed. Only valid when !empty().
+     */
+    Share& select() {
+        Share* share = &shares[active.front()];
+        if (active.size() == 1) {
+            // Nobody to be fair to.
+            share->deficit = std::max(share->deficit, 0.0);
+            return *share;
+        }
+
+        if (share->deficit <= 0) {
+            // Skip the rounds in which nobody would be served in one go, as
+            // a long running task can leave a Taskable many quanta in debt.
+            double maxDeficit = share->deficit;
+            for (const auto gid : active) {
+                maxDeficit = std::max(maxDeficit, shares[gid].deficit);
+            }
+            if (maxDeficit <= 0) {
+                const double rounds = std::floor(-maxDeficit);
+                for (const auto gid : active) {
+                    shares[gid].deficit += rounds;
+                }
+            }
+        }
+
+        while (share->deficit <= 0) {
+            share->deficit += 1.0;
+            active.push_back(active.front());
+            active.pop_front();
+            share = &shares[active.front()];
+        }
+        return *share;
+    }
+
+    const bool fairShare;
+
+    std::unordered_map<task_gid_t, Share> shares;
+
+    // Taskables with ready tasks, in round-robin order.
+    std::deque<task_gid_t> active;
+
+    size_t count;
+};
@@ -140,6 +140,7 @@ void Flusher::schedule_UNLOCKED() {
     ExTask task = new FlusherTask(ObjectRegistry::getCurrentEngine(),
                                   this,
                                   shard->getId());
+    task->setNumaNode(shard->getNumaNode());
     this->setTaskId(task->getId());
     iom->schedule(task);
 }
@@ -2034,7 +2034,7 @@ extern "C" {
             ssize_t result = fsf->orig_ops->pwrite(fsf->orig_handle, buf, count,
                                                    offset);
             if (result > 0) {
-                fsf->fs_stats->totalBytesWritten += result;
+                fsf->fs_stats->addBytesWritten(result);
             }
 
             return result;
@@ -2058,7 +2058,7 @@ extern "C" {
             ssize_t result = fsf->orig_ops->pread(fsf->orig_handle, buf, count,
                                                   offset);
             if (result) {
-                fsf->fs_stats->totalBytesRead += result;
+                fsf->fs_stats->addBytesRead(result);
             }
 
             return result;
@@ -50,7 +50,8 @@ GlobalTask::GlobalTask(Taskable& t,
       engine(NULL),
       taskable(t),
       totalRuntime(0),
-      lastStartTime(0) {
+      lastStartTime(0),
+      numaNode(-1) {
     priority = getTaskPriority(taskId);
     snooze(sleeptime);
 }
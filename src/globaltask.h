@@ -180,6 +180,19 @@ public:
         return static_cast<queue_priority_t>(priority);
     }
 
+    /**
+     * The NUMA node whose threads should preferably run this task, -1 for
+     * any. Only honoured by a topology-aware ExecutorPool, and must be set
+     * before the task is scheduled.
+     */
+    int getNumaNode() const {
+        return numaNode;
+    }
+
+    void setNumaNode(int node) {
+        numaNode = node;
+    }
+
     /*
      * Lookup the task name for TaskId id.
      * The data used is generated from tasks.def.h
@@ -226,6 +239,7 @@ protected:
 
     atomic_duration totalRuntime;
     atomic_time_point lastStartTime;
+    int numaNode;
 
 private:
     atomic_time_point waketime; // used for priority_queue
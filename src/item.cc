@@ -130,11 +130,7 @@ bool Item::compressValue(float minCompressionRatio) {
                 // compression ratio isn't achieved.
                 return true;
             }
-            setData(deflated.data.get(), deflated.len,
-                    (uint8_t *)(getExtMeta()), getExtMetaLen());
-
-            datatype |= PROTOCOL_BINARY_DATATYPE_SNAPPY;
-            setDataType(datatype);
+            setCompressedValue(deflated.data.get(), deflated.len);
         } else {
             return false;
         }
@@ -142,6 +138,14 @@ bool Item::compressValue(float minCompressionRatio) {
     return true;
 }
 
+void Item::setCompressedValue(const char* data, size_t len) {
+    auto datatype = getDataType();
+    setData(data, len, (uint8_t *)(getExtMeta()), getExtMetaLen());
+
+    datatype |= PROTOCOL_BINARY_DATATYPE_SNAPPY;
+    setDataType(datatype);
+}
+
 bool Item::decompressValue() {
     uint8_t datatype = getDataType();
     if (mcbp::datatype::is_snappy(datatype)) {
@@ -477,6 +477,10 @@ public:
     /* Snappy uncompress value and update datatype */
     bool decompressValue();
 
+    /* Replace value with its already snappy compressed form and update
+     * datatype */
+    void setCompressedValue(const char* data, size_t len);
+
     const char *getData() const {
         return value.get() ? value->getData() : NULL;
     }
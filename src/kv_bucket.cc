@@ -114,6 +114,12 @@ public:
     virtual void sizeValueChanged(const std::string &key, size_t value) {
         if (key.compare("bg_fetch_delay") == 0) {
             store.setBGFetchDelay(static_cast<uint32_t>(value));
+        } else if (key.compare("bg_fetch_coalesce_max_us") == 0) {
+            store.setBGFetchCoalescing(std::chrono::microseconds(value),
+                                       store.getBGFetchLatencyTarget());
+        } else if (key.compare("bg_fetch_latency_target_us") == 0) {
+            store.setBGFetchCoalescing(store.getBGFetchCoalesceMaxWait(),
+                                       std::chrono::microseconds(value));
         } else if (key.compare("compaction_write_queue_cap") == 0) {
             store.setCompactionWriteQueueCap(value);
         } else if (key.compare("exp_pager_stime") == 0) {
@@ -223,7 +229,8 @@ public:
                 bool residentRatioLessThanThreshold =
                         vb->isResidentRatioUnderThreshold(
                                 store.getBfiltersResidencyThreshold());
-                 if (residentRatioLessThanThreshold) {
+                 if (residentRatioLessThanThreshold ||
+                     store.isBfilterPersistEnabled()) {
                      vb->addToTempFilter(key);
                  } else {
                      if (isDeleted || !store.isMetaDataResident(vb, key)) {
@@ -280,9 +287,18 @@ bool BloomFilterCallback::initTempFilter(uint16_t vbucketId) {
          * Obtain number of items for vbucket.
          * Bloomfilter's estimated_key_count =
          *                              1.25 * (num_items)
+         *
+         * 3. If the filter is persisted it is loaded at warmup, before the
+         * non-resident keys are known, so it must describe every key on
+         * disk regardless of the resident ratio:
+         * Bloomfilter's estimated_key_count =
+         *                              1.25 * (deletes + num_items)
          */
 
-         if (residentRatioAlert) {
+         if (store.isBfilterPersistEnabled()) {
+             estimated_count = round(1.25 * (num_deletes +
+                                      vb->getNumItems()));
+         } else if (residentRatioAlert) {
              estimated_count = round(1.25 * vb->getNumItems());
          } else {
              estimated_count = round(1.25 * (num_deletes +
@@ -294,7 +310,9 @@ bool BloomFilterCallback::initTempFilter(uint16_t vbucketId) {
         estimated_count = initial_estimation;
     }
 
-    vb->initTempFilter(estimated_count, config.getBfilterFpProb());
+    vb->initTempFilter(estimated_count, config.getBfilterFpProb(),
+                       config.isBfilterBlocked() ? BloomFilterLayout::Blocked
+                                                 : BloomFilterLayout::Standard);
 
     return true;
 }
@@ -351,6 +369,8 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
       defragmenterTask(NULL),
       diskDeleteAll(false),
       bgFetchDelay(0),
+      bgFetchCoalesceMaxWait(0),
+      bgFetchLatencyTarget(0),
       backfillMemoryThreshold(0.95),
       statsSnapshotTaskId(0),
       lastTransTimePerItem(0) {
@@ -376,6 +396,10 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
 
     ExecutorPool::get()->registerTaskable(ObjectRegistry::getCurrentEngine()->getTaskable());
 
+    for (size_t i = 0; i < vbMap.getNumShards(); ++i) {
+        vbMap.getShard(i)->setNumaNode(ExecutorPool::get()->getShardNode(i));
+    }
+
     size_t num_vbs = config.getMaxVbuckets();
     vb_mutexes = new std::mutex[num_vbs];
 
@@ -418,6 +442,14 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
     config.addValueChangedListener("bg_fetch_delay",
                                    new EPStoreValueChangeListener(*this));
 
+    setBGFetchCoalescing(
+            std::chrono::microseconds(config.getBgFetchCoalesceMaxUs()),
+            std::chrono::microseconds(config.getBgFetchLatencyTargetUs()));
+    config.addValueChangedListener("bg_fetch_coalesce_max_us",
+                                   new EPStoreValueChangeListener(*this));
+    config.addValueChangedListener("bg_fetch_latency_target_us",
+                                   new EPStoreValueChangeListener(*this));
+
     stats.warmupMemUsedCap.store(static_cast<double>
                                (config.getWarmupMinMemoryThreshold()) / 100.0);
     config.addValueChangedListener("warmup_min_memory_threshold",
@@ -443,6 +475,7 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
                                    new EPStoreValueChangeListener(*this));
 
     bfilterResidencyThreshold = config.getBfilterResidencyThreshold();
+    bfilterPersist = config.isBfilterPersist();
     config.addValueChangedListener("bfilter_residency_threshold",
                                    new EPStoreValueChangeListener(*this));
 
@@ -798,7 +831,10 @@ ENGINE_ERROR_CODE KVBucket::setVBucketState_UNLOCKED(uint16_t vbid,
             // Initialize bloom filters upon vbucket creation during
             // bucket creation and rebalance
             newvb->createFilter(config.getBfilterKeyCount(),
-                                config.getBfilterFpProb());
+                                config.getBfilterFpProb(),
+                                config.isBfilterBlocked()
+                                        ? BloomFilterLayout::Blocked
+                                        : BloomFilterLayout::Standard);
         }
 
         // The first checkpoint for active vbucket should start with id 2.
@@ -998,6 +1034,9 @@ void KVBucket::compactInternal(compaction_ctx *ctx) {
 
         if (config.isBfilterEnabled() && result) {
             vb->swapFilter();
+            if (bfilterPersist) {
+                persistBloomFilter(*vb);
+            }
         } else {
             vb->clearFilter();
         }
@@ -1817,8 +1856,9 @@ class PersistenceCallback : public Callback<mutation_result>,
 public:
 
     PersistenceCallback(const queued_item &qi, RCPtr<VBucket> &vb,
-                        EPStats& s, uint64_t c)
-        : queuedItem(qi), vbucket(vb), stats(s), cas(c) {
+                        EPStats& s, uint64_t c, bool trackInFilter = false)
+        : queuedItem(qi), vbucket(vb), stats(s), cas(c),
+          addToFilter(trackInFilter) {
         if (!vb) {
             throw std::invalid_argument("PersistenceCallback(): vb is NULL");
         }
@@ -1854,6 +1894,11 @@ public:
                 }
             }
 
+            if (addToFilter) {
+                // The filter has to cover every key on disk, resident or not.
+                vbucket->addToFilter(queuedItem->getKey());
+            }
+
             vbucket->doStatsForFlushing(*queuedItem, queuedItem->size());
             --stats.diskQueueSize;
             stats.totalPersisted++;
@@ -1941,6 +1986,8 @@ private:
     RCPtr<VBucket> vbucket;
     EPStats& stats;
     uint64_t cas;
+    // Add the key to the vbucket's bloom filter once it is on disk
+    bool addToFilter;
     DISALLOW_COPY_AND_ASSIGN(PersistenceCallback);
 };
 
@@ -2261,7 +2308,9 @@ PersistenceCallback* KVBucket::flushOneDelOrSet(const queued_item &qi,
                          bySeqno == -1 ? "disk_insert" : "disk_update",
                          stats.timingLog);
         PersistenceCallback *cb =
-            new PersistenceCallback(qi, vb, stats, qi->getCas());
+            new PersistenceCallback(qi, vb, stats, qi->getCas(),
+                                    bfilterPersist &&
+                                    eviction_policy == FULL_EVICTION);
         rwUnderlying->set(*qi, *cb);
         return cb;
     } else {
@@ -2381,6 +2430,10 @@ void KVBucket::stopWarmup(void)
             stats.isShutdown ? "yes" : "no");
         warmupTask->stop();
     }
+    if (warmupTask) {
+        // Warmup is done, but its hit ratio window may still be open
+        warmupTask->cancelHitRatioWindow();
+    }
 }
 
 bool KVBucket::isMemoryUsageTooHigh() {
@@ -2537,6 +2590,19 @@ void KVBucket::setAllBloomFilters(bool to) {
     }
 }
 
+void KVBucket::persistBloomFilter(VBucket& vb) {
+    const std::string filter = vb.serialiseFilter();
+    if (filter.empty()) {
+        return;
+    }
+    if (!getRWUnderlying(vb.getId())->persistBloomFilter(vb.getId(),
+                                                         filter)) {
+        LOG(EXTENSION_LOG_WARNING,
+            "KVBucket::persistBloomFilter: Failed to persist the bloom "
+            "filter for vb:%" PRIu16, vb.getId());
+    }
+}
+
 void KVBucket::visit(VBucketVisitor &visitor)
 {
     for (VBucketMap::id_type vbid = 0; vbid < vbMap.getSize(); ++vbid) {
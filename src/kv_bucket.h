@@ -276,6 +276,20 @@ public:
 
     double getBGFetchDelay(void) { return (double)bgFetchDelay; }
 
+    void setBGFetchCoalescing(std::chrono::microseconds maxWait,
+                              std::chrono::microseconds latencyTarget) {
+        bgFetchCoalesceMaxWait = maxWait.count();
+        bgFetchLatencyTarget = latencyTarget.count();
+    }
+
+    std::chrono::microseconds getBGFetchCoalesceMaxWait() const {
+        return std::chrono::microseconds(bgFetchCoalesceMaxWait.load());
+    }
+
+    std::chrono::microseconds getBGFetchLatencyTarget() const {
+        return std::chrono::microseconds(bgFetchLatencyTarget.load());
+    }
+
     virtual bool pauseFlusher();
     virtual bool resumeFlusher();
     virtual void wakeUpFlusher();
@@ -587,6 +601,16 @@ public:
         bfilterResidencyThreshold = to;
     }
 
+    bool isBfilterPersistEnabled() const {
+        return bfilterPersist;
+    }
+
+    /**
+     * Save the vbucket's bloom filter to its data file, so that it can be
+     * reloaded at warmup. No-op if the vbucket has no enabled filter.
+     */
+    void persistBloomFilter(VBucket& vb);
+
     bool isMetaDataResident(RCPtr<VBucket> &vb, const DocKey& key);
 
     void logQTime(TaskId taskType, const ProcessClock::duration enqTime) {
@@ -824,6 +848,7 @@ protected:
     ExTask itemPagerTask;
     ExTask                          chkTask;
     float                           bfilterResidencyThreshold;
+    bool                            bfilterPersist;
     ExTask                          defragmenterTask;
 
     size_t                          compactionWriteQueueCap;
@@ -844,6 +869,8 @@ protected:
 
     std::mutex vbsetMutex;
     uint32_t bgFetchDelay;
+    std::atomic<uint64_t> bgFetchCoalesceMaxWait;
+    std::atomic<uint64_t> bgFetchLatencyTarget;
     double backfillMemoryThreshold;
     struct ExpiryPagerDelta {
         ExpiryPagerDelta() : sleeptime(0), task(0), enabled(true) {}
@@ -369,6 +369,24 @@ public:
 
     virtual double getBGFetchDelay(void) = 0;
 
+    /**
+     * Set the adaptive background fetch coalescing policy.
+     *
+     * While recent batch fetches take longer than the latency target the
+     * disk is considered busy, and a BgFetcher holds a newly woken batch
+     * open (for at most maxWait) so that further misses can join it.
+     * A maxWait of zero disables coalescing.
+     *
+     * @param maxWait upper bound on how long a batch is held open
+     * @param latencyTarget batch latency above which to coalesce
+     */
+    virtual void setBGFetchCoalescing(std::chrono::microseconds maxWait,
+                                      std::chrono::microseconds latencyTarget) = 0;
+
+    virtual std::chrono::microseconds getBGFetchCoalesceMaxWait() const = 0;
+
+    virtual std::chrono::microseconds getBGFetchLatencyTarget() const = 0;
+
     /**
      * Pause the bucket's Flusher.
      * @return true if successful.
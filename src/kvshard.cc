@@ -30,6 +30,7 @@
 /* [EPHE TODO]: Consider not using KVShard for ephemeral bucket */
 KVShard::KVShard(uint16_t id, KVBucket& kvBucket)
     : kvConfig(kvBucket.getEPEngine().getConfiguration(), id),
+      numaNode(-1),
       vbuckets(kvConfig.getMaxVBuckets()),
       highPriorityCount(0) {
     const std::string backend = kvConfig.getBackend();
@@ -46,6 +47,14 @@ KVShard::KVShard(uint16_t id, KVBucket& kvBucket)
                 backend + "'");
     }
 
+    // Count the shard's disk I/O towards the bucket's fair share.
+    auto& ioBytes = kvBucket.getEPEngine().getWorkLoadPolicy()
+                            .getDiskIOBytesCounter();
+    rwStore->getKVStoreStat().setBucketIOBytes(&ioBytes);
+    if (roStore) {
+        roStore->getKVStoreStat().setBucketIOBytes(&ioBytes);
+    }
+
     if (kvBucket.getEPEngine().getConfiguration().getBucketType() ==
         "persistent") {
         flusher = std::make_unique<Flusher>(&kvBucket, this);
@@ -85,11 +85,28 @@ public:
         return kvConfig.getShardId();
     }
 
+    /**
+     * The NUMA node this shard's flusher and bg fetcher tasks prefer to run
+     * on, -1 unless the ExecutorPool is topology aware.
+     */
+    int getNumaNode() const {
+        return numaNode;
+    }
+
+    /**
+     * Set by the KVBucket once it has registered with the ExecutorPool,
+     * before the shard's tasks are started.
+     */
+    void setNumaNode(int node) {
+        numaNode = node;
+    }
+
     std::vector<VBucket::id_type> getVBucketsSortedByState();
     std::vector<VBucket::id_type> getVBuckets();
 
 private:
     KVStoreConfig kvConfig;
+    int numaNode;
     std::vector<RCPtr<VBucket>> vbuckets;
 
     std::unique_ptr<KVStore> rwStore;
@@ -40,6 +40,7 @@ KVStoreConfig::KVStoreConfig(Configuration& config, uint16_t shardid)
                     config.getBackend(),
                     shardid,
                     config.isCollectionsPrototypeEnabled()) {
+    compactionMinStaleRatio = config.getCompactionMinStaleRatio();
 }
 
 KVStoreConfig::KVStoreConfig(uint16_t _maxVBuckets,
@@ -55,7 +56,8 @@ KVStoreConfig::KVStoreConfig(uint16_t _maxVBuckets,
       shardId(_shardId),
       logger(&global_logger),
       buffered(true),
-      persistDocNamespace(_persistDocNamespace) {
+      persistDocNamespace(_persistDocNamespace),
+      compactionMinStaleRatio(0.0) {
 }
 
 KVStoreConfig& KVStoreConfig::setLogger(Logger& _logger) {
@@ -68,6 +70,11 @@ KVStoreConfig& KVStoreConfig::setBuffered(bool _buffered) {
     return *this;
 }
 
+KVStoreConfig& KVStoreConfig::setCompactionMinStaleRatio(float ratio) {
+    compactionMinStaleRatio = ratio;
+    return *this;
+}
+
 KVStore *KVStoreFactory::create(KVStoreConfig &config, bool read_only) {
     KVStore *ret = NULL;
     std::string backend = config.getBackend();
@@ -238,6 +245,8 @@ void KVStore::addStats(ADD_STAT add_stat, const void *c) {
         addStat(prefix, "failure_del",   st.numDelFailure,   add_stat, c);
         addStat(prefix, "failure_vbset", st.numVbSetFailure, add_stat, c);
         addStat(prefix, "lastCommDocs",  st.docsCommitted,   add_stat, c);
+        addStat(prefix, "compaction_skipped", st.numCompactionSkipped,
+                add_stat, c);
     }
 
     addStat(prefix, "io_num_read", st.io_num_read, add_stat, c);
@@ -320,7 +320,8 @@ public:
         readSizeHisto(ExponentialGenerator<size_t>(1, 2), 25),
         writeSizeHisto(ExponentialGenerator<size_t>(1, 2), 25),
         totalBytesRead(0),
-        totalBytesWritten(0) { }
+        totalBytesWritten(0),
+        bucketIOBytes(nullptr) { }
 
     //Read time length
     Histogram<hrtime_t> readTimeHisto;
@@ -339,6 +340,23 @@ public:
     std::atomic<size_t> totalBytesRead;
     // Total bytes written to disk.
     std::atomic<size_t> totalBytesWritten;
+    // If set, the bucket-wide count of bytes read and written, which is
+    // charged against the bucket's fair share of the ExecutorPool.
+    std::atomic<size_t>* bucketIOBytes;
+
+    void addBytesRead(size_t bytes) {
+        totalBytesRead += bytes;
+        if (bucketIOBytes) {
+            bucketIOBytes->fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    void addBytesWritten(size_t bytes) {
+        totalBytesWritten += bytes;
+        if (bucketIOBytes) {
+            bucketIOBytes->fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
 
     void reset() {
         readTimeHisto.reset();
@@ -376,7 +394,8 @@ public:
       io_read_bytes(0),
       io_write_bytes(0),
       readSizeHisto(ExponentialGenerator<size_t>(1, 2), 25),
-      writeSizeHisto(ExponentialGenerator<size_t>(1, 2), 25) {
+      writeSizeHisto(ExponentialGenerator<size_t>(1, 2), 25),
+      numCompactionSkipped(0) {
     }
 
     KVStoreStats(const KVStoreStats &copyFrom) {}
@@ -391,6 +410,7 @@ public:
         numDelFailure = 0;
         numOpenFailure = 0;
         numVbSetFailure = 0;
+        numCompactionSkipped = 0;
 
         readTimeHisto.reset();
         readSizeHisto.reset();
@@ -405,6 +425,12 @@ public:
         fsStats.reset();
     }
 
+    /// Also count all file I/O of the KVStore in the given counter.
+    void setBucketIOBytes(std::atomic<size_t>* counter) {
+        fsStats.bucketIOBytes = counter;
+        fsStatsCompaction.bucketIOBytes = counter;
+    }
+
     // the number of docs committed
     Couchbase::RelaxedAtomic<size_t> docsCommitted;
     // the number of open() calls
@@ -447,6 +473,8 @@ public:
     Histogram<hrtime_t> commitHisto;
     // Time spent in compaction
     Histogram<hrtime_t> compactHisto;
+    // Number of compactions skipped as too little of the file was stale
+    Couchbase::RelaxedAtomic<size_t> numCompactionSkipped;
     // Time spent in saving documents to disk
     Histogram<hrtime_t> saveDocsHisto;
     // Batch size while saving documents
@@ -615,6 +643,25 @@ public:
      */
     KVStoreConfig& setBuffered(bool _buffered);
 
+    /**
+     * Minimum fraction (0.0 - 1.0) of a database file which must be stale
+     * before compaction will rewrite it. Files below the threshold are left
+     * untouched, unless the request asks for all deletes to be dropped.
+     *
+     * Only recognised by CouchKVStore
+     */
+    float getCompactionMinStaleRatio() const {
+        return compactionMinStaleRatio;
+    }
+
+    /**
+     * Used to override the default (0.0, i.e. always compact) minimum
+     * stale ratio.
+     *
+     * Only recognised by CouchKVStore
+     */
+    KVStoreConfig& setCompactionMinStaleRatio(float ratio);
+
     bool shouldPersistDocNamespace() const {
         return persistDocNamespace;
     }
@@ -632,6 +679,7 @@ private:
     Logger* logger;
     bool buffered;
     bool persistDocNamespace;
+    float compactionMinStaleRatio;
 };
 
 class IORequest {
@@ -969,6 +1017,22 @@ public:
      */
     virtual std::string getCollectionsManifest(uint16_t vbid) = 0;
 
+    /**
+     * KVStore must implement this method which should durably store the
+     * given serialised bloom filter alongside the vbucket's data.
+     *
+     * @returns true if the filter was saved.
+     */
+    virtual bool persistBloomFilter(uint16_t vbid,
+                                    const std::string& filter) = 0;
+
+    /**
+     * KVStore must implement this method which should return the bloom
+     * filter saved by persistBloomFilter, or an empty string if there is
+     * none or the vbucket's data has changed since it was saved.
+     */
+    virtual std::string getBloomFilter(uint16_t vbid) = 0;
+
 protected:
 
     /* all stats */
@@ -16,6 +16,8 @@
  */
 
 #include "linked_list.h"
+
+#include <limits>
 #include <mutex>
 
 BasicLinkedList::BasicLinkedList(uint16_t vbucketId, EPStats& st)
@@ -77,89 +79,207 @@ SequenceList::UpdateStatus BasicLinkedList::updateListElem(
     return UpdateStatus::Success;
 }
 
+/**
+ * RangeIterator over a BasicLinkedList.
+ *
+ * The iterator's entry in the list's readRanges runs from its current
+ * position to its end, so that neither the item it is on nor the ones it
+ * has still to read are moved by updates. The list is only walked with the
+ * writeLock held, as the item after the current one may be outside the
+ * range and so being moved by a writer.
+ */
+class BasicLinkedList::RangeIteratorLL : public SequenceList::RangeIterator {
+public:
+    RangeIteratorLL(BasicLinkedList& ll,
+                    seqno_t start,
+                    seqno_t end,
+                    std::list<SeqRange>::iterator range,
+                    OrderedLL::iterator pos)
+        : list(ll),
+          start(start),
+          end(end),
+          range(range),
+          pos(pos),
+          isDone(false) {
+        seek();
+    }
+
+    ~RangeIteratorLL() {
+        finish();
+    }
+
+    bool done() const override {
+        return isDone;
+    }
+
+    UniqueItemPtr curr() const override {
+        if (isDone) {
+            throw std::logic_error(
+                    "BasicLinkedList::RangeIteratorLL::curr(): "
+                    "(vb:" + std::to_string(list.vbid) + ") range read is "
+                    "done");
+        }
+        return UniqueItemPtr(pos->toItem(false, list.vbid));
+    }
+
+    void next() override {
+        if (isDone) {
+            return;
+        }
+
+        /* Don't step past the end of the range; what follows may be items
+           still being written */
+        if (pos->getBySeqno() >= end) {
+            finish();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lckGd(list.writeLock);
+            ++pos;
+        }
+        seek();
+    }
+
+    seqno_t getEnd() const override {
+        return end;
+    }
+
+private:
+    /**
+     * Walks from the current position to the first item at or after
+     * 'start', moving the range's begin along to each item on the way.
+     * Finishes the read if there is no such item in the range.
+     */
+    void seek() {
+        while (true) {
+            std::lock_guard<std::mutex> lckGd(list.writeLock);
+            if (pos == list.seqList.end() || pos->getBySeqno() > end) {
+                break;
+            }
+
+            const seqno_t seqno = pos->getBySeqno();
+            {
+                std::lock_guard<SpinLock> lh(list.rangeLock);
+                range->setBegin(seqno);
+                list.updateReadRange_UNLOCKED();
+            }
+
+            if (seqno >= start) {
+                return;
+            }
+            ++pos;
+        }
+        finish();
+    }
+
+    /* Done with the range read, give up the range */
+    void finish() {
+        if (isDone) {
+            return;
+        }
+        isDone = true;
+
+        std::lock_guard<SpinLock> lh(list.rangeLock);
+        list.readRanges.erase(range);
+        list.updateReadRange_UNLOCKED();
+    }
+
+    BasicLinkedList& list;
+    const seqno_t start;
+    const seqno_t end;
+    std::list<SeqRange>::iterator range;
+    OrderedLL::iterator pos;
+    bool isDone;
+};
+
 std::pair<ENGINE_ERROR_CODE, std::vector<UniqueItemPtr>>
 BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
     std::vector<UniqueItemPtr> empty;
+
+    ENGINE_ERROR_CODE status;
+    std::unique_ptr<RangeIterator> it;
+    std::tie(status, it) = makeRangeIterator(start, end);
+    if (status != ENGINE_SUCCESS) {
+        return {status, std::move(empty)
+                /* MSVC not happy with std::vector<UniqueItemPtr>() */};
+    }
+
+    /* Read items in the range */
+    std::vector<UniqueItemPtr> items;
+
+    for (; !it->done(); it->next()) {
+        try {
+            items.push_back(it->curr());
+        } catch (const std::bad_alloc&) {
+            LOG(EXTENSION_LOG_WARNING,
+                "BasicLinkedList::rangeRead(): "
+                "(vb %d) ENOMEM while trying to copy "
+                "items before streaming them",
+                vbid);
+            return {ENGINE_ENOMEM, std::move(empty)};
+        }
+    }
+
+    /* Return all the range read items */
+    return {ENGINE_SUCCESS, std::move(items)};
+}
+
+std::pair<ENGINE_ERROR_CODE, std::unique_ptr<SequenceList::RangeIterator>>
+BasicLinkedList::makeRangeIterator(seqno_t start, seqno_t end) {
     if ((start > end) || (start <= 0)) {
         LOG(EXTENSION_LOG_WARNING,
-            "BasicLinkedList::rangeRead(): "
+            "BasicLinkedList::makeRangeIterator(): "
             "(vb:%d) ERANGE: start %" PRIi64 " > end %" PRIi64,
             vbid,
             start,
             end);
-        return {ENGINE_ERANGE, std::move(empty)
-                /* MSVC not happy with std::vector<UniqueItemPtr>() */};
+        return {ENGINE_ERANGE, nullptr};
     }
 
-    /* Allows only 1 rangeRead for now */
-    std::lock_guard<std::mutex> lckGd(rangeReadLock);
-
+    std::list<SeqRange>::iterator range;
+    OrderedLL::iterator pos;
     {
+        std::lock_guard<std::mutex> lckGd(writeLock);
         std::lock_guard<SpinLock> lh(rangeLock);
         if (start > highSeqno) {
             LOG(EXTENSION_LOG_WARNING,
-                "BasicLinkedList::rangeRead(): "
+                "BasicLinkedList::makeRangeIterator(): "
                 "(vb:%d) ERANGE: start %" PRIi64 " > highSeqno %" PRIi64,
                 vbid,
                 start,
                 static_cast<seqno_t>(highSeqno));
             /* If the request is for an invalid range, return before iterating
                through the list */
-            return {ENGINE_ERANGE, std::move(empty)};
+            return {ENGINE_ERANGE, nullptr};
         }
 
-        /* Mark the initial read range */
+        /* Mark the initial read range, from the start of the list */
         end = std::min(end, static_cast<seqno_t>(highSeqno));
         end = std::max(end, static_cast<seqno_t>(highestDedupedSeqno));
-        readRange = SeqRange(1, end);
-    }
-
-    /* Read items in the range */
-    std::vector<UniqueItemPtr> items;
+        range = readRanges.emplace(readRanges.end(), 1, end);
+        updateReadRange_UNLOCKED();
 
-    for (const auto& osv : seqList) {
-        if (osv.getBySeqno() > end) {
-            /* we are done */
-            break;
-        }
-
-        {
-            std::lock_guard<SpinLock> lh(rangeLock);
-            readRange.setBegin(osv.getBySeqno()); /* [EPHE TODO]: should we
-                                                     update the min every time ?
-                                                   */
-        }
-
-        if (osv.getBySeqno() < start) {
-            /* skip this item */
-            continue;
-        }
-
-        try {
-            items.push_back(UniqueItemPtr(osv.toItem(false, vbid)));
-        } catch (const std::bad_alloc&) {
-            /* [EPHE TODO]: Do we handle backfill in a better way ?
-                            Perhaps do backfilling partially (that is
-                            backfill ==> stream; backfill ==> stream ..so on )?
-             */
-            LOG(EXTENSION_LOG_WARNING,
-                "BasicLinkedList::rangeRead(): "
-                "(vb %d) ENOMEM while trying to copy "
-                "item with seqno %" PRIi64 "before streaming it",
-                vbid,
-                osv.getBySeqno());
-            return {ENGINE_ENOMEM, std::move(empty)};
-        }
+        pos = seqList.begin();
     }
 
-    /* Done with range read, reset the range */
-    {
-        std::lock_guard<SpinLock> lh(rangeLock);
+    return {ENGINE_SUCCESS,
+            std::make_unique<RangeIteratorLL>(*this, start, end, range, pos)};
+}
+
+void BasicLinkedList::updateReadRange_UNLOCKED() {
+    if (readRanges.empty()) {
         readRange.reset();
+        return;
     }
 
-    /* Return all the range read items */
-    return {ENGINE_SUCCESS, std::move(items)};
+    seqno_t begin = std::numeric_limits<seqno_t>::max();
+    seqno_t end = 0;
+    for (const auto& r : readRanges) {
+        begin = std::min(begin, r.getBegin());
+        end = std::max(end, r.getEnd());
+    }
+    readRange = SeqRange(begin, end);
 }
 
 void BasicLinkedList::updateHighSeqno(const OrderedStoredValue& v) {
@@ -31,6 +31,8 @@
 #include <relaxed_atomic.h>
 #include <boost/intrusive/list.hpp>
 
+#include <list>
+
 /* This option will configure "list" to use the member hook */
 using MemberHookOption =
         boost::intrusive::member_hook<OrderedStoredValue,
@@ -145,6 +147,9 @@ public:
     std::pair<ENGINE_ERROR_CODE, std::vector<UniqueItemPtr>> rangeRead(
             seqno_t start, seqno_t end) override;
 
+    std::pair<ENGINE_ERROR_CODE, std::unique_ptr<RangeIterator>>
+    makeRangeIterator(seqno_t start, seqno_t end) override;
+
     void updateHighSeqno(const OrderedStoredValue& v) override;
 
     void markItemStale(StoredValue::UniquePtr ownedSv) override;
@@ -183,11 +188,20 @@ protected:
      * Used to mark of the range where point-in-time snapshot is happening.
      * To get a valid point-in-time snapshot and for correct list iteration we
      * must not de-duplicate an item in the list in this range.
+     *
+     * With several range reads in progress this covers all of their ranges
+     * (see readRanges).
      */
     SeqRange readRange;
 
     /**
-     * Lock that protects readRange.
+     * The ranges of the range reads in progress, each from the read's
+     * current position to its end. Guarded by rangeLock.
+     */
+    std::list<SeqRange> readRanges;
+
+    /**
+     * Lock that protects readRange and readRanges.
      * We use spinlock here since the lock is held only for very small time
      * periods.
      */
@@ -202,15 +216,13 @@ protected:
     Couchbase::RelaxedAtomic<size_t> staleMetaDataSize;
 
 private:
+    class RangeIteratorLL;
+
     /**
-     * Lock that serializes range reads on the 'seqList'.
-     * We need to serialize range reads because, range reads set a list level
-     * range in which items are read. If we have multiple range reads then we
-     * must handle the races in the updation of the range to have most inclusive
-     * range.
-     * For now we use this lock to allow only one range read at a time.
+     * Sets readRange to cover every range in readRanges.
+     * Caller must hold rangeLock.
      */
-    std::mutex rangeReadLock;
+    void updateReadRange_UNLOCKED();
 
     /**
      * We need to keep track of the highest seqno separately because there is a
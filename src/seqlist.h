@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -70,6 +71,46 @@ public:
      */
     enum class UpdateStatus { Success, Append };
 
+    /**
+     * A point-in-time read of a range of the list, made one item at a time
+     * so that the range need not be copied all at once.
+     *
+     * Until the iterator has passed them, the items in its range stay in
+     * place: an update to one of them appends a new copy of the item to the
+     * list and leaves the old one, marked stale, for the iterator to read.
+     * Writers are therefore never blocked, and items written after the
+     * iterator was created are not read. Any number of iterators may be
+     * reading the list at once.
+     */
+    class RangeIterator {
+    public:
+        virtual ~RangeIterator() {
+        }
+
+        /**
+         * @return true once every item in the range has been read
+         */
+        virtual bool done() const = 0;
+
+        /**
+         * Copies the item at the current position. Must not be called once
+         * done().
+         *
+         * @throws std::bad_alloc if the item could not be copied
+         */
+        virtual UniqueItemPtr curr() const = 0;
+
+        /**
+         * Moves on to the next item in the range.
+         */
+        virtual void next() = 0;
+
+        /**
+         * Returns the seqno the range (and so the snapshot) ends at.
+         */
+        virtual seqno_t getEnd() const = 0;
+    };
+
     virtual ~SequenceList() {
     }
 
@@ -121,6 +162,22 @@ public:
     virtual std::pair<ENGINE_ERROR_CODE, std::vector<UniqueItemPtr>> rangeRead(
             seqno_t start, seqno_t end) = 0;
 
+    /**
+     * Creates an iterator over a point-in-time snapshot of the items from
+     * seqno 'start', positioned at the first of them.
+     *
+     * As for rangeRead, the snapshot may have to end after the requested
+     * end seqno; the iterator's getEnd() gives the seqno it ends at.
+     *
+     * @param start requested start seqno
+     * @param end requested end seqno
+     *
+     * @return ENGINE_SUCCESS and the iterator
+     *         ENGINE_ERANGE on incorrect start and end
+     */
+    virtual std::pair<ENGINE_ERROR_CODE, std::unique_ptr<RangeIterator>>
+    makeRangeIterator(seqno_t start, seqno_t end) = 0;
+
     /**
      * Updates the highSeqno in the list. Since seqno is generated and managed
      * outside the list, the module managing it must update this after the seqno
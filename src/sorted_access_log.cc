@@ -0,0 +1,552 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "sorted_access_log.h"
+
+#include <memcached/types.h>
+#include <platform/make_unique.h>
+#include <platform/strerror.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include "crc32.h"
+}
+
+const char SortedAccessLog::magic[8] = {'c', 'b', 'a', 'l', 'o', 'g', 's', '1'};
+const uint32_t SortedAccessLog::version = 1;
+const uint32_t SortedAccessLog::byteOrder = 0x01020304;
+
+// Sections are aligned so that the records can be read in place
+static const size_t sectionAlignment = 8;
+
+StoredDocKey SortedAccessLog::VBucketEntries::getKey(const Entry& entry) const {
+    if (!isKeyValid(entry)) {
+        throw ReadException("SortedAccessLog: key of seqno " +
+                            std::to_string(entry.bySeqno) +
+                            " lies outside its vBucket's keys");
+    }
+    return StoredDocKey(
+            reinterpret_cast<const uint8_t*>(keys + entry.keyOffset),
+            entry.keyLen,
+            DocNamespace(entry.docNamespace));
+}
+
+bool SortedAccessLog::VBucketEntries::keyEquals(const Entry& entry,
+                                                const DocKey& key) const {
+    return isKeyValid(entry) && entry.keyLen == key.size() &&
+           DocNamespace(entry.docNamespace) == key.getDocNamespace() &&
+           std::memcmp(keys + entry.keyOffset, key.data(), key.size()) == 0;
+}
+
+SortedAccessLog::SortedAccessLog(std::string path)
+    : path(std::move(path)),
+      data(nullptr),
+      size(0),
+#ifdef WIN32
+      fileHandle(INVALID_HANDLE_VALUE),
+      mapping(nullptr),
+#endif
+      index(nullptr),
+      footer(nullptr) {
+}
+
+SortedAccessLog::~SortedAccessLog() {
+    unmap();
+}
+
+bool SortedAccessLog::isSortedAccessLog(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char buf[sizeof(magic)];
+    if (!file.read(buf, sizeof(buf))) {
+        return false;
+    }
+    return std::memcmp(buf, magic, sizeof(magic)) == 0;
+}
+
+void SortedAccessLog::open() {
+    unmap();
+
+#ifdef WIN32
+    fileHandle = CreateFile(path.c_str(),
+                            GENERIC_READ,
+                            FILE_SHARE_READ,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        throw ReadException("Failed to open '" + path + "': " +
+                            cb_strerror());
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        throw ReadException("Failed to get the size of '" + path + "': " +
+                            cb_strerror());
+    }
+    size = fileSize.QuadPart;
+    if (size > 0) {
+        mapping = CreateFileMapping(
+                fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == nullptr) {
+            throw ReadException("Failed to map '" + path + "': " +
+                                cb_strerror());
+        }
+        data = static_cast<const uint8_t*>(
+                MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (data == nullptr) {
+            throw ReadException("Failed to map '" + path + "': " +
+                                cb_strerror());
+        }
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw ReadException("Failed to open '" + path + "': " +
+                            strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const std::string error = strerror(errno);
+        ::close(fd);
+        throw ReadException("Failed to stat '" + path + "': " + error);
+    }
+    size = st.st_size;
+    if (size > 0) {
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            const std::string error = strerror(errno);
+            ::close(fd);
+            size = 0;
+            throw ReadException("Failed to map '" + path + "': " + error);
+        }
+        data = static_cast<const uint8_t*>(addr);
+        // Read the way warmup does, front to back
+        madvise(addr, size, MADV_SEQUENTIAL);
+    }
+    // The mapping holds its own reference to the file
+    ::close(fd);
+#endif
+
+    if (size < sizeof(Header) + sizeof(Footer)) {
+        throw ReadException("'" + path + "' is too short");
+    }
+    const auto* header = reinterpret_cast<const Header*>(data);
+    if (std::memcmp(header->magic, magic, sizeof(magic)) != 0) {
+        throw ReadException("'" + path + "' is not a sorted access log");
+    }
+    if (header->byteOrder != byteOrder) {
+        throw ReadException("'" + path + "' was written on another platform");
+    }
+    if (header->version != version) {
+        throw ReadException("'" + path + "' is of unsupported version " +
+                            std::to_string(header->version));
+    }
+
+    const auto* f =
+            reinterpret_cast<const Footer*>(data + size - sizeof(Footer));
+    if (std::memcmp(f->magic, magic, sizeof(magic)) != 0) {
+        throw ReadException("'" + path + "' is truncated");
+    }
+    const size_t indexSize = f->numVBuckets * sizeof(IndexEntry);
+    if (f->indexOffset % sectionAlignment != 0 ||
+        f->indexOffset + indexSize != size - sizeof(Footer)) {
+        throw ReadException("'" + path + "' has an invalid index offset");
+    }
+    const auto* idx = reinterpret_cast<const IndexEntry*>(data + f->indexOffset);
+    if (crc32buf(const_cast<uint8_t*>(data + f->indexOffset), indexSize) !=
+        f->indexCrc) {
+        throw ReadException("'" + path + "' has a damaged index");
+    }
+
+    // Check that every vBucket's entries and keys lie within the file, so
+    // that they can be used without further checks.
+    size_t numEntries = 0;
+    for (uint32_t ii = 0; ii < f->numVBuckets; ++ii) {
+        const auto& entry = idx[ii];
+        const uint64_t entriesEnd =
+                entry.entriesOffset + uint64_t(entry.count) * sizeof(Entry);
+        if (entry.entriesOffset % sectionAlignment != 0 ||
+            entry.entriesOffset < sizeof(Header) ||
+            entriesEnd > entry.keysOffset ||
+            entry.keysOffset + entry.keysSize > f->indexOffset ||
+            (ii > 0 && idx[ii - 1].vbid >= entry.vbid)) {
+            throw ReadException("'" + path + "' has an invalid index entry " +
+                                "for vb:" + std::to_string(entry.vbid));
+        }
+        numEntries += entry.count;
+    }
+    if (numEntries != f->numEntries) {
+        throw ReadException("'" + path + "' has an inconsistent index");
+    }
+
+    index = idx;
+    footer = f;
+}
+
+std::vector<uint16_t> SortedAccessLog::getVBuckets() const {
+    std::vector<uint16_t> result;
+    if (footer) {
+        for (uint32_t ii = 0; ii < footer->numVBuckets; ++ii) {
+            result.push_back(index[ii].vbid);
+        }
+    }
+    return result;
+}
+
+SortedAccessLog::VBucketEntries SortedAccessLog::getVBucket(
+        uint16_t vbid) const {
+    const auto* it = findVBucket(vbid);
+    if (!it) {
+        return {};
+    }
+    return VBucketEntries(
+            reinterpret_cast<const Entry*>(data + it->entriesOffset),
+            it->count,
+            reinterpret_cast<const char*>(data + it->keysOffset),
+            it->keysSize);
+}
+
+const SortedAccessLog::IndexEntry* SortedAccessLog::findVBucket(
+        uint16_t vbid) const {
+    if (!footer) {
+        return nullptr;
+    }
+    const auto* end = index + footer->numVBuckets;
+    const auto* it = std::lower_bound(
+            index, end, vbid, [](const IndexEntry& entry, uint16_t vb) {
+                return entry.vbid < vb;
+            });
+    if (it == end || it->vbid != vbid) {
+        return nullptr;
+    }
+    return it;
+}
+
+size_t SortedAccessLog::getNumEntries() const {
+    return footer ? footer->numEntries : 0;
+}
+
+void SortedAccessLog::unmap() {
+    index = nullptr;
+    footer = nullptr;
+#ifdef WIN32
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+SortedAccessLogWriter::SortedAccessLogWriter(std::string path)
+    : path(std::move(path)),
+      file(nullptr),
+      offset(0),
+      failed(false),
+      inVBucket(false),
+      vbid(0),
+      itemsLogged(0) {
+}
+
+SortedAccessLogWriter::~SortedAccessLogWriter() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool SortedAccessLogWriter::open() {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    SortedAccessLog::Header header;
+    std::memcpy(header.magic, SortedAccessLog::magic, sizeof(header.magic));
+    header.version = SortedAccessLog::version;
+    header.byteOrder = SortedAccessLog::byteOrder;
+    write(&header, sizeof(header));
+    return !failed;
+}
+
+void SortedAccessLogWriter::beginVBucket(uint16_t vb) {
+    if (inVBucket) {
+        endVBucket();
+    }
+    inVBucket = true;
+    vbid = vb;
+}
+
+void SortedAccessLogWriter::add(uint64_t bySeqno,
+                                const DocKey& key,
+                                uint8_t score) {
+    if (!inVBucket) {
+        throw std::logic_error(
+                "SortedAccessLogWriter::add: no vBucket has been begun");
+    }
+    SortedAccessLog::Entry entry;
+    entry.bySeqno = bySeqno;
+    entry.keyOffset = keys.size();
+    entry.keyLen = key.size();
+    entry.docNamespace = uint8_t(key.getDocNamespace());
+    entry.score = score;
+    entries.push_back(entry);
+    keys.append(reinterpret_cast<const char*>(key.data()), key.size());
+}
+
+void SortedAccessLogWriter::endVBucket() {
+    if (!inVBucket) {
+        return;
+    }
+    inVBucket = false;
+
+    // A vBucket with no keys still gets an (empty) section, which records
+    // that it had nothing to log - see SortedAccessLogSet.
+    std::sort(entries.begin(),
+              entries.end(),
+              [](const SortedAccessLog::Entry& a,
+                 const SortedAccessLog::Entry& b) {
+                  return a.bySeqno < b.bySeqno;
+              });
+
+    SortedAccessLog::IndexEntry entry;
+    entry.vbid = vbid;
+    entry.reserved = 0;
+    entry.count = entries.size();
+    entry.entriesOffset = offset;
+    write(entries.data(), entries.size() * sizeof(entries[0]));
+    entry.keysOffset = offset;
+    entry.keysSize = keys.size();
+    keys.resize(keys.size() +
+                (sectionAlignment - keys.size() % sectionAlignment) %
+                        sectionAlignment);
+    write(keys.data(), keys.size());
+
+    if (!index.empty() && index.back().vbid >= vbid) {
+        throw std::logic_error(
+                "SortedAccessLogWriter::endVBucket: vBuckets must be "
+                "written in ascending order");
+    }
+    index.push_back(entry);
+    itemsLogged += entries.size();
+
+    entries.clear();
+    keys.clear();
+}
+
+bool SortedAccessLogWriter::close() {
+    if (!file) {
+        return false;
+    }
+    endVBucket();
+
+    SortedAccessLog::Footer footer;
+    footer.indexOffset = offset;
+    footer.numEntries = itemsLogged;
+    footer.numVBuckets = index.size();
+    const size_t indexSize = index.size() * sizeof(index[0]);
+    footer.indexCrc =
+            crc32buf(reinterpret_cast<uint8_t*>(index.data()), indexSize);
+    std::memcpy(footer.magic, SortedAccessLog::magic, sizeof(footer.magic));
+    write(index.data(), indexSize);
+    write(&footer, sizeof(footer));
+
+    if (fflush(file) != 0) {
+        failed = true;
+    }
+    if (fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+    return !failed;
+}
+
+void SortedAccessLogWriter::write(const void* buf, size_t len) {
+    if (failed || len == 0) {
+        return;
+    }
+    if (fwrite(buf, 1, len, file) != len) {
+        failed = true;
+    }
+    offset += len;
+}
+
+SortedAccessLogLookup::SortedAccessLogLookup(
+        SortedAccessLog::VBucketEntries entries,
+        bool filterScore,
+        uint8_t score)
+    : entries(entries),
+      filterScore(filterScore),
+      score(score),
+      next(entries.begin()),
+      matched(0),
+      finished(false) {
+    while (next != entries.end() && !wanted(*next)) {
+        ++next;
+    }
+}
+
+SortedAccessLogSet::SortedAccessLogSet(std::string path)
+    : path(std::move(path)), numSegments(0) {
+}
+
+std::string SortedAccessLogSet::getSegmentPath(const std::string& path,
+                                               size_t segment) {
+    return path + ".seg." + std::to_string(segment);
+}
+
+size_t SortedAccessLogSet::countSegments(const std::string& path) {
+    size_t count = 0;
+    while (SortedAccessLog::isSortedAccessLog(
+            getSegmentPath(path, count + 1))) {
+        ++count;
+    }
+    return count;
+}
+
+static bool fileExists(const std::string& path) {
+    return std::ifstream(path, std::ios::binary).good();
+}
+
+bool SortedAccessLogSet::exists(const std::string& path) {
+    if (SortedAccessLog::isSortedAccessLog(path)) {
+        return true;
+    }
+    // Segments can't stand in for a main log of another format (a
+    // MutationLog), which lists the vBuckets they don't.
+    return !fileExists(path) &&
+           SortedAccessLog::isSortedAccessLog(getSegmentPath(path, 1));
+}
+
+void SortedAccessLogSet::open() {
+    logs.clear();
+    if (SortedAccessLog::isSortedAccessLog(path)) {
+        logs.push_back(std::make_unique<SortedAccessLog>(path));
+        logs.back()->open();
+    } else if (fileExists(path)) {
+        throw SortedAccessLog::ReadException(
+                "SortedAccessLogSet: main log '" + path +
+                "' is not a sorted access log");
+    }
+    numSegments = countSegments(path);
+    for (size_t ii = 1; ii <= numSegments; ++ii) {
+        logs.push_back(
+                std::make_unique<SortedAccessLog>(getSegmentPath(path, ii)));
+        logs.back()->open();
+    }
+}
+
+std::vector<uint16_t> SortedAccessLogSet::getVBuckets() const {
+    std::vector<uint16_t> result;
+    for (const auto& log : logs) {
+        const auto vbs = log->getVBuckets();
+        result.insert(result.end(), vbs.begin(), vbs.end());
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+SortedAccessLog::VBucketEntries SortedAccessLogSet::getVBucket(
+        uint16_t vbid) const {
+    for (auto it = logs.rbegin(); it != logs.rend(); ++it) {
+        if ((*it)->hasVBucket(vbid)) {
+            return (*it)->getVBucket(vbid);
+        }
+    }
+    return {};
+}
+
+ssize_t SortedAccessLogSet::compact(const std::string& dest) const {
+    SortedAccessLogWriter writer(dest);
+    if (!writer.open()) {
+        return -1;
+    }
+    for (auto vbid : getVBuckets()) {
+        const auto entries = getVBucket(vbid);
+        writer.beginVBucket(vbid);
+        for (const auto& entry : entries) {
+            writer.add(entry.bySeqno, entries.getKey(entry), entry.score);
+        }
+        writer.endVBucket();
+    }
+    const size_t items = writer.getItemsLogged();
+    if (!writer.close()) {
+        return -1;
+    }
+    return items;
+}
+
+void SortedAccessLogLookup::callback(CacheLookup& lookup) {
+    const uint64_t seqno = lookup.getBySeqno();
+    while (next != entries.end() &&
+           (next->bySeqno < seqno || !wanted(*next))) {
+        if (wanted(*next)) {
+            // Updated or deleted since it was logged
+            unmatched.push_back(next);
+        }
+        ++next;
+    }
+    if (next == entries.end()) {
+        // Nothing more to load from this vBucket
+        finished = true;
+        setStatus(ENGINE_ENOMEM);
+        return;
+    }
+    if (next->bySeqno == seqno && entries.keyEquals(*next, lookup.getKey())) {
+        ++next;
+        ++matched;
+        setStatus(ENGINE_SUCCESS);
+    } else {
+        setStatus(ENGINE_KEY_EEXISTS);
+    }
+}
+
+std::set<StoredDocKey> SortedAccessLogLookup::getUnmatchedKeys() const {
+    std::set<StoredDocKey> keys;
+    for (const auto* entry : unmatched) {
+        keys.insert(entries.getKey(*entry));
+    }
+    for (auto* entry = next; entry != entries.end(); ++entry) {
+        if (wanted(*entry)) {
+            keys.insert(entries.getKey(*entry));
+        }
+    }
+    return keys;
+}
@@ -0,0 +1,404 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+/**
+ * Sorted access log
+ *
+ * An alternative to the MutationLog format of the access log (see
+ * mutation_log.h), laid out for warmup rather than for appending. The keys
+ * of each vBucket are stored sorted by seqno in fixed size records, so that
+ * warmup can load them with one scan of the vBucket in seqno order - close
+ * to the order of the documents on disk - instead of fetching them one at a
+ * time in key order. The file is read through a memory mapping and needs no
+ * parsing beyond checking its index.
+ *
+ * File layout (native byte order, checked through the header):
+ *
+ *   Header
+ *   For each vBucket: Entry[count], then its keys (padded to 8 bytes)
+ *   IndexEntry[numVBuckets]
+ *   Footer
+ *
+ * Like any access log the contents are only a hint: documents may have
+ * changed or gone since it was written.
+ */
+
+#include "config.h"
+
+#include "callbacks.h"
+#include "storeddockey.h"
+
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class SortedAccessLog {
+public:
+    /**
+     * A key of the log.
+     */
+    struct Entry {
+        uint64_t bySeqno;
+        // Offset of the key in its vBucket's keys
+        uint32_t keyOffset;
+        uint16_t keyLen;
+        uint8_t docNamespace;
+        // How hot the key was when logged, higher being hotter
+        uint8_t score;
+    };
+
+    /**
+     * The entries of one vBucket, in seqno order.
+     */
+    class VBucketEntries {
+    public:
+        VBucketEntries()
+            : first(nullptr), last(nullptr), keys(nullptr), keysSize(0) {
+        }
+
+        VBucketEntries(const Entry* first,
+                       size_t count,
+                       const char* keys,
+                       size_t keysSize)
+            : first(first), last(first + count), keys(keys), keysSize(keysSize) {
+        }
+
+        const Entry* begin() const {
+            return first;
+        }
+
+        const Entry* end() const {
+            return last;
+        }
+
+        size_t size() const {
+            return last - first;
+        }
+
+        bool empty() const {
+            return first == last;
+        }
+
+        /**
+         * @throws ReadException if the entry's key lies outside the keys
+         */
+        StoredDocKey getKey(const Entry& entry) const;
+
+        /* False too if the entry's key lies outside the keys */
+        bool keyEquals(const Entry& entry, const DocKey& key) const;
+
+    private:
+        bool isKeyValid(const Entry& entry) const {
+            return uint64_t(entry.keyOffset) + entry.keyLen <= keysSize;
+        }
+
+        const Entry* first;
+        const Entry* last;
+        const char* keys;
+        size_t keysSize;
+    };
+
+    /**
+     * Exception thrown when a file in this format is damaged.
+     */
+    class ReadException : public std::runtime_error {
+    public:
+        ReadException(const std::string& s) : std::runtime_error(s) {
+        }
+    };
+
+    explicit SortedAccessLog(std::string path);
+
+    ~SortedAccessLog();
+
+    SortedAccessLog(const SortedAccessLog&) = delete;
+    SortedAccessLog& operator=(const SortedAccessLog&) = delete;
+
+    /**
+     * Whether the file at path is (or claims to be) a sorted access log,
+     * rather than a MutationLog one.
+     */
+    static bool isSortedAccessLog(const std::string& path);
+
+    /**
+     * Map the log and check its index.
+     *
+     * @throws ReadException if the file can't be read or is damaged
+     */
+    void open();
+
+    const std::string& getPath() const {
+        return path;
+    }
+
+    /**
+     * The vBuckets the log has a section for (possibly empty), in ascending
+     * order.
+     */
+    std::vector<uint16_t> getVBuckets() const;
+
+    /**
+     * The keys of the given vBucket (none if the log has none for it).
+     */
+    VBucketEntries getVBucket(uint16_t vbid) const;
+
+    /* Whether the log has a section for the vBucket, even an empty one */
+    bool hasVBucket(uint16_t vbid) const {
+        return findVBucket(vbid) != nullptr;
+    }
+
+    size_t getNumEntries() const;
+
+private:
+    friend class SortedAccessLogWriter;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+    };
+
+    struct IndexEntry {
+        uint16_t vbid;
+        uint16_t reserved;
+        uint32_t count;
+        uint64_t entriesOffset;
+        uint64_t keysOffset;
+        uint64_t keysSize;
+    };
+
+    struct Footer {
+        uint64_t indexOffset;
+        uint64_t numEntries;
+        uint32_t numVBuckets;
+        uint32_t indexCrc;
+        char magic[8];
+    };
+
+    static const char magic[8];
+    static const uint32_t version;
+    static const uint32_t byteOrder;
+
+    void unmap();
+
+    const IndexEntry* findVBucket(uint16_t vbid) const;
+
+    const std::string path;
+
+    const uint8_t* data;
+    size_t size;
+#ifdef WIN32
+    HANDLE fileHandle;
+    HANDLE mapping;
+#endif
+
+    const IndexEntry* index;
+    const Footer* footer;
+};
+
+/**
+ * Writes a sorted access log, one vBucket at a time. Each vBucket's keys
+ * are held in memory until it is finished, then sorted and written.
+ */
+class SortedAccessLogWriter {
+public:
+    explicit SortedAccessLogWriter(std::string path);
+
+    ~SortedAccessLogWriter();
+
+    /**
+     * Create the file, replacing any existing one.
+     */
+    bool open();
+
+    bool isOpen() const {
+        return file != nullptr;
+    }
+
+    void beginVBucket(uint16_t vbid);
+
+    void add(uint64_t bySeqno, const DocKey& key, uint8_t score = 0);
+
+    void endVBucket();
+
+    /**
+     * Write the index and close the file.
+     *
+     * @returns false if any of the file couldn't be written
+     */
+    bool close();
+
+    size_t getItemsLogged() const {
+        return itemsLogged;
+    }
+
+private:
+    void write(const void* buf, size_t len);
+
+    const std::string path;
+    FILE* file;
+    uint64_t offset;
+    bool failed;
+
+    // The vBucket being written, if any
+    bool inVBucket;
+    uint16_t vbid;
+    std::vector<SortedAccessLog::Entry> entries;
+    std::string keys;
+
+    std::vector<SortedAccessLog::IndexEntry> index;
+    size_t itemsLogged;
+};
+
+/**
+ * An access log made of a main sorted access log and the segments written
+ * since it by incremental runs of the access scanner ("<path>.seg.1",
+ * "<path>.seg.2", ...). Each segment has sections for some of the
+ * vBuckets; a vBucket's keys are those of its newest section.
+ *
+ * compact() merges the lot into a new main log, after which the segments
+ * can be removed.
+ */
+class SortedAccessLogSet {
+public:
+    explicit SortedAccessLogSet(std::string path);
+
+    static std::string getSegmentPath(const std::string& path,
+                                      size_t segment);
+
+    /**
+     * The number of segments of the log at path, counting up from 1 until
+     * one is missing.
+     */
+    static size_t countSegments(const std::string& path);
+
+    /**
+     * Whether there is a main sorted access log at path, or segments
+     * without any main log. Segments beside a MutationLog main log don't
+     * count, as the set can't merge them with it.
+     */
+    static bool exists(const std::string& path);
+
+    /**
+     * Map the main log (if there is one) and each segment.
+     *
+     * @throws SortedAccessLog::ReadException if any can't be read, or the
+     *         main log is in another format
+     */
+    void open();
+
+    size_t getNumSegments() const {
+        return numSegments;
+    }
+
+    /**
+     * The vBuckets which have a section in any of the files, in ascending
+     * order.
+     */
+    std::vector<uint16_t> getVBuckets() const;
+
+    /**
+     * The keys of the newest section for the vBucket.
+     */
+    SortedAccessLog::VBucketEntries getVBucket(uint16_t vbid) const;
+
+    /**
+     * Write the merged log to dest as a single sorted access log.
+     *
+     * @returns the number of keys written, or -1 if dest couldn't be written
+     */
+    ssize_t compact(const std::string& dest) const;
+
+private:
+    const std::string path;
+    size_t numSegments;
+    // Oldest first: the main log, if there is one, then the segments
+    std::vector<std::unique_ptr<SortedAccessLog>> logs;
+};
+
+/**
+ * CacheLookup callback for a scan of a vBucket which loads only the
+ * documents a sorted access log lists for it - optionally only those logged
+ * with a given score. The scan and the log are both in seqno order, so they
+ * are merged with a cursor rather than searched.
+ *
+ * Once past the last entry the scan is cancelled (ENGINE_ENOMEM) and
+ * isFinished() is set, to tell that apart from a scan stopped by the other
+ * callback.
+ *
+ * A document updated since the log was written has moved to a higher seqno,
+ * so the scan doesn't find it at its logged one. Such entries are kept, for
+ * the caller to load by key (see getUnmatchedKeys()).
+ */
+class SortedAccessLogLookup : public Callback<CacheLookup> {
+public:
+    explicit SortedAccessLogLookup(SortedAccessLog::VBucketEntries entries)
+        : SortedAccessLogLookup(entries, false, 0) {
+    }
+
+    SortedAccessLogLookup(SortedAccessLog::VBucketEntries entries,
+                          uint8_t score)
+        : SortedAccessLogLookup(entries, true, score) {
+    }
+
+    void callback(CacheLookup& lookup) override;
+
+    /* Whether there is anything to load */
+    bool hasEntries() const {
+        return next != entries.end();
+    }
+
+    /* The seqno to start the scan from */
+    uint64_t getStartSeqno() const {
+        return hasEntries() ? next->bySeqno : 0;
+    }
+
+    size_t getNumMatched() const {
+        return matched;
+    }
+
+    bool isFinished() const {
+        return finished;
+    }
+
+    /* The keys of the wanted entries the scan passed without finding, and of
+     * any it didn't reach. Only complete once the scan has run to its end. */
+    std::set<StoredDocKey> getUnmatchedKeys() const;
+
+private:
+    SortedAccessLogLookup(SortedAccessLog::VBucketEntries entries,
+                          bool filterScore,
+                          uint8_t score);
+
+    bool wanted(const SortedAccessLog::Entry& entry) const {
+        return !filterScore || entry.score == score;
+    }
+
+    const SortedAccessLog::VBucketEntries entries;
+    const bool filterScore;
+    const uint8_t score;
+    const SortedAccessLog::Entry* next;
+    size_t matched;
+    bool finished;
+    // Wanted entries passed without a match
+    std::vector<const SortedAccessLog::Entry*> unmatched;
+};
@@ -0,0 +1,149 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * An unbounded, lock-free, single-producer/single-consumer FIFO queue.
+ *
+ * Elements are held in a chain of fixed size rings ("chunks"): the producer
+ * fills the tail chunk, linking on a new one when it is full, and the
+ * consumer frees each chunk once it has read past its end. Neither side
+ * ever waits for the other.
+ *
+ * At most one thread may push at a time and at most one thread may pop at
+ * a time; a lock (or a single owning thread) on each side is enough for
+ * that, and the two sides need no coordination. size() and empty() may be
+ * called from any thread, but are only exact on the consumer side.
+ *
+ * T must be cheap to copy - typically a pointer. Elements still queued when
+ * the queue is destroyed are not cleaned up, so a queue of owning pointers
+ * must be drained by its owner first.
+ */
+template <typename T, size_t ChunkSize = 256>
+class SpscQueue {
+public:
+    SpscQueue()
+        : head(new Chunk), headIndex(0), tail(head), tailIndex(0),
+          pushed(0), popped(0) {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    ~SpscQueue() {
+        while (head != nullptr) {
+            Chunk* next = head->next.load(std::memory_order_relaxed);
+            delete head;
+            head = next;
+        }
+    }
+
+    /**
+     * Add value at the back. Producer side.
+     */
+    void push(const T& value) {
+        if (tailIndex == ChunkSize) {
+            Chunk* chunk = new Chunk;
+            tail->next.store(chunk, std::memory_order_relaxed);
+            tail = chunk;
+            tailIndex = 0;
+        }
+        tail->slots[tailIndex++] = value;
+        // Publishes both the value and any chunk linked on for it
+        pushed.store(pushed.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+    }
+
+    /**
+     * Look at the front value without removing it. Consumer side.
+     *
+     * @returns false if the queue is empty
+     */
+    bool front(T& value) {
+        if (popped.load(std::memory_order_relaxed) ==
+            pushed.load(std::memory_order_acquire)) {
+            return false;
+        }
+        advance();
+        value = head->slots[headIndex];
+        return true;
+    }
+
+    /**
+     * Remove the front value. Consumer side.
+     *
+     * @returns false if the queue is empty
+     */
+    bool pop(T& value) {
+        if (!front(value)) {
+            return false;
+        }
+        ++headIndex;
+        popped.store(popped.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        const size_t out = popped.load(std::memory_order_acquire);
+        return pushed.load(std::memory_order_acquire) - out;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+private:
+    struct Chunk {
+        Chunk() : next(nullptr) {
+        }
+
+        std::array<T, ChunkSize> slots;
+        std::atomic<Chunk*> next;
+    };
+
+    // Move on to the next chunk if the head one has been read to its end.
+    // Only called once a value is known to be available, which is after
+    // the producer linked on its chunk.
+    void advance() {
+        if (headIndex == ChunkSize) {
+            Chunk* next = head->next.load(std::memory_order_relaxed);
+            delete head;
+            head = next;
+            headIndex = 0;
+        }
+    }
+
+    // Each side's state is kept on its own cache line, so that the two
+    // don't contend for lines the other writes.
+
+    // Consumer owned
+    Chunk* head;
+    size_t headIndex;
+
+    // Producer owned
+    alignas(64) Chunk* tail;
+    size_t tailIndex;
+
+    alignas(64) std::atomic<size_t> pushed;
+    alignas(64) std::atomic<size_t> popped;
+};
@@ -124,6 +124,7 @@ public:
         numRemainingBgItems(0),
         numRemainingBgJobs(0),
         bgNumOperations(0),
+        bgFetchCoalesced(0),
         maxRemainingBgJobs(0),
         bgWait(0),
         bgMinWait(0),
@@ -351,6 +352,8 @@ public:
     Counter numRemainingBgJobs;
     //! The number of samples the bgWaitDelta and bgLoadDelta contains of
     Counter bgNumOperations;
+    //! Number of bg fetch batches held open to coalesce further misses
+    Counter bgFetchCoalesced;
     //! Max number of individual background fetch jobs that we've seen in the queue
     Counter maxRemainingBgJobs;
 
@@ -562,6 +565,13 @@ public:
     //! Historgram of batch reads
     Histogram<hrtime_t> getMultiHisto;
 
+    //! Histogram of bg fetch batch (getMulti) latencies, one sample per batch
+    Histogram<hrtime_t> bgFetchBatchLatencyHisto;
+    //! Histogram of number of items per bg fetch batch
+    Histogram<size_t> bgFetchBatchSizeHisto;
+    //! Histogram of time bg fetch batches were held open to coalesce misses
+    Histogram<hrtime_t> bgFetchCoalesceHisto;
+
     // ! Histograms of various task wait times, one per Task.
     std::vector<ProcessDurationHistogram> schedulingHisto;
 
@@ -588,6 +598,7 @@ public:
         numNotMyVBuckets.store(0);
         bg_fetched.store(0);
         bgNumOperations.store(0);
+        bgFetchCoalesced.store(0);
         bgWait.store(0);
         bgLoad.store(0);
         bgMinWait.store(999999999);
@@ -649,6 +660,9 @@ public:
         dirtyAgeHisto.reset();
         mlogCompactorHisto.reset();
         getMultiHisto.reset();
+        bgFetchBatchLatencyHisto.reset();
+        bgFetchBatchSizeHisto.reset();
+        bgFetchCoalesceHisto.reset();
         persistenceCursorGetItemsHisto.reset();
         dcpCursorsGetItemsHisto.reset();
     }
@@ -0,0 +1,163 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * TaskLatencyHistograms keeps, for every TaskId, a histogram of how long
+ * tasks waited past their waketime before a thread picked them up and a
+ * histogram of how long they then ran, across all buckets.
+ *
+ * Recording has to be cheap enough to do for every task run, so the
+ * histograms are split into a shard per thread (a power of two of at least
+ * the pool's maximum thread count) and each ExecutorThread records into its
+ * own shard (see ExecutorThread::getHistoShard()). Shards
+ * are separated by a cache line of padding so that threads recording into
+ * different shards never contend on a line. The bins are power-of-two
+ * microsecond ranges so finding the bin is a single bit scan; the shards
+ * are only summed when the stats are read.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <platform/processclock.h>
+
+#include "globaltask.h"
+
+class TaskLatencyHistograms {
+public:
+    // Bin 0 is [0,1)us, bin i is [2^(i-1),2^i)us and the last bin is open
+    static const size_t numBins = 32;
+
+    using Bins = std::array<uint64_t, numBins>;
+
+    /**
+     * @param numThreads the number of threads expected to record at once
+     */
+    explicit TaskLatencyHistograms(size_t numThreads)
+        : numShards(roundUpPow2(numThreads)),
+          shards(new Shard[numShards]) {
+        for (size_t shard = 0; shard < numShards; shard++) {
+            for (auto& row : shards[shard].rows) {
+                for (size_t ii = 0; ii < numBins; ii++) {
+                    row.wait[ii].store(0, std::memory_order_relaxed);
+                    row.run[ii].store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    /**
+     * Record one run of a task.
+     *
+     * @param shard the recording thread's shard, any value is accepted
+     * @param id the task's TaskId
+     * @param wait how long the task waited past its waketime
+     * @param run how long the task ran for
+     */
+    void record(size_t shard,
+                TaskId id,
+                const ProcessClock::duration wait,
+                const ProcessClock::duration run) {
+        Row& row = shards[shard & (numShards - 1)].rows[static_cast<int>(id)];
+        row.wait[binOf(wait)].fetch_add(1, std::memory_order_relaxed);
+        row.run[binOf(run)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Sum the given TaskId's histograms across all shards.
+     */
+    void getBins(TaskId id, Bins& wait, Bins& run) const {
+        wait.fill(0);
+        run.fill(0);
+        for (size_t shard = 0; shard < numShards; shard++) {
+            const Row& row = shards[shard].rows[static_cast<int>(id)];
+            for (size_t ii = 0; ii < numBins; ii++) {
+                wait[ii] += row.wait[ii].load(std::memory_order_relaxed);
+                run[ii] += row.run[ii].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t getNumShards() const {
+        return numShards;
+    }
+
+    /// Lower bound of bin in microseconds (inclusive)
+    static uint64_t binStart(size_t bin) {
+        return bin == 0 ? 0 : uint64_t(1) << (bin - 1);
+    }
+
+    /// Upper bound of bin in microseconds (exclusive)
+    static uint64_t binEnd(size_t bin) {
+        return bin == numBins - 1 ? std::numeric_limits<uint64_t>::max()
+                                  : uint64_t(1) << bin;
+    }
+
+    static size_t binOf(const ProcessClock::duration duration) {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                duration)
+                                .count();
+        if (us <= 0) {
+            return 0;
+        }
+        const size_t bin = bitLength(static_cast<uint64_t>(us));
+        return bin < numBins ? bin : numBins - 1;
+    }
+
+protected:
+    static size_t roundUpPow2(size_t value) {
+        size_t pow2 = 1;
+        while (pow2 < value) {
+            pow2 <<= 1;
+        }
+        return pow2;
+    }
+
+    /// The number of bits needed to represent value (value > 0)
+    static size_t bitLength(uint64_t value) {
+#if defined(__GNUC__)
+        return 64 - __builtin_clzll(value);
+#else
+        size_t bits = 0;
+        while (value) {
+            value >>= 1;
+            bits++;
+        }
+        return bits;
+#endif
+    }
+
+    struct Row {
+        std::array<std::atomic<uint64_t>, numBins> wait;
+        std::array<std::atomic<uint64_t>, numBins> run;
+    };
+
+    struct Shard {
+        std::array<Row, static_cast<int>(TaskId::TASK_COUNT)> rows;
+        // Keeps the last row of one shard and the first row of the next
+        // off a common cache line however the shards happen to be aligned.
+        char padding[64];
+    };
+
+    const size_t numShards;
+    std::unique_ptr<Shard[]> shards;
+};
@@ -74,6 +74,13 @@ public:
     virtual void logRunTime(TaskId id,
                             const ProcessClock::duration runTime) = 0;
 
+    /*
+        Return the total bytes read from and written to disk by the
+        taskable, used to charge disk I/O to its fair share of the
+        ExecutorPool. Called after every I/O task run, so must be cheap.
+    */
+    virtual size_t getDiskIOBytes() = 0;
+
 protected:
     virtual ~Taskable() {}
 };
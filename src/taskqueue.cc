@@ -20,12 +20,20 @@
 #include "executorpool.h"
 #include "executorthread.h"
 
+#include <platform/make_unique.h>
+
+#include <algorithm>
 #include <cmath>
 
-TaskQueue::TaskQueue(ExecutorPool *m, task_type_t t, const char *nm) :
-    name(nm), queueType(t), manager(m), sleepers(0)
+TaskQueue::TaskQueue(ExecutorPool *m, task_type_t t, const char *nm,
+                     size_t numLocalQueues, bool fairShare, bool nodeQueues) :
+    name(nm), queueType(t), manager(m), sleepers(0), readyQueue(fairShare),
+    numStolen(0), nodeQueues(nodeQueues), readyTopPriority(noReadyTask),
+    futureWaketime(ProcessClock::time_point::max().time_since_epoch().count())
 {
-    // EMPTY
+    for (size_t i = 0; i < numLocalQueues; ++i) {
+        localQueues.push_back(std::make_unique<LocalReadyQueue>());
+    }
 }
 
 TaskQueue::~TaskQueue() {
@@ -37,8 +45,16 @@ const std::string TaskQueue::getName() const {
 }
 
 size_t TaskQueue::getReadyQueueSize() {
-    LockHolder lh(mutex);
-    return readyQueue.size();
+    size_t size;
+    {
+        LockHolder lh(mutex);
+        size = readyQueue.size();
+    }
+    for (auto& local : localQueues) {
+        LockHolder lh(local->mutex);
+        size += local->queue.size();
+    }
+    return size;
 }
 
 size_t TaskQueue::getFutureQueueSize() {
@@ -51,6 +67,65 @@ size_t TaskQueue::getPendingQueueSize() {
     return pendingQueue.size();
 }
 
+void TaskQueue::charge(ExTask& task, const ProcessClock::duration runtime) {
+    // Without fair share there is nothing to charge, and nothing is
+    // accounted, so a task run takes no lock here.
+    if (!readyQueue.isFairShare()) {
+        return;
+    }
+
+    Taskable& taskable = task->getTaskable();
+    const task_gid_t gid = taskable.getGID();
+    WorkLoadPolicy& workload = taskable.getWorkLoadPolicy();
+
+    // NonIO tasks don't touch disk. The I/O tasks of a bucket are charged
+    // with all of its disk I/O since its last charge in this queue, so a
+    // bucket busy compacting is also held back in the writer queue.
+    const bool chargeIO = queueType != NONIO_TASK_IDX &&
+                          workload.getIOQuota() != 0;
+    const size_t diskBytes = chargeIO ? taskable.getDiskIOBytes() : 0;
+    const size_t cpuQuota = std::max(workload.getCpuQuota(), size_t(1));
+    double cost = std::chrono::duration<double, std::micro>(runtime).count() /
+                  cpuQuota;
+
+    // The usage is kept under the mutex which the charge needs anyway.
+    LockHolder lh(mutex);
+    TaskableUsage& taskableUsage = usage[gid];
+    taskableUsage.runtime += runtime;
+    taskableUsage.tasksRun++;
+    if (chargeIO) {
+        size_t ioCharged = 0;
+        if (taskableUsage.lastDiskBytes != 0 &&
+            diskBytes > taskableUsage.lastDiskBytes) {
+            ioCharged = diskBytes - taskableUsage.lastDiskBytes;
+        }
+        taskableUsage.lastDiskBytes = diskBytes;
+        taskableUsage.diskBytes += ioCharged;
+        cost += double(ioCharged) / workload.getIOQuota();
+    }
+
+    readyQueue.charge(gid, cost);
+    // The charge may have changed which Taskable's task is at the top
+    _publishHints_UNLOCKED();
+}
+
+void TaskQueue::addUsage(std::map<task_gid_t, TaskableUsage>& totals) {
+    LockHolder lh(mutex);
+    for (const auto& entry : usage) {
+        TaskableUsage& total = totals[entry.first];
+        total.runtime += entry.second.runtime;
+        total.tasksRun += entry.second.tasksRun;
+        total.diskBytes += entry.second.diskBytes;
+    }
+}
+
+void TaskQueue::forgetTaskable(task_gid_t gid) {
+    LockHolder lh(mutex);
+    usage.erase(gid);
+    readyQueue.forget(gid);
+    _publishHints_UNLOCKED();
+}
+
 ExTask TaskQueue::_popReadyTask(void) {
     ExTask t = readyQueue.top();
     readyQueue.pop();
@@ -113,15 +188,172 @@ bool TaskQueue::_doSleep(ExecutorThread &t,
     return true;
 }
 
+size_t TaskQueue::_localQueueIdx(const ExecutorThread &t) const {
+    const size_t idx = nodeQueues ? size_t(std::max(t.getNumaNode(), 0))
+                                  : t.getLocalQueueIdx();
+    return idx % localQueues.size();
+}
+
+void TaskQueue::_pushReadyTask(ExTask &task) {
+    if (nodeQueues && task->getNumaNode() >= 0) {
+        LocalReadyQueue& local =
+                *localQueues[task->getNumaNode() % localQueues.size()];
+        LockHolder lh(local.mutex);
+        local.queue.push(task);
+    } else {
+        readyQueue.push(task);
+    }
+}
+
+void TaskQueue::_publishHints_UNLOCKED() {
+    if (readyQueue.empty()) {
+        readyTopPriority = noReadyTask;
+    } else if (readyQueue.top()->isdead()) {
+        readyTopPriority = deadReadyTask;
+    } else {
+        readyTopPriority = readyQueue.top()->getQueuePriority();
+    }
+    futureWaketime = futureQueue.empty()
+                             ? ProcessClock::time_point::max()
+                                       .time_since_epoch()
+                                       .count()
+                             : futureQueue.top()
+                                       ->getWaketime()
+                                       .time_since_epoch()
+                                       .count();
+}
+
+void TaskQueue::snooze(ExTask& task, const double secs) {
+    futureQueue.snooze(task, secs);
+    // Not under the mutex: only ever bring the hint forward, so the fast
+    // path can't miss the task becoming due.
+    const auto waketime = task->getWaketime().time_since_epoch().count();
+    auto hint = futureWaketime.load();
+    while (waketime < hint &&
+           !futureWaketime.compare_exchange_weak(hint, waketime)) {
+    }
+}
+
+bool TaskQueue::_fetchOwnLocalTask(ExecutorThread &t) {
+    // Only if no future task is due to be collected, and nothing of higher
+    // priority (or a dead task) is at the top of the readyQueue.
+    if (t.getCurTime().time_since_epoch().count() >= futureWaketime) {
+        return false;
+    }
+    const queue_priority_t sharedTop = readyTopPriority;
+    if (sharedTop == deadReadyTask) {
+        return false;
+    }
+    LocalReadyQueue& local = *localQueues[_localQueueIdx(t)];
+    LockHolder lh(local.mutex);
+    if (local.queue.empty() ||
+        local.queue.top()->getQueuePriority() > sharedTop) {
+        return false;
+    }
+    t.setCurrentTask(local.queue.top());
+    local.queue.pop();
+    manager->lessWork(queueType);
+    return true;
+}
+
+bool TaskQueue::_fetchLocalTask(ExecutorThread &t) {
+    // A local queue holds tasks that were once at the top of the readyQueue
+    // (or, with node queues, were routed past it), but a higher priority
+    // task may have become ready since; don't let the local queues jump
+    // ahead of it (or of a dead task waiting to be cleaned out).
+    const bool haveShared = !readyQueue.empty();
+    ExTask sharedTop = haveShared ? readyQueue.top() : ExTask();
+    if (haveShared && sharedTop->isdead()) {
+        return false;
+    }
+
+    // Own queue first, then steal from the other threads' (or nodes')
+    // queues, but only if their head has strictly higher priority. A queue's
+    // owner may pop it (see _fetchOwnLocalTask) between the look and the
+    // pop, so the head is taken again under the local mutex.
+    const size_t own = _localQueueIdx(t);
+    LocalReadyQueue* best = nullptr;
+    size_t bestIdx = 0;
+    queue_priority_t bestPriority = 0;
+    for (size_t i = 0; i < localQueues.size(); ++i) {
+        LocalReadyQueue& local = *localQueues[(own + i) % localQueues.size()];
+        LockHolder lh(local.mutex);
+        if (local.queue.empty()) {
+            continue;
+        }
+        const queue_priority_t priority =
+                local.queue.top()->getQueuePriority();
+        if (!best || priority < bestPriority) {
+            best = &local;
+            bestIdx = i;
+            bestPriority = priority;
+        }
+    }
+
+    if (!best ||
+        (haveShared && sharedTop->getQueuePriority() < bestPriority)) {
+        return false;
+    }
+
+    LockHolder lh(best->mutex);
+    if (best->queue.empty()) {
+        return false;
+    }
+    t.setCurrentTask(best->queue.top());
+    best->queue.pop();
+    manager->lessWork(queueType);
+    if (bestIdx != 0) {
+        ++numStolen;
+    }
+    return true;
+}
+
+void TaskQueue::_fillLocalQueue(ExecutorThread &t) {
+    // Keep half of what is left ready for this thread, in priority order;
+    // the rest stays in the shared readyQueue for the threads being woken.
+    // Other threads can steal from the local queue if this one falls behind.
+    // Node queues only hold the tasks of their own node's shards.
+    // With fair share, tasks are only batched while a single Taskable has
+    // ready tasks: a task is charged after it has run, so a batch would all
+    // go to the Taskable at the head of the round, whatever its share.
+    size_t toMove = nodeQueues ? 0 : readyQueue.size() / 2;
+    if (toMove == 0 || readyQueue.isContended()) {
+        return;
+    }
+    LocalReadyQueue& local = *localQueues[_localQueueIdx(t)];
+    LockHolder lh(local.mutex);
+    for (; toMove && !readyQueue.isContended(); --toMove) {
+        local.queue.push(readyQueue.top());
+        readyQueue.pop();
+    }
+}
+
 bool TaskQueue::_fetchNextTask(ExecutorThread &t, bool toSleep) {
     bool ret = false;
+    if (!localQueues.empty() && _fetchOwnLocalTask(t)) {
+        // Fast path: only the thread's own local queue was locked
+        return true;
+    }
+
     std::unique_lock<std::mutex> lh(mutex);
+    size_t numToWake = 0;
+
+    if (!localQueues.empty()) {
+        // Collect any due tasks before looking in the local queues, so they
+        // can be weighed against the tasks batched there.
+        numToWake = _moveReadyTasks(t.getCurTime());
+        if (_fetchLocalTask(t)) {
+            _publishHints_UNLOCKED();
+            _doWake_UNLOCKED(numToWake);
+            return true;
+        }
+    }
 
     if (toSleep && !_doSleep(t, lh)) {
         return ret; // shutting down
     }
 
-    size_t numToWake = _moveReadyTasks(t.getCurTime());
+    numToWake += _moveReadyTasks(t.getCurTime());
 
     if (!futureQueue.empty() && t.taskType == queueType &&
         futureQueue.top()->getWaketime() < t.getWaketime()) {
@@ -139,11 +371,19 @@ bool TaskQueue::_fetchNextTask(ExecutorThread &t, bool toSleep) {
         _checkPendingQueue();
         ExTask tid = _popReadyTask(); // and pop out the top task
         t.setCurrentTask(tid);
+        if (!localQueues.empty()) {
+            _fillLocalQueue(t);
+        }
+        ret = true;
+    } else if (!localQueues.empty() && _fetchLocalTask(t)) {
+        // We may have been woken for tasks another thread has since moved
+        // into its local queue.
         ret = true;
     } else { // Let the task continue waiting in pendingQueue
         numToWake = numToWake ? numToWake - 1 : 0; // 1 fewer task ready
     }
 
+    _publishHints_UNLOCKED();
     _doWake_UNLOCKED(numToWake);
     lh.unlock();
 
@@ -167,7 +407,7 @@ size_t TaskQueue::_moveReadyTasks(const ProcessClock::time_point tv) {
         ExTask tid = futureQueue.top();
         if (tid->getWaketime() <= tv) {
             futureQueue.pop();
-            readyQueue.push(tid);
+            _pushReadyTask(tid);
             numReady++;
         } else {
             break;
@@ -193,6 +433,7 @@ ProcessClock::time_point TaskQueue::_reschedule(ExTask &task) {
     LockHolder lh(mutex);
 
     futureQueue.push(task);
+    _publishHints_UNLOCKED();
     return futureQueue.top()->getWaketime();
 }
 
@@ -211,6 +452,7 @@ void TaskQueue::_schedule(ExTask &task) {
         LockHolder lh(mutex);
 
         futureQueue.push(task);
+        _publishHints_UNLOCKED();
 
         LOG(EXTENSION_LOG_DEBUG,
             "%s: Schedule a task \"%.*s\" id %" PRIu64,
@@ -273,6 +515,7 @@ void TaskQueue::_wake(ExTask &task) {
             futureQueue.push(tid);
             notReady.pop();
         }
+        _publishHints_UNLOCKED();
 
         _doWake_UNLOCKED(readyCount);
         sleepQ = manager->getSleepQ(queueType);
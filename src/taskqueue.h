@@ -19,19 +19,56 @@
 
 #include "config.h"
 
+#include <atomic>
+#include <limits>
+#include <map>
+#include <memory>
 #include <queue>
+#include <vector>
 #include <platform/processclock.h>
 
-#include "futurequeue.h"
+#include "fairshare_readyqueue.h"
 #include "task_type.h"
 #include "tasks.h"
+#include "timerwheel_futurequeue.h"
 class ExecutorPool;
 class ExecutorThread;
 
+/**
+ * The shared thread time consumed by a Taskable's tasks in a fair share
+ * TaskQueue.
+ */
+struct TaskableUsage {
+    TaskableUsage()
+        : runtime(ProcessClock::duration::zero()),
+          tasksRun(0),
+          diskBytes(0),
+          lastDiskBytes(0) {
+    }
+
+    ProcessClock::duration runtime;
+    uint64_t tasksRun;
+    // Disk bytes charged against the Taskable's I/O quota (fair share only)
+    uint64_t diskBytes;
+    // Taskable::getDiskIOBytes() when last charged, 0 if never
+    size_t lastDiskBytes;
+};
+
 class TaskQueue {
     friend class ExecutorPool;
 public:
-    TaskQueue(ExecutorPool *m, task_type_t t, const char *nm);
+    /**
+     * @param numLocalQueues if non-zero, enables work stealing with this many
+     *        per-thread local ready queues (see LocalReadyQueue).
+     * @param fairShare if true, ready tasks are shared out between Taskables
+     *        by their quotas (see FairShareReadyQueue).
+     * @param nodeQueues if true, the local queues belong to NUMA nodes
+     *        rather than threads, and ready tasks with a NUMA node go
+     *        straight to their node's queue.
+     */
+    TaskQueue(ExecutorPool *m, task_type_t t, const char *nm,
+              size_t numLocalQueues = 0, bool fairShare = false,
+              bool nodeQueues = false);
     ~TaskQueue();
 
     void schedule(ExTask &task);
@@ -58,10 +95,30 @@ public:
 
     size_t getPendingQueueSize();
 
-    void snooze(ExTask& task, const double secs) {
-        futureQueue.snooze(task, secs);
+    /// Number of tasks taken from another thread's local ready queue
+    size_t getNumStolen() const {
+        return numStolen;
+    }
+
+    bool isWorkStealing() const {
+        return !localQueues.empty();
     }
 
+    void snooze(ExTask& task, const double secs);
+
+    /**
+     * With fair share, account a run of task against its Taskable and
+     * charge it against the Taskable's CPU and disk I/O quotas. Without fair
+     * share this does nothing.
+     */
+    void charge(ExTask& task, const ProcessClock::duration runtime);
+
+    /// Add this queue's usage per Taskable GID into totals
+    void addUsage(std::map<task_gid_t, TaskableUsage>& totals);
+
+    /// Drop the usage and fair share state of an unregistered Taskable
+    void forgetTaskable(task_gid_t gid);
+
 private:
     void _schedule(ExTask &task);
     ProcessClock::time_point _reschedule(ExTask &task);
@@ -72,6 +129,12 @@ private:
     void _doWake_UNLOCKED(size_t &numToWake);
     size_t _moveReadyTasks(const ProcessClock::time_point tv);
     ExTask _popReadyTask(void);
+    bool _fetchOwnLocalTask(ExecutorThread &thread);
+    bool _fetchLocalTask(ExecutorThread &thread);
+    void _publishHints_UNLOCKED();
+    void _fillLocalQueue(ExecutorThread &thread);
+    size_t _localQueueIdx(const ExecutorThread &thread) const;
+    void _pushReadyTask(ExTask &task);
 
     SyncObject mutex;
     const std::string name;
@@ -79,14 +142,53 @@ private:
     ExecutorPool *manager;
     size_t sleepers; // number of threads sleeping in this taskQueue
 
-    // sorted by task priority.
-    std::priority_queue<ExTask, std::deque<ExTask>,
-                        CompareByPriority> readyQueue;
+    // sorted by task priority (within each Taskable, if fair share).
+    FairShareReadyQueue readyQueue;
 
     // sorted by waketime.
-    FutureQueue<> futureQueue;
+    TimerWheelFutureQueue futureQueue;
 
     std::list<ExTask> pendingQueue;
+
+    /**
+     * Work-stealing mode: ready tasks can also sit in per-thread local
+     * queues, each with its own mutex. A thread which takes the queue-wide
+     * mutex to collect ready tasks keeps a share of them in its local queue,
+     * and threads look in their own (then other threads') local queues
+     * before the readyQueue. A thread takes the highest priority head of
+     * all the local queues (its own on a tie), and only if no task of
+     * higher priority is ready in the readyQueue, so the prioritised run
+     * order is kept. Tasks in local queues still count as ready work for
+     * the ExecutorPool, so no thread sleeps while any are left. The local
+     * queues are always locked after the queue-wide mutex.
+     *
+     * A thread first tries its own local queue taking only that queue's
+     * mutex, checked against the hints below, and takes the queue-wide
+     * mutex only to collect due tasks, refill or steal.
+     */
+    struct LocalReadyQueue {
+        std::mutex mutex;
+        std::priority_queue<ExTask, std::deque<ExTask>,
+                            CompareByPriority> queue;
+    };
+    std::vector<std::unique_ptr<LocalReadyQueue>> localQueues;
+    std::atomic<size_t> numStolen;
+    // Local queues are per NUMA node rather than per thread
+    const bool nodeQueues;
+
+    // Hints for the local queue fast path, published under the mutex each
+    // time the readyQueue or futureQueue may have changed: the priority of
+    // the readyQueue's top task (or one of the sentinels below), and the
+    // earliest waketime in the futureQueue.
+    static const queue_priority_t noReadyTask =
+            std::numeric_limits<queue_priority_t>::max();
+    static const queue_priority_t deadReadyTask =
+            std::numeric_limits<queue_priority_t>::min();
+    std::atomic<queue_priority_t> readyTopPriority;
+    std::atomic<ProcessClock::rep> futureWaketime;
+
+    // Per Taskable usage, with fair share only (guarded by mutex)
+    std::map<task_gid_t, TaskableUsage> usage;
 };
 
 #endif  // SRC_TASKQUEUE_H_
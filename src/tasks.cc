@@ -30,6 +30,8 @@
 #include <phosphor/phosphor.h>
 
 static const double WORKLOAD_MONITOR_FREQ(5.0);
+// A little under WORKLOAD_MONITOR_FREQ, so monitor drift doesn't skip periods
+static const std::chrono::milliseconds AUTOSCALE_MIN_INTERVAL(4500);
 
 bool FlusherTask::run() {
     TRACE_EVENT0("ep-engine/task", "FlusherTask");
@@ -125,6 +127,10 @@ bool WorkLoadMonitor::run() {
     prevNumMutations = curr_num_mutations;
     prevNumGets = curr_num_gets;
 
+    // The pool is shared, so only the first of the buckets' monitors to get
+    // here in a period resizes the thread groups.
+    ExecutorPool::get()->autoscale(AUTOSCALE_MIN_INTERVAL);
+
     snooze(WORKLOAD_MONITOR_FREQ);
     if (engine->getEpStats().isShutdown) {
         return false;
@@ -76,6 +76,7 @@ TASK(DefragmenterTask, NONIO_TASK_IDX, 7)
 TASK(BackfillVisitorTask, NONIO_TASK_IDX, 8)
 TASK(ConnManager, NONIO_TASK_IDX, 8)
 TASK(WorkLoadMonitor, NONIO_TASK_IDX, 10)
+TASK(WarmupHitRatioWindow, NONIO_TASK_IDX, 10)
 TASK(ResumeCallback, NONIO_TASK_IDX, 316)
 TASK(HashtableResizerTask, NONIO_TASK_IDX, 211)
 TASK(HashtableResizerVisitorTask, NONIO_TASK_IDX, 7)
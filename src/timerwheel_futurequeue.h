@@ -0,0 +1,305 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * TimerWheelFutureQueue is a drop-in alternative to FutureQueue which keeps
+ * tasks in a hierarchical timing wheel instead of a binary heap.
+ *
+ * The wheel has numLevels levels of numSlots slots. A slot at level 0 covers
+ * one tick (1ms), a slot at level 1 covers numSlots ticks and so on. A task
+ * is filed in the lowest level whose slot span contains both the task's tick
+ * and the current cursor; tasks beyond the last level live in an overflow
+ * bucket and tasks earlier than the cursor live in an overdue bucket. As the
+ * cursor advances (when the earliest task is popped) the slot it enters at
+ * each level is re-filed into the level below.
+ *
+ * Each bucket is kept sorted by wakeTime so that top() is exact rather than
+ * rounded to the tick, which the TaskQueue relies on when deciding how long
+ * to sleep. An id index allows snooze/updateWaketime to find a task without
+ * scanning the whole queue, which is what makes those calls expensive on
+ * FutureQueue.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <platform/processclock.h>
+#include <unordered_map>
+#include <vector>
+
+#include "tasks.h"
+
+class TimerWheelFutureQueue {
+public:
+    TimerWheelFutureQueue() : cursor(0), count(0), topBucket(nullptr) {
+    }
+
+    void push(ExTask task) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        insert_UNLOCKED(task);
+    }
+
+    void pop() {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        Bucket* bucket = findTop_UNLOCKED();
+        if (bucket == nullptr) {
+            return;
+        }
+        auto it = bucket->begin();
+        const uint64_t tick = toTick(it->first);
+        unindex_UNLOCKED(it->second->getId(), bucket, it);
+        bucket->erase(it);
+        count--;
+        if (bucket->empty()) {
+            topBucket = nullptr;
+        }
+        if (bucket != &overdue && tick > cursor) {
+            advance_UNLOCKED(tick);
+        }
+    }
+
+    ExTask top() {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        Bucket* bucket = findTop_UNLOCKED();
+        if (bucket == nullptr) {
+            return ExTask();
+        }
+        return bucket->begin()->second;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        return count;
+    }
+
+    bool empty() {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        return count == 0;
+    }
+
+    /*
+     * Update the wakeTime of task and re-file it in the wheel.
+     * @returns true if 'task' is in the TimerWheelFutureQueue.
+     */
+    bool updateWaketime(const ExTask& task, ProcessClock::time_point newTime) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        const size_t removed = remove_UNLOCKED(task);
+        task->updateWaketime(newTime);
+        for (size_t ii = 0; ii < removed; ii++) {
+            insert_UNLOCKED(task);
+        }
+        return removed != 0;
+    }
+
+    /*
+     * snooze the task (by altering its wakeTime) and re-file it in the wheel.
+     * @returns true if 'task' is in the TimerWheelFutureQueue.
+     */
+    bool snooze(const ExTask& task, const double secs) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        const size_t removed = remove_UNLOCKED(task);
+        task->snooze(secs);
+        for (size_t ii = 0; ii < removed; ii++) {
+            insert_UNLOCKED(task);
+        }
+        return removed != 0;
+    }
+
+protected:
+    using Bucket = std::multimap<ProcessClock::time_point, ExTask>;
+
+    static const int slotBits = 6;
+    static const size_t numSlots = size_t(1) << slotBits;
+    static const int numLevels = 4;
+
+    /*
+     * Map a time_point onto an unsigned millisecond tick, preserving order
+     * for time_points before the epoch (e.g. time_point::min()).
+     */
+    static uint64_t toTick(ProcessClock::time_point tp) {
+        using std::chrono::milliseconds;
+        const int64_t ms =
+                std::chrono::duration_cast<milliseconds>(tp.time_since_epoch())
+                        .count();
+        return static_cast<uint64_t>(ms) ^ (uint64_t(1) << 63);
+    }
+
+    static size_t slotIndex(uint64_t tick, int level) {
+        return (tick >> (slotBits * level)) & (numSlots - 1);
+    }
+
+    Bucket& bucketFor(uint64_t tick) {
+        if (tick < cursor) {
+            return overdue;
+        }
+        for (int level = 0; level < numLevels; level++) {
+            const int span = slotBits * (level + 1);
+            if ((tick >> span) == (cursor >> span)) {
+                return wheel[level][slotIndex(tick, level)];
+            }
+        }
+        return overflow;
+    }
+
+    void insert_UNLOCKED(const ExTask& task) {
+        const ProcessClock::time_point waketime = task->getWaketime();
+        const uint64_t tick = toTick(waketime);
+        if (count == 0) {
+            cursor = std::min(tick, toTick(ProcessClock::now()));
+            topBucket = nullptr;
+        }
+        Bucket& bucket = bucketFor(tick);
+        auto it = bucket.emplace(waketime, task);
+        index[task->getId()].emplace_back(&bucket, it);
+        count++;
+        if (topBucket != nullptr && waketime < topBucket->begin()->first) {
+            topBucket = &bucket;
+        }
+    }
+
+    /*
+     * Remove every entry of task from the queue.
+     * @returns the number of entries removed.
+     */
+    size_t remove_UNLOCKED(const ExTask& task) {
+        auto found = index.find(task->getId());
+        if (found == index.end()) {
+            return 0;
+        }
+        const size_t removed = found->second.size();
+        for (auto& location : found->second) {
+            location.first->erase(location.second);
+        }
+        index.erase(found);
+        count -= removed;
+        topBucket = nullptr;
+        return removed;
+    }
+
+    void unindex_UNLOCKED(size_t id, Bucket* bucket, Bucket::iterator it) {
+        auto found = index.find(id);
+        auto& locations = found->second;
+        for (auto loc = locations.begin(); loc != locations.end(); ++loc) {
+            if (loc->first == bucket && loc->second == it) {
+                locations.erase(loc);
+                break;
+            }
+        }
+        if (locations.empty()) {
+            index.erase(found);
+        }
+    }
+
+    /*
+     * Copy the entry at 'it' in 'from' into 'to' and point its index entry
+     * at the copy. The caller is responsible for erasing it from 'from'.
+     */
+    void relocate_UNLOCKED(Bucket::iterator it, Bucket* from, Bucket* to) {
+        auto moved = to->emplace(it->first, it->second);
+        for (auto& location : index[it->second->getId()]) {
+            if (location.first == from && location.second == it) {
+                location.first = to;
+                location.second = moved;
+                break;
+            }
+        }
+    }
+
+    /*
+     * Move every entry of bucket to where bucketFor() now places it.
+     * @returns true if anything was moved.
+     */
+    bool refile_UNLOCKED(Bucket& bucket) {
+        if (bucket.empty()) {
+            return false;
+        }
+        for (auto it = bucket.begin(); it != bucket.end(); ++it) {
+            Bucket& target = bucketFor(toTick(it->first));
+            relocate_UNLOCKED(it, &bucket, &target);
+        }
+        bucket.clear();
+        return true;
+    }
+
+    void advance_UNLOCKED(uint64_t tick) {
+        cursor = tick;
+        bool moved = false;
+
+        // Pull in overflow tasks which now fall within the top level.
+        const int span = slotBits * numLevels;
+        while (!overflow.empty()) {
+            auto it = overflow.begin();
+            const uint64_t next = toTick(it->first);
+            if ((next >> span) != (cursor >> span)) {
+                break;
+            }
+            relocate_UNLOCKED(it, &overflow, &bucketFor(next));
+            overflow.erase(it);
+            moved = true;
+        }
+
+        // Cascade the slot the cursor has entered at each level downwards.
+        for (int level = numLevels - 1; level > 0; level--) {
+            moved |= refile_UNLOCKED(wheel[level][slotIndex(cursor, level)]);
+        }
+
+        if (moved) {
+            topBucket = nullptr;
+        }
+    }
+
+    Bucket* findTop_UNLOCKED() {
+        if (count == 0) {
+            return nullptr;
+        }
+        if (topBucket != nullptr) {
+            return topBucket;
+        }
+        if (!overdue.empty()) {
+            return topBucket = &overdue;
+        }
+        for (int level = 0; level < numLevels; level++) {
+            for (size_t slot = slotIndex(cursor, level); slot < numSlots;
+                 slot++) {
+                if (!wheel[level][slot].empty()) {
+                    return topBucket = &wheel[level][slot];
+                }
+            }
+        }
+        return topBucket = &overflow;
+    }
+
+    std::array<std::array<Bucket, numSlots>, numLevels> wheel;
+    // Tasks due before the cursor, e.g. pushed with an already passed time.
+    Bucket overdue;
+    // Tasks too far ahead of the cursor for the top level.
+    Bucket overflow;
+    // Where each task is filed, a task may be pushed more than once.
+    using Location = std::pair<Bucket*, Bucket::iterator>;
+    std::unordered_map<size_t, std::vector<Location>> index;
+
+    uint64_t cursor;
+    size_t count;
+    // Cached result of findTop_UNLOCKED, nullptr when it must be recomputed.
+    Bucket* topBucket;
+
+    // All access to the wheel must be done with the queueMutex
+    std::mutex queueMutex;
+};
@@ -187,7 +187,9 @@ VBucket::VBucket(id_type i,
       bucketCreation(false),
       bucketDeletion(false),
       newSeqnoCb(std::move(newSeqnoCb)),
-      manifest(collectionsManifest) {
+      manifest(collectionsManifest),
+      compressValues(config.getCompressionMode() == "active"),
+      minCompressionRatio(config.getMinCompressionRatio()) {
     if (config.getConflictResolutionType().compare("lww") == 0) {
         conflictResolver.reset(new LastWriteWinsResolution());
     } else {
@@ -276,6 +278,20 @@ void VBucket::fireAllOps(EventuallyPersistentEngine &engine) {
     }
 }
 
+void VBucket::maybeCompressValue(Item& itm) {
+    // The datatype is held in the extended meta, so without it the value
+    // can't be marked as compressed.
+    if (!compressValues || itm.getNBytes() == 0 || itm.getExtMetaLen() == 0) {
+        return;
+    }
+    if (!itm.compressValue(minCompressionRatio)) {
+        LOG(EXTENSION_LOG_WARNING,
+            "VBucket::maybeCompressValue: vbucket:%" PRIu16
+            " Failed to snappy compress a value, keeping it uncompressed",
+            id);
+    }
+}
+
 void VBucket::setState(vbucket_state_t to) {
     vbucket_state_t oldstate;
     {
@@ -438,7 +454,8 @@ bool VBucket::isResidentRatioUnderThreshold(float threshold) {
     }
 }
 
-void VBucket::createFilter(size_t key_count, double probability) {
+void VBucket::createFilter(size_t key_count, double probability,
+                           BloomFilterLayout layout) {
     // Create the actual bloom filter upon vbucket creation during
     // scenarios:
     //      - Bucket creation
@@ -446,20 +463,21 @@ void VBucket::createFilter(size_t key_count, double probability) {
     LockHolder lh(bfMutex);
     if (bFilter == nullptr && tempFilter == nullptr) {
         bFilter = std::make_unique<BloomFilter>(key_count, probability,
-                                        BFILTER_ENABLED);
+                                        BFILTER_ENABLED, layout);
     } else {
         LOG(EXTENSION_LOG_WARNING, "(vb %" PRIu16 ") Bloom filter / Temp filter"
             " already exist!", id);
     }
 }
 
-void VBucket::initTempFilter(size_t key_count, double probability) {
+void VBucket::initTempFilter(size_t key_count, double probability,
+                             BloomFilterLayout layout) {
     // Create a temp bloom filter with status as COMPACTING,
     // if the main filter is found to exist, set its state to
     // COMPACTING as well.
     LockHolder lh(bfMutex);
     tempFilter = std::make_unique<BloomFilter>(key_count, probability,
-                                     BFILTER_COMPACTING);
+                                     BFILTER_COMPACTING, layout);
     if (bFilter) {
         bFilter->setStatus(BFILTER_COMPACTING);
     }
@@ -581,6 +599,24 @@ size_t VBucket::getNumOfKeysInFilter() {
     }
 }
 
+std::string VBucket::serialiseFilter() {
+    LockHolder lh(bfMutex);
+    if (bFilter && bFilter->getStatus() == BFILTER_ENABLED) {
+        return bFilter->serialise();
+    }
+    return {};
+}
+
+void VBucket::setFilter(std::unique_ptr<BloomFilter> filter) {
+    LockHolder lh(bfMutex);
+    if (bFilter == nullptr && tempFilter == nullptr) {
+        bFilter = std::move(filter);
+    } else {
+        LOG(EXTENSION_LOG_WARNING, "(vb %" PRIu16 ") Bloom filter / Temp filter"
+            " already exist, not loading persisted filter", id);
+    }
+}
+
 VBNotifyCtx VBucket::queueDirty(
         StoredValue& v,
         const GenerateBySeqno generateBySeqno,
@@ -681,6 +717,7 @@ ENGINE_ERROR_CODE VBucket::set(Item& itm,
                                const void* cookie,
                                EventuallyPersistentEngine& engine,
                                const int bgFetchDelay) {
+    maybeCompressValue(itm);
     bool cas_op = (itm.getCas() != 0);
     auto hbl = ht.getLockedBucket(itm.getKey());
     StoredValue* v = ht.unlocked_find(itm.getKey(),
@@ -770,6 +807,7 @@ ENGINE_ERROR_CODE VBucket::replace(Item& itm,
                                    const void* cookie,
                                    EventuallyPersistentEngine& engine,
                                    const int bgFetchDelay) {
+    maybeCompressValue(itm);
     auto hbl = ht.getLockedBucket(itm.getKey());
     StoredValue* v = ht.unlocked_find(itm.getKey(),
                                       hbl.getBucketNum(),
@@ -920,6 +958,7 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(Item& itm,
                                        const GenerateBySeqno genBySeqno,
                                        const GenerateCas genCas,
                                        const bool isReplication) {
+    maybeCompressValue(itm);
     auto hbl = ht.getLockedBucket(itm.getKey());
     StoredValue* v = ht.unlocked_find(itm.getKey(),
                                       hbl.getBucketNum(),
@@ -1374,6 +1413,7 @@ ENGINE_ERROR_CODE VBucket::add(Item& itm,
                                const void* cookie,
                                EventuallyPersistentEngine& engine,
                                const int bgFetchDelay) {
+    maybeCompressValue(itm);
     auto hbl = ht.getLockedBucket(itm.getKey());
     StoredValue* v = ht.unlocked_find(itm.getKey(),
                                       hbl.getBucketNum(),
@@ -1493,6 +1533,10 @@ MutationStatus VBucket::insertFromWarmup(Item& itm,
         return MutationStatus::NoMem;
     }
 
+    if (!keyMetaDataOnly) {
+        maybeCompressValue(itm);
+    }
+
     auto hbl = ht.getLockedBucket(itm.getKey());
     StoredValue* v = ht.unlocked_find(itm.getKey(),
                                       hbl.getBucketNum(),
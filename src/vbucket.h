@@ -495,8 +495,10 @@ public:
     /**
      * BloomFilter operations for vbucket
      */
-    void createFilter(size_t key_count, double probability);
-    void initTempFilter(size_t key_count, double probability);
+    void createFilter(size_t key_count, double probability,
+                      BloomFilterLayout layout = BloomFilterLayout::Standard);
+    void initTempFilter(size_t key_count, double probability,
+                        BloomFilterLayout layout = BloomFilterLayout::Standard);
     void addToFilter(const DocKey& key);
     virtual bool maybeKeyExistsInFilter(const DocKey& key);
     bool isTempFilterAvailable();
@@ -508,6 +510,19 @@ public:
     size_t getFilterSize();
     size_t getNumOfKeysInFilter();
 
+    /**
+     * Serialise the main bloom filter so it can be persisted.
+     * @return the serialised filter, or an empty string if there is no
+     *         enabled filter to save.
+     */
+    std::string serialiseFilter();
+
+    /**
+     * Install a previously persisted filter as the main bloom filter
+     * (used at warmup). Ignored if a filter already exists.
+     */
+    void setFilter(std::unique_ptr<BloomFilter> filter);
+
     uint64_t nextHLCCas() {
         return hlc.nextHLC();
     }
@@ -939,9 +954,8 @@ public:
      * Insert an item into the VBucket during warmup. If we're trying to insert
      * a partial item we mark it as nonResident
      *
-     * @param itm Item to insert. itm is not modified. But cannot be passed as
-     *            const because it is passed to functions that can generally
-     *            modify the itm but do not modify it due to the flags passed.
+     * @param itm Item to insert. Its value may be replaced by a compressed
+     *            form (see compression_mode) but is otherwise not modified.
      * @param eject true if we should eject the value immediately
      * @param keyMetaDataOnly is this just the key and meta-data or a complete
      *                        item
@@ -1358,6 +1372,14 @@ protected:
     /* size of list hpVBReqs (to avoid MB-9434) */
     Couchbase::RelaxedAtomic<size_t> numHpVBReqs;
 
+    /**
+     * In compression_mode active, replace itm's value with its snappy
+     * compressed form if that meets min_compression_ratio, so that the
+     * value is held (and queued and streamed) compressed.
+     * Done before taking the HT bucket lock.
+     */
+    void maybeCompressValue(Item& itm);
+
 private:
     void fireAllOps(EventuallyPersistentEngine& engine, ENGINE_ERROR_CODE code);
 
@@ -1565,6 +1587,11 @@ private:
     /// The VBucket collection state
     Collections::VB::Manifest manifest;
 
+    // Whether values are held compressed (compression_mode active), and the
+    // ratio they must compress to for it
+    const bool compressValues;
+    const float minCompressionRatio;
+
     static std::atomic<size_t> chkFlushTimeout;
 
     friend class VBucketTest;
@@ -22,6 +22,7 @@
 #include "ep_engine.h"
 #include "failover-table.h"
 #include "mutation_log.h"
+#include "sorted_access_log.h"
 #define STATWRITER_NAMESPACE warmup
 #include "statwriter.h"
 #undef STATWRITER_NAMESPACE
@@ -33,6 +34,8 @@
 #include <string>
 #include <utility>
 #include <array>
+#include <functional>
+#include <set>
 #include <random>
 
 struct WarmupCookie {
@@ -266,6 +269,33 @@ private:
     const std::string _description;
 };
 
+/*
+ * Sleeps through the window after warmup over which the hit ratio is
+ * measured, then closes it.
+ */
+class WarmupHitRatioWindow : public GlobalTask {
+public:
+    WarmupHitRatioWindow(KVBucket& st, Warmup* w, size_t windowMinutes)
+        : GlobalTask(&st.getEPEngine(),
+                     TaskId::WarmupHitRatioWindow,
+                     windowMinutes * 60,
+                     false),
+          _warmup(w) {
+    }
+
+    cb::const_char_buffer getDescription() {
+        return "Warmup - hit ratio window";
+    }
+
+    bool run() {
+        _warmup->closeHitRatioWindow();
+        return false;
+    }
+
+private:
+    Warmup* _warmup;
+};
+
 class WarmupCompletion : public GlobalTask {
 public:
     WarmupCompletion(KVBucket& st, Warmup* w) :
@@ -544,6 +574,9 @@ void LoadStorageKVPairCallback::callback(GetValue &val) {
         } while (!succeeded && retry-- > 0);
 
         val.setValue(NULL);
+        if (succeeded) {
+            epstore.getWarmup()->recordLoaded(warmupState, i->size());
+        }
 
         if (maybeEnableTraffic) {
             stopLoading = epstore.maybeEnableTraffic();
@@ -672,6 +705,16 @@ Warmup::Warmup(KVBucket& st, Configuration& config_)
       threadtask_count(0),
       shardKeyDumpStatus(store.vbMap.getNumShards()),
       shardVbIds(store.vbMap.getNumShards()),
+      tasksPerShard(config.getWarmupTasksPerShard()),
+      shardNextVb(store.vbMap.getNumShards()),
+      shardScansStopped(store.vbMap.getNumShards()),
+      hitRatioWindowStarted(false),
+      hitRatioWindowClosed(false),
+      hitRatioStartGets(0),
+      hitRatioStartBgFetches(0),
+      hitRatioGets(0),
+      hitRatioBgFetches(0),
+      hitRatioWindowTask(0),
       estimateTime(0),
       estimatedItemCount(std::numeric_limits<size_t>::max()),
       cleanShutdown(true),
@@ -709,6 +752,7 @@ void Warmup::start(void)
 
 void Warmup::stop(void)
 {
+    cancelHitRatioWindow();
     {
         LockHolder lh(taskSetMutex);
         if(taskSet.empty()) {
@@ -795,6 +839,10 @@ void Warmup::createVBuckets(uint16_t shardId) {
                                       ->getCollectionsManifest(vbid)
                             : ""/*no collections manifest*/);
 
+            if (config.isBfilterEnabled() && store.isBfilterPersistEnabled()) {
+                loadBloomFilter(shardId, *vb);
+            }
+
             if(vbs.state == vbucket_state_active && !cleanShutdown) {
                 if (static_cast<uint64_t>(vbs.highSeqno) == vbs.lastSnapEnd) {
                     vb->failovers->createEntry(vbs.lastSnapEnd);
@@ -822,6 +870,30 @@ void Warmup::createVBuckets(uint16_t shardId) {
     }
 }
 
+void Warmup::loadBloomFilter(uint16_t shardId, VBucket& vb) {
+    const std::string data =
+            store.getROUnderlyingByShard(shardId)->getBloomFilter(vb.getId());
+    if (data.empty()) {
+        return;
+    }
+
+    try {
+        auto filter = BloomFilter::deserialise(data);
+        LOG(EXTENSION_LOG_INFO,
+            "Warmup::loadBloomFilter: Loaded bloom filter for vb:%" PRIu16
+            " (%" PRIu64 " keys, %" PRIu64 " bits)",
+            vb.getId(),
+            uint64_t(filter->getNumOfKeysInFilter()),
+            uint64_t(filter->getFilterSize()));
+        vb.setFilter(std::move(filter));
+    } catch (const std::invalid_argument& e) {
+        LOG(EXTENSION_LOG_WARNING,
+            "Warmup::loadBloomFilter: Ignoring invalid bloom filter for "
+            "vb:%" PRIu16 ": %s",
+            vb.getId(), e.what());
+    }
+}
+
 
 void Warmup::scheduleEstimateDatabaseItemCount()
 {
@@ -864,10 +936,13 @@ void Warmup::estimateDatabaseItemCount(uint16_t shardId)
 
 void Warmup::scheduleKeyDump()
 {
-    threadtask_count = 0;
+    resetShardScans();
+    keyDumpThroughput.start = gethrtime();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = make_STRCPtr<WarmupKeyDump>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t t = 0; t < tasksPerShard; t++) {
+            ExTask task = make_STRCPtr<WarmupKeyDump>(store, i, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 
 }
@@ -879,7 +954,8 @@ void Warmup::keyDumpforShard(uint16_t shardId)
             store, false, state.getState());
     auto cl = std::make_shared<NoLookupCallback>();
 
-    for (const auto vbid : shardVbIds[shardId]) {
+    uint16_t vbid;
+    while (nextVBucketToScan(shardId, vbid)) {
         ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
                                                     DocumentFilter::NO_DELETES,
                                                     ValueFilter::KEYS_ONLY);
@@ -888,6 +964,7 @@ void Warmup::keyDumpforShard(uint16_t shardId)
             kvstore->destroyScanContext(ctx);
             if (errorCode == scan_again) { // ENGINE_ENOMEM
                 // skip loading remaining VBuckets as memory limit was reached
+                shardScansStopped[shardId] = true;
                 break;
             }
         }
@@ -895,7 +972,8 @@ void Warmup::keyDumpforShard(uint16_t shardId)
 
     shardKeyDumpStatus[shardId] = true;
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count == getNumScanTasks()) {
+        keyDumpThroughput.end = gethrtime();
         bool success = false;
         for (size_t i = 0; i < store.vbMap.getNumShards(); i++) {
             if (shardKeyDumpStatus[i]) {
@@ -938,7 +1016,8 @@ void Warmup::checkForAccessLog()
         std::string old = store.accessLog[i].getLogFile();
         old.append(".old");
         if (access(curr.c_str(), F_OK) == 0 ||
-            access(old.c_str(), F_OK) == 0) {
+            access(old.c_str(), F_OK) == 0 ||
+            SortedAccessLogSet::exists(curr)) {
             accesslogs++;
         }
     }
@@ -957,6 +1036,7 @@ void Warmup::checkForAccessLog()
 void Warmup::scheduleLoadingAccessLog()
 {
     threadtask_count = 0;
+    accessLogThroughput.start = gethrtime();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
         ExTask task = make_STRCPtr<WarmupLoadAccessLog>(store, i, this);
         ExecutorPool::get()->schedule(task);
@@ -968,7 +1048,10 @@ void Warmup::loadingAccessLog(uint16_t shardId)
     LoadStorageKVPairCallback load_cb(store, true, state.getState());
     bool success = false;
     hrtime_t stTime = gethrtime();
-    if (store.accessLog[shardId].exists()) {
+    const std::string& logFile = store.accessLog[shardId].getLogFile();
+    if (SortedAccessLogSet::exists(logFile)) {
+        success = loadSortedAccessLog(shardId, logFile);
+    } else if (store.accessLog[shardId].exists()) {
         try {
             store.accessLog[shardId].open();
             if (doWarmup(store.accessLog[shardId],
@@ -985,10 +1068,12 @@ void Warmup::loadingAccessLog(uint16_t shardId)
 
     if (!success) {
         // Do we have the previous file?
-        std::string nm = store.accessLog[shardId].getLogFile();
+        std::string nm = logFile;
         nm.append(".old");
         MutationLog old(nm);
-        if (old.exists()) {
+        if (SortedAccessLogSet::exists(nm)) {
+            success = loadSortedAccessLog(shardId, nm);
+        } else if (old.exists()) {
             try {
                 old.open();
                 if (doWarmup(old, shardVbStates[shardId], load_cb) !=
@@ -1015,6 +1100,7 @@ void Warmup::loadingAccessLog(uint16_t shardId)
     }
 
     if (++threadtask_count == store.vbMap.getNumShards()) {
+        accessLogThroughput.end = gethrtime();
         if (!store.maybeEnableTraffic()) {
             transition(WarmupState::LoadingData);
         } else {
@@ -1024,6 +1110,121 @@ void Warmup::loadingAccessLog(uint16_t shardId)
     }
 }
 
+bool Warmup::loadSortedAccessLog(uint16_t shardId, const std::string& path) {
+    // Along with any segments written since by incremental runs of the
+    // access scanner
+    SortedAccessLogSet alog(path);
+    try {
+        alog.open();
+    } catch (SortedAccessLog::ReadException& e) {
+        corruptAccessLog = true;
+        LOG(EXTENSION_LOG_WARNING, "Error reading access log '%s': %s",
+            path.c_str(), e.what());
+        return false;
+    }
+
+    KVStore* kvstore = store.getROUnderlyingByShard(shardId);
+    auto cb = std::make_shared<LoadStorageKVPairCallback>(
+            store, true, state.getState());
+    size_t total = 0;
+    size_t matched = 0;
+    std::set<uint8_t, std::greater<uint8_t>> scores;
+    for (const auto& vbState : shardVbStates[shardId]) {
+        const auto entries = alog.getVBucket(vbState.first);
+        total += entries.size();
+        for (const auto& entry : entries) {
+            scores.insert(entry.score);
+        }
+    }
+    setEstimatedWarmupCount(total);
+
+    // Load the hottest keys of the whole shard first, so that if warmup's
+    // thresholds are reached before the end it is the coldest which are
+    // left out. Each score gets one scan per vBucket, from its first logged
+    // seqno on, which loads the documents logged with that score as it
+    // comes to them. There are only a few scores (NRU levels), so this is a
+    // few scans of each vBucket.
+    bool stopped = false;
+    for (auto it = scores.begin(); it != scores.end() && !stopped; ++it) {
+        for (const auto& vbState : shardVbStates[shardId]) {
+            auto lookup = std::make_shared<SortedAccessLogLookup>(
+                    alog.getVBucket(vbState.first), *it);
+            if (!lookup->hasEntries()) {
+                continue;
+            }
+            ScanContext* ctx = kvstore->initScanContext(
+                    cb,
+                    lookup,
+                    vbState.first,
+                    lookup->getStartSeqno(),
+                    DocumentFilter::NO_DELETES,
+                    ValueFilter::VALUES_DECOMPRESSED);
+            if (!ctx) {
+                continue;
+            }
+            const scan_error_t errorCode = kvstore->scan(ctx);
+            kvstore->destroyScanContext(ctx);
+            matched += lookup->getNumMatched();
+            if (errorCode == scan_again && !lookup->isFinished()) {
+                // Stopped by the load callback - warmup is complete
+                stopped = true;
+                break;
+            }
+            // Documents updated since they were logged have moved on from
+            // their logged seqnos - load them by key instead, before any
+            // colder ones.
+            std::set<StoredDocKey> unmatched;
+            try {
+                unmatched = lookup->getUnmatchedKeys();
+            } catch (SortedAccessLog::ReadException& e) {
+                corruptAccessLog = true;
+                LOG(EXTENSION_LOG_WARNING,
+                    "Error reading access log '%s': %s",
+                    path.c_str(), e.what());
+            }
+            if (!loadKeys(vbState.first, unmatched, *cb)) {
+                stopped = true;
+                break;
+            }
+        }
+    }
+
+    LOG(EXTENSION_LOG_DEBUG,
+        "Loaded %" PRIu64 " of %" PRIu64 " keys from access log '%s'",
+        uint64_t(matched), uint64_t(total), path.c_str());
+    return true;
+}
+
+bool Warmup::loadKeys(uint16_t vbid,
+                      const std::set<StoredDocKey>& keys,
+                      Callback<GetValue>& cb) {
+    WarmupCookie cookie(&store, cb);
+    const size_t batchSize = config.getWarmupBatchSize();
+    std::set<StoredDocKey> batch;
+    for (auto it = keys.begin(); it != keys.end();) {
+        batch.clear();
+        for (; it != keys.end() && batch.size() < batchSize; ++it) {
+            batch.insert(*it);
+        }
+        if (store.multiBGFetchEnabled()) {
+            if (!batchWarmupCallback(vbid, batch, &cookie)) {
+                return false;
+            }
+        } else {
+            for (const auto& key : batch) {
+                if (!warmupCallback(&cookie, vbid, key)) {
+                    return false;
+                }
+            }
+        }
+        if (cb.getStatus() != ENGINE_SUCCESS) {
+            // The load callback wants no more
+            return false;
+        }
+    }
+    return true;
+}
+
 size_t Warmup::doWarmup(MutationLog &lf, const std::map<uint16_t,
                         vbucket_state> &vbmap, Callback<GetValue> &cb)
 {
@@ -1078,10 +1279,13 @@ void Warmup::scheduleLoadingKVPairs()
     // keys have been warmed up at this point.
     setEstimatedWarmupCount(estimatedItemCount);
 
-    threadtask_count = 0;
+    resetShardScans();
+    kvPairsThroughput.start = gethrtime();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = make_STRCPtr<WarmupLoadingKVPairs>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t t = 0; t < tasksPerShard; t++) {
+            ExTask task = make_STRCPtr<WarmupLoadingKVPairs>(store, i, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 
 }
@@ -1101,7 +1305,8 @@ void Warmup::loadKVPairsforShard(uint16_t shardId)
     auto cl =
             std::make_shared<LoadValueCallback>(store.vbMap, state.getState());
 
-    for (const auto vbid : shardVbIds[shardId]) {
+    uint16_t vbid;
+    while (nextVBucketToScan(shardId, vbid)) {
         ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
                                                     DocumentFilter::NO_DELETES,
                                                     ValueFilter::VALUES_DECOMPRESSED);
@@ -1110,11 +1315,13 @@ void Warmup::loadKVPairsforShard(uint16_t shardId)
             kvstore->destroyScanContext(ctx);
             if (errorCode == scan_again) { // ENGINE_ENOMEM
                 // skip loading remaining VBuckets as memory limit was reached
+                shardScansStopped[shardId] = true;
                 break;
             }
         }
     }
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count == getNumScanTasks()) {
+        kvPairsThroughput.end = gethrtime();
         transition(WarmupState::Done);
     }
 }
@@ -1124,10 +1331,13 @@ void Warmup::scheduleLoadingData()
     size_t estimatedCount = store.getEPEngine().getEpStats().warmedUpKeys;
     setEstimatedWarmupCount(estimatedCount);
 
-    threadtask_count = 0;
+    resetShardScans();
+    dataThroughput.start = gethrtime();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = make_STRCPtr<WarmupLoadingData>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t t = 0; t < tasksPerShard; t++) {
+            ExTask task = make_STRCPtr<WarmupLoadingData>(store, i, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 }
 
@@ -1141,7 +1351,8 @@ void Warmup::loadDataforShard(uint16_t shardId)
     auto cl =
             std::make_shared<LoadValueCallback>(store.vbMap, state.getState());
 
-    for (const auto vbid : shardVbIds[shardId]) {
+    uint16_t vbid;
+    while (nextVBucketToScan(shardId, vbid)) {
         ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
                                                     DocumentFilter::NO_DELETES,
                                                     ValueFilter::VALUES_DECOMPRESSED);
@@ -1150,12 +1361,14 @@ void Warmup::loadDataforShard(uint16_t shardId)
             kvstore->destroyScanContext(ctx);
             if (errorCode == scan_again) { // ENGINE_ENOMEM
                 // skip loading remaining VBuckets as memory limit was reached
+                shardScansStopped[shardId] = true;
                 break;
             }
         }
     }
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count == getNumScanTasks()) {
+        dataThroughput.end = gethrtime();
         transition(WarmupState::Done);
     }
 }
@@ -1170,11 +1383,97 @@ void Warmup::done()
     if (setComplete()) {
         setWarmupTime();
         store.warmupCompleted();
+        startHitRatioWindow();
         LOG(EXTENSION_LOG_NOTICE, "warmup completed in %s",
                                    hrtime2text(warmup.load()).c_str());
     }
 }
 
+void Warmup::recordLoaded(int warmupState, size_t bytes) {
+    auto* phase = getPhaseThroughput(warmupState);
+    if (phase) {
+        ++phase->items;
+        phase->bytes += bytes;
+    }
+}
+
+// How much a counter has grown since start, allowing for the stats having
+// been reset in between
+static size_t countSince(size_t now, size_t start) {
+    return now >= start ? now - start : now;
+}
+
+void Warmup::startHitRatioWindow() {
+    const size_t window = config.getWarmupHitRatioWindow();
+    EPStats& stats = store.getEPEngine().getEpStats();
+    if (window == 0 || stats.isShutdown) {
+        return;
+    }
+    hitRatioStartGets = stats.numOpsGet;
+    hitRatioStartBgFetches = stats.bg_fetched;
+    hitRatioWindowStarted = true;
+
+    ExTask task = make_STRCPtr<WarmupHitRatioWindow>(store, this, window);
+    hitRatioWindowTask = ExecutorPool::get()->schedule(task);
+}
+
+void Warmup::cancelHitRatioWindow() {
+    const size_t taskId = hitRatioWindowTask.exchange(0);
+    if (taskId != 0) {
+        ExecutorPool::get()->cancel(taskId);
+    }
+}
+
+void Warmup::closeHitRatioWindow() {
+    EPStats& stats = store.getEPEngine().getEpStats();
+    hitRatioGets = countSince(stats.numOpsGet, hitRatioStartGets);
+    hitRatioBgFetches = countSince(stats.bg_fetched, hitRatioStartBgFetches);
+    hitRatioWindowClosed = true;
+    LOG(EXTENSION_LOG_NOTICE,
+        "Hit ratio in the %" PRIu64 " minutes after warmup: %" PRIu64
+        " gets, %" PRIu64 " background fetches",
+        uint64_t(config.getWarmupHitRatioWindow()),
+        uint64_t(hitRatioGets.load()),
+        uint64_t(hitRatioBgFetches.load()));
+}
+
+void Warmup::resetShardScans() {
+    threadtask_count = 0;
+    for (auto& next : shardNextVb) {
+        next = 0;
+    }
+    for (auto& stopped : shardScansStopped) {
+        stopped = false;
+    }
+}
+
+bool Warmup::nextVBucketToScan(uint16_t shardId, uint16_t& vbid) {
+    if (shardScansStopped[shardId]) {
+        return false;
+    }
+    const size_t index = shardNextVb[shardId]++;
+    if (index >= shardVbIds[shardId].size()) {
+        return false;
+    }
+    vbid = shardVbIds[shardId][index];
+    return true;
+}
+
+Warmup::PhaseThroughput* Warmup::getPhaseThroughput(int warmupState) {
+    switch (warmupState) {
+    case WarmupState::KeyDump:
+        return &keyDumpThroughput;
+    case WarmupState::LoadingAccessLog:
+        return &accessLogThroughput;
+    case WarmupState::LoadingKVPairs:
+        return &kvPairsThroughput;
+    case WarmupState::LoadingData:
+        return &dataThroughput;
+    default:
+        return nullptr;
+    }
+}
+
 void Warmup::step() {
     switch (state.getState()) {
         case WarmupState::Initialize:
@@ -1284,6 +1583,64 @@ void Warmup::addStats(ADD_STAT add_stat, const void *c) const
     } else {
         addStat("estimated_value_count", warmupCount, add_stat, c);
     }
+
+    addPhaseStats("key_dump", keyDumpThroughput, add_stat, c);
+    addPhaseStats("access_log", accessLogThroughput, add_stat, c);
+    addPhaseStats("kv_pairs", kvPairsThroughput, add_stat, c);
+    addPhaseStats("data", dataThroughput, add_stat, c);
+    addHitRatioStats(add_stat, c);
+}
+
+void Warmup::addHitRatioStats(ADD_STAT add_stat, const void* c) const {
+    if (!hitRatioWindowStarted) {
+        return;
+    }
+    size_t gets;
+    size_t bgFetches;
+    if (hitRatioWindowClosed) {
+        addStat("hit_ratio_window", "complete", add_stat, c);
+        gets = hitRatioGets;
+        bgFetches = hitRatioBgFetches;
+    } else {
+        addStat("hit_ratio_window", "running", add_stat, c);
+        const EPStats& stats = store.getEPEngine().getEpStats();
+        gets = countSince(stats.numOpsGet, hitRatioStartGets);
+        bgFetches = countSince(stats.bg_fetched, hitRatioStartBgFetches);
+    }
+    addStat("hit_ratio_gets", gets, add_stat, c);
+    addStat("hit_ratio_bg_fetches", bgFetches, add_stat, c);
+    // Each background fetch is for a get which missed
+    const size_t hits = gets > bgFetches ? gets - bgFetches : 0;
+    addStat("hit_ratio", gets ? hits * 100.0 / gets : 100.0, add_stat, c);
+}
+
+void Warmup::addPhaseStats(const char* name,
+                           const PhaseThroughput& phase,
+                           ADD_STAT add_stat,
+                           const void* c) const {
+    const hrtime_t start = phase.start.load();
+    if (start == 0) {
+        // The phase hasn't run
+        return;
+    }
+    hrtime_t end = phase.end.load();
+    if (end == 0) {
+        end = gethrtime();
+    }
+    const double secs = double(end - start) / 1000000000;
+    const size_t items = phase.items.load();
+    const size_t bytes = phase.bytes.load();
+
+    const std::string prefix(name);
+    addStat((prefix + "_items").c_str(), items, add_stat, c);
+    addStat((prefix + "_items_per_sec").c_str(),
+            secs > 0 ? uint64_t(items / secs) : 0,
+            add_stat,
+            c);
+    addStat((prefix + "_mb_per_sec").c_str(),
+            secs > 0 ? bytes / secs / (1024 * 1024) : 0,
+            add_stat,
+            c);
 }
 
 /* In the case of CouchKVStore, all vbucket states of all the shards are stored
@@ -20,11 +20,13 @@
 #include "config.h"
 
 #include "callbacks.h"
+#include "storeddockey.h"
 #include "utility.h"
 
 #include <atomic>
 #include <map>
 #include <ostream>
+#include <set>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -35,6 +37,7 @@ class Configuration;
 class EPStats;
 class KVBucket;
 class MutationLog;
+class VBucket;
 class VBucketMap;
 
 struct vbucket_state;
@@ -140,6 +143,18 @@ public:
     size_t doWarmup(MutationLog &lf, const std::map<uint16_t,
                     vbucket_state> &vbmap, Callback<GetValue> &cb);
 
+    /* Load the documents listed by a sorted access log and its segments
+     * (see sorted_access_log.h) for the shard's vBuckets, hottest score
+     * first across the shard, with a scan of each vBucket per score. Returns
+     * false if the log couldn't be read. */
+    bool loadSortedAccessLog(uint16_t shardId, const std::string& path);
+
+    /* Load the given documents of a vBucket by key, a warmup batch at a
+     * time. Returns false if loading stopped as warmup is complete. */
+    bool loadKeys(uint16_t vbid,
+                  const std::set<StoredDocKey>& keys,
+                  Callback<GetValue>& cb);
+
     bool isComplete() { return warmupComplete.load(); }
 
     bool setComplete() {
@@ -164,7 +179,24 @@ public:
     void loadDataforShard(uint16_t shardId);
     void done();
 
+    /* Account for an item of the given size loaded in the given state */
+    void recordLoaded(int warmupState, size_t bytes);
+
+    /* End the window after warmup over which the hit ratio is measured */
+    void closeHitRatioWindow();
+
+    /* Cancel the task which ends the hit ratio window, if it is pending */
+    void cancelHitRatioWindow();
+
 private:
+    // Items and bytes loaded by one of the loading phases, and when it ran
+    struct PhaseThroughput {
+        std::atomic<size_t> items{0};
+        std::atomic<size_t> bytes{0};
+        std::atomic<hrtime_t> start{0};
+        std::atomic<hrtime_t> end{0};
+    };
+
     template <typename T>
     void addStat(const char *nm, const T &val, ADD_STAT add_stat, const void *c) const;
 
@@ -175,6 +207,34 @@ private:
 
     void populateShardVbStates();
 
+    /* Prepare for the tasks of a phase which scans every vBucket of each
+     * shard, tasksPerShard of them per shard */
+    void resetShardScans();
+
+    /* Claim the next of the shard's vBuckets for the calling task to scan.
+     * Returns false once they have all been claimed, or a scan stopped
+     * early. */
+    bool nextVBucketToScan(uint16_t shardId, uint16_t& vbid);
+
+    size_t getNumScanTasks() const {
+        return shardVbIds.size() * tasksPerShard;
+    }
+
+    PhaseThroughput* getPhaseThroughput(int warmupState);
+
+    void addPhaseStats(const char* name,
+                       const PhaseThroughput& phase,
+                       ADD_STAT add_stat,
+                       const void* c) const;
+
+    /* Start measuring the hit ratio after warmup, if it is to be measured */
+    void startHitRatioWindow();
+
+    void addHitRatioStats(ADD_STAT add_stat, const void* c) const;
+
+    /* Install the vbucket's persisted bloom filter, if there is a valid one */
+    void loadBloomFilter(uint16_t shardId, VBucket& vb);
+
     void scheduleInitialize();
     void scheduleCreateVBuckets();
     void scheduleEstimateDatabaseItemCount();
@@ -208,6 +268,33 @@ private:
     /// contains all vBucket IDs which are present for the given shard.
     std::vector<std::vector<uint16_t>> shardVbIds;
 
+    /// Number of tasks scanning each shard's vBuckets in the key dump and
+    /// loading phases, and the index (into shardVbIds) of the next vBucket
+    /// of each shard for them to scan.
+    size_t tasksPerShard;
+    std::vector<std::atomic<size_t>> shardNextVb;
+    /// Set for a shard when one of its scans stops early (memory or traffic
+    /// thresholds were hit), so that the shard's other tasks in the phase
+    /// don't start any more. Other shards carry on, as with one task each.
+    std::vector<std::atomic<bool>> shardScansStopped;
+
+    PhaseThroughput keyDumpThroughput;
+    PhaseThroughput accessLogThroughput;
+    PhaseThroughput kvPairsThroughput;
+    PhaseThroughput dataThroughput;
+
+    /// Gets and background fetches when warmup completed, and (once the
+    /// window after it has closed) the numbers of each within the window.
+    std::atomic<bool> hitRatioWindowStarted;
+    std::atomic<bool> hitRatioWindowClosed;
+    std::atomic<size_t> hitRatioStartGets;
+    std::atomic<size_t> hitRatioStartBgFetches;
+    std::atomic<size_t> hitRatioGets;
+    std::atomic<size_t> hitRatioBgFetches;
+    /// The task which closes the window (it holds a pointer to this
+    /// Warmup), 0 if none is scheduled.
+    std::atomic<size_t> hitRatioWindowTask;
+
     std::atomic<hrtime_t> estimateTime;
     std::atomic<size_t> estimatedItemCount;
     bool cleanShutdown;
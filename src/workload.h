@@ -42,7 +42,8 @@ enum workload_pattern_t {
 class WorkLoadPolicy {
 public:
     WorkLoadPolicy(int m, int s)
-        : maxNumWorkers(m), maxNumShards(s), workloadPattern(READ_HEAVY) { }
+        : maxNumWorkers(m), maxNumShards(s), workloadPattern(READ_HEAVY),
+          cpuQuota(10000), ioQuota(0), diskIOBytes(0) { }
 
     size_t getNumShards(void) {
         return maxNumShards;
@@ -78,11 +79,49 @@ public:
         workloadPattern.store(pattern);
     }
 
+    /**
+     * Shared executor thread time (in microseconds) the bucket is given per
+     * fair share round.
+     */
+    size_t getCpuQuota(void) {
+        return cpuQuota.load();
+    }
+
+    void setCpuQuota(size_t quota) {
+        cpuQuota.store(quota);
+    }
+
+    /**
+     * Disk bytes the bucket is given per fair share round, 0 for no limit.
+     */
+    size_t getIOQuota(void) {
+        return ioQuota.load();
+    }
+
+    void setIOQuota(size_t quota) {
+        ioQuota.store(quota);
+    }
+
+    /**
+     * Counter of all bytes the bucket's KVStores read from and write to
+     * disk, credited by their file ops.
+     */
+    std::atomic<size_t>& getDiskIOBytesCounter(void) {
+        return diskIOBytes;
+    }
+
+    size_t getDiskIOBytes(void) {
+        return diskIOBytes.load(std::memory_order_relaxed);
+    }
+
 private:
 
     int maxNumWorkers;
     int maxNumShards;
     std::atomic<workload_pattern_t> workloadPattern;
+    std::atomic<size_t> cpuQuota;
+    std::atomic<size_t> ioQuota;
+    std::atomic<size_t> diskIOBytes;
 };
 
 #endif  // SRC_WORKLOAD_H_
@@ -153,6 +153,8 @@ std::unordered_map<std::string, StatProperties> stat_tests = {
         make_stat_pair("dispatcher", {"dispatcher", StatRuntime::Slow, {}}),
         make_stat_pair("scheduler", {"scheduler", StatRuntime::Fast, {}}),
         make_stat_pair("runtimes", {"runtimes", StatRuntime::Fast, {}}),
+        make_stat_pair("task-latency",
+                       {"task-latency", StatRuntime::Fast, {}}),
         make_stat_pair("memory", {"memory", StatRuntime::Fast, {}}),
         make_stat_pair("uuid", {"uuid", StatRuntime::Fast, {}}),
         // We add a document with the key __sentinel__ to vbucket 0 at the
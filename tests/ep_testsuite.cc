@@ -2161,6 +2161,42 @@ static enum test_result test_bg_stats(ENGINE_HANDLE *h, ENGINE_HANDLE_V1 *h1) {
     return SUCCESS;
 }
 
+// Background fetches must still complete when batches are held open to
+// coalesce further misses, and the held batches must be counted.
+static enum test_result test_bg_fetch_coalescing(ENGINE_HANDLE *h,
+                                                 ENGINE_HANDLE_V1 *h1) {
+    checkeq(500, get_int_stat(h, h1, "ep_bg_fetch_coalesce_max_us"),
+            "Unexpected initial bg_fetch_coalesce_max_us");
+
+    const int num_keys = 5;
+    for (int ii = 0; ii < num_keys; ++ii) {
+        std::string key("key" + std::to_string(ii));
+        wait_for_persisted_value(h, h1, key.c_str(), "value");
+        evict_key(h, h1, key.c_str(), 0, "Ejected.");
+    }
+
+    // Every fetch is slower than the 0us target, so all but the first
+    // batch will be coalesced.
+    for (int ii = 0; ii < num_keys; ++ii) {
+        std::string key("key" + std::to_string(ii));
+        check_key_value(h, h1, key.c_str(), "value", 5, 0);
+    }
+    checkeq(num_keys, get_int_stat(h, h1, "ep_bg_fetched"),
+            "Expected every key to be bg fetched");
+    // Nothing has been read when the first miss arrives, so at least that
+    // batch is dispatched straight away; later ones are held open.
+    check(get_int_stat(h, h1, "ep_bg_fetch_coalesced") > 0,
+          "Expected at least one bg fetch batch to be coalesced");
+    check(get_int_stat(h, h1, "ep_bg_fetch_coalesced") < num_keys,
+          "Expected the first bg fetch batch to be dispatched immediately");
+
+    set_param(h, h1, protocol_binary_engine_param_flush,
+              "bg_fetch_coalesce_max_us", "0");
+    checkeq(0, get_int_stat(h, h1, "ep_bg_fetch_coalesce_max_us"),
+            "Failed to disable bg fetch coalescing");
+    return SUCCESS;
+}
+
 static enum test_result test_bg_meta_stats(ENGINE_HANDLE *h, ENGINE_HANDLE_V1 *h1) {
     item *itm = NULL;
     h1->reset_stats(h, NULL);
@@ -3174,6 +3210,268 @@ static enum test_result test_warmup_with_threshold(ENGINE_HANDLE *h,
     return SUCCESS;
 }
 
+// Warmup with several tasks scanning each shard loads every vbucket.
+static enum test_result test_warmup_tasks_per_shard(ENGINE_HANDLE *h,
+                                                    ENGINE_HANDLE_V1 *h1) {
+    if (!isWarmupEnabled(h, h1)) {
+        return SKIPPED;
+    }
+
+    checkeq(4, get_int_stat(h, h1, "ep_warmup_tasks_per_shard"),
+            "Unexpected warmup_tasks_per_shard");
+
+    const int numVbuckets = 16;
+    for (int vb = 0; vb < numVbuckets; ++vb) {
+        check(set_vbucket_state(h, h1, vb, vbucket_state_active),
+              "Failed to set vbucket state.");
+    }
+
+    item *it = NULL;
+    for (int i = 0; i < 4000; ++i) {
+        std::stringstream key;
+        key << "key-" << i;
+        checkeq(ENGINE_SUCCESS,
+                store(h, h1, NULL, OPERATION_SET, key.str().c_str(),
+                      "somevalue", &it, 0, (i % numVbuckets)),
+                "Error setting.");
+        h1->release(h, NULL, it);
+    }
+    wait_for_flusher_to_settle(h, h1);
+
+    // Restart the server.
+    testHarness.reload_engine(&h, &h1,
+                              testHarness.engine_path,
+                              testHarness.get_current_testcase()->cfg,
+                              true, false);
+
+    wait_for_warmup_complete(h, h1);
+
+    const auto vb_details_stats = get_all_stats(h, h1, "vbucket-details");
+    for (int vb = 0; vb < numVbuckets; ++vb) {
+        const std::string key = "vb_" + std::to_string(vb) + ":num_items";
+        checkeq(4000 / numVbuckets, std::stoi(vb_details_stats.at(key)),
+                ("Unexpected item count for " + key).c_str());
+    }
+
+    const std::string policy = get_str_stat(h, h1, "ep_item_eviction_policy");
+    const char* phase = policy == "full_eviction" ? "ep_warmup_kv_pairs_items"
+                                                  : "ep_warmup_key_dump_items";
+    checkeq(4000, get_int_stat(h, h1, phase, "warmup"),
+            "Unexpected number of items loaded by the phase");
+
+    return SUCCESS;
+}
+
+// Warmup from a sorted access log loads the logged documents updated since
+// the log was written, although they have moved on from their logged seqnos.
+static enum test_result test_warmup_sorted_alog_updated_key(
+        ENGINE_HANDLE *h, ENGINE_HANDLE_V1 *h1) {
+    if (!isWarmupEnabled(h, h1)) {
+        return SKIPPED;
+    }
+
+    checkeq(ENGINE_SUCCESS,
+            h1->get_stats(h, NULL, NULL, 0, add_stats),
+            "Failed to get stats.");
+    const auto dbname = vals.find("ep_dbname")->second;
+    const auto alog_path = std::string("alog_path=") + dbname +
+            DIRECTORY_SEPARATOR_CHARACTER + "access.log";
+
+    // Keep the access scanner task from running by itself.
+    const time_t now = time(nullptr);
+    struct tm tm_now;
+    cb_gmtime_r(&now, &tm_now);
+    const auto alog_task_time = std::string("alog_task_time=") +
+            std::to_string((tm_now.tm_hour + 2) % 24);
+
+    const auto newconfig = std::string(testHarness.get_current_testcase()->cfg)
+                           + alog_path + ";" + alog_task_time;
+    testHarness.reload_engine(&h, &h1,
+                              testHarness.engine_path,
+                              newconfig.c_str(),
+                              true, false);
+    wait_for_warmup_complete(h, h1);
+
+    // Warmup only loads access logs if every shard has one, so give each
+    // shard a vbucket with keys.
+    const int num_shards = get_int_stat(h, h1, "ep_workload:num_shards",
+                                        "workload");
+    for (int vb = 1; vb < num_shards; ++vb) {
+        check(set_vbucket_state(h, h1, vb, vbucket_state_active),
+              "Failed to set vbucket state.");
+    }
+
+    const int num_keys = 10 * num_shards;
+    item *it = NULL;
+    for (int i = 0; i < num_keys; ++i) {
+        const std::string key = "key-" + std::to_string(i);
+        checkeq(ENGINE_SUCCESS,
+                store(h, h1, NULL, OPERATION_SET, key.c_str(), "somevalue",
+                      &it, 0, (i % num_shards)),
+                "Error setting.");
+        h1->release(h, NULL, it);
+    }
+    wait_for_flusher_to_settle(h, h1);
+
+    check(set_param(h, h1, protocol_binary_engine_param_flush,
+                    "access_scanner_run", "true"),
+          "Failed to trigger access scanner");
+    wait_for_stat_to_be(h, h1, "ep_num_access_scanner_runs", num_shards);
+
+    // Update a logged key, which moves it to a higher seqno.
+    checkeq(ENGINE_SUCCESS,
+            store(h, h1, NULL, OPERATION_SET, "key-0", "newvalue", &it, 0, 0),
+            "Error updating.");
+    h1->release(h, NULL, it);
+    wait_for_flusher_to_settle(h, h1);
+
+    testHarness.reload_engine(&h, &h1,
+                              testHarness.engine_path,
+                              newconfig.c_str(),
+                              true, false);
+    wait_for_warmup_complete(h, h1);
+
+    checkeq(num_keys,
+            get_int_stat(h, h1, "ep_warmup_access_log_items", "warmup"),
+            "Expected every logged key to be loaded from the access log");
+
+    // The updated key is resident: reading it needs no background fetch.
+    check_key_value(h, h1, "key-0", "newvalue", 8);
+    checkeq(0, get_int_stat(h, h1, "ep_bg_fetched"),
+            "Expected key-0 to be resident after warmup");
+
+    return SUCCESS;
+}
+
+static enum test_result test_warmup_incremental_alog(ENGINE_HANDLE *h,
+                                                     ENGINE_HANDLE_V1 *h1) {
+    if (!isWarmupEnabled(h, h1)) {
+        return SKIPPED;
+    }
+
+    checkeq(ENGINE_SUCCESS,
+            h1->get_stats(h, NULL, NULL, 0, add_stats),
+            "Failed to get stats.");
+    const auto dbname = vals.find("ep_dbname")->second;
+    const auto alog_name = dbname + DIRECTORY_SEPARATOR_CHARACTER +
+            "access.log";
+
+    // Keep the access scanner task from running by itself.
+    const time_t now = time(nullptr);
+    struct tm tm_now;
+    cb_gmtime_r(&now, &tm_now);
+    const auto alog_task_time = std::string("alog_task_time=") +
+            std::to_string((tm_now.tm_hour + 2) % 24);
+
+    // Start with full runs, which write a MutationLog.
+    const auto fullconfig = std::string(testHarness.get_current_testcase()->cfg)
+                            + "alog_path=" + alog_name + ";" + alog_task_time;
+    testHarness.reload_engine(&h, &h1,
+                              testHarness.engine_path,
+                              fullconfig.c_str(),
+                              true, false);
+    wait_for_warmup_complete(h, h1);
+
+    // Three vbuckets with keys per shard, so an incremental pass takes three
+    // runs of one vbucket each.
+    const int num_shards = get_int_stat(h, h1, "ep_workload:num_shards",
+                                        "workload");
+    const int num_vbs = 3 * num_shards;
+    for (int vb = 1; vb < num_vbs; ++vb) {
+        check(set_vbucket_state(h, h1, vb, vbucket_state_active),
+              "Failed to set vbucket state.");
+    }
+
+    const int num_keys = 10 * num_vbs;
+    item *it = NULL;
+    for (int i = 0; i < num_keys; ++i) {
+        const std::string key = "key-" + std::to_string(i);
+        checkeq(ENGINE_SUCCESS,
+                store(h, h1, NULL, OPERATION_SET, key.c_str(), "somevalue",
+                      &it, 0, (i % num_vbs)),
+                "Error setting.");
+        h1->release(h, NULL, it);
+    }
+    wait_for_flusher_to_settle(h, h1);
+
+    // Each run completes once per shard.
+    int runs = 0;
+    auto run_access_scanner = [&h, &h1, &runs, num_shards]() {
+        check(set_param(h, h1, protocol_binary_engine_param_flush,
+                        "access_scanner_run", "true"),
+              "Failed to trigger access scanner");
+        runs += num_shards;
+        wait_for_stat_to_be(h, h1, "ep_num_access_scanner_runs", runs);
+    };
+    auto check_alog_files = [&alog_name, num_shards](bool main_log,
+                                                     int num_segments,
+                                                     const char* msg) {
+        for (int shard = 0; shard < num_shards; ++shard) {
+            const auto name = alog_name + "." + std::to_string(shard);
+            checkeq(main_log ? 0 : -1, access(name.c_str(), F_OK),
+                    (name + ": " + msg).c_str());
+            for (int seg = 1; seg <= num_segments + 1; ++seg) {
+                const auto segment = name + ".seg." + std::to_string(seg);
+                checkeq(seg <= num_segments ? 0 : -1,
+                        access(segment.c_str(), F_OK),
+                        (segment + ": " + msg).c_str());
+            }
+        }
+    };
+
+    run_access_scanner();
+    check_alog_files(true, 0, "Expected a full run to write the main log");
+
+    // Turn on incremental mode, compacting at every second segment.
+    const auto newconfig = fullconfig + ";alog_incremental_items=1;"
+            "alog_max_segments=2;alog_incremental_interval=3600";
+    testHarness.reload_engine(&h, &h1,
+                              testHarness.engine_path,
+                              newconfig.c_str(),
+                              true, false);
+    wait_for_warmup_complete(h, h1);
+    runs = 0;
+
+    // The MutationLog is converted by a full run rather than given a
+    // segment it couldn't be merged with.
+    run_access_scanner();
+    check_alog_files(true, 0, "Expected the MutationLog to be converted");
+
+    run_access_scanner();
+    check_alog_files(true, 1, "Expected a segment of the first vbucket");
+
+    run_access_scanner();
+    check_alog_files(true, 0,
+                     "Expected alog_max_segments segments to be compacted");
+
+    run_access_scanner();
+    check_alog_files(true, 0,
+                     "Expected the segments to be compacted after a pass");
+
+    // The next pass starts over with a new segment.
+    run_access_scanner();
+    check_alog_files(true, 1, "Expected a segment of the next pass");
+
+    testHarness.reload_engine(&h, &h1,
+                              testHarness.engine_path,
+                              newconfig.c_str(),
+                              true, false);
+    wait_for_warmup_complete(h, h1);
+
+    checkeq(num_keys,
+            get_int_stat(h, h1, "ep_warmup_access_log_items", "warmup"),
+            "Expected every key to be loaded from the main log and segment");
+
+    for (int i = 0; i < num_keys; i += num_vbs - 1) {
+        const std::string key = "key-" + std::to_string(i);
+        check_key_value(h, h1, key.c_str(), "somevalue", 9, (i % num_vbs));
+    }
+    checkeq(0, get_int_stat(h, h1, "ep_bg_fetched"),
+            "Expected the logged keys to be resident after warmup");
+
+    return SUCCESS;
+}
+
 #if 0
 // Comment out the entire test since the hack gave warnings on win32
 static enum test_result test_warmup_accesslog(ENGINE_HANDLE *h, ENGINE_HANDLE_V1 *h1) {
@@ -6101,6 +6399,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
     std::vector<std::string> rwKVStoreStats = {
                 "rw_0:backend_type",
                 "rw_0:close",
+                "rw_0:compaction_skipped",
                 "rw_0:failure_del",
                 "rw_0:failure_get",
                 "rw_0:failure_open",
@@ -6119,6 +6418,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "rw_0:open",
                 "rw_1:backend_type",
                 "rw_1:close",
+                "rw_1:compaction_skipped",
                 "rw_1:failure_del",
                 "rw_1:failure_get",
                 "rw_1:failure_open",
@@ -6137,6 +6437,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "rw_1:open",
                 "rw_2:backend_type",
                 "rw_2:close",
+                "rw_2:compaction_skipped",
                 "rw_2:failure_del",
                 "rw_2:failure_get",
                 "rw_2:failure_open",
@@ -6155,6 +6456,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "rw_2:open",
                 "rw_3:backend_type",
                 "rw_3:close",
+                "rw_3:compaction_skipped",
                 "rw_3:failure_del",
                 "rw_3:failure_get",
                 "rw_3:failure_open",
@@ -6198,6 +6500,12 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
         },
         {"dcp",
             {
+                "ep_dcp_compression_cache_cpu_saved",
+                "ep_dcp_compression_cache_evictions",
+                "ep_dcp_compression_cache_hits",
+                "ep_dcp_compression_cache_items",
+                "ep_dcp_compression_cache_mem_used",
+                "ep_dcp_compression_cache_misses",
                 "ep_dcp_count",
                 "ep_dcp_dead_conn_count",
                 "ep_dcp_items_remaining",
@@ -6349,6 +6657,10 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
             {
                 "ep_access_scanner_enabled",
                 "ep_alog_block_size",
+                "ep_alog_format",
+                "ep_alog_incremental_interval",
+                "ep_alog_incremental_items",
+                "ep_alog_max_segments",
                 "ep_alog_max_stored_items",
                 "ep_alog_path",
                 "ep_alog_resident_ratio_threshold",
@@ -6356,11 +6668,15 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_alog_task_time",
                 "ep_backend",
                 "ep_backfill_mem_threshold",
+                "ep_bfilter_blocked",
                 "ep_bfilter_enabled",
                 "ep_bfilter_fp_prob",
                 "ep_bfilter_key_count",
+                "ep_bfilter_persist",
                 "ep_bfilter_residency_threshold",
+                "ep_bg_fetch_coalesce_max_us",
                 "ep_bg_fetch_delay",
+                "ep_bg_fetch_latency_target_us",
                 "ep_bucket_type",
                 "ep_cache_size",
                 "ep_chk_max_items",
@@ -6368,7 +6684,9 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_chk_remover_stime",
                 "ep_collections_prototype_enabled",
                 "ep_compaction_exp_mem_threshold",
+                "ep_compaction_min_stale_ratio",
                 "ep_compaction_write_queue_cap",
+                "ep_compression_mode",
                 "ep_config_file",
                 "ep_conflict_resolution_type",
                 "ep_connection_manager_interval",
@@ -6378,6 +6696,8 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_data_traffic_enabled",
                 "ep_dbname",
                 "ep_dcp_backfill_byte_limit",
+                "ep_dcp_backfill_disk_scans_per_shard",
+                "ep_dcp_compression_cache_size",
                 "ep_dcp_conn_buffer_size",
                 "ep_dcp_conn_buffer_size_aggr_mem_threshold",
                 "ep_dcp_conn_buffer_size_aggressive_perc",
@@ -6389,9 +6709,12 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_dcp_min_compression_ratio",
                 "ep_dcp_idle_timeout",
                 "ep_dcp_noop_tx_interval",
+                "ep_dcp_producer_batch_byte_limit",
+                "ep_dcp_producer_batch_item_limit",
                 "ep_dcp_producer_snapshot_marker_yield_limit",
                 "ep_dcp_consumer_process_buffered_messages_yield_limit",
                 "ep_dcp_consumer_process_buffered_messages_batch_size",
+                "ep_dcp_consumer_processor_tasks",
                 "ep_dcp_scan_byte_limit",
                 "ep_dcp_scan_item_limit",
                 "ep_dcp_takeover_max_time",
@@ -6402,6 +6725,16 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_defragmenter_interval",
                 "ep_enable_chk_merge",
                 "ep_ephemeral_full_policy",
+                "ep_executor_autoscale",
+                "ep_executor_autoscale_cpu_limit",
+                "ep_executor_autoscale_latency_target_us",
+                "ep_executor_autoscale_max_threads",
+                "ep_executor_autoscale_min_threads",
+                "ep_executor_cpu_quota",
+                "ep_executor_fair_share",
+                "ep_executor_io_quota",
+                "ep_executor_numa_aware",
+                "ep_executor_work_stealing",
                 "ep_exp_pager_enabled",
                 "ep_exp_pager_initial_run_time",
                 "ep_exp_pager_stime",
@@ -6432,6 +6765,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_max_vbuckets",
                 "ep_mem_high_wat",
                 "ep_mem_low_wat",
+                "ep_min_compression_ratio",
                 "ep_mutation_mem_threshold",
                 "ep_num_auxio_threads",
                 "ep_num_nonio_threads",
@@ -6460,8 +6794,10 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_waitforwarmup",
                 "ep_warmup",
                 "ep_warmup_batch_size",
+                "ep_warmup_hit_ratio_window",
                 "ep_warmup_min_items_threshold",
-                "ep_warmup_min_memory_threshold"
+                "ep_warmup_min_memory_threshold",
+                "ep_warmup_tasks_per_shard"
             }
         },
         {"workload",
@@ -6477,6 +6813,10 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_workload:num_shards",
                 "ep_workload:ready_tasks",
                 "ep_workload:num_sleepers",
+                "ep_workload:autoscale_adjustments",
+                "ep_workload:numa_nodes",
+                "ep_workload:numa_local_tasks",
+                "ep_workload:numa_remote_tasks",
                 "ep_workload:LowPrioQ_AuxIO:InQsize",
                 "ep_workload:LowPrioQ_AuxIO:OutQsize",
                 "ep_workload:LowPrioQ_NonIO:InQsize",
@@ -6526,6 +6866,10 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_active_hlc_drift",
                 "ep_active_hlc_drift_count",
                 "ep_alog_block_size",
+                "ep_alog_format",
+                "ep_alog_incremental_interval",
+                "ep_alog_incremental_items",
+                "ep_alog_max_segments",
                 "ep_alog_max_stored_items",
                 "ep_alog_path",
                 "ep_alog_resident_ratio_threshold",
@@ -6533,11 +6877,16 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_alog_task_time",
                 "ep_backend",
                 "ep_backfill_mem_threshold",
+                "ep_bfilter_blocked",
                 "ep_bfilter_enabled",
                 "ep_bfilter_fp_prob",
                 "ep_bfilter_key_count",
+                "ep_bfilter_persist",
                 "ep_bfilter_residency_threshold",
+                "ep_bg_fetch_coalesce_max_us",
+                "ep_bg_fetch_coalesced",
                 "ep_bg_fetch_delay",
+                "ep_bg_fetch_latency_target_us",
                 "ep_bg_fetched",
                 "ep_bg_meta_fetched",
                 "ep_bg_remaining_items",
@@ -6554,7 +6903,9 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_clock_cas_drift_threshold_exceeded",
                 "ep_collections_prototype_enabled",
                 "ep_compaction_exp_mem_threshold",
+                "ep_compaction_min_stale_ratio",
                 "ep_compaction_write_queue_cap",
+                "ep_compression_mode",
                 "ep_config_file",
                 "ep_conflict_resolution_type",
                 "ep_connection_manager_interval",
@@ -6567,6 +6918,8 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_data_traffic_enabled",
                 "ep_dbname",
                 "ep_dcp_backfill_byte_limit",
+                "ep_dcp_backfill_disk_scans_per_shard",
+                "ep_dcp_compression_cache_size",
                 "ep_dcp_conn_buffer_size",
                 "ep_dcp_conn_buffer_size_aggr_mem_threshold",
                 "ep_dcp_conn_buffer_size_aggressive_perc",
@@ -6574,12 +6927,15 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_dcp_conn_buffer_size_perc",
                 "ep_dcp_consumer_process_buffered_messages_batch_size",
                 "ep_dcp_consumer_process_buffered_messages_yield_limit",
+                "ep_dcp_consumer_processor_tasks",
                 "ep_dcp_enable_noop",
                 "ep_dcp_flow_control_policy",
                 "ep_dcp_idle_timeout",
                 "ep_dcp_max_unacked_bytes",
                 "ep_dcp_min_compression_ratio",
                 "ep_dcp_noop_tx_interval",
+                "ep_dcp_producer_batch_byte_limit",
+                "ep_dcp_producer_batch_item_limit",
                 "ep_dcp_producer_snapshot_marker_yield_limit",
                 "ep_dcp_scan_byte_limit",
                 "ep_dcp_scan_item_limit",
@@ -6599,6 +6955,16 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_diskqueue_pending",
                 "ep_enable_chk_merge",
                 "ep_ephemeral_full_policy",
+                "ep_executor_autoscale",
+                "ep_executor_autoscale_cpu_limit",
+                "ep_executor_autoscale_latency_target_us",
+                "ep_executor_autoscale_max_threads",
+                "ep_executor_autoscale_min_threads",
+                "ep_executor_cpu_quota",
+                "ep_executor_fair_share",
+                "ep_executor_io_quota",
+                "ep_executor_numa_aware",
+                "ep_executor_work_stealing",
                 "ep_exp_pager_enabled",
                 "ep_exp_pager_initial_run_time",
                 "ep_exp_pager_stime",
@@ -6648,6 +7014,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_mem_tracker_enabled",
                 "ep_meta_data_disk",
                 "ep_meta_data_memory",
+                "ep_min_compression_ratio",
                 "ep_mlog_compactor_runs",
                 "ep_mutation_mem_threshold",
                 "ep_num_access_scanner_runs",
@@ -6735,8 +7102,10 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                 "ep_waitforwarmup",
                 "ep_warmup",
                 "ep_warmup_batch_size",
+                "ep_warmup_hit_ratio_window",
                 "ep_warmup_min_items_threshold",
                 "ep_warmup_min_memory_threshold",
+                "ep_warmup_tasks_per_shard",
                 "ep_workload_pattern",
                 "mem_used",
                 "rollback_item_count",
@@ -6995,6 +7364,7 @@ static enum test_result test_mb19687_variable(ENGINE_HANDLE* h,
     // all of these should be const, but g++ seems to have problems with that
     std::map<std::string, std::vector<std::string> > statsKeys{
         {"dispatcher", {}}, // Depends on how how long the dispatcher ran..
+        {"dcp-hot", {}}, // Only lists the streams there are
 
 //        {"tapagg foo",      {}}, // tapagg takes a key and I need to have that tap stream
 //        {"dcpagg bar",      {}}, // dcpagg takes a key and I need to have that dcp stream
@@ -7042,6 +7412,9 @@ static enum test_result test_mb19687_variable(ENGINE_HANDLE* h,
         {"runtimes",
             {}
         },
+        {"task-latency",
+            {}
+        },
         {"kvtimings",
             {}
         },
@@ -7450,6 +7823,10 @@ BaseTestCase testsuite_testcases[] = {
                  NULL, prepare_ep_bucket, cleanup),
         TestCase("bg meta stats", test_bg_meta_stats, test_setup, teardown,
                  NULL, prepare_ep_bucket, cleanup),
+        TestCase("bg fetch coalescing", test_bg_fetch_coalescing,
+                 test_setup, teardown,
+                 "bg_fetch_coalesce_max_us=500;bg_fetch_latency_target_us=0",
+                 prepare_ep_bucket, cleanup),
         TestCase("mem stats", test_mem_stats, test_setup, teardown,
                  "chk_remover_stime=1;chk_period=60", prepare, cleanup),
         TestCase("stats key", test_key_stats, test_setup, teardown,
@@ -7463,6 +7840,19 @@ BaseTestCase testsuite_testcases[] = {
         TestCase("warmup with threshold", test_warmup_with_threshold,
                  test_setup, teardown,
                  "warmup_min_items_threshold=1", prepare, cleanup),
+        TestCase("warmup tasks per shard", test_warmup_tasks_per_shard,
+                 test_setup, teardown,
+                 "warmup_tasks_per_shard=4", prepare, cleanup),
+        TestCase("warmup sorted access log updated key",
+                 test_warmup_sorted_alog_updated_key,
+                 test_setup, teardown,
+                 "alog_format=sorted;alog_resident_ratio_threshold=100",
+                 prepare, cleanup),
+        TestCase("warmup incremental access log",
+                 test_warmup_incremental_alog,
+                 test_setup, teardown,
+                 "alog_resident_ratio_threshold=100",
+                 prepare, cleanup),
         TestCase("seqno stats", test_stats_seqno,
                  test_setup, teardown, NULL, prepare, cleanup),
         TestCase("diskinfo stats", test_stats_diskinfo,
@@ -1331,6 +1331,38 @@ static enum test_result test_dcp_consumer_flow_control_dynamic(ENGINE_HANDLE *h,
     return SUCCESS;
 }
 
+static enum test_result test_dcp_consumer_flow_control_adaptive(
+                                                        ENGINE_HANDLE *h,
+                                                        ENGINE_HANDLE_V1 *h1) {
+    const auto *cookie1 = testHarness.create_cookie();
+    const std::string name("unittest");
+    const uint32_t opaque = 0;
+    const uint32_t seqno = 0;
+    const uint32_t flags = 0;
+    set_param(h, h1, protocol_binary_engine_param_flush, "max_size",
+              "2000000000");
+    checkeq(2000000000, get_int_stat(h, h1, "ep_max_size"),
+            "Incorrect new size.");
+
+    checkeq(ENGINE_SUCCESS,
+            h1->dcp.open(h, cookie1, opaque, seqno, flags,
+                         (void*)name.c_str(), name.size()),
+            "Failed dcp consumer open connection.");
+
+    /* Connections start at the default size until they have been measured */
+    const auto stat_name("eq_dcpq:" + name + ":max_buffer_bytes");
+    checkeq(10485760,
+            get_int_stat(h, h1, stat_name.c_str(), "dcp"),
+            "Flow Control Buffer Size not equal to default");
+    checkeq(0,
+            get_int_stat(h, h1, ("eq_dcpq:" + name + ":rtt_us").c_str(),
+                         "dcp"),
+            "Round trip measured before any control message");
+    testHarness.destroy_cookie(cookie1);
+
+    return SUCCESS;
+}
+
 static enum test_result test_dcp_consumer_flow_control_aggressive(
                                                         ENGINE_HANDLE *h,
                                                         ENGINE_HANDLE_V1 *h1) {
@@ -5768,6 +5800,10 @@ static enum test_result test_set_dcp_param(ENGINE_HANDLE *h,
     func("dcp_consumer_process_buffered_messages_batch_size", 1000, true);
     func("dcp_consumer_process_buffered_messages_yield_limit", 0, false);
     func("dcp_consumer_process_buffered_messages_batch_size", 0, false);
+    func("dcp_consumer_processor_tasks", 4, true);
+    func("dcp_consumer_processor_tasks", 0, false);
+    func("dcp_consumer_processor_tasks", 65, false);
+    func("dcp_backfill_disk_scans_per_shard", 2, true);
     return SUCCESS;
 }
 
@@ -5805,6 +5841,10 @@ BaseTestCase testsuite_testcases[] = {
                  test_dcp_consumer_flow_control_aggressive,
                  test_setup, teardown, "dcp_flow_control_policy=aggressive",
                  prepare, cleanup),
+        TestCase("test dcp consumer flow control adaptive",
+                 test_dcp_consumer_flow_control_adaptive,
+                 test_setup, teardown, "dcp_flow_control_policy=adaptive",
+                 prepare, cleanup),
         TestCase("test open producer", test_dcp_producer_open,
                  test_setup, teardown, nullptr, prepare, cleanup),
         TestCase("test open producer same cookie", test_dcp_producer_open_same_cookie,
@@ -23,6 +23,8 @@
 #include <memcached/engine.h>
 #include <memcached/dcp.h>
 
+#include <string>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -37,6 +39,11 @@ ENGINE_ERROR_CODE mock_dcp_add_failover_log(vbucket_failover_t* entry,
 }
 #endif
 
+// Details of the last DCP message sent through get_dcp_producers()
+extern uint8_t dcp_last_op;
+extern uint32_t dcp_last_opaque;
+extern std::string dcp_last_value;
+
 void clear_dcp_data();
 
 std::unique_ptr<dcp_message_producers> get_dcp_producers(ENGINE_HANDLE *_h,
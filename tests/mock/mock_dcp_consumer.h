@@ -45,4 +45,8 @@ public:
     void public_notifyVbucketReady(uint16_t vbid) {
         notifyVbucketReady(vbid);
     }
+
+    FlowControl& getFlowControl() {
+        return flowControl;
+    }
 };
\ No newline at end of file
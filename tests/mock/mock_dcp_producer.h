@@ -81,6 +81,16 @@ public:
         DcpProducer::scheduleCheckpointProcessorTask();
     }
 
+    /**
+     * Add a stream for its vbucket and mark it ready, bypassing
+     * streamRequest.
+     */
+    void addStream(stream_t stream) {
+        const uint16_t vbid = stream->getVBucket();
+        streams.insert({vbid, stream});
+        ready.pushUnique(vbid);
+    }
+
     ActiveStreamCheckpointProcessorTask& getCheckpointSnapshotTask() const {
         return *static_cast<ActiveStreamCheckpointProcessorTask*>(
                 checkpointCreatorTask.get());
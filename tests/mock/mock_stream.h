@@ -118,3 +118,54 @@ public:
         transitionState(StreamState::Dead);
     }
 };
+
+/*
+ * A stream with no vbucket behind it, which sends copies of the same item
+ * as mutations with seqnos 1 to numItems - subject to the producer's buffer
+ * log - and then nothing.
+ */
+class MockMutationStream : public Stream {
+public:
+    MockMutationStream(DcpProducer& p,
+                       uint16_t vb,
+                       queued_item item,
+                       size_t numItems)
+        : Stream(p.getName(), /*flags*/ 0, /*opaque*/ 0, vb,
+                 /*st_seqno*/ 0, /*en_seqno*/ numItems, /*vb_uuid*/ 0,
+                 /*snap_start_seqno*/ 0, /*snap_end_seqno*/ 0),
+          producer(p),
+          item(item),
+          remaining(numItems) {
+        state_ = StreamState::InMemory;
+    }
+
+    DcpResponse* next() override {
+        if (remaining == 0) {
+            itemsReady.store(false);
+            return nullptr;
+        }
+        queued_item next(new Item(*item));
+        next->setBySeqno(end_seqno_ - remaining + 1);
+        std::unique_ptr<DcpResponse> response(
+                new MutationResponse(next, opaque_));
+        if (!producer.bufferLogInsert(response->getMessageSize())) {
+            return nullptr;
+        }
+        --remaining;
+        return response.release();
+    }
+
+    uint32_t setDead(end_stream_status_t status) override {
+        state_ = StreamState::Dead;
+        return 0;
+    }
+
+    size_t getRemaining() const {
+        return remaining;
+    }
+
+private:
+    DcpProducer& producer;
+    queued_item item;
+    size_t remaining;
+};
@@ -135,9 +135,35 @@ static void testOperators() {
     cb_assert(Doodad::getNumInstances() == 0);
 }
 
+static void testSharedReference() {
+    // A reference taken for the server outlives the pointer...
+    SingleThreadedRCPtr<Doodad> dd(new Doodad);
+    Doodad* shared = dd.acquireReference();
+    cb_assert(shared == dd.get());
+    dd.reset();
+    cb_assert(Doodad::getNumInstances() == 1);
+    cb_assert(SingleThreadedRCPtr<Doodad>::releaseReference(shared));
+    cb_assert(Doodad::getNumInstances() == 0);
+
+    // ...or the other way around.
+    dd.reset(new Doodad);
+    shared = dd.acquireReference();
+    cb_assert(SingleThreadedRCPtr<Doodad>::releaseReference(shared));
+    cb_assert(Doodad::getNumInstances() == 1);
+    dd.reset();
+    cb_assert(Doodad::getNumInstances() == 0);
+
+    // A value which was never shared is left to its owner.
+    Doodad* owned = new Doodad;
+    cb_assert(!SingleThreadedRCPtr<Doodad>::releaseReference(owned));
+    cb_assert(Doodad::getNumInstances() == 1);
+    delete owned;
+}
+
 int main() {
     testOperators();
     testAtomicPtr();
+    testSharedReference();
 }
 #else
 int main() {}
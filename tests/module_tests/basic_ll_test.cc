@@ -385,3 +385,103 @@ TEST_F(BasicLinkedListTest, MarkStale) {
     EXPECT_EQ(svSize, basicLL->getStaleValueBytes());
     EXPECT_EQ(svMetaDataSize, basicLL->getStaleMetadataBytes());
 }
+
+TEST_F(BasicLinkedListTest, RangeIterator) {
+    const int numItems = 3;
+
+    /* Add 3 new items */
+    std::vector<seqno_t> expectedSeqno =
+            addNewItemsToList(1, std::string("key"), numItems);
+
+    ENGINE_ERROR_CODE status;
+    std::unique_ptr<SequenceList::RangeIterator> itr;
+    std::tie(status, itr) = basicLL->makeRangeIterator(1, numItems);
+    ASSERT_EQ(ENGINE_SUCCESS, status);
+    EXPECT_EQ(numItems, itr->getEnd());
+
+    /* Read the items one at a time; the read range follows the iterator */
+    std::vector<seqno_t> readSeqno;
+    for (; !itr->done(); itr->next()) {
+        const seqno_t seqno = itr->curr()->getBySeqno();
+        EXPECT_EQ(static_cast<uint64_t>(seqno), basicLL->getRangeReadBegin());
+        EXPECT_EQ(static_cast<uint64_t>(numItems), basicLL->getRangeReadEnd());
+        readSeqno.push_back(seqno);
+    }
+    EXPECT_EQ(expectedSeqno, readSeqno);
+
+    /* The read range is given up once the iterator is done */
+    EXPECT_EQ(0, basicLL->getRangeReadBegin());
+    EXPECT_EQ(0, basicLL->getRangeReadEnd());
+    EXPECT_THROW(itr->curr(), std::logic_error);
+}
+
+TEST_F(BasicLinkedListTest, RangeIteratorFromMid) {
+    const int numItems = 3;
+
+    /* Add 3 new items */
+    addNewItemsToList(1, std::string("key"), numItems);
+
+    ENGINE_ERROR_CODE status;
+    std::unique_ptr<SequenceList::RangeIterator> itr;
+    std::tie(status, itr) = basicLL->makeRangeIterator(2, numItems);
+    ASSERT_EQ(ENGINE_SUCCESS, status);
+
+    /* Items before start are skipped */
+    ASSERT_FALSE(itr->done());
+    EXPECT_EQ(2, itr->curr()->getBySeqno());
+}
+
+TEST_F(BasicLinkedListTest, RangeIteratorNegatives) {
+    const int numItems = 2;
+
+    /* Add 2 new items */
+    addNewItemsToList(1, std::string("key"), numItems);
+
+    ENGINE_ERROR_CODE status;
+    std::unique_ptr<SequenceList::RangeIterator> itr;
+
+    /* Now do a range read with start > end */
+    std::tie(status, itr) = basicLL->makeRangeIterator(2, 1);
+    EXPECT_EQ(ENGINE_ERANGE, status);
+
+    /* Now do a range read with start > highSeqno */
+    std::tie(status, itr) =
+            basicLL->makeRangeIterator(numItems + 1, numItems + 2);
+    EXPECT_EQ(ENGINE_ERANGE, status);
+}
+
+TEST_F(BasicLinkedListTest, ConcurrentRangeIterators) {
+    const int numItems = 4;
+    const std::string keyPrefix("key");
+
+    /* Add 4 new items */
+    addNewItemsToList(1, keyPrefix, numItems);
+
+    ENGINE_ERROR_CODE status;
+    std::unique_ptr<SequenceList::RangeIterator> itr1, itr2;
+    std::tie(status, itr1) = basicLL->makeRangeIterator(1, numItems);
+    ASSERT_EQ(ENGINE_SUCCESS, status);
+    std::tie(status, itr2) = basicLL->makeRangeIterator(3, numItems);
+    ASSERT_EQ(ENGINE_SUCCESS, status);
+
+    /* The read range covers both reads */
+    EXPECT_EQ(1, basicLL->getRangeReadBegin());
+    itr1->next();
+    itr1->next();
+    itr1->next();
+    EXPECT_EQ(3, basicLL->getRangeReadBegin());
+
+    /* An item in the range is appended rather than moved, so both readers
+       still see it at its old seqno */
+    updateItemDuringRangeRead(numItems, keyPrefix + std::to_string(numItems));
+    EXPECT_EQ(numItems, itr1->curr()->getBySeqno());
+    EXPECT_EQ(3, itr2->curr()->getBySeqno());
+
+    /* Once the first read is done the second one still holds its range */
+    itr1.reset();
+    EXPECT_EQ(3, basicLL->getRangeReadBegin());
+    EXPECT_EQ(numItems, basicLL->getRangeReadEnd());
+
+    itr2.reset();
+    EXPECT_EQ(0, basicLL->getRangeReadEnd());
+}
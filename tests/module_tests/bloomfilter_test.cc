@@ -89,3 +89,85 @@ INSTANTIATE_TEST_CASE_P(
         BloomFilterDocKeyTest,
         ::testing::Combine(::testing::ValuesIn(allDocNamespaces),
                            ::testing::ValuesIn(allDocNamespaces)), );
+
+class BloomFilterLayoutTest
+        : public ::testing::TestWithParam<BloomFilterLayout> {};
+
+/*
+ * Both layouts must never report an added key as absent, and should keep the
+ * false positive rate close to the requested probability (the blocked layout
+ * trades a little accuracy for touching a single cache line per lookup).
+ */
+TEST_P(BloomFilterLayoutTest, falsePositiveRate) {
+    const int numKeys = 10000;
+    BloomFilter filter(numKeys, 0.01, BFILTER_ENABLED, GetParam());
+    EXPECT_EQ(GetParam(), filter.getLayout());
+    for (int i = 0; i < numKeys; i++) {
+        filter.addKey(makeStoredDocKey("key_" + std::to_string(i)));
+    }
+    for (int i = 0; i < numKeys; i++) {
+        EXPECT_TRUE(filter.maybeKeyExists(
+                makeStoredDocKey("key_" + std::to_string(i))));
+    }
+
+    const int numProbes = 100000;
+    int falsePositives = 0;
+    for (int i = numKeys; i < numKeys + numProbes; i++) {
+        if (filter.maybeKeyExists(
+                    makeStoredDocKey("key_" + std::to_string(i)))) {
+            falsePositives++;
+        }
+    }
+    EXPECT_LT(falsePositives, numProbes * 0.02);
+}
+
+TEST_P(BloomFilterLayoutTest, serialiseRoundTrip) {
+    BloomFilter filter(1000, 0.01, BFILTER_ENABLED, GetParam());
+    for (int i = 0; i < 100; i++) {
+        filter.addKey(makeStoredDocKey("key_" + std::to_string(i)));
+    }
+
+    auto copy = BloomFilter::deserialise(filter.serialise());
+    ASSERT_TRUE(copy);
+    EXPECT_EQ(BFILTER_ENABLED, copy->getStatus());
+    EXPECT_EQ(GetParam(), copy->getLayout());
+    EXPECT_EQ(filter.getFilterSize(), copy->getFilterSize());
+    EXPECT_EQ(filter.getNumOfKeysInFilter(), copy->getNumOfKeysInFilter());
+    for (int i = 0; i < 100; i++) {
+        EXPECT_TRUE(copy->maybeKeyExists(
+                makeStoredDocKey("key_" + std::to_string(i))));
+    }
+    for (int i = 100; i < 1100; i++) {
+        auto key = makeStoredDocKey("key_" + std::to_string(i));
+        EXPECT_EQ(filter.maybeKeyExists(key), copy->maybeKeyExists(key));
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(Layout,
+                        BloomFilterLayoutTest,
+                        ::testing::Values(BloomFilterLayout::Standard,
+                                          BloomFilterLayout::Blocked), );
+
+// Filters saved before the layout was recorded (version 1) are Standard.
+TEST(BloomFilterTest, deserialiseVersion1) {
+    BloomFilter filter(1000, 0.01, BFILTER_ENABLED);
+    filter.addKey(makeStoredDocKey("key"));
+    std::string data = filter.serialise();
+    data.erase(1, 1);
+    data[0] = 1;
+
+    auto copy = BloomFilter::deserialise(data);
+    EXPECT_EQ(BloomFilterLayout::Standard, copy->getLayout());
+    EXPECT_TRUE(copy->maybeKeyExists(makeStoredDocKey("key")));
+}
+
+TEST(BloomFilterTest, deserialiseInvalid) {
+    BloomFilter filter(1000, 0.01, BFILTER_ENABLED);
+    std::string data = filter.serialise();
+
+    EXPECT_THROW(BloomFilter::deserialise(""), std::invalid_argument);
+    EXPECT_THROW(BloomFilter::deserialise(data.substr(0, data.size() - 1)),
+                 std::invalid_argument);
+    data[0] = 0x7f;
+    EXPECT_THROW(BloomFilter::deserialise(data), std::invalid_argument);
+}
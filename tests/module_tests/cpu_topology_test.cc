@@ -0,0 +1,53 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "cpu_topology.h"
+
+#include <stdexcept>
+
+TEST(CpuTopologyTest, parseCpuList) {
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 9, 10, 11}),
+              CpuTopology::parseCpuList("0-3,8-11\n"));
+    EXPECT_EQ(std::vector<int>({5}), CpuTopology::parseCpuList("5"));
+    EXPECT_EQ(std::vector<int>({1, 4, 6, 7}),
+              CpuTopology::parseCpuList("1,4,6-7"));
+    EXPECT_TRUE(CpuTopology::parseCpuList("").empty());
+
+    for (const auto* list : {"a", "3-1", "1-", "1-2x", "-1"}) {
+        EXPECT_THROW(CpuTopology::parseCpuList(list), std::invalid_argument)
+                << list;
+    }
+}
+
+TEST(CpuTopologyTest, detect) {
+    const auto topology = CpuTopology::detect();
+    ASSERT_GE(topology.getNumNodes(), 1u);
+    size_t numCpus = 0;
+    for (size_t node = 0; node < topology.getNumNodes(); ++node) {
+        numCpus += topology.getCpus(node).size();
+    }
+    EXPECT_GE(numCpus, 1u);
+}
+
+TEST(CpuTopologyTest, emptyIsOneNode) {
+    CpuTopology topology({});
+    EXPECT_EQ(1u, topology.getNumNodes());
+    EXPECT_TRUE(topology.getCpus(0).empty());
+    EXPECT_FALSE(topology.bindCurrentThread(0));
+}
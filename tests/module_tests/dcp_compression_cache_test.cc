@@ -0,0 +1,134 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the DcpCompressionCache class.
+ */
+
+#include "config.h"
+
+#include "dcp/compression_cache.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <gtest/gtest.h>
+#include <platform/compress.h>
+
+class DcpCompressionCacheTest : public ::testing::Test {
+protected:
+    Item makeItem(uint16_t vbid, int64_t seqno, const std::string& value) {
+        auto item = make_item(vbid, makeStoredDocKey("key"), value);
+        item.setBySeqno(seqno);
+        item.setCas(seqno);
+        return item;
+    }
+
+    const std::string compressible = std::string(1024, 'x');
+    const std::string incompressible = "x";
+};
+
+// The first request compresses, later ones share the value.
+TEST_F(DcpCompressionCacheTest, CompressOnce) {
+    DcpCompressionCache cache(1024 * 1024);
+    const auto item = makeItem(0, 1, compressible);
+
+    auto first = cache.getCompressed(item, 0.85);
+    ASSERT_TRUE(first);
+    EXPECT_TRUE(mcbp::datatype::is_snappy(first->getDataType()));
+    EXPECT_TRUE(mcbp::datatype::is_json(first->getDataType()));
+    EXPECT_LT(first->vlength(), compressible.size());
+
+    cb::compression::Buffer inflated;
+    ASSERT_TRUE(cb::compression::inflate(cb::compression::Algorithm::Snappy,
+                                         first->getData(),
+                                         first->vlength(),
+                                         inflated));
+    EXPECT_EQ(compressible, std::string(inflated.data.get(), inflated.len));
+
+    auto second = cache.getCompressed(item, 0.85);
+    EXPECT_EQ(first.get(), second.get());
+    EXPECT_EQ(1u, cache.getMisses());
+    EXPECT_EQ(1u, cache.getHits());
+    EXPECT_EQ(1u, cache.getNumItems());
+    EXPECT_GT(cache.getMemSize(), first->getSize());
+}
+
+// A value over the ratio is sent uncompressed, and isn't compressed again.
+TEST_F(DcpCompressionCacheTest, RatioCheckedOnce) {
+    DcpCompressionCache cache(1024 * 1024);
+    const auto item = makeItem(0, 1, incompressible);
+
+    EXPECT_FALSE(cache.getCompressed(item, 0.85));
+    EXPECT_FALSE(cache.getCompressed(item, 0.85));
+    EXPECT_EQ(1u, cache.getMisses());
+    EXPECT_EQ(1u, cache.getHits());
+
+    // Relaxing the ratio needs the value itself, so it's compressed again
+    EXPECT_TRUE(cache.getCompressed(item, 100.0));
+    EXPECT_EQ(2u, cache.getMisses());
+    EXPECT_TRUE(cache.getCompressed(item, 100.0));
+    EXPECT_EQ(2u, cache.getHits());
+    EXPECT_EQ(1u, cache.getNumItems());
+}
+
+// A different revision at the same seqno (e.g. after a rollback) misses.
+TEST_F(DcpCompressionCacheTest, RevisionChecked) {
+    DcpCompressionCache cache(1024 * 1024);
+    auto item = makeItem(0, 1, compressible);
+    auto first = cache.getCompressed(item, 0.85);
+    ASSERT_TRUE(first);
+
+    item.setCas(2);
+    auto second = cache.getCompressed(item, 0.85);
+    ASSERT_TRUE(second);
+    EXPECT_NE(first.get(), second.get());
+    EXPECT_EQ(2u, cache.getMisses());
+    EXPECT_EQ(1u, cache.getNumItems());
+
+    // Same seqno in another vbucket is another value
+    cache.getCompressed(makeItem(1, 1, compressible), 0.85);
+    EXPECT_EQ(3u, cache.getMisses());
+    EXPECT_EQ(2u, cache.getNumItems());
+}
+
+// The cache stays within its size, least recently used evicted first.
+TEST_F(DcpCompressionCacheTest, Bounded) {
+    DcpCompressionCache cache(1024 * 1024);
+    cache.getCompressed(makeItem(0, 1, compressible), 0.85);
+    const size_t entrySize = cache.getMemSize();
+
+    // Room for two entries in vbucket 0's shard
+    cache.setMaxSize(DcpCompressionCache::numShards * entrySize * 2);
+    cache.getCompressed(makeItem(0, 2, compressible), 0.85);
+    cache.getCompressed(makeItem(0, 1, compressible), 0.85);
+    cache.getCompressed(makeItem(0, 3, compressible), 0.85);
+    EXPECT_EQ(2u, cache.getNumItems());
+    EXPECT_EQ(1u, cache.getEvictions());
+    EXPECT_LE(cache.getMemSize(), cache.getMaxSize());
+
+    // Seqno 2 was the one evicted
+    const size_t misses = cache.getMisses();
+    cache.getCompressed(makeItem(0, 1, compressible), 0.85);
+    EXPECT_EQ(misses, cache.getMisses());
+
+    cache.setMaxSize(0);
+    EXPECT_EQ(0u, cache.getNumItems());
+    EXPECT_EQ(0u, cache.getMemSize());
+
+    // Disabled, still compresses but keeps nothing
+    EXPECT_TRUE(cache.getCompressed(makeItem(0, 1, compressible), 0.85));
+    EXPECT_EQ(0u, cache.getNumItems());
+}
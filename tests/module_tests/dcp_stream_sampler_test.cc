@@ -0,0 +1,133 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the DcpStreamSampler class.
+ */
+
+#include "config.h"
+
+#include "dcp/stream_sampler.h"
+#include "ep_time.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <gtest/gtest.h>
+
+class DcpStreamSamplerTest : public ::testing::Test {
+protected:
+    // Record count items of the given size, each queued latency seconds ago
+    void send(DcpStreamSampler::Sample& sample,
+              size_t count,
+              size_t bytes,
+              rel_time_t latency) {
+        for (size_t ii = 0; ii < count; ++ii) {
+            sample.recordItemSent(bytes, ep_current_time() - latency);
+        }
+    }
+
+    DcpStreamSampler sampler;
+    // So that items can have been queued in the past
+    TimeTraveller traveller{60};
+};
+
+// Streams are ranked by the latency of what they sent.
+TEST_F(DcpStreamSamplerTest, RanksByLatency) {
+    auto fast = sampler.add("fast", 0);
+    auto slow = sampler.add("slow", 1);
+    auto medium = sampler.add("medium", 2);
+    send(*fast, 10, 100, 0);
+    send(*slow, 10, 100, 20);
+    send(*medium, 5, 100, 2);
+    send(*medium, 5, 100, 4);
+
+    auto hottest = sampler.getHottest(2);
+    ASSERT_EQ(2, hottest.size());
+    EXPECT_EQ("slow", hottest[0].name);
+    EXPECT_EQ(1, hottest[0].vbid);
+    EXPECT_EQ(20, hottest[0].avgLatency);
+    EXPECT_EQ(20, hottest[0].maxLatency);
+    EXPECT_EQ("medium", hottest[1].name);
+    EXPECT_EQ(3, hottest[1].avgLatency);
+    EXPECT_EQ(4, hottest[1].maxLatency);
+    EXPECT_GT(hottest[1].itemsPerSec, 0);
+    EXPECT_GT(hottest[1].bytesPerSec, hottest[1].itemsPerSec);
+}
+
+// A stream which has items ready but sends none is ahead of one sending
+// promptly.
+TEST_F(DcpStreamSamplerTest, StalledStreamRanksFirst) {
+    auto sending = sampler.add("sending", 0);
+    auto stalled = sampler.add("stalled", 1);
+    send(*sending, 10, 100, 0);
+    stalled->setReadyQueueItems(1000);
+
+    auto hottest = sampler.getHottest(2);
+    ASSERT_EQ(2, hottest.size());
+    EXPECT_EQ("stalled", hottest[0].name);
+    EXPECT_EQ(1000, hottest[0].readyQueueItems);
+    EXPECT_EQ(0, hottest[0].itemsPerSec);
+}
+
+// Each read covers what was sent since the previous one.
+TEST_F(DcpStreamSamplerTest, ReadsAreIncremental) {
+    auto sample = sampler.add("stream", 0);
+    send(*sample, 10, 100, 5);
+
+    auto hottest = sampler.getHottest(1);
+    ASSERT_EQ(1, hottest.size());
+    EXPECT_EQ(5, hottest[0].avgLatency);
+    EXPECT_EQ(5, hottest[0].maxLatency);
+
+    hottest = sampler.getHottest(1);
+    ASSERT_EQ(1, hottest.size());
+    EXPECT_EQ(0, hottest[0].avgLatency);
+    EXPECT_EQ(0, hottest[0].maxLatency);
+    EXPECT_EQ(0, hottest[0].itemsPerSec);
+    EXPECT_EQ(0, hottest[0].bytesPerSec);
+
+    send(*sample, 2, 100, 1);
+    hottest = sampler.getHottest(1);
+    ASSERT_EQ(1, hottest.size());
+    EXPECT_EQ(1, hottest[0].avgLatency);
+}
+
+// Samples released by their streams are dropped.
+TEST_F(DcpStreamSamplerTest, ReleasedSamplesDropped) {
+    auto kept = sampler.add("kept", 0);
+    auto released = sampler.add("released", 1);
+    EXPECT_EQ(2, sampler.size());
+
+    released.reset();
+    auto hottest = sampler.getHottest(10);
+    ASSERT_EQ(1, hottest.size());
+    EXPECT_EQ("kept", hottest[0].name);
+    EXPECT_EQ(1, sampler.size());
+}
+
+// Adding streams drops the released samples of earlier ones, so they don't
+// pile up when nothing reads the sampler.
+TEST_F(DcpStreamSamplerTest, ReleasedSamplesDroppedOnAdd) {
+    auto kept = sampler.add("kept", 0);
+    for (int ii = 0; ii < 10000; ++ii) {
+        sampler.add("released", 1);
+    }
+    EXPECT_LT(sampler.size(), 200);
+
+    auto hottest = sampler.getHottest(10);
+    ASSERT_EQ(1, hottest.size());
+    EXPECT_EQ("kept", hottest[0].name);
+}
@@ -24,6 +24,7 @@
 
 #include "connmap.h"
 #include "dcp/dcpconnmap.h"
+#include "dcp/flow-control-manager.h"
 #include "dcp/producer.h"
 #include "dcp/stream.h"
 #include "evp_engine_test.h"
@@ -408,6 +409,293 @@ TEST_F(ConnectionTest, test_maybesendnoop_send_noop) {
     destroy_mock_cookie(cookie);
 }
 
+/*
+ * Test that a batched step sends up to the item limit from one stream, and
+ * that the stream then waits behind the others ready.
+ */
+TEST_F(ConnectionTest, test_step_batched) {
+    const void* cookie = create_mock_cookie();
+    engine->getConfiguration().setDcpProducerBatchItemLimit(4);
+    SingleThreadedRCPtr<MockDcpProducer> producer(new MockDcpProducer(
+            *engine, cookie, "test_producer", /*notifyOnly*/false));
+    std::unique_ptr<dcp_message_producers> producers(
+            get_dcp_producers(handle, engine_v1));
+
+    queued_item item(new Item(make_item(0, makeStoredDocKey("key"), "value")));
+    SingleThreadedRCPtr<MockMutationStream> stream0(
+            new MockMutationStream(*producer, 0, item, 10));
+    SingleThreadedRCPtr<MockMutationStream> stream1(
+            new MockMutationStream(*producer, 1, item, 10));
+    producer->addStream(stream0);
+    producer->addStream(stream1);
+
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(4, producer->getItemsSent());
+    EXPECT_EQ(6, stream0->getRemaining());
+    EXPECT_EQ(10, stream1->getRemaining());
+
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(8, producer->getItemsSent());
+    EXPECT_EQ(6, stream1->getRemaining());
+
+    // The byte limit ends a batch early; at least one message is sent
+    engine->getConfiguration().setDcpProducerBatchByteLimit(1);
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(5, stream0->getRemaining());
+
+    destroy_mock_cookie(cookie);
+}
+
+/*
+ * Test that a batched step stops once the buffer log is full.
+ */
+TEST_F(ConnectionTest, test_step_batched_flow_control) {
+    const void* cookie = create_mock_cookie();
+    engine->getConfiguration().setDcpProducerBatchItemLimit(4);
+    SingleThreadedRCPtr<MockDcpProducer> producer(new MockDcpProducer(
+            *engine, cookie, "test_producer", /*notifyOnly*/false));
+    std::unique_ptr<dcp_message_producers> producers(
+            get_dcp_producers(handle, engine_v1));
+
+    queued_item item(new Item(make_item(0, makeStoredDocKey("key"), "value")));
+    const size_t size = MutationResponse(item, 0).getMessageSize();
+    const std::string bufferSize = std::to_string(size * 2);
+    ASSERT_EQ(ENGINE_SUCCESS,
+              producer->control(0, "connection_buffer_size",
+                                sizeof("connection_buffer_size"),
+                                bufferSize.data(), bufferSize.size()));
+
+    SingleThreadedRCPtr<MockMutationStream> stream(
+            new MockMutationStream(*producer, 0, item, 10));
+    producer->addStream(stream);
+
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(8, stream->getRemaining());
+
+    // Full, nothing more until acknowledged
+    EXPECT_EQ(ENGINE_SUCCESS, producer->step(producers.get()));
+    EXPECT_EQ(8, stream->getRemaining());
+
+    producer->bufferAcknowledgement(0, 0, size * 2);
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(6, stream->getRemaining());
+
+    destroy_mock_cookie(cookie);
+}
+
+// Mutations sent through mock_mutation_until_full, and how many more it
+// accepts before the connection's send buffer is "full" (E2BIG).
+static std::vector<uint64_t> fullTestSeqnos;
+static size_t fullTestAccept;
+static ENGINE_HANDLE* fullTestHandle;
+static ENGINE_HANDLE_V1* fullTestHandleV1;
+
+static ENGINE_ERROR_CODE mock_mutation_until_full(const void* cookie,
+                                                  uint32_t opaque,
+                                                  item* itm,
+                                                  uint16_t vbucket,
+                                                  uint64_t by_seqno,
+                                                  uint64_t rev_seqno,
+                                                  uint32_t lock_time,
+                                                  const void* meta,
+                                                  uint16_t nmeta,
+                                                  uint8_t nru) {
+    // The server takes the Item whether or not it is sent
+    fullTestHandleV1->release(fullTestHandle, cookie, itm);
+    if (fullTestAccept == 0) {
+        return ENGINE_E2BIG;
+    }
+    --fullTestAccept;
+    fullTestSeqnos.push_back(by_seqno);
+    return ENGINE_SUCCESS;
+}
+
+/*
+ * Test that when the connection's buffer fills (E2BIG) or the buffer log
+ * fills part way through a batch, the unsent responses are kept and sent
+ * in order by later steps.
+ */
+TEST_F(ConnectionTest, test_step_batched_partial_send) {
+    const void* cookie = create_mock_cookie();
+    engine->getConfiguration().setDcpProducerBatchItemLimit(4);
+    SingleThreadedRCPtr<MockDcpProducer> producer(new MockDcpProducer(
+            *engine, cookie, "test_producer", /*notifyOnly*/false));
+    std::unique_ptr<dcp_message_producers> producers(
+            get_dcp_producers(handle, engine_v1));
+    producers->mutation = mock_mutation_until_full;
+    fullTestHandle = handle;
+    fullTestHandleV1 = engine_v1;
+    fullTestSeqnos.clear();
+
+    queued_item item(new Item(make_item(0, makeStoredDocKey("key"), "value")));
+    const size_t size = MutationResponse(item, 0).getMessageSize();
+    const std::string bufferSize = std::to_string(size * 6);
+    ASSERT_EQ(ENGINE_SUCCESS,
+              producer->control(0, "connection_buffer_size",
+                                sizeof("connection_buffer_size"),
+                                bufferSize.data(), bufferSize.size()));
+
+    SingleThreadedRCPtr<MockMutationStream> stream(
+            new MockMutationStream(*producer, 0, item, 10));
+    producer->addStream(stream);
+
+    // E2BIG on the third of a batch of four: the first two are reported
+    fullTestAccept = 2;
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(std::vector<uint64_t>({1, 2}), fullTestSeqnos);
+    EXPECT_EQ(6, stream->getRemaining());
+
+    // Still full: nothing sent, nothing lost
+    fullTestAccept = 0;
+    EXPECT_EQ(ENGINE_E2BIG, producer->step(producers.get()));
+    EXPECT_EQ(2u, fullTestSeqnos.size());
+
+    // The rest of the batch goes first, before anything new is taken
+    fullTestAccept = 100;
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(std::vector<uint64_t>({1, 2, 3, 4}), fullTestSeqnos);
+    EXPECT_EQ(6, stream->getRemaining());
+
+    // The buffer log has room for two more of the next batch
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(std::vector<uint64_t>({1, 2, 3, 4, 5, 6}), fullTestSeqnos);
+    EXPECT_EQ(4, stream->getRemaining());
+    EXPECT_EQ(ENGINE_SUCCESS, producer->step(producers.get()));
+
+    producer->bufferAcknowledgement(0, 0, size * 6);
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(std::vector<uint64_t>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}),
+              fullTestSeqnos);
+    EXPECT_EQ(0, stream->getRemaining());
+
+    destroy_mock_cookie(cookie);
+}
+
+/*
+ * Test that the adaptive flow control policy sizes a buffer to twice the
+ * measured bandwidth-delay product, within the min and max sizes and the
+ * aggr memory threshold.
+ */
+TEST_F(ConnectionTest, test_flow_control_adaptive) {
+    const void* cookie = create_mock_cookie();
+    auto& config = engine->getConfiguration();
+    const size_t defaultSize = config.getDcpConnBufferSize();
+    const size_t minSize = config.getDcpConnBufferSizeAdaptiveMin();
+    const size_t maxSize = config.getDcpConnBufferSizeMax();
+    engine->getEpStats().setMaxDataSize(2000000000);
+
+    DcpFlowControlManagerAdaptive manager(*engine);
+    SingleThreadedRCPtr<MockDcpConsumer> consumer(
+            new MockDcpConsumer(*engine, cookie, "test_consumer"));
+    consumer->setFlowControlBufSize(manager.newConsumerConn(consumer.get()));
+    EXPECT_EQ(defaultSize, consumer->getFlowControlBufSize());
+
+    manager.handleBdpMeasurement(consumer.get(), defaultSize);
+    EXPECT_EQ(defaultSize * 2, consumer->getFlowControlBufSize());
+
+    // Small changes are ignored
+    manager.handleBdpMeasurement(consumer.get(), defaultSize + 1);
+    EXPECT_EQ(defaultSize * 2, consumer->getFlowControlBufSize());
+
+    manager.handleBdpMeasurement(consumer.get(), maxSize);
+    EXPECT_EQ(maxSize, consumer->getFlowControlBufSize());
+
+    // A fast link shrinks the buffer, as far as the adaptive min
+    manager.handleBdpMeasurement(consumer.get(), 0);
+    EXPECT_EQ(minSize, consumer->getFlowControlBufSize());
+
+    // No growth beyond the aggr memory threshold (10% of quota)
+    engine->getEpStats().setMaxDataSize(defaultSize * 15);
+    manager.handleBdpMeasurement(consumer.get(), maxSize);
+    EXPECT_EQ(defaultSize * 3 / 2, consumer->getFlowControlBufSize());
+
+    manager.handleDisconnect(consumer.get());
+    destroy_mock_cookie(cookie);
+}
+
+class FlowControlAdaptiveTest : public ConnectionTest {
+protected:
+    void SetUp() override {
+        config_string += "dcp_flow_control_policy=adaptive";
+        ConnectionTest::SetUp();
+    }
+};
+
+/*
+ * Test that a consumer times the round trip of its buffer size control
+ * message from the producer's response, and with the drain rate measured
+ * by its buffer acks resizes its buffer and sends the producer the new size.
+ */
+TEST_F(FlowControlAdaptiveTest, test_flow_control_adaptive_round_trip) {
+    const void* cookie = create_mock_cookie();
+    const size_t defaultSize =
+            engine->getConfiguration().getDcpConnBufferSize();
+    SingleThreadedRCPtr<MockDcpConsumer> consumer(
+            new MockDcpConsumer(*engine, cookie, "test_consumer"));
+    std::unique_ptr<dcp_message_producers> producers(
+            get_dcp_producers(handle, engine_v1));
+
+    // The buffer size is the first message sent
+    ASSERT_EQ(ENGINE_WANT_MORE, consumer->step(producers.get()));
+    ASSERT_EQ(PROTOCOL_BINARY_CMD_DCP_CONTROL, dcp_last_op);
+    ASSERT_EQ(std::to_string(defaultSize), dcp_last_value);
+
+    // The producer responds at least 20ms later
+    usleep(20000);
+    protocol_binary_response_header resp{};
+    resp.response.magic = PROTOCOL_BINARY_RES;
+    resp.response.opcode = PROTOCOL_BINARY_CMD_DCP_CONTROL;
+    resp.response.opaque = dcp_last_opaque;
+    EXPECT_TRUE(consumer->handleResponse(&resp));
+
+    // Nothing drained yet, so the buffer keeps its size
+    EXPECT_EQ(defaultSize, consumer->getFlowControlBufSize());
+
+    // Drain 30% of the buffer, which is acked. That took at least the 20ms,
+    // so the bandwidth-delay product is at most 30% of the buffer and it
+    // shrinks.
+    consumer->getFlowControl().incrFreedBytes(defaultSize * 3 / 10);
+    ASSERT_EQ(ENGINE_WANT_MORE, consumer->step(producers.get()));
+    ASSERT_EQ(PROTOCOL_BINARY_CMD_DCP_BUFFER_ACKNOWLEDGEMENT, dcp_last_op);
+    const size_t newSize = consumer->getFlowControlBufSize();
+    EXPECT_LT(newSize, defaultSize);
+
+    // The producer is told the new size
+    ASSERT_EQ(ENGINE_WANT_MORE, consumer->step(producers.get()));
+    EXPECT_EQ(PROTOCOL_BINARY_CMD_DCP_CONTROL, dcp_last_op);
+    EXPECT_EQ(std::to_string(newSize), dcp_last_value);
+
+    destroy_mock_cookie(cookie);
+}
+
+/*
+ * Test that the disk scans of a shard are limited across connections, and
+ * that a scan given back can be claimed again.
+ */
+TEST_F(ConnectionTest, test_backfill_disk_scans_per_shard) {
+    auto& connMap = engine->getDcpConnMap();
+    engine->getConfiguration().setDcpBackfillDiskScansPerShard(2);
+
+    EXPECT_TRUE(connMap.tryAcquireDiskScan(0));
+    EXPECT_TRUE(connMap.tryAcquireDiskScan(0));
+    EXPECT_FALSE(connMap.tryAcquireDiskScan(0));
+
+    // Each shard has its own limit
+    EXPECT_TRUE(connMap.tryAcquireDiskScan(1));
+
+    connMap.releaseDiskScan(0);
+    EXPECT_TRUE(connMap.tryAcquireDiskScan(0));
+
+    // 0 means no limit
+    engine->getConfiguration().setDcpBackfillDiskScansPerShard(0);
+    EXPECT_TRUE(connMap.tryAcquireDiskScan(0));
+
+    connMap.releaseDiskScan(0);
+    connMap.releaseDiskScan(0);
+    connMap.releaseDiskScan(0);
+    connMap.releaseDiskScan(1);
+}
+
 TEST_F(ConnectionTest, test_maybesendnoop_noop_already_pending) {
     const void* cookie = create_mock_cookie();
     // Create a Mock Dcp producer
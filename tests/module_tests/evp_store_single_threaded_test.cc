@@ -735,6 +735,81 @@ TEST_F(SingleThreadedEPBucketTest, MB18452_yield_dcp_processor) {
     consumer->closeStream(/*opaque*/0, vbid);
 }
 
+/*
+ * Test that a consumer schedules dcp_consumer_processor_tasks Processor
+ * tasks.
+ */
+TEST_F(SingleThreadedEPBucketTest, dcp_consumer_processor_tasks) {
+    auto& lpNonioQ = *task_executor->getLpTaskQ()[NONIO_TASK_IDX];
+    const size_t before = lpNonioQ.getFutureQueueSize();
+
+    engine->getConfiguration().setDcpConsumerProcessorTasks(3);
+    dcp_consumer_t consumer = new MockDcpConsumer(*engine, cookie, "test");
+    EXPECT_EQ(before + 3, lpNonioQ.getFutureQueueSize());
+
+    consumer->cancelTask();
+}
+
+/*
+ * Test that a Processor task skips a vbucket whose buffered messages
+ * another Processor task is applying, so each vbucket's messages are only
+ * ever applied in order.
+ */
+TEST_F(SingleThreadedEPBucketTest, dcp_processor_skips_claimed_vbucket) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_replica);
+
+    dcp_consumer_t consumer = new MockDcpConsumer(*engine, cookie, "test");
+    auto* mockConsumer = static_cast<MockDcpConsumer*>(consumer.get());
+    EXPECT_EQ(ENGINE_SUCCESS,
+              consumer->addStream(/*opaque*/0, vbid, /*flags*/0));
+
+    // Force the stream to buffer a snapshot of one mutation
+    const ssize_t queueCap = engine->getEpStats().replicationThrottleWriteQueueCap;
+    engine->getEpStats().replicationThrottleWriteQueueCap = 0;
+
+    consumer->snapshotMarker(/*opaque*/1, vbid, /*startseq*/0,
+                             /*endseq*/1, /*flags*/0);
+    const std::string key = "key";
+    const DocKey docKey{key, DocNamespace::DefaultCollection};
+    const std::string value = "value";
+    consumer->mutation(1/*opaque*/,
+                       docKey,
+                       {(const uint8_t*)value.c_str(), value.length()},
+                       0, // privileged bytes
+                       PROTOCOL_BINARY_RAW_BYTES, // datatype
+                       0, // cas
+                       vbid, // vbucket
+                       0, // flags
+                       1, // bySeqno
+                       0, // revSeqno
+                       0, // exptime
+                       0, // locktime
+                       {}, // meta
+                       0); // nru
+
+    engine->getEpStats().replicationThrottleWriteQueueCap = queueCap;
+
+    auto stream = mockConsumer->getVbucketStream(vbid);
+    ASSERT_TRUE(stream->hasBufferedMessages());
+
+    // Whilst another task holds the stream nothing is applied
+    ASSERT_TRUE(stream->claimBufferedMessages());
+    EXPECT_EQ(all_processed, consumer->processBufferedItems());
+    EXPECT_TRUE(stream->hasBufferedMessages());
+    EXPECT_FALSE(stream->claimBufferedMessages());
+
+    // Once it lets go the messages are applied
+    stream->releaseBufferedMessages();
+    mockConsumer->public_notifyVbucketReady(vbid);
+    EXPECT_EQ(more_to_process, consumer->processBufferedItems());
+    EXPECT_FALSE(stream->hasBufferedMessages());
+    EXPECT_TRUE(stream->claimBufferedMessages());
+    stream->releaseBufferedMessages();
+
+    // Drop the stream
+    consumer->closeStream(/*opaque*/0, vbid);
+}
+
 /*
  * Background thread used by MB20054_onDeleteItem_during_bucket_deletion
  */
@@ -747,6 +747,73 @@ TEST_P(EPStoreEvictionTest, mb22824) {
     EXPECT_EQ(itemMeta1.cas, itemMeta2.cas);
 }
 
+class EPStoreCompressionTest : public EPBucketTest {
+    void SetUp() override {
+        config_string += "compression_mode=active";
+        EPBucketTest::SetUp();
+        store->setVBucketState(vbid, vbucket_state_active, false);
+    }
+};
+
+// Values which compress well are held compressed, others as they are.
+TEST_F(EPStoreCompressionTest, ValuesHeldCompressed) {
+    const std::string value(1024, 'x');
+    store_item(vbid, makeStoredDocKey("compressible"), value);
+    store_item(vbid, makeStoredDocKey("incompressible"), "x");
+
+    auto vb = store->getVBucket(vbid);
+    auto* sv = vb->ht.find(makeStoredDocKey("compressible"),
+                           TrackReference::No,
+                           WantsDeleted::No);
+    ASSERT_NE(nullptr, sv);
+    EXPECT_TRUE(mcbp::datatype::is_snappy(sv->getDatatype()));
+    EXPECT_TRUE(mcbp::datatype::is_json(sv->getDatatype()));
+    EXPECT_LT(sv->valuelen(), value.size());
+
+    sv = vb->ht.find(makeStoredDocKey("incompressible"),
+                     TrackReference::No,
+                     WantsDeleted::No);
+    ASSERT_NE(nullptr, sv);
+    EXPECT_FALSE(mcbp::datatype::is_snappy(sv->getDatatype()));
+
+    // A client which hasn't negotiated snappy gets the original value.
+    mock_set_datatype_support(cookie, PROTOCOL_BINARY_DATATYPE_JSON);
+    item* itm = nullptr;
+    ASSERT_EQ(ENGINE_SUCCESS,
+              engine->get(cookie,
+                          &itm,
+                          makeStoredDocKey("compressible"),
+                          vbid,
+                          TRACK_STATISTICS));
+    auto* fetched = reinterpret_cast<Item*>(itm);
+    EXPECT_FALSE(mcbp::datatype::is_snappy(fetched->getDataType()));
+    EXPECT_EQ(value, std::string(fetched->getData(), fetched->getNBytes()));
+    engine->itemRelease(cookie, itm);
+}
+
+// Compressed values are persisted as-is and read back still compressed.
+TEST_F(EPStoreCompressionTest, PersistedCompressed) {
+    const std::string value(1024, 'x');
+    const auto key = makeStoredDocKey("key");
+    store_item(vbid, key, value);
+    flush_vbucket_to_disk(vbid);
+    evict_key(vbid, key);
+
+    auto options = static_cast<get_options_t>(QUEUE_BG_FETCH | HONOR_STATES);
+    GetValue gv = store->get(key, vbid, cookie, options);
+    ASSERT_EQ(ENGINE_EWOULDBLOCK, gv.getStatus());
+    MockGlobalTask mockTask(engine->getTaskable(),
+                            TaskId::MultiBGFetcherTask);
+    store->getVBucket(vbid)->getShard()->getBgFetcher()->run(&mockTask);
+
+    gv = store->get(key, vbid, cookie, options);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    std::unique_ptr<Item> fetched(gv.getValue());
+    EXPECT_TRUE(mcbp::datatype::is_snappy(fetched->getDataType()));
+    ASSERT_TRUE(fetched->decompressValue());
+    EXPECT_EQ(value, std::string(fetched->getData(), fetched->getNBytes()));
+}
+
 // Test cases which run in both Full and Value eviction
 INSTANTIATE_TEST_CASE_P(FullAndValueEviction,
                         EPStoreEvictionTest,
@@ -21,6 +21,10 @@
 
 #include "executorpool_test.h"
 
+#include <numeric>
+#include <set>
+#include <thread>
+
 class LambdaTask : public GlobalTask {
 public:
     LambdaTask(Taskable& t,
@@ -71,6 +75,10 @@ void MockTaskable::logQTime(TaskId id, const ProcessClock::duration enqTime) {
 void MockTaskable::logRunTime(TaskId id, const ProcessClock::duration runTime) {
 }
 
+size_t MockTaskable::getDiskIOBytes() {
+    return 0;
+}
+
 ExTask makeTask(Taskable& taskable, ThreadGate& tg, size_t i) {
     return new LambdaTask(taskable, TaskId::StatSnap, 0, true, [&]() -> bool {
         tg.threadUp();
@@ -230,3 +238,527 @@ TEST_F(ExecutorPoolDynamicWorkerTest, new_worker_naming_test) {
     EXPECT_TRUE(pool->threadExists("writer_worker_0"));
     EXPECT_TRUE(pool->threadExists("writer_worker_1"));
 }
+
+/*
+ * Push a large number of short tasks through the NonIO threads and check
+ * every one runs exactly once, with and without work stealing. The time
+ * taken is recorded as the "elapsed_ms" test property, so the two modes can
+ * be compared.
+ */
+TEST_P(ExecutorPoolWorkStealingTest, many_short_tasks) {
+    const size_t numTasks = 20000;
+    TestExecutorPool pool(8, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          1, // MaxNumReaders
+                          1, // MaxNumWriters
+                          1, // MaxNumAuxio
+                          4, // MaxNumNonio
+                          GetParam());
+
+    MockTaskable taskable;
+    pool.registerTaskable(taskable);
+
+    std::atomic<size_t> runs{0};
+    const auto start = ProcessClock::now();
+    for (size_t i = 0; i < numTasks; ++i) {
+        ExTask task = new LambdaTask(
+                taskable, TaskId::Processor, 0, true, [&runs]() -> bool {
+                    ++runs;
+                    return false;
+                });
+        pool.schedule(task);
+    }
+
+    const auto deadline = start + std::chrono::seconds(30);
+    while (runs < numTasks && ProcessClock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const auto elapsed = ProcessClock::now() - start;
+
+    EXPECT_EQ(numTasks, runs) << "Timeout waiting for tasks to run";
+    RecordProperty("elapsed_ms",
+                   int(std::chrono::duration_cast<std::chrono::milliseconds>(
+                               elapsed)
+                               .count()));
+
+    pool.unregisterTaskable(taskable, false);
+    EXPECT_EQ(numTasks, runs);
+}
+
+INSTANTIATE_TEST_CASE_P(WorkStealing,
+                        ExecutorPoolWorkStealingTest,
+                        ::testing::Bool(), );
+
+/*
+ * Serve two taskables by deficit round-robin, where each of A's tasks costs
+ * a whole quantum and each of B's costs a quarter: B should run four tasks
+ * for every one of A's.
+ */
+TEST_F(ExecutorPoolTest, fair_share_ready_queue) {
+    GroupTaskable taskableA;
+    GroupTaskable taskableB;
+    FairShareReadyQueue queue(true);
+
+    const size_t numTasks = 10;
+    for (size_t i = 0; i < numTasks; ++i) {
+        queue.push(new LambdaTask(taskableA, TaskId::Processor, 0, true,
+                                  []() -> bool { return false; }));
+        queue.push(new LambdaTask(taskableB, TaskId::Processor, 0, true,
+                                  []() -> bool { return false; }));
+    }
+    EXPECT_EQ(2 * numTasks, queue.size());
+    // Both taskables have ready tasks, so none can be batched ahead.
+    EXPECT_TRUE(queue.isContended());
+
+    size_t runsA = 0;
+    size_t runsB = 0;
+    for (size_t i = 0; i < numTasks; ++i) {
+        ExTask task = queue.top();
+        queue.pop();
+        const task_gid_t gid = task->getTaskable().getGID();
+        if (gid == taskableA.getGID()) {
+            ++runsA;
+            queue.charge(gid, 1.0);
+        } else {
+            ++runsB;
+            queue.charge(gid, 0.25);
+        }
+    }
+    EXPECT_EQ(2u, runsA);
+    EXPECT_EQ(8u, runsB);
+    EXPECT_EQ(numTasks, queue.size());
+}
+
+/*
+ * Without fair share the ready queue is ordered only by task priority (and
+ * FIFO within a priority), whichever taskable the tasks belong to.
+ */
+TEST_F(ExecutorPoolTest, ready_queue_without_fair_share) {
+    GroupTaskable taskableA;
+    GroupTaskable taskableB;
+    FairShareReadyQueue queue;
+
+    std::vector<ExTask> tasks;
+    tasks.push_back(new LambdaTask(taskableA, TaskId::Processor, 0, true,
+                                   []() -> bool { return false; }));
+    tasks.push_back(new LambdaTask(taskableA, TaskId::Processor, 0, true,
+                                   []() -> bool { return false; }));
+    tasks.push_back(new LambdaTask(taskableB, TaskId::Processor, 0, true,
+                                   []() -> bool { return false; }));
+    for (auto& task : tasks) {
+        queue.push(task);
+    }
+
+    for (auto& task : tasks) {
+        queue.charge(task->getTaskable().getGID(), 100.0);
+        EXPECT_EQ(task->getId(), queue.top()->getId());
+        queue.pop();
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+/*
+ * Run tasks for two taskables through a fair share pool and check every
+ * task runs and is accounted to its own taskable.
+ */
+TEST_F(ExecutorPoolTest, fair_share_usage) {
+    const size_t numTasks = 100;
+    TestExecutorPool pool(4, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          1, // MaxNumReaders
+                          1, // MaxNumWriters
+                          1, // MaxNumAuxio
+                          1, // MaxNumNonio
+                          false, // workStealing
+                          true); // fairShare
+
+    GroupTaskable taskableA;
+    GroupTaskable taskableB;
+    pool.registerTaskable(taskableA);
+    pool.registerTaskable(taskableB);
+
+    std::atomic<size_t> runs{0};
+    for (size_t i = 0; i < numTasks; ++i) {
+        for (Taskable* taskable : {static_cast<Taskable*>(&taskableA),
+                                   static_cast<Taskable*>(&taskableB)}) {
+            ExTask task = new LambdaTask(
+                    *taskable, TaskId::Processor, 0, true, [&runs]() -> bool {
+                        ++runs;
+                        return false;
+                    });
+            pool.schedule(task);
+        }
+    }
+
+    const auto deadline = ProcessClock::now() + std::chrono::seconds(30);
+    while (runs < 2 * numTasks && ProcessClock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(2 * numTasks, runs) << "Timeout waiting for tasks to run";
+
+    // A task is accounted just after it runs, so allow for the last ones.
+    std::map<task_gid_t, TaskableUsage> usage;
+    while (ProcessClock::now() < deadline) {
+        usage = pool.getUsage();
+        if (usage[taskableA.getGID()].tasksRun == numTasks &&
+            usage[taskableB.getGID()].tasksRun == numTasks) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(numTasks, usage[taskableA.getGID()].tasksRun);
+    EXPECT_EQ(numTasks, usage[taskableB.getGID()].tasksRun);
+
+    pool.unregisterTaskable(taskableA, false);
+    pool.unregisterTaskable(taskableB, false);
+}
+
+TEST_F(ExecutorPoolTest, autoscale_workers) {
+    const std::chrono::nanoseconds target = std::chrono::milliseconds(10);
+    size_t lowPeriods = 0;
+
+    AutoscaleSample busy;
+    busy.workers = 8;
+    busy.tasksRun = 100;
+    busy.meanLatency = std::chrono::milliseconds(20);
+    busy.readyTasks = 5;
+    busy.cpuSaturated = false;
+
+    // Grow by a quarter, within the bounds
+    EXPECT_EQ(10u,
+              ExecutorPool::calcAutoscaleWorkers(
+                      busy, target, 1, 16, lowPeriods));
+    EXPECT_EQ(9u,
+              ExecutorPool::calcAutoscaleWorkers(
+                      busy, target, 1, 9, lowPeriods));
+
+    // More threads won't help if the CPUs are busy
+    busy.cpuSaturated = true;
+    EXPECT_EQ(8u,
+              ExecutorPool::calcAutoscaleWorkers(
+                      busy, target, 1, 16, lowPeriods));
+
+    // Shrink by one only once idle for a few periods, down to the minimum
+    AutoscaleSample idle;
+    idle.workers = 2;
+    idle.tasksRun = 0;
+    idle.meanLatency = std::chrono::nanoseconds(0);
+    idle.readyTasks = 0;
+    idle.cpuSaturated = false;
+    EXPECT_EQ(2u,
+              ExecutorPool::calcAutoscaleWorkers(
+                      idle, target, 1, 16, lowPeriods));
+    EXPECT_EQ(2u,
+              ExecutorPool::calcAutoscaleWorkers(
+                      idle, target, 1, 16, lowPeriods));
+    EXPECT_EQ(1u,
+              ExecutorPool::calcAutoscaleWorkers(
+                      idle, target, 1, 16, lowPeriods));
+    EXPECT_EQ(0u, lowPeriods);
+
+    idle.workers = 1;
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(1u,
+                  ExecutorPool::calcAutoscaleWorkers(
+                          idle, target, 1, 16, lowPeriods));
+    }
+
+    // A busy period starts the idle count again
+    lowPeriods = 2;
+    busy.cpuSaturated = false;
+    ExecutorPool::calcAutoscaleWorkers(busy, target, 1, 16, lowPeriods);
+    EXPECT_EQ(0u, lowPeriods);
+}
+
+/*
+ * Queue tasks behind a single NonIO thread so they wait well past their
+ * waketime, and check autoscale() gives the NonIO group another thread.
+ */
+TEST_F(ExecutorPoolTest, autoscale_grows_busy_group) {
+    AutoscaleConfig autoscale;
+    autoscale.enabled = true;
+    autoscale.latencyTarget = std::chrono::milliseconds(1);
+    autoscale.maxThreads = 4;
+    autoscale.cpuLimit = 1.0;
+
+    TestExecutorPool pool(8, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          1, // MaxNumReaders
+                          1, // MaxNumWriters
+                          1, // MaxNumAuxio
+                          1, // MaxNumNonio
+                          false, // workStealing
+                          false, // fairShare
+                          autoscale);
+
+    MockTaskable taskable;
+    pool.registerTaskable(taskable);
+
+    const size_t numTasks = 20;
+    std::atomic<size_t> runs{0};
+    for (size_t i = 0; i < numTasks; ++i) {
+        ExTask task = new LambdaTask(
+                taskable, TaskId::Processor, 0, true, [&runs]() -> bool {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                    ++runs;
+                    return false;
+                });
+        pool.schedule(task);
+    }
+
+    const auto deadline = ProcessClock::now() + std::chrono::seconds(30);
+    while (runs < numTasks && ProcessClock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(numTasks, runs) << "Timeout waiting for tasks to run";
+
+    pool.autoscale(ProcessClock::duration::zero());
+    EXPECT_EQ(2u, pool.getMaxNonIO());
+    EXPECT_EQ(1u, pool.getNumAutoscaleAdjustments());
+    EXPECT_TRUE(pool.threadExists("nonIO_worker_1"));
+
+    pool.unregisterTaskable(taskable, false);
+}
+
+/*
+ * autoscale() is run by a WorkLoadMonitor on a NonIO thread, and may remove
+ * that very thread: it must not wait for the removed threads to exit.
+ */
+TEST_F(ExecutorPoolTest, autoscale_shrinks_from_pool_thread) {
+    AutoscaleConfig autoscale;
+    autoscale.enabled = true;
+    autoscale.latencyTarget = std::chrono::seconds(1);
+    autoscale.minThreads = 1;
+
+    TestExecutorPool pool(8, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          1, // MaxNumReaders
+                          1, // MaxNumWriters
+                          1, // MaxNumAuxio
+                          2, // MaxNumNonio
+                          false, // workStealing
+                          false, // fairShare
+                          autoscale);
+
+    MockTaskable taskable;
+    pool.registerTaskable(taskable);
+    ASSERT_TRUE(pool.threadExists("nonIO_worker_1"));
+
+    std::atomic<bool> done{false};
+    ExTask task = new LambdaTask(
+            taskable, TaskId::Processor, 0, true, [&pool, &done]() -> bool {
+                // Idle for enough periods for the NonIO group to shrink.
+                for (int i = 0; i < 100 &&
+                                pool.getNumAutoscaleAdjustments() == 0;
+                     ++i) {
+                    std::this_thread::sleep_for(
+                            std::chrono::milliseconds(1));
+                    pool.autoscale(ProcessClock::duration::zero());
+                }
+                done = true;
+                return false;
+            });
+    pool.schedule(task);
+
+    const auto deadline = ProcessClock::now() + std::chrono::seconds(30);
+    while (!done && ProcessClock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(done) << "Timeout waiting for autoscale task";
+
+    EXPECT_EQ(1u, pool.getMaxNonIO());
+    EXPECT_EQ(1u, pool.getNumAutoscaleAdjustments());
+    EXPECT_FALSE(pool.threadExists("nonIO_worker_1"));
+
+    pool.unregisterTaskable(taskable, false);
+}
+
+TEST_F(ExecutorPoolTest, task_latency_histograms) {
+    using std::chrono::microseconds;
+    EXPECT_EQ(0u, TaskLatencyHistograms::binOf(microseconds(0)));
+    EXPECT_EQ(1u, TaskLatencyHistograms::binOf(microseconds(1)));
+    EXPECT_EQ(2u, TaskLatencyHistograms::binOf(microseconds(3)));
+    EXPECT_EQ(11u, TaskLatencyHistograms::binOf(microseconds(1024)));
+    EXPECT_EQ(TaskLatencyHistograms::numBins - 1,
+              TaskLatencyHistograms::binOf(std::chrono::hours(24)));
+    for (size_t bin = 1; bin < TaskLatencyHistograms::numBins - 1; ++bin) {
+        EXPECT_EQ(bin,
+                  TaskLatencyHistograms::binOf(microseconds(
+                          TaskLatencyHistograms::binStart(bin))));
+        EXPECT_EQ(bin,
+                  TaskLatencyHistograms::binOf(microseconds(
+                          TaskLatencyHistograms::binEnd(bin) - 1)));
+    }
+
+    // A power of two of shards, at least one per thread
+    EXPECT_EQ(1u, TaskLatencyHistograms(1).getNumShards());
+    EXPECT_EQ(8u, TaskLatencyHistograms(5).getNumShards());
+    EXPECT_EQ(16u, TaskLatencyHistograms(16).getNumShards());
+
+    // Every shard is summed, including out of range shard numbers
+    TaskLatencyHistograms histos(5);
+    const size_t numShards = histos.getNumShards();
+    for (size_t shard = 0; shard < 2 * numShards; ++shard) {
+        histos.record(shard,
+                      TaskId::MultiBGFetcherTask,
+                      microseconds(100),
+                      microseconds(5000));
+    }
+    TaskLatencyHistograms::Bins wait;
+    TaskLatencyHistograms::Bins run;
+    histos.getBins(TaskId::MultiBGFetcherTask, wait, run);
+    EXPECT_EQ(2 * numShards,
+              wait[TaskLatencyHistograms::binOf(microseconds(100))]);
+    EXPECT_EQ(2 * numShards,
+              run[TaskLatencyHistograms::binOf(microseconds(5000))]);
+
+    histos.getBins(TaskId::FlusherTask, wait, run);
+    EXPECT_EQ(0u, std::accumulate(wait.begin(), wait.end(), uint64_t(0)));
+    EXPECT_EQ(0u, std::accumulate(run.begin(), run.end(), uint64_t(0)));
+}
+
+/*
+ * Each of the pool's threads records into a shard of its own, however many
+ * there are of each type.
+ */
+TEST_F(ExecutorPoolTest, task_latency_shard_per_thread) {
+    TestExecutorPool pool(8, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          4, // MaxNumReaders
+                          2, // MaxNumWriters
+                          1, // MaxNumAuxio
+                          1 // MaxNumNonio
+                          );
+    MockTaskable taskable;
+    pool.registerTaskable(taskable);
+
+    const auto shards = pool.getHistoShards();
+    EXPECT_EQ(8u, shards.size());
+    EXPECT_EQ(shards.size(),
+              std::set<size_t>(shards.begin(), shards.end()).size());
+    for (auto shard : shards) {
+        EXPECT_LT(shard, pool.getTaskLatency().getNumShards());
+    }
+
+    pool.unregisterTaskable(taskable, false);
+}
+
+/*
+ * Check every task run by the pool's threads is recorded in its
+ * TaskLatencyHistograms.
+ */
+TEST_F(ExecutorPoolTest, task_latency_recorded) {
+    TestExecutorPool pool(4, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          1, // MaxNumReaders
+                          1, // MaxNumWriters
+                          1, // MaxNumAuxio
+                          2 // MaxNumNonio
+                          );
+
+    MockTaskable taskable;
+    pool.registerTaskable(taskable);
+
+    const size_t numTasks = 10;
+    for (size_t i = 0; i < numTasks; ++i) {
+        ExTask task = new LambdaTask(
+                taskable, TaskId::Processor, 0, true, []() -> bool {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    return false;
+                });
+        pool.schedule(task);
+    }
+
+    // A run is recorded just after the task returns, so poll for the last.
+    TaskLatencyHistograms::Bins wait;
+    TaskLatencyHistograms::Bins run;
+    uint64_t runs = 0;
+    const auto deadline = ProcessClock::now() + std::chrono::seconds(30);
+    while (runs < numTasks && ProcessClock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        pool.getTaskLatency().getBins(TaskId::Processor, wait, run);
+        runs = std::accumulate(run.begin(), run.end(), uint64_t(0));
+    }
+    EXPECT_EQ(numTasks, runs) << "Timeout waiting for tasks to run";
+    EXPECT_EQ(numTasks,
+              std::accumulate(wait.begin(), wait.end(), uint64_t(0)));
+
+    // Each task slept for 2ms, so none can have run in under 1024us.
+    const size_t minBin = TaskLatencyHistograms::binOf(
+            std::chrono::microseconds(1024));
+    EXPECT_EQ(0u, std::accumulate(run.begin(), run.begin() + minBin,
+                                  uint64_t(0)));
+
+    pool.unregisterTaskable(taskable, false);
+}
+
+/*
+ * Run shard tasks for two NUMA nodes through a topology-aware pool with a
+ * thread on each node, and check every run is counted as on or off node.
+ */
+TEST_F(ExecutorPoolTest, numa_aware_placement) {
+    // Two nodes of this host's CPUs, so binding works whatever the host.
+    const auto cpus = CpuTopology::detect().getCpus(0);
+    const CpuTopology topology({cpus, cpus});
+    TestExecutorPool pool(4, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          1, // MaxNumReaders
+                          2, // MaxNumWriters
+                          1, // MaxNumAuxio
+                          1, // MaxNumNonio
+                          false, // workStealing
+                          false, // fairShare
+                          AutoscaleConfig(),
+                          true, // numaAware
+                          &topology);
+
+    EXPECT_EQ(2u, pool.getNumNumaNodes());
+    EXPECT_EQ(0, pool.getShardNode(0));
+    EXPECT_EQ(1, pool.getShardNode(1));
+    EXPECT_EQ(0, pool.getShardNode(2));
+
+    MockTaskable taskable;
+    pool.registerTaskable(taskable);
+
+    const size_t numTasks = 20;
+    std::atomic<size_t> runs{0};
+    for (size_t i = 0; i < numTasks; ++i) {
+        ExTask task = new LambdaTask(
+                taskable, TaskId::FlusherTask, 0, true, [&runs]() -> bool {
+                    ++runs;
+                    return false;
+                });
+        task->setNumaNode(pool.getShardNode(i));
+        pool.schedule(task);
+    }
+    // A task without a node is run wherever and not counted.
+    ExTask anyNode = new LambdaTask(
+            taskable, TaskId::FlusherTask, 0, true, [&runs]() -> bool {
+                ++runs;
+                return false;
+            });
+    pool.schedule(anyNode);
+
+    const auto deadline = ProcessClock::now() + std::chrono::seconds(30);
+    while (runs < numTasks + 1 && ProcessClock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(numTasks + 1, runs) << "Timeout waiting for tasks to run";
+    EXPECT_EQ(numTasks,
+              pool.getNumNumaLocalTasks() + pool.getNumNumaRemoteTasks());
+
+    pool.unregisterTaskable(taskable, false);
+}
+
+TEST_F(ExecutorPoolTest, numa_unaware_placement) {
+    TestExecutorPool pool(4, // MaxThreads
+                          NUM_TASK_GROUPS,
+                          1, // MaxNumReaders
+                          1, // MaxNumWriters
+                          1, // MaxNumAuxio
+                          1 // MaxNumNonio
+                          );
+    EXPECT_EQ(0u, pool.getNumNumaNodes());
+    EXPECT_EQ(-1, pool.getShardNode(0));
+    EXPECT_EQ(-1, pool.getShardNode(1));
+}
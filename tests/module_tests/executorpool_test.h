@@ -25,6 +25,7 @@
 #include <executorthread.h>
 #include <gtest/gtest.h>
 #include <taskable.h>
+#include <taskqueue.h>
 #include "thread_gate.h"
 
 class MockTaskable : public Taskable {
@@ -45,11 +46,21 @@ public:
 
     void logRunTime(TaskId id, const ProcessClock::duration runTime);
 
+    size_t getDiskIOBytes();
+
 protected:
     std::string name;
     WorkLoadPolicy policy;
 };
 
+/// A MockTaskable with a task group of its own, for fair share tests
+class GroupTaskable : public MockTaskable {
+public:
+    task_gid_t getGID() const override {
+        return reinterpret_cast<task_gid_t>(this);
+    }
+};
+
 class TestExecutorPool : public ExecutorPool {
 public:
     TestExecutorPool(size_t maxThreads,
@@ -57,13 +68,23 @@ public:
                      size_t maxReaders,
                      size_t maxWriters,
                      size_t maxAuxIO,
-                     size_t maxNonIO)
+                     size_t maxNonIO,
+                     bool workStealing = false,
+                     bool fairShare = false,
+                     const AutoscaleConfig& autoscale = AutoscaleConfig(),
+                     bool numaAware = false,
+                     const CpuTopology* topology = nullptr)
         : ExecutorPool(maxThreads,
                        nTaskSets,
                        maxReaders,
                        maxWriters,
                        maxAuxIO,
-                       maxNonIO) {
+                       maxNonIO,
+                       workStealing,
+                       fairShare,
+                       autoscale,
+                       numaAware,
+                       topology) {
     }
 
     size_t getNumBuckets() {
@@ -84,11 +105,29 @@ public:
         return output;
     }
 
+    std::vector<size_t> getHistoShards() {
+        LockHolder lh(tMutex);
+        std::vector<size_t> shards;
+        for (const auto* thread : threadQ) {
+            shards.push_back(thread->getHistoShard());
+        }
+        return shards;
+    }
+
     bool threadExists(std::string name) {
         auto names = getThreadNames();
         return std::find(names.begin(), names.end(), name) != names.end();
     }
 
+    std::map<task_gid_t, TaskableUsage> getUsage() {
+        LockHolder lh(tMutex);
+        std::map<task_gid_t, TaskableUsage> usage;
+        for (auto tq : hpTaskQ) {
+            tq->addUsage(usage);
+        }
+        return usage;
+    }
+
     ~TestExecutorPool() = default;
 };
 
@@ -145,3 +184,8 @@ struct ExpectedThreadCounts {
 class ExecutorPoolTestWithParam
         : public ExecutorPoolTest,
           public ::testing::WithParamInterface<ExpectedThreadCounts> {};
+
+/// Parameterised on whether work stealing is enabled
+class ExecutorPoolWorkStealingTest
+        : public ExecutorPoolTest,
+          public ::testing::WithParamInterface<bool> {};
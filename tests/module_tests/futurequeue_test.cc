@@ -19,46 +19,55 @@
 
 #include "futurequeue.h"
 #include "tests/module_tests/test_task.h"
+#include "timerwheel_futurequeue.h"
 
-class FutureQueueTest : public ::testing::TestWithParam<std::string> {
+#include <random>
+
+template <typename Queue>
+class FutureQueueTest : public ::testing::Test {
 public:
-    FutureQueue<> queue;
+    Queue queue;
 };
 
-TEST_F(FutureQueueTest, initAssumptions) {
-    EXPECT_EQ(0u, queue.size());
-    EXPECT_TRUE(queue.empty());
+using FutureQueueTypes = ::testing::Types<FutureQueue<>, TimerWheelFutureQueue>;
+TYPED_TEST_CASE(FutureQueueTest, FutureQueueTypes);
+
+TYPED_TEST(FutureQueueTest, initAssumptions) {
+    EXPECT_EQ(0u, this->queue.size());
+    EXPECT_TRUE(this->queue.empty());
 }
 
-TEST_F(FutureQueueTest, push1) {
+TYPED_TEST(FutureQueueTest, push1) {
     ExTask hpTask = new TestTask(nullptr,
                                  TaskId::PendingOpsNotification);
 
-    queue.push(hpTask);
-    EXPECT_EQ(1u, queue.size());
-    EXPECT_FALSE(queue.empty());
+    this->queue.push(hpTask);
+    EXPECT_EQ(1u, this->queue.size());
+    EXPECT_FALSE(this->queue.empty());
 
-    EXPECT_EQ(TaskId::PendingOpsNotification, queue.top()->getTypeId());
+    EXPECT_EQ(TaskId::PendingOpsNotification,
+              this->queue.top()->getTypeId());
 }
 
-TEST_F(FutureQueueTest, pushn) {
+TYPED_TEST(FutureQueueTest, pushn) {
     ExTask hpTask = new TestTask(nullptr,
                                  TaskId::PendingOpsNotification);
 
     const size_t n = 10;
     for (size_t i = 0; i < n; i++) {
-        queue.push(hpTask);
+        this->queue.push(hpTask);
     }
-    EXPECT_EQ(n, queue.size());
-    EXPECT_FALSE(queue.empty());
-    EXPECT_EQ(TaskId::PendingOpsNotification, queue.top()->getTypeId());
+    EXPECT_EQ(n, this->queue.size());
+    EXPECT_FALSE(this->queue.empty());
+    EXPECT_EQ(TaskId::PendingOpsNotification,
+              this->queue.top()->getTypeId());
 }
 
 /*
  * Push n TestTask objects, each with an id of their push order but with
  * a decreasing waketime, i.e. last element pushed has the smallest wakeTime.
  */
-TEST_F(FutureQueueTest, pushOrder) {
+TYPED_TEST(FutureQueueTest, pushOrder) {
     const int n = 10;
     for (int i = 0; i <= n; i++) {
         ExTask hpTask;
@@ -67,11 +76,11 @@ TEST_F(FutureQueueTest, pushOrder) {
                               i);
         const auto newtime = std::chrono::nanoseconds(n - i);
         hpTask->updateWaketime(ProcessClock::time_point(newtime));
-        queue.push(hpTask);
+        this->queue.push(hpTask);
     }
 
     // last task pushed must be the first one in the queue
-    EXPECT_EQ(n, static_cast<TestTask*>(queue.top().get())->order);
+    EXPECT_EQ(n, static_cast<TestTask*>(this->queue.top().get())->order);
 }
 
 /*
@@ -81,7 +90,7 @@ TEST_F(FutureQueueTest, pushOrder) {
  * Then use the queue updateWake time to move a task to the front
  *
  */
-TEST_F(FutureQueueTest, updateWaketime) {
+TYPED_TEST(FutureQueueTest, updateWaketime) {
     const int n = 10;
     ExTask middleTask;
     for (int i = 0; i <= n; i++) {
@@ -91,7 +100,7 @@ TEST_F(FutureQueueTest, updateWaketime) {
                               i);
         const auto newtime = std::chrono::nanoseconds((n * 2) - i);
         hpTask->updateWaketime(ProcessClock::time_point(newtime));
-        queue.push(hpTask);
+        this->queue.push(hpTask);
 
         if (i == n/2) {
             middleTask = hpTask;
@@ -101,17 +110,17 @@ TEST_F(FutureQueueTest, updateWaketime) {
     ASSERT_NE(nullptr, middleTask.get());
 
     // last task pushed must be the first one in the queue
-    EXPECT_EQ(n, static_cast<TestTask*>(queue.top().get())->order);
+    EXPECT_EQ(n, static_cast<TestTask*>(this->queue.top().get())->order);
     EXPECT_NE(static_cast<TestTask*>(middleTask.get())->order,
-              static_cast<TestTask*>(queue.top().get())->order);
+              static_cast<TestTask*>(this->queue.top().get())->order);
 
     // Now update the n/2 task's time and expect it to become the front task
-    EXPECT_TRUE(queue.updateWaketime(middleTask,
+    EXPECT_TRUE(this->queue.updateWaketime(middleTask,
                                      ProcessClock::time_point::min()));
 
     // Now the middleTask is queue.top
     EXPECT_EQ(static_cast<TestTask*>(middleTask.get())->order,
-              static_cast<TestTask*>(queue.top().get())->order);
+              static_cast<TestTask*>(this->queue.top().get())->order);
 }
 
 /*
@@ -121,7 +130,7 @@ TEST_F(FutureQueueTest, updateWaketime) {
  * Then use the snooze method to move a task from the front
  *
  */
-TEST_F(FutureQueueTest, snooze) {
+TYPED_TEST(FutureQueueTest, snooze) {
     const int n = 10;
 
     for (int i = 0; i <= n; i++) {
@@ -131,26 +140,26 @@ TEST_F(FutureQueueTest, snooze) {
                               i);
         const auto newtime = std::chrono::nanoseconds((n * 2) - i);
         hpTask->updateWaketime(ProcessClock::time_point(newtime));
-        queue.push(hpTask);
+        this->queue.push(hpTask);
     }
 
     // Now update the top task's time and expect it to become the last task
     // we can't see the back, so will pop/top all..
-    int top = static_cast<TestTask*>(queue.top().get())->order;
-    EXPECT_TRUE(queue.snooze(queue.top(), n*3));
+    int top = static_cast<TestTask*>(this->queue.top().get())->order;
+    EXPECT_TRUE(this->queue.snooze(this->queue.top(), n*3));
 
     // The top task is not the old top
     EXPECT_NE(top,
-              static_cast<TestTask*>(queue.top().get())->order);
+              static_cast<TestTask*>(this->queue.top().get())->order);
 
     ExTask lastTask;
-    while (!queue.empty()) {
+    while (!this->queue.empty()) {
         if (lastTask) {
             EXPECT_LT(lastTask->getWaketime(),
-                      queue.top()->getWaketime());
+                      this->queue.top()->getWaketime());
         }
-        lastTask = queue.top();
-        queue.pop();
+        lastTask = this->queue.top();
+        this->queue.pop();
     }
 
     EXPECT_EQ(top, static_cast<TestTask*>(lastTask.get())->order);
@@ -159,62 +168,145 @@ TEST_F(FutureQueueTest, snooze) {
 /*
  * snooze/wake a task not in the queue, the queue is also empty.
  */
-TEST_F(FutureQueueTest, taskNotInEmptyQueue) {
+TYPED_TEST(FutureQueueTest, taskNotInEmptyQueue) {
     ExTask task = new TestTask(nullptr, TaskId::PendingOpsNotification);
 
     const auto wake = task->getWaketime();
-    queue.snooze(task, 5.0);
+    this->queue.snooze(task, 5.0);
     // snooze uses gethrtime so we'll only check that the tasks time changed.
     EXPECT_NE(wake, task->getWaketime());
 
-    EXPECT_EQ(0u, queue.size());
-    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0u, this->queue.size());
+    EXPECT_TRUE(this->queue.empty());
 
     const auto newtime = std::chrono::nanoseconds(5);
-    EXPECT_FALSE(queue.updateWaketime(task, ProcessClock::time_point(newtime)));
+    EXPECT_FALSE(this->queue.updateWaketime(task,
+                                            ProcessClock::time_point(newtime)));
     EXPECT_EQ(ProcessClock::time_point(std::chrono::nanoseconds(5)),
               task->getWaketime());
 
-    EXPECT_EQ(0u, queue.size());
-    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0u, this->queue.size());
+    EXPECT_TRUE(this->queue.empty());
 }
 
 /*
  * snooze/wake a task not in the queue
  */
-TEST_F(FutureQueueTest, taskNotInQueue) {
+TYPED_TEST(FutureQueueTest, taskNotInQueue) {
     const size_t nTasks = 5;
     for (size_t ii = 1; ii < nTasks; ii++) {
         ExTask t = new TestTask(nullptr, TaskId::PendingOpsNotification);
         const auto newtime = std::chrono::nanoseconds(1+ii);
         t->updateWaketime(ProcessClock::time_point(newtime));
-        queue.push(t);
+        this->queue.push(t);
     }
     // Finally push a task with an obvious ID value of -1
     ExTask task = new TestTask(nullptr, TaskId::PendingOpsNotification, -1);
     task->updateWaketime(ProcessClock::time_point::min());
-    queue.push(task);
+    this->queue.push(task);
 
     // Now operate with a new task not in the queue
     task = new TestTask(nullptr, TaskId::PendingOpsNotification);
     const auto wake = task->getWaketime();
-    EXPECT_FALSE(queue.snooze(task, 5.0));
+    EXPECT_FALSE(this->queue.snooze(task, 5.0));
 
     // snooze uses gethrtime so we'll only check that the tasks time changed.
     EXPECT_NE(wake, task->getWaketime());
 
-    EXPECT_EQ(nTasks, queue.size());
-    EXPECT_FALSE(queue.empty());
+    EXPECT_EQ(nTasks, this->queue.size());
+    EXPECT_FALSE(this->queue.empty());
     EXPECT_EQ(-1,
-              static_cast<TestTask*>(queue.top().get())->order);
+              static_cast<TestTask*>(this->queue.top().get())->order);
 
     const auto newtime = std::chrono::nanoseconds(5);
-    EXPECT_FALSE(queue.updateWaketime(task, ProcessClock::time_point(newtime)));
+    EXPECT_FALSE(this->queue.updateWaketime(task,
+                                            ProcessClock::time_point(newtime)));
     EXPECT_EQ(ProcessClock::time_point(std::chrono::nanoseconds(5)),
               task->getWaketime());
 
-    EXPECT_EQ(nTasks, queue.size());
-    EXPECT_FALSE(queue.empty());
+    EXPECT_EQ(nTasks, this->queue.size());
+    EXPECT_FALSE(this->queue.empty());
     EXPECT_EQ(-1,
-              static_cast<TestTask*>(queue.top().get())->order);
+              static_cast<TestTask*>(this->queue.top().get())->order);
+}
+
+/*
+ * Push tasks with wakeTimes spread from the past to many hours ahead, so
+ * that every level of a timing wheel (and its overflow) is used, and check
+ * they pop in wakeTime order.
+ */
+TYPED_TEST(FutureQueueTest, popOrderWideRange) {
+    std::mt19937_64 rng(0);
+    const auto now = ProcessClock::now();
+    const std::vector<std::chrono::milliseconds> ranges = {
+            std::chrono::milliseconds(50),
+            std::chrono::seconds(5),
+            std::chrono::minutes(10),
+            std::chrono::hours(10)};
+
+    for (int i = 0; i < 1000; i++) {
+        ExTask task = new TestTask(nullptr, TaskId::PendingOpsNotification, i);
+        const auto range = ranges[i % ranges.size()].count();
+        const auto offset = std::chrono::milliseconds(
+                static_cast<int64_t>(rng() % (2 * range)) - range);
+        task->updateWaketime(now + offset);
+        this->queue.push(task);
+    }
+
+    ExTask lastTask;
+    while (!this->queue.empty()) {
+        if (lastTask) {
+            EXPECT_LE(lastTask->getWaketime(),
+                      this->queue.top()->getWaketime());
+        }
+        lastTask = this->queue.top();
+        this->queue.pop();
+    }
+    EXPECT_EQ(0u, this->queue.size());
+}
+
+/*
+ * Benchmark-style test: push 100k tasks, snooze a subset and pop them all,
+ * recording how long each phase took. Only every 100th task is snoozed as
+ * FutureQueue's snooze is linear in the queue size.
+ */
+TYPED_TEST(FutureQueueTest, benchmark100k) {
+    const size_t numTasks = 100000;
+    std::mt19937_64 rng(0);
+    std::vector<ExTask> tasks;
+    tasks.reserve(numTasks);
+    const auto now = ProcessClock::now();
+    for (size_t i = 0; i < numTasks; i++) {
+        ExTask task = new TestTask(
+                nullptr, TaskId::PendingOpsNotification, int(i));
+        task->updateWaketime(now + std::chrono::milliseconds(rng() % 60000));
+        tasks.push_back(task);
+    }
+
+    auto start = ProcessClock::now();
+    for (auto& task : tasks) {
+        this->queue.push(task);
+    }
+    const auto pushed = ProcessClock::now() - start;
+
+    start = ProcessClock::now();
+    for (size_t i = 0; i < numTasks; i += 100) {
+        EXPECT_TRUE(this->queue.snooze(tasks[i], (rng() % 600) / 10.0));
+    }
+    const auto snoozed = ProcessClock::now() - start;
+
+    start = ProcessClock::now();
+    while (!this->queue.empty()) {
+        this->queue.pop();
+    }
+    const auto popped = ProcessClock::now() - start;
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    this->RecordProperty("push_us",
+                         int(duration_cast<microseconds>(pushed).count()));
+    this->RecordProperty("snooze_us",
+                         int(duration_cast<microseconds>(snoozed).count()));
+    this->RecordProperty("pop_us",
+                         int(duration_cast<microseconds>(popped).count()));
 }
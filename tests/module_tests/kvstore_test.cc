@@ -339,6 +339,113 @@ TEST_F(CouchKVStoreTest, CompactStatsTest) {
     EXPECT_GE(io_compaction_write_bytes, io_write_bytes);
 }
 
+// Verify that compaction leaves a file alone when too little of it is stale,
+// unless the request asks for deletes to be dropped.
+TEST_F(CouchKVStoreTest, CompactMinStaleRatio) {
+    KVStoreConfig config(
+            1, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    config.setCompactionMinStaleRatio(1.0);
+    auto kvstore = setup_kv_store(config);
+
+    kvstore->begin();
+    Item item(makeStoredDocKey("key"), 0, 0, "value", 5);
+    WriteCallback wc;
+    kvstore->set(item, wc);
+    EXPECT_TRUE(kvstore->commit(nullptr /*no collections manifest*/));
+
+    compaction_ctx cctx;
+    cctx.purge_before_seq = 0;
+    cctx.purge_before_ts = 0;
+    cctx.curr_time = 0;
+    cctx.drop_deletes = 0;
+    cctx.db_file_id = 0;
+
+    // A file can never be 100% stale, so this compaction is skipped.
+    EXPECT_TRUE(kvstore->compactDB(&cctx));
+    std::map<std::string, std::string> stats;
+    kvstore->addStats(add_stat_callback, &stats);
+    EXPECT_EQ("1", stats["rw_0:compaction_skipped"]);
+    EXPECT_EQ("0", stats["rw_0:io_compaction_write_bytes"]);
+
+    // Dropping deletes must always rewrite the file.
+    cctx.drop_deletes = 1;
+    EXPECT_TRUE(kvstore->compactDB(&cctx));
+    stats.clear();
+    kvstore->addStats(add_stat_callback, &stats);
+    EXPECT_EQ("1", stats["rw_0:compaction_skipped"]);
+    EXPECT_NE("0", stats["rw_0:io_compaction_write_bytes"]);
+}
+
+// Verify that a batched getMulti (which looks keys up in sorted order and then
+// reads bodies in file order) returns the correct value for every key,
+// including a mix of full and metadata-only fetches.
+TEST_F(CouchKVStoreTest, GetMultiMixedOrder) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    auto kvstore = setup_kv_store(config);
+
+    // Write in descending key order so file order differs from key order.
+    const int numKeys = 20;
+    kvstore->begin();
+    WriteCallback wc;
+    for (int ii = numKeys - 1; ii >= 0; --ii) {
+        const std::string value = "value" + std::to_string(ii);
+        Item item(makeStoredDocKey("key" + std::to_string(ii)),
+                  0, 0, value.c_str(), value.size());
+        kvstore->set(item, wc);
+    }
+    EXPECT_TRUE(kvstore->commit(nullptr /*no collections manifest*/));
+
+    vb_bgfetch_queue_t itms;
+    for (int ii = 0; ii < numKeys; ++ii) {
+        const bool metaOnly = (ii % 3) == 0;
+        vb_bgfetch_item_ctx_t ctx;
+        ctx.isMetaOnly = metaOnly;
+        ctx.bgfetched_list.emplace_back(
+                std::make_unique<VBucketBGFetchItem>(nullptr, metaOnly));
+        itms[makeStoredDocKey("key" + std::to_string(ii))] = std::move(ctx);
+    }
+
+    kvstore->getMulti(0, itms);
+
+    for (int ii = 0; ii < numKeys; ++ii) {
+        auto& fetched = itms[makeStoredDocKey("key" + std::to_string(ii))];
+        auto& value = fetched.bgfetched_list.front()->value;
+        ASSERT_EQ(ENGINE_SUCCESS, value.getStatus());
+        ASSERT_NE(nullptr, value.getValue());
+        if (!fetched.isMetaOnly) {
+            const std::string expected = "value" + std::to_string(ii);
+            EXPECT_EQ(expected,
+                      std::string(value.getValue()->getData(),
+                                  value.getValue()->getNBytes()));
+        }
+        fetched.bgfetched_list.front()->delValue();
+    }
+}
+
+// Verify that a persisted bloom filter is returned until further documents
+// are written to the file, after which it is treated as stale.
+TEST_F(CouchKVStoreTest, PersistBloomFilter) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    auto kvstore = setup_kv_store(config);
+
+    // No filter has been saved yet.
+    EXPECT_EQ("", kvstore->getBloomFilter(0));
+
+    const std::string filter("\x01some filter bits\x00\xff", 19);
+    EXPECT_TRUE(kvstore->persistBloomFilter(0, filter));
+    EXPECT_EQ(filter, kvstore->getBloomFilter(0));
+
+    kvstore->begin();
+    Item item(makeStoredDocKey("key"), 0, 0, "value", 5);
+    WriteCallback wc;
+    kvstore->set(item, wc);
+    EXPECT_TRUE(kvstore->commit(nullptr /*no collections manifest*/));
+
+    EXPECT_EQ("", kvstore->getBloomFilter(0));
+}
+
 // Regression test for MB-17517 - ensure that if a couchstore file has a max
 // CAS of -1, it is detected and reset to zero when file is loaded.
 TEST_F(CouchKVStoreTest, MB_17517MaxCasOfMinus1) {
@@ -1465,6 +1572,37 @@ TEST_F(CouchstoreTest, testV2WriteRead) {
     kvstore->get(key, 0, gc);
 }
 
+/*
+ * A value held snappy compressed in memory must be persisted with
+ * couchstore's compressed flag (so that any couchstore reader can
+ * decompress it) and read back as the plain value.
+ */
+TEST_F(CouchstoreTest, snappyValuePersistedCompressed) {
+    uint8_t datatype = PROTOCOL_BINARY_DATATYPE_JSON;
+    StoredDocKey key = makeStoredDocKey("key");
+    Item item(key, 0, 0, "value", 5, &datatype, 1);
+    // "value" doesn't shrink, so allow any ratio to force compression
+    ASSERT_TRUE(item.compressValue(10.0));
+    ASSERT_TRUE(mcbp::datatype::is_snappy(item.getDataType()));
+
+    WriteCallback wc;
+    kvstore->begin();
+    auto request = kvstore->setAndReturnRequest(item, wc);
+    EXPECT_TRUE(request->getDbDocInfo()->content_meta &
+                COUCH_DOC_IS_COMPRESSED);
+    EXPECT_EQ(5, request->getDbDocInfo()->size);
+    kvstore->commit(nullptr /*no collections manifest*/);
+
+    MockedGetCallback<GetValue> gc;
+    EXPECT_CALL(gc, status(ENGINE_SUCCESS));
+    EXPECT_CALL(gc, cas(_));
+    EXPECT_CALL(gc, expTime(_));
+    EXPECT_CALL(gc, flags(_));
+    EXPECT_CALL(gc, datatype(protocol_binary_datatype_t(
+                            PROTOCOL_BINARY_DATATYPE_JSON)));
+    kvstore->get(key, 0, gc);
+}
+
 class CouchKVStoreMetaData : public ::testing::Test {
 };
 
@@ -0,0 +1,370 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the SortedAccessLog classes.
+ */
+
+#include "config.h"
+
+#include "mutation_log.h"
+#include "sorted_access_log.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+
+class SortedAccessLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tmp_log_filename = "salt_test.XXXXXX";
+        ASSERT_NE(nullptr, cb_mktemp(&tmp_log_filename[0]));
+    }
+
+    void TearDown() override {
+        remove(tmp_log_filename.c_str());
+    }
+
+    // Write a log of vBuckets 0 and 2, with their keys out of seqno order
+    void writeLog() {
+        SortedAccessLogWriter writer(tmp_log_filename);
+        ASSERT_TRUE(writer.open());
+        writer.beginVBucket(0);
+        writer.add(30, makeStoredDocKey("c"));
+        writer.add(10, makeStoredDocKey("a"));
+        writer.add(20, makeStoredDocKey("bb"));
+        writer.beginVBucket(2);
+        writer.add(5, makeStoredDocKey("key5"), 3);
+        writer.endVBucket();
+        EXPECT_EQ(4, writer.getItemsLogged());
+        ASSERT_TRUE(writer.close());
+    }
+
+    std::string readFile() {
+        std::ifstream file(tmp_log_filename, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string& contents) {
+        std::ofstream file(tmp_log_filename,
+                           std::ios::binary | std::ios::trunc);
+        file << contents;
+    }
+
+    void lookup(SortedAccessLogLookup& cl,
+                const std::string& key,
+                int64_t seqno,
+                ENGINE_ERROR_CODE expected) {
+        CacheLookup cacheLookup(makeStoredDocKey(key), seqno, 0);
+        cl.callback(cacheLookup);
+        EXPECT_EQ(expected, cl.getStatus()) << key << ":" << seqno;
+    }
+
+    std::string tmp_log_filename;
+};
+
+TEST_F(SortedAccessLogTest, WriteAndRead) {
+    writeLog();
+    ASSERT_TRUE(SortedAccessLog::isSortedAccessLog(tmp_log_filename));
+
+    SortedAccessLog alog(tmp_log_filename);
+    alog.open();
+    EXPECT_EQ(4, alog.getNumEntries());
+    EXPECT_EQ(std::vector<uint16_t>({0, 2}), alog.getVBuckets());
+
+    // Keys come back in seqno order
+    auto vb0 = alog.getVBucket(0);
+    ASSERT_EQ(3, vb0.size());
+    std::vector<uint64_t> seqnos;
+    std::vector<StoredDocKey> keys;
+    for (const auto& entry : vb0) {
+        seqnos.push_back(entry.bySeqno);
+        keys.push_back(vb0.getKey(entry));
+    }
+    EXPECT_EQ(std::vector<uint64_t>({10, 20, 30}), seqnos);
+    EXPECT_EQ(makeStoredDocKey("a"), keys[0]);
+    EXPECT_EQ(makeStoredDocKey("bb"), keys[1]);
+    EXPECT_EQ(makeStoredDocKey("c"), keys[2]);
+
+    auto vb2 = alog.getVBucket(2);
+    ASSERT_EQ(1, vb2.size());
+    EXPECT_EQ(5, vb2.begin()->bySeqno);
+    EXPECT_EQ(3, vb2.begin()->score);
+    EXPECT_TRUE(vb2.keyEquals(*vb2.begin(), makeStoredDocKey("key5")));
+    EXPECT_FALSE(vb2.keyEquals(*vb2.begin(), makeStoredDocKey("key6")));
+
+    EXPECT_TRUE(alog.getVBucket(1).empty());
+    EXPECT_TRUE(alog.getVBucket(1023).empty());
+}
+
+TEST_F(SortedAccessLogTest, EmptyLog) {
+    SortedAccessLogWriter writer(tmp_log_filename);
+    ASSERT_TRUE(writer.open());
+    ASSERT_TRUE(writer.close());
+
+    SortedAccessLog alog(tmp_log_filename);
+    alog.open();
+    EXPECT_EQ(0, alog.getNumEntries());
+    EXPECT_TRUE(alog.getVBuckets().empty());
+}
+
+TEST_F(SortedAccessLogTest, MissingFile) {
+    remove(tmp_log_filename.c_str());
+    EXPECT_FALSE(SortedAccessLog::isSortedAccessLog(tmp_log_filename));
+    SortedAccessLog alog(tmp_log_filename);
+    EXPECT_THROW(alog.open(), SortedAccessLog::ReadException);
+}
+
+// A MutationLog format access log isn't mistaken for one.
+TEST_F(SortedAccessLogTest, MutationLogNotSorted) {
+    {
+        MutationLog ml(tmp_log_filename);
+        ml.open();
+        ml.newItem(0, makeStoredDocKey("key"));
+        ml.commit1();
+        ml.commit2();
+    }
+    EXPECT_FALSE(SortedAccessLog::isSortedAccessLog(tmp_log_filename));
+}
+
+TEST_F(SortedAccessLogTest, Truncated) {
+    writeLog();
+    const auto contents = readFile();
+    writeFile(contents.substr(0, contents.size() - 4));
+
+    // Still claims to be one, but can't be read
+    EXPECT_TRUE(SortedAccessLog::isSortedAccessLog(tmp_log_filename));
+    SortedAccessLog alog(tmp_log_filename);
+    EXPECT_THROW(alog.open(), SortedAccessLog::ReadException);
+}
+
+TEST_F(SortedAccessLogTest, CorruptIndex) {
+    writeLog();
+    auto contents = readFile();
+    // The vbid of the first index entry, which precedes the footer
+    const size_t footerSize = 8 + 8 + 4 + 4 + 8;
+    const size_t indexEntrySize = 2 + 2 + 4 + 8 + 8 + 8;
+    contents[contents.size() - footerSize - 2 * indexEntrySize] ^= 0x1;
+    writeFile(contents);
+
+    SortedAccessLog alog(tmp_log_filename);
+    EXPECT_THROW(alog.open(), SortedAccessLog::ReadException);
+}
+
+// The lookup passes only the logged documents, and ends the scan after the
+// last of them.
+TEST_F(SortedAccessLogTest, Lookup) {
+    writeLog();
+    SortedAccessLog alog(tmp_log_filename);
+    alog.open();
+
+    SortedAccessLogLookup cl(alog.getVBucket(0));
+    EXPECT_EQ(10, cl.getStartSeqno());
+
+    lookup(cl, "a", 10, ENGINE_SUCCESS);
+    // Not logged
+    lookup(cl, "x", 15, ENGINE_KEY_EEXISTS);
+    // Logged seqno but a different key - "bb" was since updated
+    lookup(cl, "y", 20, ENGINE_KEY_EEXISTS);
+    lookup(cl, "c", 30, ENGINE_SUCCESS);
+    EXPECT_FALSE(cl.isFinished());
+    lookup(cl, "d", 31, ENGINE_ENOMEM);
+    EXPECT_TRUE(cl.isFinished());
+    EXPECT_EQ(2, cl.getNumMatched());
+}
+
+// Given a score, the lookup passes only the logged documents with that
+// score.
+TEST_F(SortedAccessLogTest, LookupByScore) {
+    {
+        SortedAccessLogWriter writer(tmp_log_filename);
+        ASSERT_TRUE(writer.open());
+        writer.beginVBucket(0);
+        writer.add(10, makeStoredDocKey("a"), 1);
+        writer.add(20, makeStoredDocKey("b"), 3);
+        writer.add(30, makeStoredDocKey("c"), 1);
+        writer.add(40, makeStoredDocKey("d"), 3);
+        ASSERT_TRUE(writer.close());
+    }
+    SortedAccessLog alog(tmp_log_filename);
+    alog.open();
+
+    SortedAccessLogLookup hot(alog.getVBucket(0), 3);
+    ASSERT_TRUE(hot.hasEntries());
+    EXPECT_EQ(20, hot.getStartSeqno());
+    lookup(hot, "b", 20, ENGINE_SUCCESS);
+    lookup(hot, "c", 30, ENGINE_KEY_EEXISTS);
+    lookup(hot, "d", 40, ENGINE_SUCCESS);
+    lookup(hot, "e", 50, ENGINE_ENOMEM);
+    EXPECT_EQ(2, hot.getNumMatched());
+
+    SortedAccessLogLookup warm(alog.getVBucket(0), 1);
+    EXPECT_EQ(10, warm.getStartSeqno());
+    lookup(warm, "a", 10, ENGINE_SUCCESS);
+    lookup(warm, "b", 20, ENGINE_KEY_EEXISTS);
+    lookup(warm, "c", 30, ENGINE_SUCCESS);
+    // Nothing of this score after "c"
+    lookup(warm, "d", 40, ENGINE_ENOMEM);
+    EXPECT_TRUE(warm.isFinished());
+
+    SortedAccessLogLookup none(alog.getVBucket(0), 2);
+    EXPECT_FALSE(none.hasEntries());
+}
+
+// Without a score the lookup passes every logged document, and tells the
+// score each was logged with.
+class SortedAccessLogSetTest : public SortedAccessLogTest {
+protected:
+    void TearDown() override {
+        for (size_t ii = 1; ii <= 3; ++ii) {
+            remove(SortedAccessLogSet::getSegmentPath(tmp_log_filename, ii)
+                           .c_str());
+        }
+        remove(compacted.c_str());
+        SortedAccessLogTest::TearDown();
+    }
+
+    // Write a segment with a key for each of the given vBuckets, named
+    // after the segment
+    void writeSegment(size_t segment, const std::vector<uint16_t>& vbs) {
+        SortedAccessLogWriter writer(
+                SortedAccessLogSet::getSegmentPath(tmp_log_filename, segment));
+        ASSERT_TRUE(writer.open());
+        for (auto vb : vbs) {
+            writer.beginVBucket(vb);
+            writer.add(100 + segment,
+                       makeStoredDocKey("seg" + std::to_string(segment)));
+        }
+        ASSERT_TRUE(writer.close());
+    }
+
+    std::string keyOf(const SortedAccessLogSet& alog, uint16_t vbid) {
+        const auto entries = alog.getVBucket(vbid);
+        if (entries.size() != 1) {
+            return "entries:" + std::to_string(entries.size());
+        }
+        return entries.getKey(*entries.begin()).c_str();
+    }
+
+    const std::string compacted = tmp_log_filename + ".compacted";
+};
+
+// Each vBucket's keys come from the newest file with a section for it.
+TEST_F(SortedAccessLogSetTest, NewestSectionWins) {
+    writeLog();
+    writeSegment(1, {0, 1});
+    writeSegment(2, {1});
+    // Missing segment 3 ends the set
+    {
+        SortedAccessLogWriter writer(
+                SortedAccessLogSet::getSegmentPath(tmp_log_filename, 4));
+        ASSERT_TRUE(writer.open());
+        ASSERT_TRUE(writer.close());
+    }
+    EXPECT_EQ(2, SortedAccessLogSet::countSegments(tmp_log_filename));
+    remove(SortedAccessLogSet::getSegmentPath(tmp_log_filename, 4).c_str());
+
+    SortedAccessLogSet alog(tmp_log_filename);
+    alog.open();
+    EXPECT_EQ(2, alog.getNumSegments());
+    EXPECT_EQ(std::vector<uint16_t>({0, 1, 2}), alog.getVBuckets());
+    EXPECT_EQ("seg1", keyOf(alog, 0));
+    EXPECT_EQ("seg2", keyOf(alog, 1));
+    // Only in the main log
+    EXPECT_EQ("key5", keyOf(alog, 2));
+    EXPECT_TRUE(alog.getVBucket(3).empty());
+}
+
+// A vBucket which had nothing to log still replaces older keys.
+TEST_F(SortedAccessLogSetTest, EmptySectionWins) {
+    writeLog();
+    {
+        SortedAccessLogWriter writer(
+                SortedAccessLogSet::getSegmentPath(tmp_log_filename, 1));
+        ASSERT_TRUE(writer.open());
+        writer.beginVBucket(2);
+        ASSERT_TRUE(writer.close());
+    }
+    SortedAccessLogSet alog(tmp_log_filename);
+    alog.open();
+    EXPECT_TRUE(alog.getVBucket(2).empty());
+    EXPECT_EQ(3, alog.getVBucket(0).size());
+}
+
+// Segments without a main log, as before the first compaction.
+TEST_F(SortedAccessLogSetTest, SegmentsOnly) {
+    remove(tmp_log_filename.c_str());
+    EXPECT_FALSE(SortedAccessLogSet::exists(tmp_log_filename));
+    writeSegment(1, {4});
+    EXPECT_TRUE(SortedAccessLogSet::exists(tmp_log_filename));
+
+    SortedAccessLogSet alog(tmp_log_filename);
+    alog.open();
+    EXPECT_EQ("seg1", keyOf(alog, 4));
+}
+
+// Segments beside a MutationLog main log don't make a set, which would
+// leave out the vBuckets only the MutationLog lists.
+TEST_F(SortedAccessLogSetTest, MutationLogMainLog) {
+    {
+        MutationLog ml(tmp_log_filename);
+        ml.open();
+        ml.newItem(0, makeStoredDocKey("key"));
+        ml.newItem(5, makeStoredDocKey("key"));
+        ml.commit1();
+        ml.commit2();
+    }
+    writeSegment(1, {0});
+    EXPECT_FALSE(SortedAccessLogSet::exists(tmp_log_filename));
+
+    // Nor can they be compacted without it
+    SortedAccessLogSet alog(tmp_log_filename);
+    EXPECT_THROW(alog.open(), SortedAccessLog::ReadException);
+}
+
+TEST_F(SortedAccessLogSetTest, Compact) {
+    writeLog();
+    writeSegment(1, {0, 1});
+    SortedAccessLogSet alog(tmp_log_filename);
+    alog.open();
+    EXPECT_EQ(3, alog.compact(compacted));
+
+    SortedAccessLog merged(compacted);
+    merged.open();
+    EXPECT_EQ(std::vector<uint16_t>({0, 1, 2}), merged.getVBuckets());
+    EXPECT_EQ(3, merged.getNumEntries());
+    const auto vb2 = merged.getVBucket(2);
+    ASSERT_EQ(1, vb2.size());
+    EXPECT_EQ(makeStoredDocKey("key5"), vb2.getKey(*vb2.begin()));
+    // Scores are kept
+    EXPECT_EQ(3, vb2.begin()->score);
+}
+
+TEST_F(SortedAccessLogSetTest, CorruptSegment) {
+    writeLog();
+    writeSegment(1, {0});
+    const auto segment = SortedAccessLogSet::getSegmentPath(tmp_log_filename, 1);
+    {
+        std::ofstream file(segment, std::ios::binary | std::ios::app);
+        file << "junk";
+    }
+    SortedAccessLogSet alog(tmp_log_filename);
+    EXPECT_THROW(alog.open(), SortedAccessLog::ReadException);
+}
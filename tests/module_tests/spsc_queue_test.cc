@@ -0,0 +1,91 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "spsc_queue.h"
+
+#include <thread>
+
+TEST(SpscQueueTest, initAssumptions) {
+    SpscQueue<int> queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0u, queue.size());
+    int value;
+    EXPECT_FALSE(queue.front(value));
+    EXPECT_FALSE(queue.pop(value));
+}
+
+// FIFO order holds across chunk boundaries, with the queue emptied and
+// refilled part way through a chunk.
+TEST(SpscQueueTest, fifoAcrossChunks) {
+    SpscQueue<int, 4> queue;
+    int next = 0;
+    int expected = 0;
+    for (int round = 0; round < 5; ++round) {
+        for (int ii = 0; ii < 7; ++ii) {
+            queue.push(next++);
+        }
+        EXPECT_EQ(7u, queue.size());
+        int value;
+        while (queue.pop(value)) {
+            EXPECT_EQ(expected++, value);
+        }
+        EXPECT_TRUE(queue.empty());
+    }
+    EXPECT_EQ(next, expected);
+}
+
+TEST(SpscQueueTest, frontDoesNotPop) {
+    SpscQueue<int, 2> queue;
+    queue.push(1);
+    queue.push(2);
+    int value;
+    ASSERT_TRUE(queue.front(value));
+    EXPECT_EQ(1, value);
+    ASSERT_TRUE(queue.front(value));
+    EXPECT_EQ(1, value);
+    ASSERT_TRUE(queue.pop(value));
+    EXPECT_EQ(1, value);
+    ASSERT_TRUE(queue.front(value));
+    EXPECT_EQ(2, value);
+}
+
+// One thread pushing while another pops sees every value, in order.
+TEST(SpscQueueTest, concurrentPushPop) {
+    SpscQueue<size_t, 16> queue;
+    const size_t count = 100000;
+
+    std::thread producer([&queue, count]() {
+        for (size_t ii = 0; ii < count; ++ii) {
+            queue.push(ii);
+        }
+    });
+
+    size_t expected = 0;
+    while (expected < count) {
+        size_t value;
+        if (queue.pop(value)) {
+            ASSERT_EQ(expected, value);
+            ++expected;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(queue.empty());
+}